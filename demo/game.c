@@ -8,6 +8,7 @@
 #include "asset_cache.h"
 #include "collision.h"
 #include "forces.h"
+#include "scheduler.h"
 #include "sdl_wrapper.h"
 #include <SDL2/SDL_image.h>
 #include <SDL2/SDL_ttf.h>
@@ -49,11 +50,50 @@ const char *BOWSER_VICTORY_SKIN = "assets/Bowser_Winner.png";
 const char *MARIO_LOSER_SKIN = "assets/Loser_Mario.png";
 const char *BOWSER_LOSER_SKIN = "assets/Loser_Bowser.png";
 const char *HEALTH_UP = "assets/plus health.png";
+
+// Sprites swapped in every frame, resolved to asset IDs once at startup
+typedef enum {
+  MARIO_RIGHT_SPRITE,
+  MARIO_LEFT_SPRITE,
+  POWERED_MARIO_RIGHT_SPRITE,
+  POWERED_MARIO_LEFT_SPRITE,
+  MARIO_ATTACKED_SPRITE,
+  BOWSER_RIGHT_SPRITE,
+  BOWSER_LEFT_SPRITE,
+  POWERED_BOWSER_RIGHT_SPRITE,
+  POWERED_BOWSER_LEFT_SPRITE,
+  BOWSER_ATTACKED_RIGHT_SPRITE,
+  BOWSER_ATTACKED_LEFT_SPRITE,
+  MARIO_VICTORY_SPRITE,
+  MARIO_LOSER_SPRITE,
+  BOWSER_VICTORY_SPRITE,
+  BOWSER_LOSER_SPRITE,
+  BACKGROUND_SPRITE,
+  NUM_SPRITES
+} sprite_t;
 const char *PLAYER_TYPE = "PLAYER";
 const char *STANDARD_BULLET_TYPE = "STANDARD";
 const char *BOMB_BULLET_TYPE = "BOMB";
 const char *GOOMBA_TYPE = "GOOMBA";
 const char *MYSTERY_TYPE = "MYSTERY";
+//collision categories, one bit each, and what each collides with; only pairs
+//that handle_collisions does something with are ever tested
+typedef enum {
+  PLAYER_CATEGORY = 1 << 0,
+  BULLET_CATEGORY = 1 << 1,
+  GOOMBA_CATEGORY = 1 << 2,
+  MYSTERY_CATEGORY = 1 << 3,
+  //these only pick out bodies for the force fields, and are always set
+  //alongside one of the categories above
+  MARIO_CATEGORY = 1 << 4,
+  BOWSER_CATEGORY = 1 << 5,
+  BOMB_CATEGORY = 1 << 6,
+  PLAYER_MASK = BULLET_CATEGORY | GOOMBA_CATEGORY | MYSTERY_CATEGORY,
+  BULLET_MASK = PLAYER_CATEGORY | GOOMBA_CATEGORY,
+  GOOMBA_MASK = PLAYER_CATEGORY | BULLET_CATEGORY,
+  MYSTERY_MASK = PLAYER_CATEGORY,
+  HEART_MASK = 0
+} collision_category_t;
 const char *MARIO_HEALTH = "100";
 const char *BOWSER_HEALTH = "100";
 const char *POWER_UPS[] = {"SPEED", "HEALTH", "INVINCIBILITY", "BOMB"};
@@ -90,6 +130,7 @@ const double GOOMBA_RADIUS = 30;
 const double BULLET_RADIUS = 30;
 const double HEART_RADIUS = 30;
 const double MYSTERY_BOX_RADIUS = 30;
+const size_t MAX_SPAWN_ATTEMPTS = 8;
 const double GOOMBA_VELOCITY = 25.0;
 const double JUMP_VELOCITY = 800.0;
 const double BULLET_SHIFT = 80.5;
@@ -120,7 +161,15 @@ const size_t BOWSER_CHARACTER = 1;
 const size_t BACKGROUND_ASSET = 0;
 const size_t MARIO_ASSET = 1;
 const size_t BOWSER_ASSET = 2;
+const size_t CHARACTER_DATA = 0;
+const size_t ASSET_DATA = 1;
 const int16_t H_STEP = 5;
+//the physics runs at a fixed rate, whatever the frame rate
+const double TICK_RATE = 120;
+const size_t MAX_SUBSTEPS = 8;
+//bodies that sit still for a quarter second stop being ticked
+const uint32_t SLEEP_TICKS = 30;
+const double SLEEP_SPEED = 1;
 
 struct state {
   list_t *body_assets;
@@ -130,6 +179,7 @@ struct state {
   list_t *sounds;
   list_t *characters;
   scene_t *scene;
+  scheduler_t *scheduler;
   double timer;
   double goomba_timer;
   double goomba_count;
@@ -145,11 +195,16 @@ struct state {
   bool bombs_only;
   bool is_win;
   bool winner; // true for mario and false for bowser
+  //the scene's force fields, so the win screen can change them
+  size_t gravity_field;
+  size_t mario_ground_field;
+  size_t bowser_ground_field;
   asset_t *mario_health;
   asset_t *bowser_health;
   asset_t *mario_power;
   asset_t *bowser_power;
   asset_t *restart_button;
+  asset_id_t sprites[NUM_SPRITES];
 };
 
 double rand_neg1_or_1() {
@@ -164,34 +219,47 @@ size_t rand_int(size_t low, size_t high) {
   return rand() % (high - low + 1) + low;
 }
 
-body_t *make_body(double outer_radius, double inner_radius, vector_t center) {
-  center.y += inner_radius;
-  list_t *c = list_init(NUM_POINTS, free);
-  for (size_t i = 0; i < NUM_POINTS; i++) {
-    double angle = 2 * M_PI * i / NUM_POINTS;
-    vector_t *v = malloc(sizeof(*v));
-    assert(v != NULL);
-    *v = (vector_t){center.x + inner_radius * cos(angle),
-                    center.y + outer_radius * sin(angle)};
-    list_add(c, v);
+// Outlines built by make_body, shared by every body with the same radii
+typedef struct {
+  double outer_radius;
+  double inner_radius;
+  shape_t *shape;
+} body_shape_t;
+
+#define MAX_BODY_SHAPES 8
+body_shape_t BODY_SHAPES[MAX_BODY_SHAPES];
+size_t NUM_BODY_SHAPES = 0;
+
+shape_t *get_body_shape(double outer_radius, double inner_radius) {
+  for (size_t i = 0; i < NUM_BODY_SHAPES; i++) {
+    if (BODY_SHAPES[i].outer_radius == outer_radius &&
+        BODY_SHAPES[i].inner_radius == inner_radius) {
+      return BODY_SHAPES[i].shape;
+    }
   }
-  body_t *player = body_init(c, 1, PLAYER_COLOR);
-  return player;
+  shape_t *shape = outer_radius == inner_radius
+                       ? shape_init_circle(inner_radius, NUM_POINTS)
+                       : shape_init_ellipse(inner_radius, outer_radius,
+                                            NUM_POINTS);
+  assert(NUM_BODY_SHAPES < MAX_BODY_SHAPES);
+  BODY_SHAPES[NUM_BODY_SHAPES] =
+      (body_shape_t){outer_radius, inner_radius, shape};
+  return BODY_SHAPES[NUM_BODY_SHAPES++].shape;
 }
 
-void apply_gravity(body_t *body, state_t *state, double min_y) {
-  vector_t body_vel = body_get_velocity(body);
-  vector_t body_pos = body_get_centroid(body);
-  bool is_jumping = (body_vel.y > 0);
-  if (body_pos.y > min_y) {
-    body_add_force(body, (vector_t){0, -GRAVITY_CONSTANT});
-  }
-  else {
-    if (!is_jumping) {
-    body_reset(body);
-    body_set_velocity(body, (vector_t){body_vel.x, 0});
-  }
+void free_body_shapes() {
+  for (size_t i = 0; i < NUM_BODY_SHAPES; i++) {
+    shape_release(BODY_SHAPES[i].shape);
   }
+  NUM_BODY_SHAPES = 0;
+}
+
+body_t *make_body(double outer_radius, double inner_radius, vector_t center) {
+  center.y += inner_radius;
+  body_t *player =
+      body_init_from_shape(get_body_shape(outer_radius, inner_radius), center,
+                           1, PLAYER_COLOR, NULL, NULL);
+  return player;
 }
 
 void jump(body_t *player, state_t *state) {
@@ -209,23 +277,23 @@ void jump(body_t *player, state_t *state) {
 }
 
 //animation for when a player collects a mystery box
-void powerup_oscillation(state_t *state, asset_t *asset, const char *filepath1, 
-                          const char *filepath2){
+void powerup_oscillation(state_t *state, asset_t *asset, sprite_t sprite1,
+                         sprite_t sprite2){
   if (state->frozen) {
     if (state->freeze_timer < FREEZE_INTERVALS[0]) {
-      asset_change_texture(asset, filepath1);
+      asset_change_texture_id(asset, state->sprites[sprite1]);
     }
     else if (state->freeze_timer < FREEZE_INTERVALS[1]) {
-      asset_change_texture(asset, filepath2);
+      asset_change_texture_id(asset, state->sprites[sprite2]);
     }
     else if (state->freeze_timer < FREEZE_INTERVALS[2]) {
-      asset_change_texture(asset, filepath1);
+      asset_change_texture_id(asset, state->sprites[sprite1]);
     }
     else if (state->freeze_timer < FREEZE_INTERVALS[3]) {
-      asset_change_texture(asset, filepath2);
+      asset_change_texture_id(asset, state->sprites[sprite2]);
     }
     else {
-      asset_change_texture(asset, filepath1);
+      asset_change_texture_id(asset, state->sprites[sprite1]);
     }
   }
 }
@@ -237,47 +305,53 @@ void powerup_animation(state_t *state, character_t *character) {
     character_t *mario = list_get(state->characters, MARIO_CHARACTER);
       if (character == mario) {
         if (character_get_direction(character)) {
-          powerup_oscillation(state, mario_asset, POWERED_MARIO_PATH_RIGHT, 
-                              MARIO_PATH_RIGHT);
+          powerup_oscillation(state, mario_asset, POWERED_MARIO_RIGHT_SPRITE,
+                              MARIO_RIGHT_SPRITE);
         }
         else {
-          powerup_oscillation(state, mario_asset, POWERED_MARIO_PATH_LEFT, 
-                              MARIO_PATH_LEFT);
+          powerup_oscillation(state, mario_asset, POWERED_MARIO_LEFT_SPRITE,
+                              MARIO_LEFT_SPRITE);
         }
       }
       else {
         if (character_get_direction(character)) {
-          powerup_oscillation(state, bowser_asset, POWERED_BOWSER_PATH_RIGHT, 
-                              BOWSER_PATH_RIGHT);
+          powerup_oscillation(state, bowser_asset, POWERED_BOWSER_RIGHT_SPRITE,
+                              BOWSER_RIGHT_SPRITE);
         }
         else {
-          powerup_oscillation(state, bowser_asset, POWERED_BOWSER_PATH_LEFT, 
-                              BOWSER_PATH_LEFT);
+          powerup_oscillation(state, bowser_asset, POWERED_BOWSER_LEFT_SPRITE,
+                              BOWSER_LEFT_SPRITE);
         }
       }
 }
 
+//hangs a body's character and asset off its scene handle
+void attach_body(state_t *state, body_t *body, character_t *character,
+                 asset_t *asset) {
+  body_handle_t handle = body_get_handle(body);
+  scene_set_handle_data(state->scene, handle, CHARACTER_DATA, character);
+  scene_set_handle_data(state->scene, handle, ASSET_DATA, asset);
+}
+
 void fire_bullet(bool fire_left, character_t *character, state_t *state) {
   if (character_get_fire(character)) {
-    double gravity = 0;
-    char *bullet_type = malloc(sizeof(char) * CHAR_SIZE);
-    assert(bullet_type != NULL);
+    uint32_t bullet_category = BULLET_CATEGORY;
+    const char *bullet_type = STANDARD_BULLET_TYPE;
     bool direction = true;
     bool is_bomb = false;
-    char *bullet_path = malloc(sizeof(char) * CHAR_SIZE);
-    assert(bullet_path != NULL);
+    const char *bullet_path = RIGHT_STANDARD_BULLET;
     vector_t bullet_vel = {STANDARD_BULLET, 0};
     if (strcmp(character_get_bullet_type(character), STANDARD_BULLET_TYPE) 
         == 0) {
-      bullet_type = strdup(STANDARD_BULLET_TYPE);
-      bullet_path = strdup(RIGHT_STANDARD_BULLET);
+      bullet_type = STANDARD_BULLET_TYPE;
+      bullet_path = RIGHT_STANDARD_BULLET;
     }
     if ((strcmp(character_get_bullet_type(character), BOMB_BULLET_TYPE) == 0 ||
           state->bombs_only)) {
       bullet_vel = BOMB_VEL;
-      gravity = GRAVITY_CONSTANT;
-      bullet_type = strdup(BOMB_BULLET_TYPE);
-      bullet_path = strdup(RIGHT_BOMB_BULLET);
+      bullet_category |= BOMB_CATEGORY;
+      bullet_type = BOMB_BULLET_TYPE;
+      bullet_path = RIGHT_BOMB_BULLET;
       is_bomb = true;
     }
     body_t *player = character_get_body(character);
@@ -289,24 +363,27 @@ void fire_bullet(bool fire_left, character_t *character, state_t *state) {
       bullet_pos.x -= 2 * BULLET_SHIFT;
       direction = false;
       if (is_bomb) {
-        bullet_path = strdup(LEFT_BOMB_BULLET);
+        bullet_path = LEFT_BOMB_BULLET;
       }
       else {
-        bullet_path = strdup(LEFT_STANDARD_BULLET);
+        bullet_path = LEFT_STANDARD_BULLET;
       }
     }
     body_t *bullet = make_body(BULLET_RADIUS, BULLET_RADIUS, VEC_ZERO);
     body_set_centroid(bullet, bullet_pos);
     body_set_velocity(bullet, bullet_vel);
-    body_add_force(bullet, (vector_t){0, -gravity});
+    //bullets can outrun a slow frame, so the scene sweeps them for hits
+    body_set_fast(bullet, true);
+    body_set_collision_filter(bullet, bullet_category, BULLET_MASK);
     scene_add_body(state->scene, bullet);
     asset_t *bullet_asset =
       asset_make_image_with_body(bullet_path, scene_get_body(state->scene, 
       scene_bodies(state->scene) - 1));
     list_add(state->bullet_assets, bullet_asset);
-    character_t *bullet_char = character_init(bullet, bullet_type, 0, 0, 0, 0, 
+    character_t *bullet_char = character_init(bullet, (char *)bullet_type, 0, 0, 0, 0, 
     NULL, direction);
     list_add(state->characters, bullet_char);
+    attach_body(state, bullet, bullet_char, bullet_asset);
     character_set_fire(character, false);
     character_set_fire_time(character, 0.0);
     Mix_Chunk *fire_sound = sdl_sound(FIREBALL_SOUND);
@@ -427,26 +504,20 @@ void on_key(char key, key_event_type_t type, double held_time, state_t *state) {
     body_set_centroid(player2, new_centroid2);
 }
 
+//detaches the character from the body and marks the body for removal;
+//the character is freed by sweep_detached()
 void remove_character(state_t *state, body_t *body) {
-    for (size_t i = 0; i < list_size(state->characters); i++) {
-      character_t *character = list_get(state->characters, i);
-        if (character_get_body(character) == body) {
-            list_remove(state->characters, i);
-            character_free(character);
-            break;
-        }
-    }
+    scene_set_handle_data(state->scene, body_get_handle(body), CHARACTER_DATA,
+                          NULL);
+    body_remove(body);
 }
 
-void remove_asset(list_t *list, body_t *body) {
-    for (size_t i = 0; i < list_size(list); i++) {
-        asset_t *asset = list_get(list, i);
-        if (asset_get_body(asset) == body) {
-            asset_destroy(asset);
-            list_remove(list, i);
-            break;
-        }
-    }
+//detaches the asset from the body and marks the body for removal;
+//the asset is destroyed by sweep_detached()
+void remove_asset(state_t *state, body_t *body) {
+    scene_set_handle_data(state->scene, body_get_handle(body), ASSET_DATA,
+                          NULL);
+    body_remove(body);
 }
 
 void generate_goomba(state_t *state) {
@@ -457,6 +528,7 @@ void generate_goomba(state_t *state) {
                                         (vector_t){GOOMBA_VELOCITY, 0});
     body_set_centroid(goomba, goomba_pos);
     body_set_velocity(goomba, goomba_vel);
+    body_set_collision_filter(goomba, GOOMBA_CATEGORY, GOOMBA_MASK);
     scene_add_body(state->scene, goomba);
     asset_t *goomba_asset =
       asset_make_image_with_body(GOOMBA_PATH, scene_get_body(state->scene, 
@@ -465,14 +537,38 @@ void generate_goomba(state_t *state) {
     character_t *goomba_char = character_init(goomba, (char *) GOOMBA_TYPE, 0, 
                                               0, 0, 0, NULL, NULL);
     list_add(state->characters, goomba_char);
+    attach_body(state, goomba, goomba_char, goomba_asset);
+}
+
+bool mark_occupied(body_t *body, bool *occupied) {
+  *occupied = true;
+  return false;
+}
+
+//whether any body comes within radius of a point
+bool is_occupied(state_t *state, vector_t point, double radius) {
+  bool occupied = false;
+  scene_query_radius(state->scene, point, radius,
+                     (scene_query_t)mark_occupied, &occupied);
+  return occupied;
 }
 
 void generate_mystery_box(state_t *state) {
   body_t *mystery = make_body(MYSTERY_BOX_RADIUS, MYSTERY_BOX_RADIUS, 
                                 VEC_ZERO);
-  vector_t mystery_pos = {rand_double(0, MAX.x), 
-                         rand_double(POWER_UP_MIN_HEIGHT, POWER_UP_MAX_HEIGHT)};
+  //try a few spots so the box doesn't appear on top of something
+  vector_t mystery_pos;
+  size_t attempts = 0;
+  do {
+    mystery_pos = (vector_t){rand_double(0, MAX.x),
+                        rand_double(POWER_UP_MIN_HEIGHT, POWER_UP_MAX_HEIGHT)};
+  } while (++attempts < MAX_SPAWN_ATTEMPTS &&
+           is_occupied(state, mystery_pos, MYSTERY_BOX_RADIUS));
   body_set_centroid(mystery, mystery_pos);
+  //boxes are picked up, not bumped into, and never move
+  body_set_sensor(mystery, true);
+  body_set_type(mystery, BODY_TYPE_STATIC);
+  body_set_collision_filter(mystery, MYSTERY_CATEGORY, MYSTERY_MASK);
   scene_add_body(state->scene, mystery);
   asset_t *mystery_asset =
     asset_make_image_with_body(MYSTERY_BOX_PATH, scene_get_body(state->scene, 
@@ -481,6 +577,7 @@ void generate_mystery_box(state_t *state) {
   character_t *mystery_char = character_init(mystery, (char *) MYSTERY_TYPE, 
                                               0, 0, 0, 0, NULL, NULL);
   list_add(state->characters, mystery_char);
+  attach_body(state, mystery, mystery_char, mystery_asset);
 }
 
 //updates the floating powerup texts above the players
@@ -500,6 +597,9 @@ void health_animation(state_t *state, character_t *character) {
    heart_pos.y += HEART_SHIFT;
    body_t *heart = make_body(HEART_RADIUS, HEART_RADIUS, VEC_ZERO);
    body_set_centroid(heart, heart_pos);
+   //the heart is only drawn, never collided with
+   body_set_sensor(heart, true);
+   body_set_collision_filter(heart, 0, HEART_MASK);
    asset_t *heart_asset = asset_make_image_with_body(HEALTH_UP, heart);
    list_add(state->heart_assets, heart_asset);
 }
@@ -526,27 +626,23 @@ void update_win(state_t *state, character_t *loser) {
     body_set_centroid(loser_body, LOSER_POSITION);
     body_set_velocity(loser_body, MIN);
   }
+  //only the players fall on the win screen, and the winner lands higher up
+  force_field_t gravity = scene_get_force_field(state->scene,
+                                                state->gravity_field);
+  gravity.category = PLAYER_CATEGORY;
+  scene_set_force_field(state->scene, state->gravity_field, gravity);
+  size_t winner_ground = state->winner ? state->mario_ground_field
+                                       : state->bowser_ground_field;
+  force_field_t ground = scene_get_force_field(state->scene, winner_ground);
+  ground.height = WINNER_POSITION.y;
+  scene_set_force_field(state->scene, winner_ground, ground);
   state->is_win = true;
 }
 
 //applies an animation to the winner of the game
 void update_win_screen(state_t *state) {
-  character_t *mario = list_get(state->characters, MARIO_CHARACTER);
-  character_t *bowser = list_get(state->characters, BOWSER_CHARACTER);
-  if (state->winner) {
-    body_t *winner = character_get_body(mario);
-    body_t *loser = character_get_body(bowser);
-    jump(winner, state);
-    apply_gravity(winner, state, WINNER_POSITION.y);
-    apply_gravity(loser, state, START_POS2.y);
-  }
-  else {
-    body_t *winner = character_get_body(bowser);
-    body_t *loser = character_get_body(mario);
-    jump(winner, state);
-    apply_gravity(winner, state, WINNER_POSITION.y);
-    apply_gravity(loser, state, START_POS1.y);
-  }
+  size_t winner = state->winner ? MARIO_CHARACTER : BOWSER_CHARACTER;
+  jump(character_get_body(list_get(state->characters, winner)), state);
 }
 
 bool compare_character_type(character_t *character, const char* type) {
@@ -562,26 +658,24 @@ void handle_collisions(state_t *state, character_t *character1,
     if ((compare_character_type(character1, STANDARD_BULLET_TYPE) ||
           compare_character_type(character1, BOMB_BULLET_TYPE)) && 
           compare_character_type(character2, GOOMBA_TYPE)) {
-        remove_asset(state->bullet_assets, body1);
-        remove_asset(state->body_assets, body2);
+        remove_asset(state, body1);
+        remove_asset(state, body2);
         remove_character(state, body1);
         remove_character(state, body2);
-        create_destructive_collision(state->scene, body1, body2);
     } 
     else if ((compare_character_type(character2, STANDARD_BULLET_TYPE) ||
               compare_character_type(character2, BOMB_BULLET_TYPE)) && 
               compare_character_type(character1, GOOMBA_TYPE)) {
-        remove_asset(state->bullet_assets, body2);
-        remove_asset(state->body_assets, body1);
+        remove_asset(state, body2);
+        remove_asset(state, body1);
         remove_character(state, body2);
         remove_character(state, body1);
-        create_destructive_collision(state->scene, body2, body1);
     }
     //Player - Mystery Box collisions
     else if (compare_character_type(character1, PLAYER_TYPE)
               && compare_character_type(character2, MYSTERY_TYPE)) {
         freeze_screen(state, 1.0);
-        remove_asset(state->body_assets, body2);
+        remove_asset(state, body2);
         remove_character(state, body2);
         create_physics_collision(state->scene, body1, body2, 0.0);
         body_remove(body2);
@@ -617,7 +711,7 @@ void handle_collisions(state_t *state, character_t *character1,
     else if (compare_character_type(character1, PLAYER_TYPE) && 
     (compare_character_type(character2, STANDARD_BULLET_TYPE) || 
     compare_character_type(character2, BOMB_BULLET_TYPE))) {
-      remove_asset(state->bullet_assets, body2);
+      remove_asset(state, body2);
       remove_character(state, body2);
       if (compare_character_type(character2, BOMB_BULLET_TYPE)) {
         character_change_health(character1, BOMB_DAMAGE);
@@ -655,7 +749,7 @@ void handle_collisions(state_t *state, character_t *character1,
     // Player - Goomba Collisions
     else if (compare_character_type(character1, PLAYER_TYPE)
     && compare_character_type(character2, GOOMBA_TYPE)) {
-      remove_asset(state->body_assets, body2);
+      remove_asset(state, body2);
       remove_character(state, body2);
       create_physics_collision(state->scene, body1, body2, 0.0);
       body_remove(body2);
@@ -678,33 +772,79 @@ void handle_collisions(state_t *state, character_t *character1,
     }
   }
 
-void collisions(state_t *state) {
-  for (size_t i = 0; i < list_size(state->characters); i++) {
-    character_t *character1 = list_get(state->characters, i);
-      for (size_t j = i + 1; j < list_size(state->characters); j++) {
-        character_t *character2 = list_get(state->characters, j);
-        collision_info_t collision = 
-          find_collision(character_get_body(character1), 
-                          character_get_body(character2)); 
-        if (collision.collided) {
-          handle_collisions(state, character1, character2, collision);
-        }
-      }
+bool character_is_live(character_t *character) {
+  return !body_is_removed(character_get_body(character));
+}
+
+//called by the scene's contact stage; the type handlers pass players first,
+//then bullets before goombas, as handle_collisions expects
+void collisions(body_t *body1, body_t *body2, contact_event_t event,
+                collision_info_t collision, state_t *state) {
+  if (event == CONTACT_EXIT) {
+    return;
+  }
+  character_t *character1 = scene_get_handle_data(state->scene,
+                              body_get_handle(body1), CHARACTER_DATA);
+  character_t *character2 = scene_get_handle_data(state->scene,
+                              body_get_handle(body2), CHARACTER_DATA);
+  if (character1 == NULL || character2 == NULL ||
+      !character_is_live(character1) || !character_is_live(character2)) {
+    return;
+  }
+  handle_collisions(state, character1, character2, collision);
+}
+
+void add_collision_handlers(state_t *state) {
+  scene_add_type_handler(state->scene, PLAYER_CATEGORY, PLAYER_MASK,
+                         (contact_handler_t)collisions, state, NULL);
+  scene_add_type_handler(state->scene, BULLET_CATEGORY, GOOMBA_CATEGORY,
+                         (contact_handler_t)collisions, state, NULL);
+}
+
+void print_broadphase_stats(state_t *state) {
+  broadphase_stats_t stats = scene_get_broadphase_stats(state->scene);
+  if (stats.num_updates == 0) {
+    return;
   }
+  printf("broadphase: %zu frames, %.1f pairs and %.1f box tests per frame, "
+         "%.2f us per frame\n", stats.num_updates,
+         (double)stats.total_pairs / stats.num_updates,
+         (double)stats.total_tests / stats.num_updates,
+         stats.total_seconds / stats.num_updates * 1e6);
+}
+
+bool character_is_detached(character_t *character, scene_t *scene) {
+  body_handle_t handle = body_get_handle(character_get_body(character));
+  return scene_get_handle_data(scene, handle, CHARACTER_DATA) != character;
+}
+
+bool asset_is_detached(asset_t *asset, scene_t *scene) {
+  body_t *body = asset_get_body(asset);
+  if (body == NULL) {
+    return false;
+  }
+  body_handle_t handle = body_get_handle(body);
+  return scene_get_handle_data(scene, handle, ASSET_DATA) != asset;
+}
+
+//frees the characters and assets detached this frame in one pass per list
+void sweep_detached(state_t *state) {
+  list_remove_if(state->characters, (list_pred_t)character_is_detached,
+                 state->scene, (free_func_t)character_free);
+  list_remove_if(state->body_assets, (list_pred_t)asset_is_detached,
+                 state->scene, (free_func_t)asset_destroy);
+  list_remove_if(state->bullet_assets, (list_pred_t)asset_is_detached,
+                 state->scene, (free_func_t)asset_destroy);
 }
 
 //frees the bullets if they leave the screen
 void free_bullets(state_t *state) {
   for (size_t i = 0; i < list_size(state->bullet_assets); i++) {
-    asset_t *bullet = list_get(state->bullet_assets, i);
-    body_t *body = asset_get_body(bullet);
-    if (body_get_centroid(body).x > MAX.x || body_get_centroid(body).x < MIN.x
-    || body_get_centroid(body).y < MIN.y) {
-      body_remove(body);
-      asset_destroy(bullet);
+    body_t *body = asset_get_body(list_get(state->bullet_assets, i));
+    vector_t centroid = body_get_centroid(body);
+    if (centroid.x > MAX.x || centroid.x < MIN.x || centroid.y < MIN.y) {
+      remove_asset(state, body);
       remove_character(state, body);
-      list_remove(state->bullet_assets, i);
-      i--;
     }
   }
 }
@@ -722,6 +862,14 @@ void wrap_edges(body_t *body) {
   }
 }
 
+//gravity and the floors are force fields set up by add_force_fields, so the
+//scene applies them on every tick
+void step_physics(state_t *state, double dt) {
+  scene_tick(state->scene, dt);
+  //bodies removed during the tick are freed by the next one
+  sweep_detached(state);
+}
+
 void update_health_texts(asset_t *health_text, character_t *character) {
   double health = character_get_health(character);
   char *health_text_content = malloc(sizeof(char) * CHAR_SIZE);
@@ -749,8 +897,26 @@ void bombs_only(state_t *state) {
   state->loading = false;
 }
 
+//registers gravity for everything that falls, and the floor each kind of body
+//lands on; the floors come after the gravity they hold bodies up against
+void add_force_fields(state_t *state) {
+  uint32_t falling = PLAYER_CATEGORY | BOMB_CATEGORY | GOOMBA_CATEGORY;
+  vector_t gravity = {0, -GRAVITY_CONSTANT};
+  state->gravity_field = create_gravity_field(state->scene, falling, gravity);
+  state->mario_ground_field = create_ground_field(
+      state->scene, MARIO_CATEGORY, AABB_EVERYWHERE, START_POS1.y);
+  state->bowser_ground_field = create_ground_field(
+      state->scene, BOWSER_CATEGORY, AABB_EVERYWHERE, START_POS2.y);
+  create_ground_field(state->scene, BOMB_CATEGORY, AABB_EVERYWHERE, 0);
+  create_ground_field(state->scene, GOOMBA_CATEGORY, AABB_EVERYWHERE,
+                      GOOMBA_MINIMUM_HEIGHT);
+}
+
 void init_game(state_t *state) {
   state->scene = scene_init();
+  scene_set_sleep(state->scene, SLEEP_TICKS, SLEEP_SPEED);
+  add_collision_handlers(state);
+  add_force_fields(state);
   state->body_assets = list_init(2, (free_func_t)asset_destroy);
   state->bullet_assets = list_init(2, (free_func_t)asset_destroy);
   state->button_assets = list_init(2, (free_func_t)asset_destroy);
@@ -762,6 +928,10 @@ void init_game(state_t *state) {
   body_set_centroid(player1, START_POS1);
   body_t *player2 = make_body(OUTER_RADIUS, INNER_RADIUS, VEC_ZERO);
   body_set_centroid(player2, START_POS2);
+  body_set_collision_filter(player1, PLAYER_CATEGORY | MARIO_CATEGORY,
+                            PLAYER_MASK);
+  body_set_collision_filter(player2, PLAYER_CATEGORY | BOWSER_CATEGORY,
+                            PLAYER_MASK);
   scene_add_body(state->scene, player1);
   scene_add_body(state->scene, player2);
 
@@ -793,6 +963,8 @@ void init_game(state_t *state) {
                                   scene_get_body(state->scene, 1));
   list_add(state->body_assets, player_asset1);
   list_add(state->body_assets, player_asset2);
+  attach_body(state, player1, mario, player_asset1);
+  attach_body(state, player2, bowser, player_asset2);
 
 
   asset_t *bomb_button_im = asset_make_image(BOMB_BUTTON_PATH, 
@@ -835,6 +1007,7 @@ void reset(state_t *state) {
   remove_entire_list(state->heart_assets);
   remove_entire_list(state->characters);
   remove_entire_list(state->sounds);
+  print_broadphase_stats(state);
   scene_free(state->scene);
   init_game(state);
   asset_t *restart_button_image = asset_make_image(RESTART_BUTTON, 
@@ -847,6 +1020,32 @@ void reset(state_t *state) {
 }
 
 
+//resolves every per-frame sprite to its asset ID so that sprite switching
+//never has to look up a filepath
+void load_sprites(state_t *state) {
+  const char *paths[NUM_SPRITES] = {
+      [MARIO_RIGHT_SPRITE] = MARIO_PATH_RIGHT,
+      [MARIO_LEFT_SPRITE] = MARIO_PATH_LEFT,
+      [POWERED_MARIO_RIGHT_SPRITE] = POWERED_MARIO_PATH_RIGHT,
+      [POWERED_MARIO_LEFT_SPRITE] = POWERED_MARIO_PATH_LEFT,
+      [MARIO_ATTACKED_SPRITE] = MARIO_ATTACKED,
+      [BOWSER_RIGHT_SPRITE] = BOWSER_PATH_RIGHT,
+      [BOWSER_LEFT_SPRITE] = BOWSER_PATH_LEFT,
+      [POWERED_BOWSER_RIGHT_SPRITE] = POWERED_BOWSER_PATH_RIGHT,
+      [POWERED_BOWSER_LEFT_SPRITE] = POWERED_BOWSER_PATH_LEFT,
+      [BOWSER_ATTACKED_RIGHT_SPRITE] = BOWSER_ATTACKED_RIGHT,
+      [BOWSER_ATTACKED_LEFT_SPRITE] = BOWSER_ATTACKED_LEFT,
+      [MARIO_VICTORY_SPRITE] = MARIO_VICTORY_SKIN,
+      [MARIO_LOSER_SPRITE] = MARIO_LOSER_SKIN,
+      [BOWSER_VICTORY_SPRITE] = BOWSER_VICTORY_SKIN,
+      [BOWSER_LOSER_SPRITE] = BOWSER_LOSER_SKIN,
+      [BACKGROUND_SPRITE] = BACKGROUND_PATH,
+  };
+  for (size_t i = 0; i < NUM_SPRITES; i++) {
+    state->sprites[i] = asset_cache_get_id(ASSET_IMAGE, paths[i]);
+  }
+}
+
 state_t *emscripten_init() {
   asset_cache_init();
   sdl_init(MIN, MAX);
@@ -854,6 +1053,8 @@ state_t *emscripten_init() {
   state_t *state = malloc(sizeof(state_t));
   assert(state != NULL);
   srand(time(NULL));
+  load_sprites(state);
+  state->scheduler = scheduler_init(TICK_RATE, MAX_SUBSTEPS);
   init_game(state);
   asset_t *restart_button_image = asset_make_image(RESTART_BUTTON, 
                                                   RESTART_BOUNDING_BOX);
@@ -870,7 +1071,10 @@ state_t *emscripten_init() {
 bool emscripten_main(state_t *state) {
   character_t *mario = list_get(state->characters, MARIO_CHARACTER);
   character_t *bowser = list_get(state->characters, BOWSER_CHARACTER);
-  double dt = time_since_last_tick();
+  size_t ticks = scheduler_frame(state->scheduler);
+  double tick_dt = scheduler_get_dt(state->scheduler);
+  //the game's timers follow the time simulated this frame
+  double dt = ticks * tick_dt;
   state->timer += dt;
   //win animation
   if (state->is_win) {
@@ -935,9 +1139,6 @@ bool emscripten_main(state_t *state) {
       body_set_velocity(player2, player2_vel);
       state->velocity_timer = 0.0;
     }
-    collisions(state);
-    apply_gravity(player1, state, START_POS1.y);
-    apply_gravity(player2, state, START_POS2.y);
     if (list_size(state->heart_assets) > 0) {
       clear_hearts(state);
       character_set_health_boost(mario, false);
@@ -945,16 +1146,12 @@ bool emscripten_main(state_t *state) {
     }
     for (size_t i = 0; i < list_size(state->characters); i++) {
       character_t *character = list_get(state->characters, i);
-      if (compare_character_type(character, BOMB_BULLET_TYPE)) {
-        apply_gravity(character_get_body(character), state, 0);
-      }
       if (compare_character_type(character, GOOMBA_TYPE)) {
-        apply_gravity(character_get_body(character), state, 
-                                          GOOMBA_MINIMUM_HEIGHT);
         wrap_edges(character_get_body(character));
       }
     }
     free_bullets(state);
+    sweep_detached(state);
     if (state->mystery_timer >= MYSTERY_INTERVAL) {
       if (state->mystery_box_count < 2) {
         generate_mystery_box(state);
@@ -972,70 +1169,77 @@ bool emscripten_main(state_t *state) {
     if (character_get_direction(mario)) {
       if (character_get_hit_time(mario) + 1 <= state->timer) {
         if (strcmp(character_get_ability(mario), DEFAULT_POWER) == 0) {
-          asset_change_texture(mario_asset, MARIO_PATH_RIGHT);
+          asset_change_texture_id(mario_asset, state->sprites[MARIO_RIGHT_SPRITE]);
         }
         else {
-          asset_change_texture(mario_asset, POWERED_MARIO_PATH_RIGHT);
+          asset_change_texture_id(mario_asset, state->sprites[POWERED_MARIO_RIGHT_SPRITE]);
         }
       }
       else {
-        asset_change_texture(mario_asset, (char *)MARIO_ATTACKED);
+        asset_change_texture_id(mario_asset, state->sprites[MARIO_ATTACKED_SPRITE]);
       }
       }
     else {
       if (character_get_hit_time(mario) + 1 <= state->timer) {
         if (strcmp(character_get_ability(mario), DEFAULT_POWER) == 0) {
-          asset_change_texture(mario_asset, MARIO_PATH_LEFT);
+          asset_change_texture_id(mario_asset, state->sprites[MARIO_LEFT_SPRITE]);
         }
         else {
-          asset_change_texture(mario_asset, POWERED_MARIO_PATH_LEFT);
+          asset_change_texture_id(mario_asset, state->sprites[POWERED_MARIO_LEFT_SPRITE]);
         }
     }
     else {
-      asset_change_texture(mario_asset, (char *)MARIO_ATTACKED);
+      asset_change_texture_id(mario_asset, state->sprites[MARIO_ATTACKED_SPRITE]);
     }
     }
     if (character_get_direction(bowser)) {
       if (character_get_hit_time(bowser) + 1 <= state->timer) {
         if (strcmp(character_get_ability(bowser), DEFAULT_POWER) == 0) {
-          asset_change_texture(bowser_asset, BOWSER_PATH_RIGHT);
+          asset_change_texture_id(bowser_asset, state->sprites[BOWSER_RIGHT_SPRITE]);
         }
         else {
-          asset_change_texture(bowser_asset, POWERED_BOWSER_PATH_RIGHT);
+          asset_change_texture_id(bowser_asset, state->sprites[POWERED_BOWSER_RIGHT_SPRITE]);
         }
       }
       else {
-        asset_change_texture(bowser_asset, BOWSER_ATTACKED_RIGHT);
+        asset_change_texture_id(bowser_asset, state->sprites[BOWSER_ATTACKED_RIGHT_SPRITE]);
       }
       }
     else {
       if (character_get_hit_time(bowser) + 1 <= state->timer) {
         if (strcmp(character_get_ability(bowser), DEFAULT_POWER) == 0) {
-          asset_change_texture(bowser_asset, BOWSER_PATH_LEFT);
+          asset_change_texture_id(bowser_asset, state->sprites[BOWSER_LEFT_SPRITE]);
         }
         else {
-          asset_change_texture(bowser_asset, POWERED_BOWSER_PATH_LEFT);
+          asset_change_texture_id(bowser_asset, state->sprites[POWERED_BOWSER_LEFT_SPRITE]);
         }
       }
       else {
-        asset_change_texture(bowser_asset, BOWSER_ATTACKED_LEFT);
+        asset_change_texture_id(bowser_asset, state->sprites[BOWSER_ATTACKED_LEFT_SPRITE]);
       }
     }
     sdl_clear();
   }
+  //only moves the objects if the game is not frozen or loading
+  if (!state->frozen && !state->loading) {
+    for (size_t i = 0; i < ticks; i++) {
+      step_physics(state, tick_dt);
+    }
+  }
+  sdl_set_interpolation(scheduler_get_alpha(state->scheduler));
   //win state rendering
   if (state->is_win) {
     if (state->winner) {
-      asset_change_texture(list_get(state->body_assets, MARIO_ASSET), 
-                                    MARIO_VICTORY_SKIN);
-      asset_change_texture(list_get(state->body_assets, BOWSER_ASSET), 
-                                    BOWSER_LOSER_SKIN);
+      asset_change_texture_id(list_get(state->body_assets, MARIO_ASSET),
+                            state->sprites[MARIO_VICTORY_SPRITE]);
+      asset_change_texture_id(list_get(state->body_assets, BOWSER_ASSET),
+                            state->sprites[BOWSER_LOSER_SPRITE]);
     }
     else {
-      asset_change_texture(list_get(state->body_assets, MARIO_ASSET), 
-                                    MARIO_LOSER_SKIN);
-      asset_change_texture(list_get(state->body_assets, BOWSER_ASSET), 
-                                    BOWSER_VICTORY_SKIN);
+      asset_change_texture_id(list_get(state->body_assets, MARIO_ASSET),
+                            state->sprites[MARIO_LOSER_SPRITE]);
+      asset_change_texture_id(list_get(state->body_assets, BOWSER_ASSET),
+                            state->sprites[BOWSER_VICTORY_SPRITE]);
     }
     asset_render(list_get(state->body_assets, BACKGROUND_ASSET));
     asset_render(list_get(state->body_assets, MARIO_ASSET));
@@ -1044,8 +1248,8 @@ bool emscripten_main(state_t *state) {
   }
   //main game rendering
   else if (!state->loading) {
-    asset_change_texture(list_get(state->body_assets, BACKGROUND_ASSET), 
-                                  BACKGROUND_PATH);
+    asset_change_texture_id(list_get(state->body_assets, BACKGROUND_ASSET),
+                            state->sprites[BACKGROUND_SPRITE]);
     for (size_t i = 0; i < list_size(state->body_assets); i++) {
       asset_render(list_get(state->body_assets, i));
     }
@@ -1070,10 +1274,6 @@ bool emscripten_main(state_t *state) {
     }
   }
   sdl_show();
-  //only moves the objects if the game is not frozen or loading
-  if (!state->frozen && !state->loading) {
-  scene_tick(state->scene, dt);
-  }
   return false;
 }
 
@@ -1084,7 +1284,10 @@ void emscripten_free(state_t *state) {
    list_free(state->sounds);
    list_free(state->characters);
    asset_cache_destroy();
+   print_broadphase_stats(state);
    scene_free(state->scene);
+   scheduler_free(state->scheduler);
+   free_body_shapes();
    free(state);
 }
 
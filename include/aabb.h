@@ -0,0 +1,96 @@
+#ifndef __AABB_H__
+#define __AABB_H__
+
+#include "vector.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * An axis-aligned bounding box, given by its lower-left and upper-right
+ * corners.
+ */
+typedef struct aabb {
+  vector_t min;
+  vector_t max;
+} aabb_t;
+
+/**
+ * The box containing every point.
+ */
+extern const aabb_t AABB_EVERYWHERE;
+
+/**
+ * Computes the smallest box containing a set of points.
+ * The box of zero points has min > max, so it overlaps nothing.
+ *
+ * @param points the points to bound
+ * @param num_points the number of points
+ * @return the bounding box of the points
+ */
+aabb_t aabb_of_points(const vector_t *points, size_t num_points);
+
+/**
+ * Moves a box by a given vector.
+ *
+ * @param box the box to move
+ * @param translation the vector to add to both corners
+ * @return the moved box
+ */
+aabb_t aabb_translate(aabb_t box, vector_t translation);
+
+/**
+ * Computes the smallest box containing two boxes.
+ *
+ * @param box1 the first box
+ * @param box2 the second box
+ * @return the union of the boxes
+ */
+aabb_t aabb_union(aabb_t box1, aabb_t box2);
+
+/**
+ * Determines whether two boxes overlap. Boxes that only touch count as
+ * overlapping.
+ *
+ * @param box1 the first box
+ * @param box2 the second box
+ * @return whether the boxes overlap
+ */
+bool aabb_overlaps(aabb_t box1, aabb_t box2);
+
+/**
+ * Determines whether a point lies inside a box, including its boundary.
+ *
+ * @param box the box
+ * @param point the point
+ * @return whether the box contains the point
+ */
+bool aabb_contains(aabb_t box, vector_t point);
+
+/**
+ * Grows a box by the same margin on every side.
+ *
+ * @param box the box
+ * @param margin the distance to move each side outwards
+ * @return the grown box
+ */
+aabb_t aabb_expand(aabb_t box, double margin);
+
+/**
+ * Computes the perimeter of a box, a measure of its size that stays
+ * meaningful for boxes of zero width or height.
+ *
+ * @param box the box
+ * @return the box's perimeter
+ */
+double aabb_perimeter(aabb_t box);
+
+/**
+ * Computes the distance from a point to the nearest point of a box.
+ *
+ * @param box the box
+ * @param point the point
+ * @return the distance, or 0 if the box contains the point
+ */
+double aabb_distance(aabb_t box, vector_t point);
+
+#endif // #ifndef __AABB_H__
@@ -0,0 +1,170 @@
+#ifndef __AABB_TREE_H__
+#define __AABB_TREE_H__
+
+#include "aabb.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * A dynamic bounding volume hierarchy over a set of boxes.
+ * Each leaf is a "proxy" holding a user data pointer and a fattened copy of
+ * its box, so small movements don't change the tree at all. The tree is kept
+ * balanced as proxies come and go, so queries visit O(log n) nodes plus the
+ * nodes that actually match.
+ */
+typedef struct aabb_tree aabb_tree_t;
+
+/**
+ * Called with the data of each proxy whose box matches a query.
+ * Takes in an auxiliary value that can store parameters or state.
+ *
+ * @return whether to keep looking for more matches
+ */
+typedef bool (*aabb_tree_query_t)(void *data, void *aux);
+
+/**
+ * Called with the data of each proxy whose box a ray passes through.
+ *
+ * @return the fraction along the ray (from 0 at start to 1 at end) where it
+ *   first hits the proxy's object, or INFINITY if it misses it
+ */
+typedef double (*aabb_tree_raycast_t)(void *data, vector_t start, vector_t end,
+                                      void *aux);
+
+/**
+ * Called with the data of proxies that could be nearest to a point.
+ * The result must be no less than the distance to the proxy's box.
+ *
+ * @return the distance from the point to the proxy's object, or INFINITY to
+ *   leave the proxy out of the results
+ */
+typedef double (*aabb_tree_distance_t)(void *data, vector_t point, void *aux);
+
+/**
+ * Allocates memory for an empty tree.
+ * Asserts that the required memory was allocated.
+ *
+ * @param margin how far to fatten every proxy's box on each side.
+ *   Larger margins mean fewer tree updates but looser queries.
+ * @return a pointer to the newly allocated tree
+ */
+aabb_tree_t *aabb_tree_init(double margin);
+
+/**
+ * Releases the memory allocated for a tree. The data is not freed.
+ *
+ * @param tree a pointer to a tree returned from aabb_tree_init()
+ */
+void aabb_tree_free(aabb_tree_t *tree);
+
+/**
+ * Returns the number of proxies in a tree.
+ *
+ * @param tree a pointer to a tree returned from aabb_tree_init()
+ * @return the number of proxies
+ */
+size_t aabb_tree_size(aabb_tree_t *tree);
+
+/**
+ * Returns the height of a tree, i.e. the most nodes on a path from the root to
+ * a leaf. An empty tree has height 0.
+ *
+ * @param tree a pointer to a tree returned from aabb_tree_init()
+ * @return the tree's height
+ */
+size_t aabb_tree_height(aabb_tree_t *tree);
+
+/**
+ * Adds a proxy to a tree.
+ *
+ * @param tree a pointer to a tree returned from aabb_tree_init()
+ * @param box the proxy's box
+ * @param data the pointer to report when the proxy matches a query
+ * @return the proxy's ID, valid until the proxy is removed
+ */
+size_t aabb_tree_insert(aabb_tree_t *tree, aabb_t box, void *data);
+
+/**
+ * Removes a proxy from a tree.
+ *
+ * @param tree a pointer to a tree returned from aabb_tree_init()
+ * @param proxy an ID returned from aabb_tree_insert()
+ */
+void aabb_tree_remove(aabb_tree_t *tree, size_t proxy);
+
+/**
+ * Updates the box of a proxy. The tree only changes if the new box has left
+ * the proxy's fattened box.
+ *
+ * @param tree a pointer to a tree returned from aabb_tree_init()
+ * @param proxy an ID returned from aabb_tree_insert()
+ * @param box the proxy's new box
+ * @return whether the proxy had to be reinserted
+ */
+bool aabb_tree_move(aabb_tree_t *tree, size_t proxy, aabb_t box);
+
+/**
+ * Gets the data of a proxy.
+ *
+ * @param tree a pointer to a tree returned from aabb_tree_init()
+ * @param proxy an ID returned from aabb_tree_insert()
+ * @return the proxy's data
+ */
+void *aabb_tree_get_data(aabb_tree_t *tree, size_t proxy);
+
+/**
+ * Gets the fattened box a tree stores for a proxy.
+ *
+ * @param tree a pointer to a tree returned from aabb_tree_init()
+ * @param proxy an ID returned from aabb_tree_insert()
+ * @return a box containing the proxy's box as of its last insert or move
+ */
+aabb_t aabb_tree_get_fat_aabb(aabb_tree_t *tree, size_t proxy);
+
+/**
+ * Calls a function on every proxy whose fattened box overlaps a box.
+ *
+ * @param tree a pointer to a tree returned from aabb_tree_init()
+ * @param box the box to search
+ * @param callback the function to call with each matching proxy's data
+ * @param aux an auxiliary value to pass to callback
+ */
+void aabb_tree_query(aabb_tree_t *tree, aabb_t box, aabb_tree_query_t callback,
+                     void *aux);
+
+/**
+ * Finds the first proxy hit by the segment from start to end. Proxies are
+ * only passed to callback if the segment could hit them before the closest
+ * hit found so far.
+ *
+ * @param tree a pointer to a tree returned from aabb_tree_init()
+ * @param start the start of the segment
+ * @param end the end of the segment
+ * @param callback the function testing the segment against a proxy's object
+ * @param aux an auxiliary value to pass to callback
+ * @param fraction if non-NULL and there is a hit, set to the fraction along
+ *   the segment where it occurs
+ * @return the data of the first proxy hit, or NULL if there is none
+ */
+void *aabb_tree_raycast(aabb_tree_t *tree, vector_t start, vector_t end,
+                        aabb_tree_raycast_t callback, void *aux,
+                        double *fraction);
+
+/**
+ * Finds the proxies nearest to a point, nearest first.
+ * Not reentrant: callback must not query the same tree for nearest proxies.
+ *
+ * @param tree a pointer to a tree returned from aabb_tree_init()
+ * @param point the point to measure from
+ * @param k the most proxies to find
+ * @param callback the function measuring the distance to a proxy's object
+ * @param aux an auxiliary value to pass to callback
+ * @param nearest an array with room for k pointers, filled with the data of
+ *   the proxies found
+ * @return the number of proxies found, at most k
+ */
+size_t aabb_tree_nearest(aabb_tree_t *tree, vector_t point, size_t k,
+                         aabb_tree_distance_t callback, void *aux,
+                         void **nearest);
+
+#endif // #ifndef __AABB_TREE_H__
@@ -0,0 +1,102 @@
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <stddef.h>
+
+/**
+ * A bump-pointer allocator for short-lived memory.
+ * Allocations are carved out of large blocks and are never freed one at a
+ * time; instead the whole arena is reset at once, or rolled back to a mark.
+ * If an arena runs out of room it chains on another block, and the next reset
+ * merges its blocks into one big enough for everything that was allocated,
+ * so an arena that is reset every frame settles into a single block.
+ */
+typedef struct arena arena_t;
+
+/**
+ * A position in an arena that it can later be rolled back to.
+ */
+typedef struct arena_mark {
+  size_t block;
+  size_t offset;
+  size_t used;
+} arena_mark_t;
+
+/**
+ * Allocates memory for an empty arena.
+ * Asserts that the required memory was allocated.
+ *
+ * @param capacity the number of bytes to allocate space for up front
+ * @return a pointer to the newly allocated arena
+ */
+arena_t *arena_init(size_t capacity);
+
+/**
+ * Releases an arena and all memory allocated from it.
+ *
+ * @param arena a pointer to an arena returned from arena_init()
+ */
+void arena_free(arena_t *arena);
+
+/**
+ * Allocates memory from an arena. The memory stays valid until the arena is
+ * reset or rolled back past it, and must not be passed to free().
+ * Asserts that the required memory was allocated.
+ *
+ * @param arena a pointer to an arena returned from arena_init()
+ * @param size the number of bytes to allocate
+ * @return a pointer to the memory, suitably aligned for any type
+ */
+void *arena_alloc(arena_t *arena, size_t size);
+
+/**
+ * Gets the arena's current position, to pass to arena_release() later.
+ *
+ * @param arena a pointer to an arena returned from arena_init()
+ * @return the current position in the arena
+ */
+arena_mark_t arena_mark(arena_t *arena);
+
+/**
+ * Rolls an arena back to a mark, releasing everything allocated since.
+ *
+ * @param arena a pointer to an arena returned from arena_init()
+ * @param mark a position returned from arena_mark() on the same arena,
+ *   with no reset in between
+ */
+void arena_release(arena_t *arena, arena_mark_t mark);
+
+/**
+ * Releases everything allocated from an arena.
+ *
+ * @param arena a pointer to an arena returned from arena_init()
+ */
+void arena_reset(arena_t *arena);
+
+/**
+ * Gets the number of bytes currently allocated from an arena.
+ *
+ * @param arena a pointer to an arena returned from arena_init()
+ * @return the bytes in use, including alignment padding
+ */
+size_t arena_used(arena_t *arena);
+
+/**
+ * Gets the largest number of bytes that have been in use in an arena at once.
+ *
+ * @param arena a pointer to an arena returned from arena_init()
+ * @return the arena's high-water mark in bytes
+ */
+size_t arena_high_water(arena_t *arena);
+
+/**
+ * Gets the global frame arena, creating it on first use.
+ * The frame arena holds scratch memory that only has to live until the end of
+ * the current frame. The main loop resets it once per frame; code that may run
+ * outside the main loop should roll it back with arena_mark()/arena_release().
+ *
+ * @return the frame arena
+ */
+arena_t *frame_arena();
+
+#endif // #ifndef __ARENA_H__
@@ -4,6 +4,7 @@
 #include <SDL2/SDL_image.h>
 #include <SDL2/SDL_ttf.h>
 #include <color.h>
+#include <pool.h>
 #include <sdl_wrapper.h>
 #include <stddef.h>
 
@@ -11,6 +12,11 @@ typedef enum { ASSET_IMAGE, ASSET_FONT, ASSET_BUTTON } asset_type_t;
 
 typedef struct asset asset_t;
 
+/**
+ * Stable handle to an object in the asset cache. See `asset_cache_get_id`.
+ */
+typedef size_t asset_id_t;
+
 /**
  * Gets the `asset_type_t` of the asset.
  *
@@ -100,6 +106,13 @@ void asset_render(asset_t *asset);
  */
 void asset_destroy(asset_t *asset);
 
+/**
+ * Gets the occupancy statistics of the pool that assets are allocated from.
+ * Image, text and button assets share one pool.
+ * @return the asset pool's statistics
+ */
+pool_stats_t asset_pool_stats();
+
 /**
  *checks if a coordinate, x and y is in the bounding box
  @param bounding_box bounding box to check
@@ -134,4 +147,12 @@ void asset_change_text(asset_t *asset, char *text);
  */
 void asset_change_texture(asset_t *asset, const char *filepath);
 
+/**
+ *changes the texture within asset to an already cached image, skipping the
+ *filepath lookup
+ @param asset asset to check
+ @param id asset ID of the new texture, from `asset_cache_get_id`
+ */
+void asset_change_texture_id(asset_t *asset, asset_id_t id);
+
 #endif // #ifndef __ASSET_H__
@@ -5,7 +5,8 @@
 #include <stddef.h>
 
 /**
- * Initializes the empty, list-based global asset cache. The caller must then
+ * Initializes the empty global asset cache, indexed by a hash table of
+ * interned filepaths. The caller must then
  * destroy the cache with `asset_cache_destroy` when done.
  */
 void asset_cache_init();
@@ -37,6 +38,25 @@ void asset_cache_destroy();
  */
 void *asset_cache_obj_get_or_create(asset_type_t ty, const char *filepath);
 
+/**
+ * Gets the stable ID of the object associated with the given filepath,
+ * creating the object if it doesn't exist yet. An ID stays valid until
+ * `asset_cache_destroy`, so callers that switch assets every frame can
+ * resolve their filepaths once and use `asset_cache_obj_get` afterwards.
+ *
+ * @param ty the type of the asset
+ * @param filepath the filepath to the asset
+ * @return the ID of the object that corresponds to the filepath
+ */
+asset_id_t asset_cache_get_id(asset_type_t ty, const char *filepath);
+
+/**
+ * Gets the object with the given ID in constant time.
+ *
+ * @param id an ID returned by `asset_cache_get_id`
+ * @return the object that corresponds to the ID, as a void*
+ */
+void *asset_cache_obj_get(asset_id_t id);
 
 /**
  * helper function to determine if the object already exists in the list;
@@ -2,10 +2,13 @@
 #define __BODY_H__
 
 #include <stdbool.h>
+#include <stdint.h>
 
+#include "aabb.h"
 #include "color.h"
 #include "list.h"
 #include "polygon.h"
+#include "pool.h"
 
 /**
  * A rigid body constrained to the plane.
@@ -13,6 +16,124 @@
  */
 typedef struct body body_t;
 
+/**
+ * Where bodies keep the state that changes every tick: positions, velocities,
+ * accumulated forces and impulses, inverse masses and flags. Each is a
+ * contiguous, cache-line aligned array, so a tick streams through them.
+ * A body_t is a handle to one entry. Bodies start out in a shared store and
+ * move into a scene's store when added to the scene.
+ * Stores are not thread-safe, except as described for body_store_tick().
+ */
+typedef struct body_store body_store_t;
+
+/**
+ * The ways of moving bodies through a tick. Multi-stage integrators need the
+ * forces on the bodies at each stage's intermediate state, so force creators
+ * run once per stage; see integrator_num_stages().
+ */
+typedef enum {
+  // Adds the tick's acceleration to the velocity and moves the body at the
+  // average of its old and new velocities. One stage. The default.
+  INTEGRATOR_TRAPEZOIDAL,
+  // Adds the tick's acceleration to the velocity, then moves the body at its
+  // new velocity. One stage, and symplectic, so orbits and springs keep their
+  // energy over long runs.
+  INTEGRATOR_SEMI_IMPLICIT_EULER,
+  // Moves the body with a half-tick kick of the velocity, then kicks it again
+  // with the forces at the new position. Two stages, second order, symplectic.
+  INTEGRATOR_VELOCITY_VERLET,
+  // Classic fourth order Runge-Kutta. Four stages; very accurate over short
+  // runs, though its energy slowly drifts.
+  INTEGRATOR_RK4,
+} integrator_t;
+
+/**
+ * How a body takes part in the simulation.
+ */
+typedef enum {
+  // Moved by forces, impulses and its velocity. The default.
+  BODY_TYPE_DYNAMIC,
+  // Moved by its velocity alone, as if its mass were infinite
+  BODY_TYPE_KINEMATIC,
+  // Never moves by itself, and scenes don't tick it at all. Only moved by
+  // body_set_centroid() or body_set_rotation().
+  BODY_TYPE_STATIC,
+} body_type_t;
+
+/**
+ * The kinds of force field; see force_field_t.
+ */
+typedef enum {
+  // Pulls every body with the same acceleration, whatever its mass
+  FORCE_FIELD_GRAVITY,
+  // Slows bodies down with a force of -gamma times their velocity
+  FORCE_FIELD_DRAG,
+  // Pushes every body with the same force
+  FORCE_FIELD_WIND,
+  // A floor at a given height, facing up. Bodies at or below it that aren't
+  // moving up stop falling, and the forces pushing them down are dropped.
+  FORCE_FIELD_GROUND,
+} force_field_kind_t;
+
+/**
+ * A force acting on every body in some collision categories whose center is
+ * inside a region. Applying a field is one pass over a store, where a force
+ * creator per body would be a call per body. Bodies that ignore forces, and
+ * sleeping bodies, aren't affected.
+ */
+typedef struct {
+  force_field_kind_t kind;
+  // The field acts on bodies in any of these categories
+  uint32_t category;
+  // The field acts on bodies whose centers are inside this box
+  aabb_t region;
+  // The acceleration of a gravity field
+  vector_t acceleration;
+  // The force of a wind field
+  vector_t force;
+  // The drag constant of a drag field
+  double gamma;
+  // The height of a ground field
+  double height;
+} force_field_t;
+
+/**
+ * Adds the forces a body feels in its current state to the body.
+ * See body_substep().
+ *
+ * @param body the body to apply forces to
+ * @param aux an auxiliary value
+ */
+typedef void (*body_force_eval_t)(body_t *body, void *aux);
+
+/**
+ * A stable 32-bit identifier for a body in a scene.
+ * Unlike an index, a handle does not change when other bodies are removed,
+ * and it can be detected as stale once its body has been freed.
+ * See scene_resolve_body().
+ */
+typedef uint32_t body_handle_t;
+
+/**
+ * The handle of a body that has not been added to a scene.
+ * Never resolves to a body.
+ */
+extern const body_handle_t BODY_HANDLE_NONE;
+
+/**
+ * Receives the forces and impulses applied to bodies on the current thread,
+ * in place of the bodies themselves. See body_set_force_sink().
+ */
+typedef void (*body_force_sink_t)(body_t *body, vector_t force,
+                                  vector_t impulse, void *aux);
+
+/**
+ * The collision category and mask bodies start with: every body is in the
+ * first category and collides with every category.
+ */
+extern const uint32_t BODY_DEFAULT_CATEGORY;
+extern const uint32_t BODY_DEFAULT_MASK;
+
 /**
  * Initializes a body without any info.
  * Acts like body_init_with_info() where info and info_freer are NULL.
@@ -20,10 +141,50 @@ typedef struct body body_t;
 
 body_t *body_init(list_t *shape, double mass, rgb_color_t color);
 
+/**
+ * Allocates memory for a body whose shape is given as a contiguous array
+ * of vertices. The vertices are copied, so the caller keeps ownership of
+ * the array (it may live on the stack).
+ * The body is initially at rest.
+ *
+ * @param vertices the vertices describing the initial shape of the body
+ * @param num_vertices the number of vertices in the array
+ * @param mass the mass of the body (if INFINITY, stops the body from moving)
+ * @param color the color of the body, used to draw it on the screen
+ * @param info additional information to associate with the body,
+ *   e.g. its type if the scene has multiple types of bodies
+ * @param info_freer if non-NULL, a function call on the info to free it
+ * @return a pointer to the newly allocated body
+ */
+body_t *body_init_from_vertices(const vector_t *vertices, size_t num_vertices,
+                                double mass, rgb_color_t color, void *info,
+                                free_func_t info_freer);
+
+/**
+ * Allocates memory for a body that places a shared local-space shape in the
+ * world. The body takes its own reference to the shape, so bodies with the
+ * same outline can share one vertex buffer.
+ * The body is initially at rest and unrotated.
+ *
+ * @param shape the outline of the body, centered on its centroid
+ * @param position where to place the body's centroid
+ * @param mass the mass of the body (if INFINITY, stops the body from moving)
+ * @param color the color of the body, used to draw it on the screen
+ * @param info additional information to associate with the body,
+ *   e.g. its type if the scene has multiple types of bodies
+ * @param info_freer if non-NULL, a function call on the info to free it
+ * @return a pointer to the newly allocated body
+ */
+body_t *body_init_from_shape(shape_t *shape, vector_t position, double mass,
+                             rgb_color_t color, void *info,
+                             free_func_t info_freer);
+
 /**
  * Allocates memory for a body with the given parameters.
  * The body is initially at rest.
  * Asserts that the mass is positive and that the required memory is allocated.
+ * Kept for compatibility with list-based shapes: the vertices are copied
+ * into the body and the list is freed. Prefer body_init_from_vertices().
  *
  * @param shape a list of vectors describing the initial shape of the body
  * @param mass the mass of the body (if INFINITY, stops the body from moving)
@@ -38,11 +199,20 @@ body_t *body_init_with_info(list_t *shape, double mass, rgb_color_t color,
 
 /**
  * Releases the memory allocated for a body.
+ * Bodies are allocated from a pool, so the memory is kept for reuse by the
+ * next body that is created.
  *
  * @param body a pointer to a body returned from body_init()
  */
 void body_free(body_t *body);
 
+/**
+ * Gets the occupancy statistics of the pool that bodies are allocated from.
+ *
+ * @return the body pool's statistics
+ */
+pool_stats_t body_pool_stats();
+
 /**
  * Gets the current shape of a body.
  * Returns a newly allocated vector list, which must be list_free()d.
@@ -52,6 +222,24 @@ void body_free(body_t *body);
  */
 list_t *body_get_shape(body_t *body);
 
+/**
+ * Gets the current vertices of a body without copying them.
+ * The array is owned by the body and is only valid until the body
+ * is next moved, rotated, or freed.
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @return a pointer to the first vertex of the body's current shape
+ */
+const vector_t *body_get_vertices(body_t *body);
+
+/**
+ * Gets the number of vertices in a body's shape.
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @return the number of vertices
+ */
+size_t body_num_vertices(body_t *body);
+
 /**
  * Gets the current center of mass of a body.
  * While this could be calculated with polygon_centroid(), that becomes too slow
@@ -63,6 +251,15 @@ list_t *body_get_shape(body_t *body);
  */
 vector_t body_get_centroid(body_t *body);
 
+/**
+ * Gets the axis-aligned bounding box of a body in world space.
+ * See polygon_get_aabb().
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @return the body's bounding box
+ */
+aabb_t body_get_aabb(body_t *body);
+
 /**
  * Gets the current velocity of a body.
  *
@@ -91,17 +288,28 @@ double body_get_rotation(body_t *body);
  * Gets the mass of a body.
  *
  * @param body a pointer to a body returned from body_init()
- * @return the body's mass
+ * @return the body's mass, or INFINITY if it is static or kinematic
  */
 double body_get_mass(body_t *body);
 
 /**
- * Gets the polygon object associated with the body
+ * Gets the polygon object associated with the body.
+ * Moving or rotating the polygon directly moves the body.
  * @param body a pointer to a body returned from body_init()
  * @return a pointer to a polygon_t struct
  */
 polygon_t *body_get_polygon(body_t *body);
 
+/**
+ * Gets a body's polygon for reading only, which is cheaper than
+ * body_get_polygon(). Moving or rotating the returned polygon directly isn't
+ * picked up by the body.
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @return a pointer to the body's polygon, at the body's position
+ */
+polygon_t *body_peek_polygon(body_t *body);
+
 /**
  * Return the info associated with a body.
  *
@@ -110,6 +318,23 @@ polygon_t *body_get_polygon(body_t *body);
  */
 void *body_get_info(body_t *body);
 
+/**
+ * Return the handle the body was given when it was added to a scene.
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @return the body's handle, or BODY_HANDLE_NONE if it is not in a scene
+ */
+body_handle_t body_get_handle(body_t *body);
+
+/**
+ * Records the handle a scene assigned to a body.
+ * Called by scene_add_body(); games should not need to call this directly.
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @param handle the body's new handle
+ */
+void body_set_handle(body_t *body, body_handle_t handle);
+
 /**
  * Sets the display color of a body.
  *
@@ -129,6 +354,7 @@ void body_set_centroid(body_t *body, vector_t x);
 
 /**
  * Changes a body's velocity (the time-derivative of its position).
+ * Static bodies keep a velocity of zero.
  *
  * @param body a pointer to a body returned from body_init()
  * @param v the body's new velocity
@@ -158,6 +384,16 @@ void body_set_rotation(body_t *body, double angle);
  */
 void body_tick(body_t *body, double dt);
 
+/**
+ * Gets how far the last body_tick() moved a body, for interpolating its
+ * position between ticks. Moving the body with body_set_centroid() resets
+ * this to zero, so teleports are never interpolated.
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @return the body's translation over its last tick
+ */
+vector_t body_get_last_move(body_t *body);
+
 /**
  * Applies a force to a body over the current tick.
  * If multiple forces are applied in the same tick, they should be added.
@@ -168,6 +404,17 @@ void body_tick(body_t *body, double dt);
  */
 void body_add_force(body_t *body, vector_t force);
 
+/**
+ * Redirects the forces and impulses applied on the calling thread, so that
+ * several threads can apply them to the same bodies at once and add them up
+ * afterwards. Other threads are unaffected.
+ *
+ * @param sink the function to pass each force or impulse to, or NULL to
+ *   apply them to the bodies again
+ * @param aux an auxiliary value to pass to sink
+ */
+void body_set_force_sink(body_force_sink_t sink, void *aux);
+
 /**
  * Applies an impulse to a body.
  * An impulse causes an instantaneous change in velocity,
@@ -206,6 +453,299 @@ void body_remove(body_t *body);
  */
 bool body_is_removed(body_t *body);
 
+/**
+ * Marks whether a body moves fast enough to pass through other bodies in a
+ * single tick, like a bullet. The scene sweeps fast bodies along their motion
+ * each tick and stops them where they first touch another body.
+ * Bodies are not fast by default.
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @param fast whether the body should be swept
+ */
+void body_set_fast(body_t *body, bool fast);
+
+/**
+ * Returns whether a body is marked as fast; see body_set_fast().
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @return whether the body is swept each tick
+ */
+bool body_is_fast(body_t *body);
+
+/**
+ * Sets which collision categories a body belongs to and which it collides
+ * with, one bit per category. Two bodies are only tested for collisions if
+ * each is in a category the other's mask includes; see body_can_collide().
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @param category the categories the body belongs to
+ * @param mask the categories the body collides with
+ */
+void body_set_collision_filter(body_t *body, uint32_t category, uint32_t mask);
+
+/**
+ * Gets the collision categories a body belongs to.
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @return the body's category bits
+ */
+uint32_t body_get_category(body_t *body);
+
+/**
+ * Gets the collision categories a body collides with.
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @return the body's mask bits
+ */
+uint32_t body_get_mask(body_t *body);
+
+/**
+ * Returns whether the collision filters of two bodies let them collide.
+ * This is checked before any geometry, so masked pairs cost next to nothing.
+ *
+ * @param body1 a pointer to a body returned from body_init()
+ * @param body2 a pointer to a body returned from body_init()
+ * @return whether each body's category is in the other's mask
+ */
+bool body_can_collide(body_t *body1, body_t *body2);
+
+/**
+ * Marks whether a body is a sensor. Sensors report overlaps like any other
+ * body, but physics collisions don't push them or push off them, and they
+ * don't stop fast bodies. Bodies are not sensors by default.
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @param sensor whether the body only detects overlaps
+ */
+void body_set_sensor(body_t *body, bool sensor);
+
+/**
+ * Returns whether a body is a sensor; see body_set_sensor().
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @return whether the body only detects overlaps
+ */
+bool body_is_sensor(body_t *body);
+
+/**
+ * Allocates memory for an empty body store.
+ * Asserts that the required memory was allocated.
+ *
+ * @return a pointer to the newly allocated store
+ */
+body_store_t *body_store_init(void);
+
+/**
+ * Releases the memory allocated for a store.
+ * The store must be empty; freeing its bodies empties it.
+ *
+ * @param store a pointer to a store returned from body_store_init()
+ */
+void body_store_free(body_store_t *store);
+
+/**
+ * Gets the number of bodies in a store.
+ *
+ * @param store a pointer to a store returned from body_store_init()
+ * @return the number of bodies
+ */
+size_t body_store_size(body_store_t *store);
+
+/**
+ * Gets the body at a given index of a store.
+ * Indices change when bodies leave the store.
+ *
+ * @param store a pointer to a store returned from body_store_init()
+ * @param index an index from 0 to body_store_size() - 1
+ * @return the body at that index
+ */
+body_t *body_store_get(body_store_t *store, size_t index);
+
+/**
+ * Moves a body and its state into a store, out of the store it was in.
+ *
+ * @param store a pointer to a store returned from body_store_init()
+ * @param body a pointer to a body returned from body_init()
+ */
+void body_store_add(body_store_t *store, body_t *body);
+
+/**
+ * Brings the polygons of a store's bodies and the store up to date with each
+ * other. Polygons are only moved, so their cached vertices may still be out
+ * of date.
+ *
+ * @param store a pointer to a store returned from body_store_init()
+ */
+void body_store_settle(body_store_t *store);
+
+/**
+ * Settles a store, then brings the cached vertices, normals and bounding box
+ * of each of its bodies' polygons up to date. Afterwards, reading the bodies
+ * doesn't write to them, so they can be read from several threads at once
+ * until something moves them or hands out their polygons.
+ *
+ * @param store a pointer to a store returned from body_store_init()
+ */
+void body_store_refresh(body_store_t *store);
+
+/**
+ * Returns whether any body in a store has been marked for removal.
+ *
+ * @param store a pointer to a store returned from body_store_init()
+ * @return whether body_remove() has been called on any of its bodies
+ */
+bool body_store_has_removed(body_store_t *store);
+
+/**
+ * Gets how many times an integrator needs the forces on the bodies per tick.
+ *
+ * @param integrator an integrator
+ * @return the number of stages in each of its ticks
+ */
+size_t integrator_num_stages(integrator_t integrator);
+
+/**
+ * Runs one stage of an integrator on the bodies at indices start to end - 1
+ * of a store, using the forces and impulses applied to them since the last
+ * stage. Then resets those forces and impulses. Impulses only count in the
+ * first stage. Until the last stage, the bodies are left at the state the
+ * integrator needs the forces at next. Disjoint ranges of a settled store may
+ * be run on different threads.
+ *
+ * @param store a pointer to a store returned from body_store_init()
+ * @param integrator the integrator to run
+ * @param stage the stage, from 0 to integrator_num_stages() - 1; stages must
+ *   be run in order
+ * @param start the index of the first body to integrate
+ * @param end one past the index of the last body to integrate
+ * @param dt the number of seconds in the tick
+ */
+void body_store_integrate(body_store_t *store, integrator_t integrator,
+                          size_t stage, size_t start, size_t end, double dt);
+
+/**
+ * Ticks a body in several smaller steps, which keeps stiff forces on it
+ * stable at a larger tick. The forces and impulses applied to the body so far
+ * are taken as the forces at its starting state. Before every later stage,
+ * eval adds the forces that depend on the body's state; the rest of the
+ * starting forces are held constant over the tick.
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @param integrator the integrator to run each step with
+ * @param num_steps the number of steps, at least 1
+ * @param dt the number of seconds in the whole tick
+ * @param eval a function adding the state-dependent forces on the body
+ * @param aux an auxiliary value to pass to eval
+ */
+void body_substep(body_t *body, integrator_t integrator, size_t num_steps,
+                  double dt, body_force_eval_t eval, void *aux);
+
+/**
+ * Ticks the bodies at indices start to end - 1 of a store, as body_tick()
+ * does. Disjoint ranges of a settled store may be ticked on different threads.
+ *
+ * @param store a pointer to a store returned from body_store_init()
+ * @param start the index of the first body to tick
+ * @param end one past the index of the last body to tick
+ * @param dt the number of seconds elapsed since the last tick
+ */
+void body_store_tick(body_store_t *store, size_t start, size_t end,
+                     double dt);
+
+/**
+ * Applies a force field to the bodies at indices start to end - 1 of a store,
+ * adding to the forces applied to them since the last stage. A ground field
+ * also stops their fall, so it should be applied after the forces it holds
+ * bodies up against. Disjoint ranges of a settled store may be run on
+ * different threads.
+ *
+ * @param store a pointer to a store returned from body_store_init()
+ * @param field the field to apply
+ * @param start the index of the first body to apply it to
+ * @param end one past the index of the last body to apply it to
+ */
+void body_store_apply_field(body_store_t *store, const force_field_t *field,
+                            size_t start, size_t end);
+
+/**
+ * Sets how a body takes part in the simulation. Static and kinematic bodies
+ * ignore forces and impulses. Making a body static stops it.
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @param type the body's new type
+ */
+void body_set_type(body_t *body, body_type_t type);
+
+/**
+ * Gets how a body takes part in the simulation; see body_set_type().
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @return the body's type
+ */
+body_type_t body_get_type(body_t *body);
+
+/**
+ * Puts a body to sleep: it stops, and its scene stops ticking it until it is
+ * woken. Changing its position, velocity or rotation, or pushing it with a
+ * non-zero force or impulse, wakes it. Static bodies never sleep.
+ * Scenes put bodies to sleep themselves; see scene_set_sleep().
+ *
+ * @param body a pointer to a body returned from body_init()
+ */
+void body_sleep(body_t *body);
+
+/**
+ * Wakes a sleeping body, and restarts the count of ticks it has been quiet.
+ *
+ * @param body a pointer to a body returned from body_init()
+ */
+void body_wake(body_t *body);
+
+/**
+ * Returns whether a body is asleep; see body_sleep().
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @return whether the body is asleep
+ */
+bool body_is_sleeping(body_t *body);
+
+/**
+ * Gets how many ticks in a row a body has been slower than its scene's sleep
+ * speed, as counted by body_store_update_quiet().
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @return the number of quiet ticks
+ */
+uint32_t body_get_quiet_ticks(body_t *body);
+
+/**
+ * Gets the store a body's state is kept in.
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @return the body's store
+ */
+body_store_t *body_get_store(body_t *body);
+
+/**
+ * Counts another quiet tick for each body in a store no faster than a given
+ * speed, and restarts the count for the rest.
+ *
+ * @param store a pointer to a store returned from body_store_init()
+ * @param max_speed the fastest a body can be going and still be quiet
+ */
+void body_store_update_quiet(body_store_t *store, double max_speed);
+
+/**
+ * Finds the bodies in a store that were woken or changed while asleep or
+ * static, or whose type changed, since the last call. Their scene has to
+ * move them to the right store, or update its index for them.
+ *
+ * @param store a pointer to a store returned from body_store_init()
+ * @param touched a list to add the bodies to
+ * @return the number of bodies added
+ */
+size_t body_store_take_touched(body_store_t *store, list_t *touched);
+
 // double body_get_health(body_t *body);
 
 // double body_set_health(body_t *body, double health);
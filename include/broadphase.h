@@ -0,0 +1,156 @@
+#ifndef __BROADPHASE_H__
+#define __BROADPHASE_H__
+
+#include "aabb.h"
+#include "body.h"
+#include "list.h"
+#include <stddef.h>
+
+/**
+ * A broadphase tracks the bounding boxes of a set of bodies and finds the
+ * pairs whose boxes overlap, so that the exact (and much more expensive)
+ * collision test only runs on pairs that could actually be touching.
+ * Each tracked body is a "proxy" carrying a user data pointer.
+ */
+typedef struct broadphase broadphase_t;
+
+/**
+ * The algorithms a broadphase can use to find overlapping boxes.
+ */
+typedef enum {
+  // A uniform grid of square cells, hashed so the world can be unbounded.
+  // Best when bodies are of similar size and spread over a large area.
+  BROADPHASE_GRID,
+  // Sweep and prune along x. The sorted order is kept between updates, so
+  // re-sorting is nearly linear while bodies move a little each frame.
+  BROADPHASE_SWEEP,
+} broadphase_kind_t;
+
+/**
+ * A pair of proxies with overlapping boxes, given by their data pointers.
+ * first was added to the broadphase before second.
+ */
+typedef struct broadphase_pair {
+  void *first;
+  void *second;
+} broadphase_pair_t;
+
+/**
+ * Work done by a broadphase, for the last update and in total.
+ */
+typedef struct broadphase_stats {
+  // Number of proxies in the last update
+  size_t num_proxies;
+  // Number of overlapping pairs found by the last update
+  size_t num_pairs;
+  // Number of box-box overlap tests done by the last update, not counting
+  // pairs skipped by their collision filters
+  size_t num_tests;
+  // Time spent in the last update, in seconds
+  double seconds;
+  // Number of updates since the broadphase was created
+  size_t num_updates;
+  // Sum of num_pairs over all updates
+  size_t total_pairs;
+  // Sum of num_tests over all updates
+  size_t total_tests;
+  // Sum of seconds over all updates
+  double total_seconds;
+} broadphase_stats_t;
+
+/**
+ * Allocates memory for an empty broadphase.
+ * Asserts that the required memory was allocated.
+ *
+ * @param kind the algorithm to find overlapping boxes with
+ * @param cell_size the side length of a grid cell; ignored unless kind is
+ *   BROADPHASE_GRID. About the size of a typical body works well.
+ * @return a pointer to the newly allocated broadphase
+ */
+broadphase_t *broadphase_init(broadphase_kind_t kind, double cell_size);
+
+/**
+ * Releases the memory allocated for a broadphase.
+ * The tracked bodies and their data are not freed.
+ *
+ * @param broadphase a pointer to a broadphase returned from broadphase_init()
+ */
+void broadphase_free(broadphase_t *broadphase);
+
+/**
+ * Returns the algorithm a broadphase uses.
+ *
+ * @param broadphase a pointer to a broadphase returned from broadphase_init()
+ * @return the broadphase's kind
+ */
+broadphase_kind_t broadphase_get_kind(broadphase_t *broadphase);
+
+/**
+ * Starts tracking a body. Its box is read on every broadphase_update().
+ *
+ * @param broadphase a pointer to a broadphase returned from broadphase_init()
+ * @param body the body to track; must stay valid until its proxy is removed
+ * @param data the pointer to report in pairs involving this body
+ */
+void broadphase_add(broadphase_t *broadphase, body_t *body, void *data);
+
+/**
+ * Stops tracking every proxy whose data satisfies a predicate.
+ * The remaining proxies keep their relative order.
+ *
+ * @param broadphase a pointer to a broadphase returned from broadphase_init()
+ * @param pred the predicate, called with each proxy's data
+ * @param aux an auxiliary value to pass to pred
+ * @return the number of proxies removed
+ */
+size_t broadphase_remove_if(broadphase_t *broadphase, list_pred_t pred,
+                            void *aux);
+
+/**
+ * Returns the number of proxies in a broadphase.
+ *
+ * @param broadphase a pointer to a broadphase returned from broadphase_init()
+ * @return the number of tracked bodies
+ */
+size_t broadphase_size(broadphase_t *broadphase);
+
+/**
+ * Reads the current box of every tracked body and finds the overlapping pairs.
+ * Boxes that only touch count as overlapping. Pairs of bodies whose collision
+ * filters exclude each other (see body_can_collide()) are skipped before
+ * their boxes are compared. Pairs are ordered by their first
+ * proxy and then by their second, in the order the proxies were added, so the
+ * result doesn't depend on the algorithm.
+ *
+ * @param broadphase a pointer to a broadphase returned from broadphase_init()
+ * @return the number of overlapping pairs
+ */
+size_t broadphase_update(broadphase_t *broadphase);
+
+/**
+ * Returns the number of pairs found by the last broadphase_update().
+ *
+ * @param broadphase a pointer to a broadphase returned from broadphase_init()
+ * @return the number of overlapping pairs
+ */
+size_t broadphase_num_pairs(broadphase_t *broadphase);
+
+/**
+ * Gets a pair found by the last broadphase_update().
+ * Asserts that the index is valid.
+ *
+ * @param broadphase a pointer to a broadphase returned from broadphase_init()
+ * @param index an index in [0, broadphase_num_pairs(broadphase))
+ * @return the pair at the given index
+ */
+broadphase_pair_t broadphase_get_pair(broadphase_t *broadphase, size_t index);
+
+/**
+ * Returns how much work a broadphase has done.
+ *
+ * @param broadphase a pointer to a broadphase returned from broadphase_init()
+ * @return the broadphase's statistics
+ */
+broadphase_stats_t broadphase_get_stats(broadphase_t *broadphase);
+
+#endif // #ifndef __BROADPHASE_H__
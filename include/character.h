@@ -61,11 +61,17 @@ body_t *character_get_body(character_t *character);
 void character_set_body(character_t *character, body_t *body);
 
 /**
- *frees the character object
+ *frees the character object, returning it to the character pool
  @param character character to check
  */
 void character_free(character_t *character);
 
+/**
+ *gets the occupancy statistics of the pool that characters are allocated from
+ @return the character pool's statistics
+ */
+pool_stats_t character_pool_stats();
+
 /**
  *changes health based on bullet damage
  @param character character to check
@@ -8,7 +8,8 @@
 
 /**
  * Represents the status of a collision between two shapes.
- * The shapes are either not colliding, or they are colliding along some axis.
+ * The shapes are either not colliding, or they are colliding along some axis,
+ * in which case this is their contact manifold.
  */
 typedef struct {
   /** Whether the two shapes are colliding */
@@ -20,10 +21,29 @@ typedef struct {
    * If collided is false, this value is undefined.
    */
   vector_t axis;
+  /**
+   * How far the shapes overlap along the axis, i.e. how far the second shape
+   * must move along it to just touch the first.
+   */
+  double depth;
+  /** The number of contact points, 1 or 2 if the shapes are colliding */
+  size_t num_contacts;
+  /**
+   * Where the shapes touch. Two points are given when flat edges of two
+   * polygons rest against each other.
+   */
+  vector_t contacts[2];
 } collision_info_t;
 
 /**
  * Computes the status of the collision between two bodies.
+ * Bodies whose collision filters exclude each other (see body_can_collide()),
+ * or whose bounding circles or bounding boxes don't overlap, are rejected
+ * straight away. Pairs of circles and capsules are solved in closed form, and
+ * polygons with few vertices are tested with the separating axis theorem
+ * against each other and against circles and capsules. Any other pair of
+ * convex bodies goes through GJK, with EPA to measure the overlap. Nothing is
+ * allocated.
  *
  * @param body1 the first body
  * @param body2 the second body
@@ -32,4 +52,46 @@ typedef struct {
  */
 collision_info_t find_collision(body_t *body1, body_t *body2);
 
+/**
+ * Computes the status of the collision between two bodies, like
+ * find_collision(), but always with GJK and EPA, whatever their shapes.
+ * Useful to compare the kernels against.
+ *
+ * @param body1 the first body
+ * @param body2 the second body
+ * @return whether the shapes are colliding, and if so, the contact manifold
+ */
+collision_info_t find_collision_gjk(body_t *body1, body_t *body2);
+
+/**
+ * Computes the status of the collision between two bodies, like
+ * find_collision(), but remembers an axis that separated them last time.
+ * Bodies rarely move far between ticks, so if the axis still separates them
+ * the kernel is skipped altogether.
+ *
+ * @param body1 the first body
+ * @param body2 the second body
+ * @param separating_axis an axis along which body2 lay beyond body1 last time,
+ *   or VEC_ZERO if there is none. Updated to an axis that separates the bodies
+ *   now, or VEC_ZERO if they are colliding.
+ * @return whether the shapes are colliding, and if so, the contact manifold
+ */
+collision_info_t find_collision_cached(body_t *body1, body_t *body2,
+                                       vector_t *separating_axis);
+
+/**
+ * Finds when a body moving in a straight line first touches another body,
+ * which is treated as still. Catches hits that find_collision() would miss
+ * because the body passes all the way through the other between ticks.
+ * Bodies touching at the start are not reported, so a body can move out of a
+ * contact it is already in.
+ *
+ * @param body1 the moving body, at the end of its motion
+ * @param start where body1's centroid was at the start of its motion
+ * @param body2 the other body
+ * @return the fraction of the motion (between 0 and 1) at which the bodies
+ *   first touch, or INFINITY if they don't
+ */
+double find_time_of_impact(body_t *body1, vector_t start, body_t *body2);
+
 #endif // #ifndef __COLLISION_H__
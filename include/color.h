@@ -3,6 +3,8 @@
 
 #include <stdbool.h>
 
+#include "pool.h"
+
 typedef struct color {
   double r;
   double g;
@@ -38,8 +40,15 @@ bool color_compare(rgb_color_t c1, rgb_color_t c2);
 /**
  * Free memory allocated for the color object.
  *
- * @param color a color with r, g, b values
+ * @param color a color returned from color_init() or color_get_random()
  */
 void color_free(rgb_color_t *color);
 
+/**
+ * Gets the occupancy statistics of the pool that colors are allocated from.
+ *
+ * @return the color pool's statistics
+ */
+pool_stats_t color_pool_stats();
+
 #endif // #ifndef __COLOR_H__
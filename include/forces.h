@@ -38,6 +38,22 @@ typedef void (*collision_handler_t)(body_t *body1, body_t *body2, vector_t axis,
 void create_newtonian_gravity(scene_t *scene, double G, body_t *body1,
                               body_t *body2);
 
+/**
+ * Adds a force creator to a scene that applies gravity between every pair of
+ * bodies in it with a finite mass, including bodies added later.
+ * It computes the same force as create_newtonian_gravity() on every pair, but
+ * as one pass: with a theta above 0, through a Barnes-Hut tree that makes a
+ * tick O(n log n) rather than O(n^2) (see nbody_forces()). Small scenes are
+ * summed exactly either way.
+ * Unlike a creator per pair, it is never dropped when a body is removed.
+ *
+ * @param scene the scene containing the bodies
+ * @param G the gravitational proportionality constant
+ * @param theta the opening angle; 0 sums every pair exactly, and 0.5 is a
+ *   good tradeoff between speed and accuracy
+ */
+void create_nbody_gravity(scene_t *scene, double G, double theta);
+
 /**
  * Adds a force creator to a scene that acts like a spring between two bodies.
  * The force creator will be called each tick
@@ -65,8 +81,62 @@ void create_spring(scene_t *scene, double k, body_t *body1, body_t *body2);
 void create_drag(scene_t *scene, double gamma, body_t *body);
 
 /**
- * Adds a force creator to a scene that calls a given collision handler
- * function each time two bodies collide.
+ * Adds a uniform gravity field to a scene (see scene_add_force_field()).
+ * Every body in the given categories accelerates at the same rate.
+ *
+ * @param scene the scene to add the field to
+ * @param category the categories of the bodies the field acts on
+ * @param acceleration the acceleration of gravity
+ * @return the field's index in the scene
+ */
+size_t create_gravity_field(scene_t *scene, uint32_t category,
+                            vector_t acceleration);
+
+/**
+ * Adds a linear drag field to a scene (see scene_add_force_field()). It
+ * applies the same force as create_drag() to every body in the given
+ * categories, in one pass rather than one force creator per body.
+ *
+ * @param scene the scene to add the field to
+ * @param category the categories of the bodies the field acts on
+ * @param gamma the proportionality constant between force and velocity
+ * @return the field's index in the scene
+ */
+size_t create_drag_field(scene_t *scene, uint32_t category, double gamma);
+
+/**
+ * Adds a wind field to a scene (see scene_add_force_field()), which pushes
+ * every body in the given categories with the same force while it is inside
+ * a region.
+ *
+ * @param scene the scene to add the field to
+ * @param category the categories of the bodies the field acts on
+ * @param region where the wind blows; AABB_EVERYWHERE for everywhere
+ * @param force the force on each body
+ * @return the field's index in the scene
+ */
+size_t create_wind_field(scene_t *scene, uint32_t category, aabb_t region,
+                         vector_t force);
+
+/**
+ * Adds a ground field to a scene (see scene_add_force_field()): a floor the
+ * bodies in the given categories can't fall through. A body whose center is
+ * at or below the floor stops falling, unless it is moving up, e.g. jumping.
+ * Add it after the gravity it holds bodies up against.
+ *
+ * @param scene the scene to add the field to
+ * @param category the categories of the bodies the field acts on
+ * @param region where the floor is; AABB_EVERYWHERE for everywhere
+ * @param height the height of the floor
+ * @return the field's index in the scene
+ */
+size_t create_ground_field(scene_t *scene, uint32_t category, aabb_t region,
+                           double height);
+
+/**
+ * Subscribes a given collision handler function to the contact events of two
+ * bodies (see scene_add_contact_handler()), so it is called each time they
+ * start colliding.
  * This generalizes create_destructive_collision() from last week,
  * allowing different things to happen on a collision.
  * The handler is passed the bodies, the collision axis, and an auxiliary value.
@@ -84,7 +154,7 @@ void create_collision(scene_t *scene, body_t *body1, body_t *body2,
                       double force_const);
 
 /**
- * Adds a force creator to a scene that destroys two bodies when they collide.
+ * Adds a handler to a scene that destroys two bodies when they collide.
  * The bodies should be destroyed by calling body_remove().
  * This should be represented as an on-collision callback
  * registered with create_collision().
@@ -103,7 +173,7 @@ void physics_collision_handler(body_t *body1, body_t *body2, vector_t axis,
                                void *aux, double force_const);
 
 /**
- * Adds a force creator to a scene that applies impulses
+ * Adds a handler to a scene that applies impulses
  * to resolve collisions between two bodies in the scene.
  * This should be represented as an on-collision callback
  * registered with create_collision().
@@ -113,6 +183,10 @@ void physics_collision_handler(body_t *body1, body_t *body2, vector_t axis,
  * You should also have a special case that allows either body1 or body2
  * to have mass INFINITY, as this is useful for simulating walls.
  *
+ * While the bodies overlap, they are also pushed apart along the collision
+ * axis on every tick (most of the way, in inverse proportion to their masses),
+ * so resting bodies don't sink into each other.
+ *
  * @param scene the scene containing the bodies
  * @param body1 the first body
  * @param body2 the second body
@@ -2,6 +2,7 @@
 #define __LIST_H__
 
 #include "vector.h"
+#include <stdbool.h>
 #include <stddef.h>
 
 /**
@@ -17,6 +18,12 @@ typedef struct list list_t;
  */
 typedef void (*free_func_t)(void *);
 
+/**
+ * A predicate over list elements, used to select elements for bulk removal.
+ * Takes in an auxiliary value that can store parameters or state.
+ */
+typedef bool (*list_pred_t)(void *value, void *aux);
+
 /**
  * Allocates memory for a new list with space for the given number of elements.
  * The list is initially empty.
@@ -65,6 +72,60 @@ void *list_get(list_t *list, size_t index);
  */
 void *list_remove(list_t *list, size_t index);
 
+/**
+ * Removes the element at a given index in a list and returns it,
+ * moving the last element of the list into its place.
+ * Runs in constant time, but does not preserve the order of the list.
+ * Asserts that the index is valid, given the list's current size.
+ *
+ * @param list a pointer to a list returned from list_init()
+ * @param index an index in the list (the first element is at 0)
+ * @return the element at the given index in the list
+ */
+void *list_swap_remove(list_t *list, size_t index);
+
+/**
+ * Swaps two elements of a list.
+ * Asserts that both indices are valid, given the list's current size.
+ *
+ * @param list a pointer to a list returned from list_init()
+ * @param index1 an index in the list
+ * @param index2 another index in the list, which may be the same
+ */
+void list_swap(list_t *list, size_t index1, size_t index2);
+
+/**
+ * Removes every element matching a predicate in a single pass,
+ * preserving the relative order of the remaining elements.
+ * Each removed element is passed to freer, if it is non-NULL.
+ *
+ * @param list a pointer to a list returned from list_init()
+ * @param pred the predicate selecting elements to remove;
+ *   if NULL, every element is removed
+ * @param aux an auxiliary value to pass to pred
+ * @param freer if non-NULL, a function to call on each removed element
+ * @return the number of elements removed
+ */
+size_t list_remove_if(list_t *list, list_pred_t pred, void *aux,
+                      free_func_t freer);
+
+/**
+ * Removes every element matching a predicate in a single pass,
+ * filling each hole with an element from the end of the list.
+ * Faster than list_remove_if() when few elements are removed,
+ * but does not preserve the order of the list.
+ * Each removed element is passed to freer, if it is non-NULL.
+ *
+ * @param list a pointer to a list returned from list_init()
+ * @param pred the predicate selecting elements to remove;
+ *   if NULL, every element is removed
+ * @param aux an auxiliary value to pass to pred
+ * @param freer if non-NULL, a function to call on each removed element
+ * @return the number of elements removed
+ */
+size_t list_swap_remove_if(list_t *list, list_pred_t pred, void *aux,
+                           free_func_t freer);
+
 /**
  * Appends an element to the end of a list.
  * If the list is filled to capacity, resizes the list to fit more elements
@@ -77,7 +138,8 @@ void *list_remove(list_t *list, size_t index);
 void list_add(list_t *list, void *value);
 
 /**
- * Removes the entire list
+ * Removes every element from the list without freeing them.
+ * The list itself stays allocated and can be reused.
  *
  * @param list a pointer to a list returned from list_init()
  */
@@ -0,0 +1,83 @@
+#ifndef __NBODY_H__
+#define __NBODY_H__
+
+#include "vector.h"
+#include <stddef.h>
+
+/**
+ * Computes the Newtonian gravity between every pair of a set of point
+ * masses. Large sets are approximated with a Barnes-Hut quadtree, built
+ * again on every call: distant groups of masses pull like a single mass at
+ * their center of mass, which makes a call O(n log n). Small sets, or a
+ * theta of 0, are summed exactly, pair by pair.
+ * The solver keeps its tree and scratch space between calls, so calling it
+ * every tick doesn't allocate once it has grown to the size of the set.
+ */
+typedef struct nbody nbody_t;
+
+/**
+ * Allocates memory for a solver.
+ * Asserts that the required memory was allocated.
+ *
+ * @return a pointer to the newly allocated solver
+ */
+nbody_t *nbody_init(void);
+
+/**
+ * Releases the memory allocated for a solver.
+ *
+ * @param solver a pointer to a solver returned from nbody_init()
+ */
+void nbody_free(nbody_t *solver);
+
+/**
+ * Computes the gravitational force on each of a set of point masses from all
+ * of the others. Like create_newtonian_gravity(), pairs closer than
+ * min_distance don't pull on each other, since the force blows up as the
+ * distance goes to 0.
+ * A group of masses is treated as one when its cell in the tree is smaller
+ * than theta times its distance. 0.5 is a good tradeoff; larger thetas are
+ * faster and less accurate.
+ *
+ * @param solver a pointer to a solver returned from nbody_init()
+ * @param num_masses the number of masses
+ * @param positions where each mass is
+ * @param masses how heavy each mass is
+ * @param G the gravitational proportionality constant
+ * @param theta the opening angle; 0 sums every pair exactly
+ * @param min_distance the distance below which pairs are ignored
+ * @param forces where to store the force on each mass
+ */
+void nbody_forces(nbody_t *solver, size_t num_masses,
+                  const vector_t *positions, const double *masses, double G,
+                  double theta, double min_distance, vector_t *forces);
+
+/**
+ * Sets how many threads nbody_forces() walks the tree on. The forces are
+ * exactly the same however many there are. Only the tree is walked in
+ * parallel; exact sums run on the calling thread.
+ *
+ * @param solver a pointer to a solver returned from nbody_init()
+ * @param num_threads the number of threads, including the calling one; 1 by
+ *   default
+ */
+void nbody_set_threads(nbody_t *solver, size_t num_threads);
+
+/**
+ * Gets how many threads nbody_forces() walks the tree on.
+ *
+ * @param solver a pointer to a solver returned from nbody_init()
+ * @return the number set by nbody_set_threads()
+ */
+size_t nbody_get_threads(nbody_t *solver);
+
+/**
+ * Gets the number of cells in the tree built by the last call to
+ * nbody_forces(), or 0 if it summed every pair exactly.
+ *
+ * @param solver a pointer to a solver returned from nbody_init()
+ * @return the number of cells
+ */
+size_t nbody_num_cells(nbody_t *solver);
+
+#endif // #ifndef __NBODY_H__
@@ -3,12 +3,66 @@
 
 #include "color.h"
 #include "list.h"
+#include "pool.h"
+#include "shape.h"
 #include "vector.h"
 
+/**
+ * A polygon placed in the world.
+ * A polygon is an immutable local-space shape plus a pose: the world position
+ * of the shape's centroid and an angle of rotation about it. Moving or
+ * rotating a polygon only updates the pose. World-space vertices are computed
+ * from the pose when they are asked for, and cached until the pose changes.
+ */
 typedef struct polygon polygon_t;
 
+/**
+ * Initialize a polygon object that places a shared shape in the world.
+ * The polygon takes a reference to the shape and starts unrotated.
+ *
+ * @param shape the polygon's outline; see shape_init()
+ * @param position where to place the shape's centroid
+ * @param initial_velocity a vector representing the initial velocity of the
+ * polygon
+ * @param rotation_speed the rotation angle of the polygon per unit time
+ * @param red double value between 0 and 1 representing the red of the polygon
+ * @param green double value between 0 and 1 representing the green of the
+ * polygon
+ * @param blue double value between 0 and 1 representing the blue of the polygon
+ * @return a polygon object pointer
+ */
+polygon_t *polygon_init_from_shape(shape_t *shape, vector_t position,
+                                   vector_t initial_velocity,
+                                   double rotation_speed, double red,
+                                   double green, double blue);
+
+/**
+ * Initialize a polygon object given a contiguous array of vertices.
+ * The vertices are copied into a new shape owned by the polygon.
+ * Polygons and their vertex arrays are allocated from pools, so creating and
+ * freeing polygons of similar sizes every frame does not call malloc.
+ *
+ * @param vertices the vertices that make up the polygon
+ * @param num_vertices the number of vertices in the array
+ * @param initial_velocity a vector representing the initial velocity of the
+ * polygon
+ * @param rotation_speed the rotation angle of the polygon per unit time
+ * @param red double value between 0 and 1 representing the red of the polygon
+ * @param green double value between 0 and 1 representing the green of the
+ * polygon
+ * @param blue double value between 0 and 1 representing the blue of the polygon
+ * @return a polygon object pointer
+ */
+polygon_t *polygon_init_from_vertices(const vector_t *vertices,
+                                      size_t num_vertices,
+                                      vector_t initial_velocity,
+                                      double rotation_speed, double red,
+                                      double green, double blue);
+
 /**
  * Initialize a polygon object given a list of vertices.
+ * The vertices are copied into the polygon and the list is freed,
+ * so the polygon takes ownership of it as before.
  *
  * @param points the list of vertices that make up the polygon
  * @param initial_position a vector representing the initial center position of
@@ -27,12 +81,63 @@ polygon_t *polygon_init(list_t *points, vector_t initial_velocity,
                         double blue);
 
 /**
- * Return the list of vectors representing the vertices of the polygon.
+ * Return the world-space vertices of the polygon as a contiguous array.
+ * The vertices are recomputed from the polygon's pose only if it has changed
+ * since the last call. The array is owned by the polygon, and its contents
+ * are only valid until the polygon is next moved or rotated.
  *
  * @param polygon the list of vertices that make up the polygon
- * @return a list of vectors
+ * @return a pointer to the first vertex
  */
-list_t *polygon_get_points(polygon_t *polygon);
+const vector_t *polygon_get_vertices(polygon_t *polygon);
+
+/**
+ * Return the number of vertices in the polygon.
+ *
+ * @param polygon the list of vertices that make up the polygon
+ * @return the number of vertices
+ */
+size_t polygon_num_vertices(polygon_t *polygon);
+
+/**
+ * Return the world-space outward unit normals of the polygon's edges.
+ * See shape_get_normals(). Translations don't change the normals, so they are
+ * only recomputed after the polygon has been rotated.
+ * The array is owned by the polygon, and its contents are only valid until
+ * the polygon is next rotated.
+ *
+ * @param polygon the list of vertices that make up the polygon
+ * @return a pointer to the first normal
+ */
+const vector_t *polygon_get_normals(polygon_t *polygon);
+
+/**
+ * Return the local-space shape of the polygon.
+ * The shape is owned by the polygon; use shape_retain() to keep it longer.
+ *
+ * @param polygon the list of vertices that make up the polygon
+ * @return the polygon's shape
+ */
+shape_t *polygon_get_shape(polygon_t *polygon);
+
+/**
+ * Return the world-space axis-aligned bounding box of the polygon.
+ * The box is cached: translations move it in constant time, and it is only
+ * recomputed from the vertices after the polygon has been rotated.
+ *
+ * @param polygon the list of vertices that make up the polygon
+ * @return the polygon's bounding box
+ */
+aabb_t polygon_get_aabb(polygon_t *polygon);
+
+/**
+ * Brings the polygon's cached world-space vertices, normals and bounding box
+ * up to date. Until the polygon is next moved or rotated, reading them
+ * doesn't write to it, so several threads can read it at once.
+ *
+ * @param polygon the list of vertices that make up the polygon
+ */
+void polygon_refresh(polygon_t *polygon);
 
 /**
  * Translate and rotate the polygon then update velocity based on gravity.
@@ -45,6 +150,7 @@ void polygon_move(polygon_t *polygon, double time_elapsed);
 /**
  * Computes the area of a polygon.
  * See https://en.wikipedia.org/wiki/Shoelace_formula#Statement.
+ * The area is computed once when the polygon's shape is created.
  *
  * @param polygon the list of vertices that make up the polygon,
  * listed in a counterclockwise direction. There is an edge between
@@ -56,6 +162,8 @@ double polygon_area(polygon_t *polygon);
 /**
  * Computes the center of mass of a polygon.
  * See https://en.wikipedia.org/wiki/Centroid#Of_a_polygon.
+ * The centroid is the position of the polygon's pose, so this takes constant
+ * time.
  *
  * @param polygon the list of vertices that make up the polygon,
  * listed in a counterclockwise direction. There is an edge between
@@ -66,7 +174,8 @@ vector_t polygon_centroid(polygon_t *polygon);
 
 /**
  * Translates all vertices in a polygon by a given vector.
- * Note: mutates the original polygon.
+ * Note: mutates the original polygon. Only the pose is updated, so this takes
+ * constant time.
  *
  * @param polygon the list of vertices that make up the polygon
  * @param translation the vector to add to each vertex's position
@@ -75,7 +184,8 @@ void polygon_translate(polygon_t *polygon, vector_t translation);
 
 /**
  * Rotates vertices in a polygon by a given angle about a given point.
- * Note: mutates the original polygon.
+ * Note: mutates the original polygon. Only the pose is updated, so this takes
+ * constant time.
  *
  * @param polygon the list of vertices that make up the polygon
  * @param angle the angle to rotate the polygon, in radians.
@@ -117,7 +227,8 @@ void polygon_set_center(polygon_t *polygon, vector_t centroid);
 vector_t polygon_get_center(polygon_t *polygon);
 
 /**
- * Sets the rotation angle of the polygon relative to the vertical.
+ * Sets the rotation angle of the polygon about its centroid, relative to the
+ * orientation it was created with.
  *
  * @param polygon a polygon_t struct
  * @param rot a double value of the angle in radians
@@ -125,7 +236,8 @@ vector_t polygon_get_center(polygon_t *polygon);
 void polygon_set_rotation(polygon_t *polygon, double rot);
 
 /**
- * Returns the rotation angle of the polygon relative to the vertical.
+ * Returns the rotation angle of the polygon about its centroid, relative to
+ * the orientation it was created with.
  *
  * @param polygon a polygon_t struct
  * @return a double value of the angle in radians
@@ -155,4 +267,20 @@ vector_t *polygon_get_velocity(polygon_t *polygon);
  */
 void polygon_free(polygon_t *polygon);
 
+/**
+ * Gets the occupancy statistics of the pool that polygons are allocated from.
+ *
+ * @return the polygon pool's statistics
+ */
+pool_stats_t polygon_pool_stats();
+
+/**
+ * Gets the combined occupancy statistics of the pools that polygon vertex
+ * arrays are allocated from. Vertex arrays are pooled by size class, so the
+ * block size of the result is 0.
+ *
+ * @return the vertex pools' statistics
+ */
+pool_stats_t polygon_vertex_pool_stats();
+
 #endif // #ifndef __POLYGON_H__
@@ -0,0 +1,89 @@
+#ifndef __POOL_H__
+#define __POOL_H__
+
+#include <stddef.h>
+
+/**
+ * A fixed-size block allocator.
+ * Every block handed out by a pool has the same size. Released blocks are kept
+ * on a free list and reused by later allocations, so objects that are created
+ * and destroyed every frame stop going through malloc once the pool has grown
+ * to the working set. The pool grows in chunks of several blocks at a time
+ * and only returns memory to the system in pool_free().
+ */
+typedef struct pool pool_t;
+
+/**
+ * Occupancy statistics for a pool.
+ */
+typedef struct pool_stats {
+  // Size in bytes of each block, after alignment
+  size_t block_size;
+  // Number of blocks currently handed out
+  size_t in_use;
+  // Largest value in_use has reached
+  size_t peak_in_use;
+  // Number of blocks the pool has room for without growing
+  size_t capacity;
+  // Number of times the pool has called malloc to grow
+  size_t num_chunks;
+} pool_stats_t;
+
+/**
+ * Allocates memory for an empty pool.
+ * No blocks are allocated until the first call to pool_alloc().
+ * Asserts that the required memory was allocated.
+ *
+ * @param block_size the size in bytes of each block
+ * @param blocks_per_chunk how many blocks to allocate each time the pool grows
+ * @return a pointer to the newly allocated pool
+ */
+pool_t *pool_init(size_t block_size, size_t blocks_per_chunk);
+
+/**
+ * Releases the pool and every block it has handed out.
+ * Blocks still in use become invalid.
+ *
+ * @param pool a pointer to a pool returned from pool_init()
+ */
+void pool_free(pool_t *pool);
+
+/**
+ * Hands out a block from the pool, growing the pool if it is full.
+ * The contents of the block are uninitialized.
+ * Asserts that the required memory was allocated.
+ *
+ * @param pool a pointer to a pool returned from pool_init()
+ * @return a pointer to a block of the pool's block size, suitably aligned
+ *   for any type
+ */
+void *pool_alloc(pool_t *pool);
+
+/**
+ * Returns a block to the pool so it can be handed out again.
+ * Does nothing if block is NULL.
+ *
+ * @param pool the pool the block was allocated from
+ * @param block a pointer returned from pool_alloc() on the same pool
+ */
+void pool_release(pool_t *pool, void *block);
+
+/**
+ * Gets the occupancy statistics of a pool.
+ *
+ * @param pool a pointer to a pool returned from pool_init()
+ * @return the pool's current statistics
+ */
+pool_stats_t pool_get_stats(pool_t *pool);
+
+/**
+ * Adds the counts in one set of pool statistics to another, for reporting
+ * several pools as one. The block size of the total is kept only if both
+ * sets agree on it, and is 0 otherwise.
+ *
+ * @param total the statistics to add to
+ * @param stats the statistics to add
+ */
+void pool_stats_add(pool_stats_t *total, pool_stats_t stats);
+
+#endif // #ifndef __POOL_H__
@@ -1,7 +1,10 @@
 #ifndef __SCENE_H__
 #define __SCENE_H__
 
+#include "aabb.h"
 #include "body.h"
+#include "broadphase.h"
+#include "collision.h"
 #include "list.h"
 
 /**
@@ -11,6 +14,12 @@
  */
 typedef struct scene scene_t;
 
+/**
+ * The number of user data pointers that can hang off each body handle,
+ * e.g. the game object and the sprite that belong to a body.
+ */
+enum { SCENE_HANDLE_DATA_SLOTS = 4 };
+
 /**
  * A function which adds some forces or impulses to bodies,
  * e.g. from collisions, gravity, or spring forces.
@@ -18,6 +27,57 @@ typedef struct scene scene_t;
  */
 typedef void (*force_creator_t)(void *aux);
 
+/**
+ * What has happened between two bodies since the last tick.
+ */
+typedef enum {
+  // The bodies started touching
+  CONTACT_ENTER,
+  // The bodies were touching and still are
+  CONTACT_STAY,
+  // The bodies stopped touching, or one of them is being removed
+  CONTACT_EXIT,
+} contact_event_t;
+
+/**
+ * Called each tick two bodies touch, and once when they stop.
+ *
+ * @param body1 the first body passed to scene_add_contact_handler()
+ * @param body2 the second body passed to scene_add_contact_handler()
+ * @param event whether the contact started, continued or ended
+ * @param info the contact manifold, with the axis pointing from body1 towards
+ *   body2. Not collided for CONTACT_EXIT.
+ * @param aux the auxiliary value passed to scene_add_contact_handler()
+ */
+typedef void (*contact_handler_t)(body_t *body1, body_t *body2,
+                                  contact_event_t event, collision_info_t info,
+                                  void *aux);
+
+/**
+ * Called with each body matching a spatial query.
+ * Takes in an auxiliary value that can store parameters or state.
+ *
+ * @return whether to keep looking for more matches
+ */
+typedef bool (*scene_query_t)(body_t *body, void *aux);
+
+/**
+ * The result of casting a ray through a scene.
+ */
+typedef struct scene_raycast {
+  // Whether the ray hit any body
+  bool hit;
+  // The first body hit
+  body_t *body;
+  // The fraction along the ray where it hit, from 0 at its start to 1 at its
+  // end
+  double fraction;
+  // The point where the ray hit
+  vector_t point;
+  // The outward normal of the body's edge at that point
+  vector_t normal;
+} scene_raycast_t;
+
 /**
  * Allocates memory for an empty scene.
  * Makes a reasonable guess of the number of bodies to allocate space for.
@@ -54,12 +114,47 @@ size_t scene_bodies(scene_t *scene);
 body_t *scene_get_body(scene_t *scene, size_t index);
 
 /**
- * Adds a body to a scene.
+ * Adds a body to a scene and gives it a handle.
+ * The handle stays valid until the body is removed and freed by scene_tick(),
+ * regardless of how the indices of other bodies change.
  *
  * @param scene a pointer to a scene returned from scene_init()
  * @param body a pointer to the body to add to the scene
+ * @return the body's handle (also available through body_get_handle())
  */
-void scene_add_body(scene_t *scene, body_t *body);
+body_handle_t scene_add_body(scene_t *scene, body_t *body);
+
+/**
+ * Looks up a body by its handle in constant time.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param handle a handle returned from scene_add_body()
+ * @return the body, or NULL if the handle is stale (its body has been freed)
+ */
+body_t *scene_resolve_body(scene_t *scene, body_handle_t handle);
+
+/**
+ * Attaches a user data pointer to a body handle.
+ * The scene does not own the data; it is simply forgotten when the body
+ * is freed. Does nothing if the handle is stale.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param handle a handle returned from scene_add_body()
+ * @param key which data slot to set, less than SCENE_HANDLE_DATA_SLOTS
+ * @param data the pointer to store (may be NULL to clear the slot)
+ */
+void scene_set_handle_data(scene_t *scene, body_handle_t handle, size_t key,
+                           void *data);
+
+/**
+ * Gets a user data pointer attached to a body handle in constant time.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param handle a handle returned from scene_add_body()
+ * @param key which data slot to read, less than SCENE_HANDLE_DATA_SLOTS
+ * @return the stored pointer, or NULL if the handle is stale or unset
+ */
+void *scene_get_handle_data(scene_t *scene, body_handle_t handle, size_t key);
 
 /**
  * @deprecated Use body_remove() instead
@@ -84,23 +179,295 @@ void scene_add_force_creator(scene_t *scene, force_creator_t forcer, void *aux);
  * The auxiliary value is passed to the force creator each time it is called.
  * The force creator is registered with a list of bodies it applies to,
  * so it can be removed when any one of the bodies is removed.
+ * Each body keeps a list of the force creators registered with it, so removing
+ * a body only costs as much as the force creators acting on it.
+ * Force creators run in no particular order.
  *
  * @param scene a pointer to a scene returned from scene_init()
  * @param forcer a force creator function
  * @param aux an auxiliary value to pass to forcer when it is called
  * @param bodies the list of bodies affected by the force creator.
  *   The force creator will be removed if any of these bodies are removed.
+ *   Bodies may be added to the scene before or after the force creator.
  *   This list does not own the bodies, so its freer should be NULL.
  */
 void scene_add_bodies_force_creator(scene_t *scene, force_creator_t forcer,
                                     void *aux, list_t *bodies);
 
+/**
+ * Adds a force creator to a scene, like scene_add_bodies_force_creator(), but
+ * with an aux of any type. A force creator with no bodies acts on the whole
+ * scene, and is only dropped when the scene is freed.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param forcer a force creator function
+ * @param aux an auxiliary value to pass to forcer when it is called
+ * @param bodies the list of bodies affected by the force creator; see
+ *   scene_add_bodies_force_creator()
+ * @param aux_freer a function to call on aux when the force creator is
+ *   dropped
+ */
+void scene_add_owned_force_creator(scene_t *scene, force_creator_t forcer,
+                                   void *aux, list_t *bodies,
+                                   free_func_t aux_freer);
+
+/**
+ * Subscribes a handler to the contact events between two bodies in a scene.
+ * The scene keeps one cached entry per pair of bodies, however many handlers
+ * are subscribed to it, and tests each pair once per scene_tick() (once the
+ * bodies have moved), remembering the axis that last separated it so that
+ * pairs that stay apart are cheap to check.
+ * A handler subscribed while its bodies touch gets CONTACT_ENTER on the next
+ * tick. The handler is dropped, after a CONTACT_EXIT if the bodies were
+ * touching, when either body is removed.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param body1 the first body, which must be in the scene
+ * @param body2 the second body, which must be in the scene
+ * @param handler the function to call with the pair's events
+ * @param aux an auxiliary value to pass to handler
+ * @param aux_freer if non-NULL, a function to call on aux when the handler is
+ *   dropped
+ */
+void scene_add_contact_handler(scene_t *scene, body_t *body1, body_t *body2,
+                               contact_handler_t handler, void *aux,
+                               free_func_t aux_freer);
+
+/**
+ * Subscribes a handler to the contact events between any body in one
+ * collision category and any body in another (see
+ * body_set_collision_filter()), e.g. between bullets and players.
+ * On every scene_tick(), the scene's broadphase finds the pairs whose boxes
+ * overlap and whose filters let them collide, and the pairs some type handler
+ * is interested in join the same cache as the pairs with their own handlers,
+ * so each contact is computed once for everyone.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param category1 the categories of the first body passed to handler
+ * @param category2 the categories of the second body passed to handler
+ * @param handler the function to call with the events of matching pairs
+ * @param aux an auxiliary value to pass to handler
+ * @param aux_freer if non-NULL, a function to call on aux when the scene is
+ *   freed
+ */
+void scene_add_type_handler(scene_t *scene, uint32_t category1,
+                            uint32_t category2, contact_handler_t handler,
+                            void *aux, free_func_t aux_freer);
+
+/**
+ * Gets the number of pairs of bodies a scene has contact handlers for.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @return the number of cached pairs
+ */
+size_t scene_contact_pairs(scene_t *scene);
+
+/**
+ * Gets the work done by the broadphase behind scene_add_type_handler().
+ * It only runs while there are type handlers.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @return the broadphase's statistics
+ */
+broadphase_stats_t scene_get_broadphase_stats(scene_t *scene);
+
+/**
+ * Calls a function on every body whose bounding box overlaps a box.
+ * Bodies marked for removal are skipped.
+ *
+ * The scene keeps its bodies in a bounding volume tree that is brought up to
+ * date in scene_tick(), so this and the other spatial queries take time
+ * logarithmic in the number of bodies. A body moved far by hand since the
+ * last tick may be missed until the next one.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param box the box to search
+ * @param callback the function to call with each body found
+ * @param aux an auxiliary value to pass to callback
+ */
+void scene_query_aabb(scene_t *scene, aabb_t box, scene_query_t callback,
+                      void *aux);
+
+/**
+ * Calls a function on every body whose bounding box comes within some
+ * distance of a point. Bodies marked for removal are skipped.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param center the point to search around
+ * @param radius the distance to search
+ * @param callback the function to call with each body found
+ * @param aux an auxiliary value to pass to callback
+ */
+void scene_query_radius(scene_t *scene, vector_t center, double radius,
+                        scene_query_t callback, void *aux);
+
+/**
+ * Finds the first body hit by the segment from start to end.
+ * Bodies containing start are not hit. Bodies marked for removal are skipped.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param start the start of the segment
+ * @param end the end of the segment
+ * @return the first hit; if hit is false, the other fields are undefined
+ */
+scene_raycast_t scene_raycast(scene_t *scene, vector_t start, vector_t end);
+
+/**
+ * Finds the bodies nearest to a point, measured to their bounding boxes.
+ * Bodies marked for removal are skipped.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param point the point to measure from
+ * @param k the most bodies to find
+ * @param nearest an array with room for k bodies, filled nearest first
+ * @return the number of bodies found, at most k
+ */
+size_t scene_query_nearest(scene_t *scene, vector_t point, size_t k,
+                           body_t **nearest);
+
+/**
+ * Sets how many threads scene_tick() runs on. With more than one, the force
+ * creators are split into that many chunks, each adding its forces into a
+ * buffer of its own. The buffers are then added up body by body in chunk
+ * order, and the bodies are ticked in parallel. Results differ slightly from
+ * a single thread's, since the forces are added in a different order, but
+ * they are the same on every run with the same number of threads.
+ * With more than one thread, force creators must only read bodies through
+ * the body_get_*() functions and apply forces and impulses to bodies in the
+ * scene. Each tick fills in every body's cached vertices before running them,
+ * so that reads don't write. Creators must not move, rotate or remove bodies,
+ * or take their polygons with body_get_polygon().
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param num_threads the number of threads, counting the caller; 1 (the
+ *   default) runs everything on the calling thread
+ */
+void scene_set_threads(scene_t *scene, size_t num_threads);
+
+/**
+ * Gets how many threads scene_tick() runs on.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @return the number of threads set by scene_set_threads()
+ */
+size_t scene_get_threads(scene_t *scene);
+
+/**
+ * Sets how scene_tick() moves the bodies. With a multi-stage integrator, the
+ * force creators run once per stage, with the bodies at that stage's
+ * intermediate state, so a tick costs that many times as much force work.
+ * Impulses only count in the first stage.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param integrator the integrator; INTEGRATOR_TRAPEZOIDAL by default
+ */
+void scene_set_integrator(scene_t *scene, integrator_t integrator);
+
+/**
+ * Gets how scene_tick() moves the bodies.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @return the integrator set by scene_set_integrator()
+ */
+integrator_t scene_get_integrator(scene_t *scene);
+
+/**
+ * Sets how many steps a body is ticked in, for bodies on stiff springs or
+ * close orbits that would need a smaller dt than the rest of the scene.
+ * Substepped bodies are ticked one at a time, before the rest, against the
+ * rest of the scene as it was at the start of the tick. Between steps only
+ * the force creators registered with the body are rerun, and only their
+ * forces on the body are kept; other forces on it are held constant.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param body a body in the scene
+ * @param substeps the number of steps per tick; 1 (the default) ticks the
+ *   body with the rest of the scene
+ */
+void scene_set_substeps(scene_t *scene, body_t *body, size_t substeps);
+
+/**
+ * Gets how many steps a body is ticked in.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param body a body in the scene
+ * @return the number of steps set by scene_set_substeps()
+ */
+size_t scene_get_substeps(scene_t *scene, body_t *body);
+
+/**
+ * Lets a scene put bodies to sleep. Bodies joined by force creators form an
+ * island, and an island sleeps once every body in it has been no faster
+ * than max_speed for quiet_ticks ticks in a row. Sleeping bodies, like static
+ * ones (see body_set_type()), aren't integrated, and force creators acting
+ * only on them aren't run. Pairs of them aren't tested for contact again
+ * either; their last result is kept.
+ * A sleeping body wakes, along with its island, when it is moved or pushed,
+ * or when an awake, moving body runs into it.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param quiet_ticks how many quiet ticks a body needs to sleep; 0 (the
+ *   default) keeps every body awake
+ * @param max_speed the fastest a quiet body can be going
+ */
+void scene_set_sleep(scene_t *scene, uint32_t quiet_ticks, double max_speed);
+
+/**
+ * Gets how many quiet ticks bodies in a scene need to fall asleep.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @return the number set by scene_set_sleep(), or 0 if bodies never sleep
+ */
+uint32_t scene_get_sleep_ticks(scene_t *scene);
+
+/**
+ * Adds a force field to a scene (see force_field_t). Each tick, and at each
+ * stage of the scene's integrator, the fields are applied to the bodies the
+ * scene ticks after the force creators have run, in the order they were
+ * added. Bodies ticked in several steps feel the fields as they were at the
+ * start of the tick.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param field the field to add
+ * @return the field's index, for scene_get_force_field() and
+ *   scene_set_force_field()
+ */
+size_t scene_add_force_field(scene_t *scene, force_field_t field);
+
+/**
+ * Gets one of a scene's force fields.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param index an index returned from scene_add_force_field()
+ * @return the field at that index
+ */
+force_field_t scene_get_force_field(scene_t *scene, size_t index);
+
+/**
+ * Replaces one of a scene's force fields, e.g. to move it or turn it off by
+ * giving it no categories.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param index an index returned from scene_add_force_field()
+ * @param field the field to put in its place
+ */
+void scene_set_force_field(scene_t *scene, size_t index, force_field_t field);
+
 /**
  * Executes a tick of a given scene over a small time interval.
- * This requires executing all the force creators
- * and then ticking each body (see body_tick()).
+ * This requires executing all the force creators and force fields
+ * and then ticking each body with the scene's integrator (see
+ * scene_set_integrator()). Sleeping and static bodies are left alone.
  * If any bodies are marked for removal, they should be removed from the scene
- * and freed, along with any force creators acting on them.
+ * and freed, along with any force creators and contact handlers acting on
+ * them.
+ * Then the spatial index is updated for the bodies that moved.
+ * Bodies marked fast (see body_set_fast()) are then swept along their motion
+ * and stopped just past the first body they touch, so they can't tunnel
+ * through it however large dt is.
+ * Islands of quiet bodies are then put to sleep (see scene_set_sleep()).
+ * Last comes the contact stage, which calls the contact handlers. Bodies they
+ * remove are freed on the next tick.
  *
  * @param scene a pointer to a scene returned from scene_init()
  * @param dt the time elapsed since the last tick, in seconds
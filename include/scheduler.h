@@ -0,0 +1,97 @@
+#ifndef __SCHEDULER_H__
+#define __SCHEDULER_H__
+
+#include <stddef.h>
+
+/**
+ * A fixed-timestep frame scheduler.
+ * Each frame, the wall time that has passed is added to an accumulator, and
+ * the simulation is advanced by as many fixed ticks as fit in it. What is
+ * left over becomes the interpolation alpha for rendering, so the simulation
+ * behaves the same at any frame rate. Each scheduler keeps its own tick rate,
+ * so several simulations can run side by side at different rates.
+ */
+typedef struct scheduler scheduler_t;
+
+/**
+ * Gets the time from a monotonic, high-resolution clock.
+ * Unlike clock(), this measures wall time rather than CPU time, and never
+ * jumps backwards.
+ *
+ * @return the current time in seconds, from an arbitrary starting point
+ */
+double scheduler_now(void);
+
+/**
+ * Allocates memory for a scheduler. Its first frame runs no ticks.
+ * Asserts that the required memory was allocated.
+ *
+ * @param tick_rate how many fixed ticks to run per second, e.g. 120
+ * @param max_substeps the most ticks to run in one frame. When a frame takes
+ *   longer than that, the rest of the time is dropped, so that a slow frame
+ *   can't make the next one slower still.
+ * @return a pointer to the newly allocated scheduler
+ */
+scheduler_t *scheduler_init(double tick_rate, size_t max_substeps);
+
+/**
+ * Releases the memory allocated for a scheduler.
+ *
+ * @param scheduler a pointer to a scheduler returned from scheduler_init()
+ */
+void scheduler_free(scheduler_t *scheduler);
+
+/**
+ * Starts a new frame, adding the time since the last frame (measured with
+ * scheduler_now()) to the accumulator.
+ *
+ * @param scheduler a pointer to a scheduler returned from scheduler_init()
+ * @return the number of fixed ticks to run this frame
+ */
+size_t scheduler_frame(scheduler_t *scheduler);
+
+/**
+ * Starts a new frame, adding a given amount of time to the accumulator.
+ * Useful for tests and for callers with their own clock.
+ *
+ * @param scheduler a pointer to a scheduler returned from scheduler_init()
+ * @param elapsed the time since the last frame in seconds
+ * @return the number of fixed ticks to run this frame
+ */
+size_t scheduler_advance(scheduler_t *scheduler, double elapsed);
+
+/**
+ * Gets the length of a scheduler's fixed tick.
+ *
+ * @param scheduler a pointer to a scheduler returned from scheduler_init()
+ * @return the time each tick simulates, in seconds
+ */
+double scheduler_get_dt(scheduler_t *scheduler);
+
+/**
+ * Gets how far the current frame is between the last two ticks, for
+ * interpolating what is rendered.
+ *
+ * @param scheduler a pointer to a scheduler returned from scheduler_init()
+ * @return the time left in the accumulator as a fraction of a tick, in [0, 1)
+ */
+double scheduler_get_alpha(scheduler_t *scheduler);
+
+/**
+ * Gets the number of ticks a scheduler has handed out.
+ *
+ * @param scheduler a pointer to a scheduler returned from scheduler_init()
+ * @return the total number of ticks
+ */
+size_t scheduler_get_ticks(scheduler_t *scheduler);
+
+/**
+ * Gets the amount of wall time a scheduler has dropped because frames needed
+ * more than max_substeps ticks.
+ *
+ * @param scheduler a pointer to a scheduler returned from scheduler_init()
+ * @return the time dropped in seconds
+ */
+double scheduler_get_dropped(scheduler_t *scheduler);
+
+#endif // #ifndef __SCHEDULER_H__
@@ -134,12 +134,22 @@ void sdl_on_key(key_handler_t handler);
 void sdl_on_click(mouse_handler_t handler);
 
 /**
- * Gets the amount of time that has passed since the last time
+ * Gets the amount of wall time that has passed since the last time
  * this function was called, in seconds.
+ * Games with a fixed timestep should use a scheduler_t instead.
  *
  * @return the number of seconds that have elapsed
  */
 double time_since_last_tick(void);
+
+/**
+ * Sets how far between the last two ticks to draw bodies' images, e.g. the
+ * alpha from scheduler_get_alpha(). At 0, each body is drawn where it was
+ * before its last tick; at 1 (the default), where it is now.
+ *
+ * @param alpha the fraction of the last tick to draw bodies at
+ */
+void sdl_set_interpolation(double alpha);
 /**
  * Creates the image given the position and size and texture.
  */
@@ -161,7 +171,10 @@ SDL_Texture *sdl_create_texture(const char *filename);
 SDL_Surface *sdl_create_message(const char *filename, double curr_time);
 
 /**
- * Given the body, return the bounding box as a SDL_Rect object.
+ * Given the body, return the bounding box as a SDL_Rect object,
+ * interpolated as set by sdl_set_interpolation().
+ * The rect is allocated from the frame arena, so it is only valid until the
+ * end of the current frame and must not be freed.
  */
 SDL_Rect *sdl_make_bounding_box(body_t *body);
 
@@ -0,0 +1,214 @@
+#ifndef __SHAPE_H__
+#define __SHAPE_H__
+
+#include "aabb.h"
+#include "pool.h"
+#include "vector.h"
+
+/**
+ * The kinds of shape. Polygons are described only by their outline; the other
+ * kinds also carry analytic parameters that collision kernels can use, along
+ * with an outline tessellated from them for drawing.
+ */
+typedef enum {
+  SHAPE_POLYGON,
+  SHAPE_CIRCLE,
+  SHAPE_ELLIPSE,
+  SHAPE_CAPSULE,
+  NUM_SHAPE_KINDS
+} shape_kind_t;
+
+/**
+ * An immutable polygon outline in local space.
+ * The vertices are stored relative to the outline's centroid, so placing a
+ * shape in the world only takes a position and an angle (see polygon_t).
+ * Shapes are reference counted, so any number of polygons with the same
+ * outline can share one vertex buffer.
+ */
+typedef struct shape shape_t;
+
+/**
+ * Creates a shape from vertices given in any coordinate frame.
+ * The vertices are copied and moved so that their centroid is the origin.
+ * The new shape has one reference, owned by the caller.
+ *
+ * @param vertices the vertices of the outline, in counterclockwise order
+ * @param num_vertices the number of vertices
+ * @param centroid if non-NULL, set to the centroid of the given vertices,
+ *   i.e. the position to place the shape at to reproduce them
+ * @return a pointer to the new shape
+ */
+shape_t *shape_init(const vector_t *vertices, size_t num_vertices,
+                    vector_t *centroid);
+
+/**
+ * Creates a circle centered on the origin.
+ * The new shape has one reference, owned by the caller.
+ *
+ * @param radius the radius of the circle
+ * @param num_vertices the number of vertices in the tessellated outline
+ * @return a pointer to the new shape
+ */
+shape_t *shape_init_circle(double radius, size_t num_vertices);
+
+/**
+ * Creates an axis-aligned ellipse centered on the origin.
+ * The new shape has one reference, owned by the caller.
+ *
+ * @param x_radius the semi-axis along local x
+ * @param y_radius the semi-axis along local y
+ * @param num_vertices the number of vertices in the tessellated outline
+ * @return a pointer to the new shape
+ */
+shape_t *shape_init_ellipse(double x_radius, double y_radius,
+                            size_t num_vertices);
+
+/**
+ * Creates a capsule centered on the origin: every point within radius of the
+ * segment from (-half_length, 0) to (half_length, 0).
+ * A capsule with zero half length is a circle.
+ * The new shape has one reference, owned by the caller.
+ *
+ * @param half_length half the length of the capsule's core segment
+ * @param radius the radius of the capsule's rounded ends
+ * @param num_vertices the number of vertices in the tessellated outline;
+ *   must be even unless half_length is zero
+ * @return a pointer to the new shape
+ */
+shape_t *shape_init_capsule(double half_length, double radius,
+                            size_t num_vertices);
+
+/**
+ * Adds a reference to a shape.
+ *
+ * @param shape a pointer to a shape returned from shape_init()
+ * @return the same shape, for convenience
+ */
+shape_t *shape_retain(shape_t *shape);
+
+/**
+ * Drops a reference to a shape, freeing it when no references remain.
+ *
+ * @param shape a pointer to a shape returned from shape_init()
+ */
+void shape_release(shape_t *shape);
+
+/**
+ * Returns the local-space vertices of a shape, centered on its centroid.
+ *
+ * @param shape a pointer to a shape returned from shape_init()
+ * @return a pointer to the first vertex
+ */
+const vector_t *shape_get_vertices(shape_t *shape);
+
+/**
+ * Returns the number of vertices in a shape.
+ *
+ * @param shape a pointer to a shape returned from shape_init()
+ * @return the number of vertices
+ */
+size_t shape_num_vertices(shape_t *shape);
+
+/**
+ * Returns the area of a shape.
+ *
+ * @param shape a pointer to a shape returned from shape_init()
+ * @return the area enclosed by the shape's vertices
+ */
+double shape_area(shape_t *shape);
+
+/**
+ * Returns the bounding box of a shape's local-space vertices.
+ *
+ * @param shape a pointer to a shape returned from shape_init()
+ * @return the bounding box of the unrotated shape, centered near the origin
+ */
+aabb_t shape_get_aabb(shape_t *shape);
+
+/**
+ * Returns the outward unit normals of a shape's edges, in local space.
+ * Normal i belongs to the edge from vertex i to vertex i + 1 (wrapping
+ * around), assuming the vertices are in counterclockwise order.
+ * Edges of zero length have a zero normal.
+ *
+ * @param shape a pointer to a shape returned from shape_init()
+ * @return a pointer to the first normal
+ */
+const vector_t *shape_get_normals(shape_t *shape);
+
+/**
+ * Returns the radius of the smallest circle around a shape's centroid that
+ * contains the whole shape. For circles this is exactly the circle's radius.
+ *
+ * @param shape a pointer to a shape returned from shape_init()
+ * @return the shape's bounding radius
+ */
+double shape_get_radius(shape_t *shape);
+
+/**
+ * Returns the kind of a shape.
+ *
+ * @param shape a pointer to a shape
+ * @return the shape's kind
+ */
+shape_kind_t shape_get_kind(shape_t *shape);
+
+/**
+ * Returns the semi-axes of an ellipse along local x and y.
+ *
+ * @param shape a pointer to a shape of kind SHAPE_ELLIPSE
+ * @return the semi-axes, or zero for other kinds
+ */
+vector_t shape_get_semi_axes(shape_t *shape);
+
+/**
+ * Returns half the length of a capsule's core segment, which lies along
+ * local x.
+ *
+ * @param shape a pointer to a shape
+ * @return the half length for capsules, or zero for other kinds
+ */
+double shape_get_half_length(shape_t *shape);
+
+/**
+ * Returns the radius of a circle or of a capsule's rounded ends.
+ *
+ * @param shape a pointer to a shape
+ * @return the radius for circles and capsules, or zero for other kinds
+ */
+double shape_get_round_radius(shape_t *shape);
+
+/**
+ * Allocates an array of vertices from the vertex pools.
+ * Arrays are pooled in power-of-two size classes; very large arrays fall back
+ * to malloc.
+ *
+ * @param num_vertices the length of the array
+ * @return a pointer to the uninitialized array
+ */
+vector_t *shape_alloc_vertices(size_t num_vertices);
+
+/**
+ * Returns an array of vertices to the vertex pools.
+ *
+ * @param vertices an array returned from shape_alloc_vertices()
+ * @param num_vertices the length the array was allocated with
+ */
+void shape_free_vertices(vector_t *vertices, size_t num_vertices);
+
+/**
+ * Gets the occupancy statistics of the pool that shapes are allocated from.
+ *
+ * @return the shape pool's statistics
+ */
+pool_stats_t shape_pool_stats();
+
+/**
+ * Gets the combined occupancy statistics of the vertex pools.
+ * The block size of the result is 0, since the pools differ in size.
+ *
+ * @return the vertex pools' statistics
+ */
+pool_stats_t shape_vertex_pool_stats();
+
+#endif // #ifndef __SHAPE_H__
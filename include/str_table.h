@@ -0,0 +1,69 @@
+#ifndef __STR_TABLE_H__
+#define __STR_TABLE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * A table of interned strings, indexed by an open-addressing hash table.
+ * Each distinct string is copied once and given a small integer ID.
+ * IDs are assigned in insertion order starting at 0 and never change,
+ * so callers can keep an ID and skip hashing the string entirely.
+ */
+typedef struct str_table str_table_t;
+
+/**
+ * Allocates memory for an empty string table.
+ * Asserts that the required memory was allocated.
+ *
+ * @param initial_capacity the number of strings to allocate space for
+ * @return a pointer to the newly allocated table
+ */
+str_table_t *str_table_init(size_t initial_capacity);
+
+/**
+ * Releases the memory allocated for a string table and its interned strings.
+ *
+ * @param table a pointer to a table returned from str_table_init()
+ */
+void str_table_free(str_table_t *table);
+
+/**
+ * Gets the number of distinct strings in the table.
+ *
+ * @param table a pointer to a table returned from str_table_init()
+ * @return the number of interned strings
+ */
+size_t str_table_size(str_table_t *table);
+
+/**
+ * Looks up a string in the table.
+ * Runs in expected constant time regardless of the table's size.
+ *
+ * @param table a pointer to a table returned from str_table_init()
+ * @param str the string to look up
+ * @param id if the string is found, set to its ID
+ * @return whether the string is in the table
+ */
+bool str_table_find(str_table_t *table, const char *str, size_t *id);
+
+/**
+ * Interns a string, copying it into the table if it is not already present.
+ *
+ * @param table a pointer to a table returned from str_table_init()
+ * @param str the string to intern
+ * @return the string's ID
+ */
+size_t str_table_intern(str_table_t *table, const char *str);
+
+/**
+ * Gets the interned copy of the string with the given ID.
+ * Asserts that the ID is valid.
+ *
+ * @param table a pointer to a table returned from str_table_init()
+ * @param id an ID returned from str_table_intern()
+ * @return the interned string, owned by the table
+ */
+const char *str_table_get(str_table_t *table, size_t id);
+
+#endif // #ifndef __STR_TABLE_H__
@@ -0,0 +1,61 @@
+#ifndef __THREAD_POOL_H__
+#define __THREAD_POOL_H__
+
+#include <stddef.h>
+
+/**
+ * A fixed set of worker threads that run batches of tasks.
+ * The thread that submits a batch works on it too, and waits for the whole
+ * batch to finish, so a pool of n threads has n - 1 workers.
+ * If the platform can't start threads, the submitting thread runs every task.
+ */
+typedef struct thread_pool thread_pool_t;
+
+/**
+ * Runs one task of a batch.
+ *
+ * @param aux the auxiliary value the batch was submitted with
+ * @param task the index of the task, from 0 to the batch's size - 1
+ */
+typedef void (*thread_pool_task_t)(void *aux, size_t task);
+
+/**
+ * Allocates memory for a pool and starts its workers.
+ * Asserts that the required memory was allocated.
+ *
+ * @param num_threads the number of threads to run tasks on, including the
+ *   thread submitting them; at least 1
+ * @return a pointer to the newly allocated pool
+ */
+thread_pool_t *thread_pool_init(size_t num_threads);
+
+/**
+ * Stops a pool's workers and releases the memory allocated for it.
+ *
+ * @param pool a pointer to a pool returned from thread_pool_init()
+ */
+void thread_pool_free(thread_pool_t *pool);
+
+/**
+ * Gets the number of threads a pool runs tasks on, counting the thread that
+ * submits them.
+ *
+ * @param pool a pointer to a pool returned from thread_pool_init()
+ * @return the number of threads
+ */
+size_t thread_pool_size(thread_pool_t *pool);
+
+/**
+ * Runs a batch of tasks across a pool and waits for all of them to finish.
+ * Tasks may run in any order and on any thread. Not reentrant: tasks must
+ * not submit batches to the same pool.
+ *
+ * @param pool a pointer to a pool returned from thread_pool_init()
+ * @param task the function to call for each task
+ * @param aux an auxiliary value to pass to task
+ * @param num_tasks the number of tasks in the batch
+ */
+void thread_pool_run(thread_pool_t *pool, thread_pool_task_t task, void *aux,
+                     size_t num_tasks);
+
+#endif // #ifndef __THREAD_POOL_H__
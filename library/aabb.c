@@ -0,0 +1,53 @@
+#include "aabb.h"
+#include <math.h>
+
+const aabb_t AABB_EVERYWHERE = {.min = {-INFINITY, -INFINITY},
+                                .max = {INFINITY, INFINITY}};
+
+aabb_t aabb_of_points(const vector_t *points, size_t num_points) {
+  aabb_t box = {.min = {INFINITY, INFINITY}, .max = {-INFINITY, -INFINITY}};
+  for (size_t i = 0; i < num_points; i++) {
+    box.min.x = fmin(box.min.x, points[i].x);
+    box.min.y = fmin(box.min.y, points[i].y);
+    box.max.x = fmax(box.max.x, points[i].x);
+    box.max.y = fmax(box.max.y, points[i].y);
+  }
+  return box;
+}
+
+aabb_t aabb_translate(aabb_t box, vector_t translation) {
+  return (aabb_t){.min = vec_add(box.min, translation),
+                  .max = vec_add(box.max, translation)};
+}
+
+aabb_t aabb_union(aabb_t box1, aabb_t box2) {
+  return (aabb_t){.min = {fmin(box1.min.x, box2.min.x),
+                          fmin(box1.min.y, box2.min.y)},
+                  .max = {fmax(box1.max.x, box2.max.x),
+                          fmax(box1.max.y, box2.max.y)}};
+}
+
+bool aabb_overlaps(aabb_t box1, aabb_t box2) {
+  return box1.min.x <= box2.max.x && box2.min.x <= box1.max.x &&
+         box1.min.y <= box2.max.y && box2.min.y <= box1.max.y;
+}
+
+bool aabb_contains(aabb_t box, vector_t point) {
+  return box.min.x <= point.x && point.x <= box.max.x &&
+         box.min.y <= point.y && point.y <= box.max.y;
+}
+
+aabb_t aabb_expand(aabb_t box, double margin) {
+  return (aabb_t){.min = {box.min.x - margin, box.min.y - margin},
+                  .max = {box.max.x + margin, box.max.y + margin}};
+}
+
+double aabb_perimeter(aabb_t box) {
+  return 2 * ((box.max.x - box.min.x) + (box.max.y - box.min.y));
+}
+
+double aabb_distance(aabb_t box, vector_t point) {
+  double dx = fmax(fmax(box.min.x - point.x, point.x - box.max.x), 0);
+  double dy = fmax(fmax(box.min.y - point.y, point.y - box.max.y), 0);
+  return sqrt(dx * dx + dy * dy);
+}
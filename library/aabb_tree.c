@@ -0,0 +1,461 @@
+#include "aabb_tree.h"
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// Depth-first traversals push at most one node per level plus one, and the
+// balancing keeps the height logarithmic, so this is plenty
+#define TREE_STACK_SIZE 256
+
+const size_t TREE_NULL_NODE = SIZE_MAX;
+const size_t TREE_INITIAL_NODES = 16;
+
+typedef struct tree_node {
+  // For leaves, the fattened box of the proxy; otherwise the union of the
+  // children's boxes
+  aabb_t box;
+  void *data;
+  // The next free node while the node is on the free list
+  size_t parent;
+  size_t left;
+  size_t right;
+  // 0 for leaves, -1 for free nodes
+  int height;
+} tree_node_t;
+
+// A node waiting to be visited by a nearest-proxy search
+typedef struct nearest_entry {
+  double distance;
+  size_t node;
+  // Whether distance is the exact distance to the proxy's object, rather than
+  // a lower bound from its box
+  bool exact;
+} nearest_entry_t;
+
+struct aabb_tree {
+  tree_node_t *nodes;
+  size_t node_capacity;
+  size_t num_nodes;
+  size_t free_node;
+  size_t root;
+  size_t num_proxies;
+  double margin;
+  nearest_entry_t *heap;
+  size_t heap_capacity;
+};
+
+aabb_tree_t *aabb_tree_init(double margin) {
+  assert(margin >= 0);
+  aabb_tree_t *tree = malloc(sizeof(aabb_tree_t));
+  assert(tree != NULL);
+  tree->nodes = NULL;
+  tree->node_capacity = 0;
+  tree->num_nodes = 0;
+  tree->free_node = TREE_NULL_NODE;
+  tree->root = TREE_NULL_NODE;
+  tree->num_proxies = 0;
+  tree->margin = margin;
+  tree->heap = NULL;
+  tree->heap_capacity = 0;
+  return tree;
+}
+
+void aabb_tree_free(aabb_tree_t *tree) {
+  free(tree->nodes);
+  free(tree->heap);
+  free(tree);
+}
+
+size_t aabb_tree_size(aabb_tree_t *tree) { return tree->num_proxies; }
+
+size_t aabb_tree_height(aabb_tree_t *tree) {
+  if (tree->root == TREE_NULL_NODE) {
+    return 0;
+  }
+  return tree->nodes[tree->root].height + 1;
+}
+
+static bool is_leaf(tree_node_t *node) { return node->left == TREE_NULL_NODE; }
+
+static size_t allocate_node(aabb_tree_t *tree) {
+  if (tree->free_node == TREE_NULL_NODE) {
+    assert(tree->num_nodes == tree->node_capacity);
+    tree->node_capacity = tree->node_capacity > 0 ? tree->node_capacity * 2
+                                                  : TREE_INITIAL_NODES;
+    tree->nodes =
+        realloc(tree->nodes, tree->node_capacity * sizeof(tree_node_t));
+    assert(tree->nodes != NULL);
+    for (size_t i = tree->num_nodes; i < tree->node_capacity; i++) {
+      tree->nodes[i].parent =
+          i + 1 < tree->node_capacity ? i + 1 : TREE_NULL_NODE;
+      tree->nodes[i].height = -1;
+    }
+    tree->free_node = tree->num_nodes;
+  }
+  size_t index = tree->free_node;
+  tree_node_t *node = &tree->nodes[index];
+  tree->free_node = node->parent;
+  node->parent = TREE_NULL_NODE;
+  node->left = TREE_NULL_NODE;
+  node->right = TREE_NULL_NODE;
+  node->data = NULL;
+  node->height = 0;
+  tree->num_nodes++;
+  return index;
+}
+
+static void release_node(aabb_tree_t *tree, size_t index) {
+  tree->nodes[index].parent = tree->free_node;
+  tree->nodes[index].height = -1;
+  tree->free_node = index;
+  tree->num_nodes--;
+}
+
+/**
+ * Replaces a child of a node, or the root if the node is TREE_NULL_NODE.
+ */
+static void replace_child(aabb_tree_t *tree, size_t parent, size_t old_child,
+                          size_t new_child) {
+  if (parent == TREE_NULL_NODE) {
+    tree->root = new_child;
+  } else if (tree->nodes[parent].left == old_child) {
+    tree->nodes[parent].left = new_child;
+  } else {
+    tree->nodes[parent].right = new_child;
+  }
+}
+
+/**
+ * Recomputes a branch's box and height from its children.
+ */
+static void refit(aabb_tree_t *tree, size_t index) {
+  tree_node_t *node = &tree->nodes[index];
+  tree_node_t *left = &tree->nodes[node->left];
+  tree_node_t *right = &tree->nodes[node->right];
+  node->box = aabb_union(left->box, right->box);
+  node->height = 1 + (left->height > right->height ? left->height
+                                                   : right->height);
+}
+
+/**
+ * If one subtree of a node is more than one level taller than the other,
+ * rotates the taller child up into the node's place.
+ *
+ * @return the index of the node now at the top of the subtree
+ */
+static size_t balance(aabb_tree_t *tree, size_t a) {
+  tree_node_t *nodes = tree->nodes;
+  if (is_leaf(&nodes[a]) || nodes[a].height < 2) {
+    return a;
+  }
+  size_t b = nodes[a].left;
+  size_t c = nodes[a].right;
+  int skew = nodes[c].height - nodes[b].height;
+  if (skew >= -1 && skew <= 1) {
+    return a;
+  }
+
+  // Rotate the taller child up; the shorter of its children moves under a
+  size_t up = skew > 1 ? c : b;
+  size_t first = nodes[up].left;
+  size_t second = nodes[up].right;
+  size_t keep = nodes[first].height > nodes[second].height ? first : second;
+  size_t give = keep == first ? second : first;
+
+  nodes[up].left = a;
+  nodes[up].right = keep;
+  nodes[up].parent = nodes[a].parent;
+  replace_child(tree, nodes[a].parent, a, up);
+  nodes[a].parent = up;
+  if (skew > 1) {
+    nodes[a].right = give;
+  } else {
+    nodes[a].left = give;
+  }
+  nodes[give].parent = a;
+
+  refit(tree, a);
+  refit(tree, up);
+  return up;
+}
+
+/**
+ * Walks from a node up to the root, rebalancing and refitting every branch.
+ */
+static void fix_upwards(aabb_tree_t *tree, size_t index) {
+  while (index != TREE_NULL_NODE) {
+    index = balance(tree, index);
+    refit(tree, index);
+    index = tree->nodes[index].parent;
+  }
+}
+
+static void insert_leaf(aabb_tree_t *tree, size_t leaf) {
+  if (tree->root == TREE_NULL_NODE) {
+    tree->root = leaf;
+    tree->nodes[leaf].parent = TREE_NULL_NODE;
+    return;
+  }
+
+  // Descend towards the sibling that grows the total perimeter the least
+  aabb_t leaf_box = tree->nodes[leaf].box;
+  size_t index = tree->root;
+  while (!is_leaf(&tree->nodes[index])) {
+    tree_node_t *node = &tree->nodes[index];
+    double perimeter = aabb_perimeter(node->box);
+    double combined = aabb_perimeter(aabb_union(node->box, leaf_box));
+    // Cost of pairing the leaf with this node right here
+    double cost = 2 * combined;
+    // Cost every level below pays for this node growing
+    double inherited = 2 * (combined - perimeter);
+
+    double child_costs[2];
+    size_t children[2] = {node->left, node->right};
+    for (size_t i = 0; i < 2; i++) {
+      tree_node_t *child = &tree->nodes[children[i]];
+      double grown = aabb_perimeter(aabb_union(child->box, leaf_box));
+      if (!is_leaf(child)) {
+        grown -= aabb_perimeter(child->box);
+      }
+      child_costs[i] = grown + inherited;
+    }
+    if (cost < child_costs[0] && cost < child_costs[1]) {
+      break;
+    }
+    index = child_costs[0] < child_costs[1] ? children[0] : children[1];
+  }
+
+  size_t sibling = index;
+  size_t old_parent = tree->nodes[sibling].parent;
+  size_t new_parent = allocate_node(tree);
+  tree_node_t *nodes = tree->nodes;
+  nodes[new_parent].parent = old_parent;
+  nodes[new_parent].left = sibling;
+  nodes[new_parent].right = leaf;
+  replace_child(tree, old_parent, sibling, new_parent);
+  nodes[sibling].parent = new_parent;
+  nodes[leaf].parent = new_parent;
+  fix_upwards(tree, new_parent);
+}
+
+static void remove_leaf(aabb_tree_t *tree, size_t leaf) {
+  tree_node_t *nodes = tree->nodes;
+  if (leaf == tree->root) {
+    tree->root = TREE_NULL_NODE;
+    return;
+  }
+  size_t parent = nodes[leaf].parent;
+  size_t grandparent = nodes[parent].parent;
+  size_t sibling =
+      nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+
+  replace_child(tree, grandparent, parent, sibling);
+  nodes[sibling].parent = grandparent;
+  release_node(tree, parent);
+  fix_upwards(tree, grandparent);
+}
+
+size_t aabb_tree_insert(aabb_tree_t *tree, aabb_t box, void *data) {
+  size_t proxy = allocate_node(tree);
+  tree->nodes[proxy].box = aabb_expand(box, tree->margin);
+  tree->nodes[proxy].data = data;
+  insert_leaf(tree, proxy);
+  tree->num_proxies++;
+  return proxy;
+}
+
+void aabb_tree_remove(aabb_tree_t *tree, size_t proxy) {
+  assert(proxy < tree->node_capacity && is_leaf(&tree->nodes[proxy]));
+  remove_leaf(tree, proxy);
+  release_node(tree, proxy);
+  tree->num_proxies--;
+}
+
+bool aabb_tree_move(aabb_tree_t *tree, size_t proxy, aabb_t box) {
+  assert(proxy < tree->node_capacity && is_leaf(&tree->nodes[proxy]));
+  aabb_t fat = tree->nodes[proxy].box;
+  if (aabb_contains(fat, box.min) && aabb_contains(fat, box.max)) {
+    return false;
+  }
+  remove_leaf(tree, proxy);
+  tree->nodes[proxy].box = aabb_expand(box, tree->margin);
+  insert_leaf(tree, proxy);
+  return true;
+}
+
+void *aabb_tree_get_data(aabb_tree_t *tree, size_t proxy) {
+  assert(proxy < tree->node_capacity);
+  return tree->nodes[proxy].data;
+}
+
+aabb_t aabb_tree_get_fat_aabb(aabb_tree_t *tree, size_t proxy) {
+  assert(proxy < tree->node_capacity);
+  return tree->nodes[proxy].box;
+}
+
+void aabb_tree_query(aabb_tree_t *tree, aabb_t box, aabb_tree_query_t callback,
+                     void *aux) {
+  if (tree->root == TREE_NULL_NODE) {
+    return;
+  }
+  size_t stack[TREE_STACK_SIZE];
+  size_t size = 0;
+  stack[size++] = tree->root;
+  while (size > 0) {
+    tree_node_t *node = &tree->nodes[stack[--size]];
+    if (!aabb_overlaps(node->box, box)) {
+      continue;
+    }
+    if (is_leaf(node)) {
+      if (!callback(node->data, aux)) {
+        return;
+      }
+    } else {
+      assert(size + 2 <= TREE_STACK_SIZE);
+      stack[size++] = node->left;
+      stack[size++] = node->right;
+    }
+  }
+}
+
+/**
+ * Returns the fraction along a segment where it enters a box, or INFINITY if
+ * it misses the box or only reaches it after max_fraction.
+ */
+static double segment_enters_box(vector_t start, vector_t delta,
+                                 double max_fraction, aabb_t box) {
+  double enter = 0;
+  double leave = max_fraction;
+  double starts[2] = {start.x, start.y};
+  double deltas[2] = {delta.x, delta.y};
+  double mins[2] = {box.min.x, box.min.y};
+  double maxes[2] = {box.max.x, box.max.y};
+  for (size_t axis = 0; axis < 2; axis++) {
+    if (deltas[axis] == 0) {
+      if (starts[axis] < mins[axis] || starts[axis] > maxes[axis]) {
+        return INFINITY;
+      }
+      continue;
+    }
+    double t1 = (mins[axis] - starts[axis]) / deltas[axis];
+    double t2 = (maxes[axis] - starts[axis]) / deltas[axis];
+    enter = fmax(enter, fmin(t1, t2));
+    leave = fmin(leave, fmax(t1, t2));
+    if (enter > leave) {
+      return INFINITY;
+    }
+  }
+  return enter;
+}
+
+void *aabb_tree_raycast(aabb_tree_t *tree, vector_t start, vector_t end,
+                        aabb_tree_raycast_t callback, void *aux,
+                        double *fraction) {
+  if (tree->root == TREE_NULL_NODE) {
+    return NULL;
+  }
+  vector_t delta = vec_subtract(end, start);
+  double best_fraction = 1;
+  void *best = NULL;
+  size_t stack[TREE_STACK_SIZE];
+  size_t size = 0;
+  stack[size++] = tree->root;
+  while (size > 0) {
+    tree_node_t *node = &tree->nodes[stack[--size]];
+    if (segment_enters_box(start, delta, best_fraction, node->box) ==
+        INFINITY) {
+      continue;
+    }
+    if (is_leaf(node)) {
+      double hit = callback(node->data, start, end, aux);
+      if (hit <= best_fraction) {
+        best_fraction = hit;
+        best = node->data;
+      }
+    } else {
+      assert(size + 2 <= TREE_STACK_SIZE);
+      stack[size++] = node->left;
+      stack[size++] = node->right;
+    }
+  }
+  if (best != NULL && fraction != NULL) {
+    *fraction = best_fraction;
+  }
+  return best;
+}
+
+static void heap_push(aabb_tree_t *tree, size_t *size, nearest_entry_t entry) {
+  if (*size == tree->heap_capacity) {
+    tree->heap_capacity =
+        tree->heap_capacity > 0 ? tree->heap_capacity * 2 : TREE_INITIAL_NODES;
+    tree->heap =
+        realloc(tree->heap, tree->heap_capacity * sizeof(nearest_entry_t));
+    assert(tree->heap != NULL);
+  }
+  nearest_entry_t *heap = tree->heap;
+  size_t i = (*size)++;
+  while (i > 0 && heap[(i - 1) / 2].distance > entry.distance) {
+    heap[i] = heap[(i - 1) / 2];
+    i = (i - 1) / 2;
+  }
+  heap[i] = entry;
+}
+
+static nearest_entry_t heap_pop(aabb_tree_t *tree, size_t *size) {
+  nearest_entry_t *heap = tree->heap;
+  nearest_entry_t top = heap[0];
+  nearest_entry_t last = heap[--*size];
+  size_t i = 0;
+  while (2 * i + 1 < *size) {
+    size_t child = 2 * i + 1;
+    if (child + 1 < *size && heap[child + 1].distance < heap[child].distance) {
+      child++;
+    }
+    if (heap[child].distance >= last.distance) {
+      break;
+    }
+    heap[i] = heap[child];
+    i = child;
+  }
+  heap[i] = last;
+  return top;
+}
+
+size_t aabb_tree_nearest(aabb_tree_t *tree, vector_t point, size_t k,
+                         aabb_tree_distance_t callback, void *aux,
+                         void **nearest) {
+  if (tree->root == TREE_NULL_NODE || k == 0) {
+    return 0;
+  }
+  // Best-first search: nodes come off the heap in order of the distance to
+  // their boxes, so once an exact distance is on top nothing else is closer
+  size_t size = 0;
+  size_t found = 0;
+  heap_push(tree, &size,
+            (nearest_entry_t){aabb_distance(tree->nodes[tree->root].box, point),
+                              tree->root, false});
+  while (size > 0) {
+    nearest_entry_t entry = heap_pop(tree, &size);
+    tree_node_t *node = &tree->nodes[entry.node];
+    if (entry.exact) {
+      nearest[found++] = node->data;
+      if (found == k) {
+        break;
+      }
+    } else if (is_leaf(node)) {
+      double distance = callback(node->data, point, aux);
+      if (distance != INFINITY) {
+        heap_push(tree, &size, (nearest_entry_t){distance, entry.node, true});
+      }
+    } else {
+      size_t children[2] = {node->left, node->right};
+      for (size_t i = 0; i < 2; i++) {
+        aabb_t box = tree->nodes[children[i]].box;
+        heap_push(tree, &size, (nearest_entry_t){aabb_distance(box, point),
+                                                 children[i], false});
+      }
+    }
+  }
+  return found;
+}
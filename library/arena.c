@@ -0,0 +1,139 @@
+#include "arena.h"
+#include <assert.h>
+#include <stdalign.h>
+#include <stdlib.h>
+
+const size_t ARENA_ALIGNMENT = alignof(max_align_t);
+const size_t MIN_ARENA_BLOCK = 4096;
+const size_t INITIAL_NUM_BLOCKS = 4;
+const size_t FRAME_ARENA_CAPACITY = 64 * 1024;
+
+typedef struct block {
+  char *data;
+  size_t capacity;
+} block_t;
+
+struct arena {
+  block_t *blocks;
+  size_t num_blocks;
+  size_t max_blocks;
+  // The block allocations currently come from, and the offset into it
+  size_t current;
+  size_t offset;
+  size_t used;
+  size_t high_water;
+};
+
+static arena_t *FRAME_ARENA = NULL;
+
+static block_t block_init(size_t capacity) {
+  if (capacity < MIN_ARENA_BLOCK) {
+    capacity = MIN_ARENA_BLOCK;
+  }
+  char *data = malloc(capacity);
+  assert(data != NULL);
+  return (block_t){.data = data, .capacity = capacity};
+}
+
+static void arena_add_block(arena_t *arena, size_t capacity) {
+  if (arena->num_blocks == arena->max_blocks) {
+    arena->max_blocks *= 2;
+    arena->blocks = realloc(arena->blocks, sizeof(block_t) * arena->max_blocks);
+    assert(arena->blocks != NULL);
+  }
+  arena->blocks[arena->num_blocks] = block_init(capacity);
+  arena->num_blocks++;
+}
+
+/**
+ * Frees the blocks at and after the given index.
+ */
+static void arena_truncate(arena_t *arena, size_t num_blocks) {
+  for (size_t i = num_blocks; i < arena->num_blocks; i++) {
+    free(arena->blocks[i].data);
+  }
+  arena->num_blocks = num_blocks;
+}
+
+arena_t *arena_init(size_t capacity) {
+  arena_t *arena = malloc(sizeof(arena_t));
+  assert(arena != NULL);
+  arena->blocks = malloc(sizeof(block_t) * INITIAL_NUM_BLOCKS);
+  assert(arena->blocks != NULL);
+  arena->num_blocks = 0;
+  arena->max_blocks = INITIAL_NUM_BLOCKS;
+  arena_add_block(arena, capacity);
+  arena->current = 0;
+  arena->offset = 0;
+  arena->used = 0;
+  arena->high_water = 0;
+  return arena;
+}
+
+void arena_free(arena_t *arena) {
+  arena_truncate(arena, 0);
+  free(arena->blocks);
+  free(arena);
+}
+
+void *arena_alloc(arena_t *arena, size_t size) {
+  size = (size + ARENA_ALIGNMENT - 1) / ARENA_ALIGNMENT * ARENA_ALIGNMENT;
+  if (arena->offset + size > arena->blocks[arena->current].capacity) {
+    // Move on to the next block, replacing any that are too small to hold
+    // this allocation. Blocks after the current one are always empty.
+    size_t next = arena->current + 1;
+    if (next == arena->num_blocks || arena->blocks[next].capacity < size) {
+      arena_truncate(arena, next);
+      arena_add_block(arena, 2 * arena->blocks[arena->current].capacity > size
+                                 ? 2 * arena->blocks[arena->current].capacity
+                                 : size);
+    }
+    arena->current = next;
+    arena->offset = 0;
+  }
+  void *result = arena->blocks[arena->current].data + arena->offset;
+  arena->offset += size;
+  arena->used += size;
+  if (arena->used > arena->high_water) {
+    arena->high_water = arena->used;
+  }
+  return result;
+}
+
+arena_mark_t arena_mark(arena_t *arena) {
+  return (arena_mark_t){
+      .block = arena->current, .offset = arena->offset, .used = arena->used};
+}
+
+void arena_release(arena_t *arena, arena_mark_t mark) {
+  assert(mark.block < arena->current ||
+         (mark.block == arena->current && mark.offset <= arena->offset));
+  arena->current = mark.block;
+  arena->offset = mark.offset;
+  arena->used = mark.used;
+}
+
+void arena_reset(arena_t *arena) {
+  if (arena->num_blocks > 1) {
+    size_t capacity = 0;
+    for (size_t i = 0; i < arena->num_blocks; i++) {
+      capacity += arena->blocks[i].capacity;
+    }
+    arena_truncate(arena, 0);
+    arena_add_block(arena, capacity);
+  }
+  arena->current = 0;
+  arena->offset = 0;
+  arena->used = 0;
+}
+
+size_t arena_used(arena_t *arena) { return arena->used; }
+
+size_t arena_high_water(arena_t *arena) { return arena->high_water; }
+
+arena_t *frame_arena() {
+  if (FRAME_ARENA == NULL) {
+    FRAME_ARENA = arena_init(FRAME_ARENA_CAPACITY);
+  }
+  return FRAME_ARENA;
+}
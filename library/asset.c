@@ -5,8 +5,11 @@
 #include "asset.h"
 #include "asset_cache.h"
 #include "color.h"
+#include "pool.h"
 #include "sdl_wrapper.h"
 
+const size_t ASSET_POOL_CHUNK = 64;
+
 typedef struct asset {
   asset_type_t type;
   SDL_Rect bounding_box;
@@ -33,26 +36,28 @@ typedef struct button_asset {
   bool is_rendered;
 } button_asset_t;
 
-static asset_t *asset_init(asset_type_t ty, SDL_Rect bounding_box) {
-  asset_t *new;
-  switch (ty) {
-  case ASSET_IMAGE: {
-    new = malloc(sizeof(image_asset_t));
-    break;
-  }
-  case ASSET_FONT: {
-    new = malloc(sizeof(text_asset_t));
-    break;
-  }
-  case ASSET_BUTTON: {
-    new = malloc(sizeof(button_asset_t));
-    break;
-  }
-  default: {
-    assert(false && "Unknown asset type");
-  }
+// Every kind of asset is allocated from one pool whose blocks fit the largest
+typedef union {
+  image_asset_t image;
+  text_asset_t text;
+  button_asset_t button;
+} any_asset_t;
+
+static pool_t *ASSET_POOL = NULL;
+
+static pool_t *asset_pool() {
+  if (ASSET_POOL == NULL) {
+    ASSET_POOL = pool_init(sizeof(any_asset_t), ASSET_POOL_CHUNK);
   }
-  assert(new);
+  return ASSET_POOL;
+}
+
+pool_stats_t asset_pool_stats() { return pool_get_stats(asset_pool()); }
+
+static asset_t *asset_init(asset_type_t ty, SDL_Rect bounding_box) {
+  assert((ty == ASSET_IMAGE || ty == ASSET_FONT || ty == ASSET_BUTTON) &&
+         "Unknown asset type");
+  asset_t *new = pool_alloc(asset_pool());
   new->type = ty;
   new->bounding_box = bounding_box;
   return new;
@@ -62,10 +67,8 @@ asset_type_t asset_get_type(asset_t *asset) { return asset->type; }
 
 asset_t *asset_make_image(const char *filepath, SDL_Rect bounding_box) {
   SDL_Texture *texture = asset_cache_obj_get_or_create(ASSET_IMAGE, filepath);
-  asset_t *asset = asset_init(ASSET_IMAGE, bounding_box);
-  image_asset_t *image_asset = malloc(sizeof(image_asset_t));
-  assert(image_asset != NULL);
-  image_asset->base = *asset;
+  image_asset_t *image_asset =
+      (image_asset_t *)asset_init(ASSET_IMAGE, bounding_box);
   image_asset->texture = texture;
   image_asset->body = NULL;
   return (asset_t *)image_asset;
@@ -73,10 +76,9 @@ asset_t *asset_make_image(const char *filepath, SDL_Rect bounding_box) {
 
 asset_t *asset_make_image_with_body(const char *filepath, body_t *body) {
   SDL_Texture *texture = asset_cache_obj_get_or_create(ASSET_IMAGE, filepath);
-  asset_t *asset = asset_init(ASSET_IMAGE, *sdl_make_bounding_box(body));
-  image_asset_t *image_asset = malloc(sizeof(image_asset_t));
-  assert(image_asset != NULL);
-  image_asset->base = *asset;
+  SDL_Rect *bounding_box = sdl_make_bounding_box(body);
+  image_asset_t *image_asset =
+      (image_asset_t *)asset_init(ASSET_IMAGE, *bounding_box);
   image_asset->texture = texture;
   image_asset->body = body;
   return (asset_t *)image_asset;
@@ -85,10 +87,8 @@ asset_t *asset_make_image_with_body(const char *filepath, body_t *body) {
 asset_t *asset_make_text(const char *filepath, SDL_Rect bounding_box,
                          const char *text, rgb_color_t color) {
   TTF_Font *font = asset_cache_obj_get_or_create(ASSET_FONT, filepath);
-  asset_t *asset = asset_init(ASSET_FONT, bounding_box);
-  text_asset_t *text_asset = malloc(sizeof(text_asset_t));
-  assert(text_asset != NULL);
-  text_asset->base = *asset;
+  text_asset_t *text_asset =
+      (text_asset_t *)asset_init(ASSET_FONT, bounding_box);
   text_asset->color = color;
   text_asset->text = text;
   text_asset->font = font;
@@ -97,10 +97,8 @@ asset_t *asset_make_text(const char *filepath, SDL_Rect bounding_box,
 
 asset_t *asset_make_button(SDL_Rect bounding_box, asset_t *image_asset,
                            asset_t *text_asset, button_handler_t handler) {
-  asset_t *asset = asset_init(ASSET_BUTTON, bounding_box);
-  button_asset_t *button_asset = malloc(sizeof(button_asset_t));
-  assert(button_asset != NULL);
-  button_asset->base = *asset;
+  button_asset_t *button_asset =
+      (button_asset_t *)asset_init(ASSET_BUTTON, bounding_box);
   button_asset->handler = handler;
   button_asset->image_asset = (image_asset_t *)image_asset;
   button_asset->text_asset = (text_asset_t *)text_asset;
@@ -191,6 +189,9 @@ void asset_change_texture(asset_t *asset, const char *filepath) {
   image_asset->texture = asset_cache_obj_get_or_create(ASSET_IMAGE, filepath);
 }
 
-void asset_destroy(asset_t *asset) {
-  free(asset);
+void asset_change_texture_id(asset_t *asset, asset_id_t id) {
+  image_asset_t *image_asset = (image_asset_t *)asset;
+  image_asset->texture = asset_cache_obj_get(id);
 }
+
+void asset_destroy(asset_t *asset) { pool_release(asset_pool(), asset); }
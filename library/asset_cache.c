@@ -6,8 +6,13 @@
 #include "asset_cache.h"
 #include "list.h"
 #include "sdl_wrapper.h"
+#include "str_table.h"
 
+// Loaded objects, indexed by asset ID.
+// An object's ID is the ID of its interned filepath in ASSET_PATHS.
 static list_t *ASSET_CACHE;
+static str_table_t *ASSET_PATHS;
+static list_t *BUTTONS;
 
 const size_t FONT_SIZE = 18;
 const size_t INITIAL_CAPACITY = 5;
@@ -21,15 +26,16 @@ typedef struct {
 static void asset_cache_free_entry(entry_t *entry) {
   switch (entry->type) {
   case ASSET_IMAGE: {
-    asset_destroy((asset_t *)entry->obj);
+    SDL_DestroyTexture(entry->obj);
     break;
   }
   case ASSET_FONT: {
-    asset_destroy((asset_t *)entry->obj);
+    TTF_CloseFont(entry->obj);
     break;
   }
   case ASSET_BUTTON: {
     asset_destroy((asset_t *)entry->obj);
+    break;
   }
   default: {
     break;
@@ -41,22 +47,30 @@ static void asset_cache_free_entry(entry_t *entry) {
 void asset_cache_init() {
   ASSET_CACHE =
       list_init(INITIAL_CAPACITY, (free_func_t)asset_cache_free_entry);
+  ASSET_PATHS = str_table_init(INITIAL_CAPACITY);
+  BUTTONS = list_init(INITIAL_CAPACITY, (free_func_t)asset_cache_free_entry);
 }
 
-void asset_cache_destroy() { list_free(ASSET_CACHE); }
+void asset_cache_destroy() {
+  list_free(ASSET_CACHE);
+  str_table_free(ASSET_PATHS);
+  list_free(BUTTONS);
+}
 
-void *asset_cache_obj_get_or_create(asset_type_t ty, const char *filepath) {
-  if (filepath == NULL) {
-    return NULL;
-  }
-  entry_t *entry = (entry_t *)obj_exists(filepath);
-  if (entry != NULL) {
+asset_id_t asset_cache_get_id(asset_type_t ty, const char *filepath) {
+  assert(filepath != NULL);
+  size_t id;
+  if (str_table_find(ASSET_PATHS, filepath, &id)) {
+    entry_t *entry = list_get(ASSET_CACHE, id);
     assert(entry->type == ty);
-    return entry->obj;
+    return id;
   }
+  id = str_table_intern(ASSET_PATHS, filepath);
+  assert(id == list_size(ASSET_CACHE));
+
   entry_t *new_entry = malloc(sizeof(entry_t));
   assert(new_entry != NULL);
-  new_entry->filepath = filepath;
+  new_entry->filepath = str_table_get(ASSET_PATHS, id);
   new_entry->type = ty;
 
   switch (ty) {
@@ -69,40 +83,50 @@ void *asset_cache_obj_get_or_create(asset_type_t ty, const char *filepath) {
     break;
   }
   default: {
+    new_entry->obj = NULL;
     break;
   }
   }
   list_add(ASSET_CACHE, new_entry);
-  return new_entry->obj;
+  return id;
+}
+
+void *asset_cache_obj_get(asset_id_t id) {
+  entry_t *entry = list_get(ASSET_CACHE, id);
+  return entry->obj;
+}
+
+void *asset_cache_obj_get_or_create(asset_type_t ty, const char *filepath) {
+  if (filepath == NULL) {
+    return NULL;
+  }
+  return asset_cache_obj_get(asset_cache_get_id(ty, filepath));
 }
 
 void *obj_exists(const char *filepath) {
   if (filepath == NULL) {
     return NULL;
   }
-  for (int i = 0; i < list_size(ASSET_CACHE); i++) {
-    entry_t *entry = list_get(ASSET_CACHE, i);
-    if (strcmp(entry->filepath, filepath) == 0) {
-      return entry;
-    }
+  size_t id;
+  if (!str_table_find(ASSET_PATHS, filepath, &id)) {
+    return NULL;
   }
-  return NULL;
+  return list_get(ASSET_CACHE, id);
 }
 
 void asset_cache_register_button(asset_t *button) {
+  assert(asset_get_type(button) == ASSET_BUTTON);
   entry_t *new_button = malloc(sizeof(entry_t));
   assert(new_button);
   new_button->type = ASSET_BUTTON;
   new_button->filepath = NULL;
   new_button->obj = button;
-  list_add(ASSET_CACHE, new_button);
+  list_add(BUTTONS, new_button);
 }
 
 void asset_cache_handle_buttons(state_t *state, double x, double y) {
-  for (size_t i = 0; i < list_size(ASSET_CACHE); i++) {
-    entry_t *entry = list_get(ASSET_CACHE, i);
-    if (entry->type == ASSET_BUTTON) {
-      asset_on_button_click(entry->obj, state, x, y);
-    }
+  for (size_t i = 0; i < list_size(BUTTONS); i++) {
+    entry_t *entry = list_get(BUTTONS, i);
+    asset_on_button_click(entry->obj, state, x, y);
   }
 }
@@ -1,41 +1,674 @@
 #include <assert.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "body.h"
 
-#include <assert.h>
-#include <stdio.h>
-#include <stdlib.h>
+const double INITIAL_ROTATION = 0;
+const size_t BODY_POOL_CHUNK = 64;
+const body_handle_t BODY_HANDLE_NONE = 0;
+const uint32_t BODY_DEFAULT_CATEGORY = 1;
+const uint32_t BODY_DEFAULT_MASK = UINT32_MAX;
+// Store arrays start on cache line boundaries, which also suits SIMD loads
+const size_t BODY_STORE_ALIGNMENT = 64;
+const size_t MIN_BODY_STORE_CAPACITY = 16;
 
-#include "body.h"
+// Bits of a body's entry in its store's flags
+enum {
+  BODY_REMOVED = 1 << 0,
+  BODY_FAST = 1 << 1,
+  BODY_SENSOR = 1 << 2,
+  // The body's polygon has been handed out by body_get_polygon(), so it may
+  // have been moved behind the store's back
+  BODY_LENT = 1 << 3,
+  BODY_SLEEPING = 1 << 4,
+  BODY_STATIC = 1 << 5,
+  BODY_KINEMATIC = 1 << 6,
+  // The body is asleep or static and has been changed since the scene last
+  // looked, or its type has changed; see body_store_take_touched()
+  BODY_TOUCHED = 1 << 7,
+};
 
-const double INITIAL_ROTATION = 0;
+/**
+ * The state of a set of bodies that changes every tick, kept in parallel
+ * arrays so that integration is a linear pass over contiguous memory.
+ * Entry i belongs to bodies[i]. Removing a body moves the last entry into its
+ * place.
+ */
+struct body_store {
+  size_t size;
+  size_t capacity;
+  vector_t *positions;
+  vector_t *velocities;
+  vector_t *forces;
+  vector_t *impulses;
+  // How far the last tick moved each body
+  vector_t *last_moves;
+  double *inverse_masses;
+  // The collision categories of each body, which also pick the force fields
+  // that act on it
+  uint32_t *categories;
+  // How many ticks in a row each body has been slower than the sleep speed
+  uint32_t *quiet_ticks;
+  // Scratch space for multi-stage integrators, only meaningful during a
+  // tick, so not kept in order when bodies leave
+  vector_t *start_positions;
+  vector_t *start_velocities;
+  vector_t *position_sums;
+  vector_t *velocity_sums;
+  uint8_t *flags;
+  body_t **bodies;
+  // How many bodies have BODY_LENT, BODY_REMOVED and BODY_TOUCHED set
+  size_t num_lent;
+  size_t num_removed;
+  size_t num_touched;
+};
 
+// The cold state of a body, and where its hot state lives
 struct body {
   polygon_t *poly;
-
   double mass;
-  vector_t force;
-  vector_t impulse;
-  bool removed;
+  uint32_t mask;
+  body_handle_t handle;
   void *info;
   free_func_t info_freer;
+  body_store_t *store;
+  size_t index;
 };
 
-body_t *body_init_with_info(list_t *shape, double mass, rgb_color_t color,
-                            void *info, free_func_t info_freer) {
-  assert(shape != NULL);
-  body_t *body = malloc(sizeof(body_t));
-  assert(body != NULL);
-  body->poly = polygon_init(shape, VEC_ZERO, INITIAL_ROTATION, color.r, color.g,
-                            color.b);
+static pool_t *BODY_POOL = NULL;
+// Holds the bodies that aren't in a scene's store
+static body_store_t *LOOSE_BODIES = NULL;
+
+// Where this thread's forces go instead of the bodies, if anywhere
+static _Thread_local body_force_sink_t FORCE_SINK = NULL;
+static _Thread_local void *FORCE_SINK_AUX = NULL;
+
+static pool_t *body_pool() {
+  if (BODY_POOL == NULL) {
+    BODY_POOL = pool_init(sizeof(body_t), BODY_POOL_CHUNK);
+  }
+  return BODY_POOL;
+}
+
+static body_store_t *loose_bodies() {
+  if (LOOSE_BODIES == NULL) {
+    LOOSE_BODIES = body_store_init();
+  }
+  return LOOSE_BODIES;
+}
+
+pool_stats_t body_pool_stats() { return pool_get_stats(body_pool()); }
+
+static bool same_point(vector_t v1, vector_t v2) {
+  return v1.x == v2.x && v1.y == v2.y;
+}
+
+static void *store_array_alloc(size_t size) {
+  size_t bytes = (size + BODY_STORE_ALIGNMENT - 1) / BODY_STORE_ALIGNMENT *
+                 BODY_STORE_ALIGNMENT;
+  void *array = aligned_alloc(BODY_STORE_ALIGNMENT, bytes);
+  assert(array != NULL);
+  return array;
+}
+
+/**
+ * Moves an array to a new allocation with room for capacity elements.
+ */
+static void *store_array_grow(void *array, size_t elem_size, size_t size,
+                              size_t capacity) {
+  void *grown = store_array_alloc(elem_size * capacity);
+  if (size > 0) {
+    memcpy(grown, array, elem_size * size);
+  }
+  free(array);
+  return grown;
+}
+
+body_store_t *body_store_init(void) {
+  body_store_t *store = malloc(sizeof(body_store_t));
+  assert(store != NULL);
+  *store = (body_store_t){.size = 0, .capacity = 0};
+  return store;
+}
+
+void body_store_free(body_store_t *store) {
+  assert(store->size == 0);
+  free(store->positions);
+  free(store->velocities);
+  free(store->forces);
+  free(store->impulses);
+  free(store->last_moves);
+  free(store->inverse_masses);
+  free(store->categories);
+  free(store->quiet_ticks);
+  free(store->start_positions);
+  free(store->start_velocities);
+  free(store->position_sums);
+  free(store->velocity_sums);
+  free(store->flags);
+  free(store->bodies);
+  free(store);
+}
+
+size_t body_store_size(body_store_t *store) { return store->size; }
+
+body_t *body_store_get(body_store_t *store, size_t index) {
+  assert(index < store->size);
+  return store->bodies[index];
+}
+
+static void body_store_reserve(body_store_t *store) {
+  if (store->size < store->capacity) {
+    return;
+  }
+  size_t capacity = store->capacity > 0 ? store->capacity * 2
+                                        : MIN_BODY_STORE_CAPACITY;
+  size_t size = store->size;
+  store->positions =
+      store_array_grow(store->positions, sizeof(vector_t), size, capacity);
+  store->velocities =
+      store_array_grow(store->velocities, sizeof(vector_t), size, capacity);
+  store->forces =
+      store_array_grow(store->forces, sizeof(vector_t), size, capacity);
+  store->impulses =
+      store_array_grow(store->impulses, sizeof(vector_t), size, capacity);
+  store->last_moves =
+      store_array_grow(store->last_moves, sizeof(vector_t), size, capacity);
+  store->inverse_masses =
+      store_array_grow(store->inverse_masses, sizeof(double), size, capacity);
+  store->categories =
+      store_array_grow(store->categories, sizeof(uint32_t), size, capacity);
+  store->quiet_ticks =
+      store_array_grow(store->quiet_ticks, sizeof(uint32_t), size, capacity);
+  store->start_positions = store_array_grow(store->start_positions,
+                                            sizeof(vector_t), 0, capacity);
+  store->start_velocities = store_array_grow(store->start_velocities,
+                                             sizeof(vector_t), 0, capacity);
+  store->position_sums =
+      store_array_grow(store->position_sums, sizeof(vector_t), 0, capacity);
+  store->velocity_sums =
+      store_array_grow(store->velocity_sums, sizeof(vector_t), 0, capacity);
+  store->flags =
+      store_array_grow(store->flags, sizeof(uint8_t), size, capacity);
+  store->bodies =
+      store_array_grow(store->bodies, sizeof(body_t *), size, capacity);
+  store->capacity = capacity;
+}
+
+/**
+ * Adds (sign 1) or takes away (sign -1) a set of flags from a store's counts.
+ */
+static void store_count_flags(body_store_t *store, uint8_t flags, int sign) {
+  store->num_lent += (flags & BODY_LENT) ? sign : 0;
+  store->num_removed += (flags & BODY_REMOVED) ? sign : 0;
+  store->num_touched += (flags & BODY_TOUCHED) ? sign : 0;
+}
+
+static void store_set_flags(body_store_t *store, size_t i, uint8_t flags) {
+  store_count_flags(store, store->flags[i], -1);
+  store->flags[i] = flags;
+  store_count_flags(store, flags, 1);
+}
+
+/**
+ * Notes that something moved or pushed a body: it is no longer quiet, wakes
+ * up if it was asleep, and the scene is told if it was idle.
+ */
+static void store_disturb(body_store_t *store, size_t i) {
+  uint8_t flags = store->flags[i];
+  store->quiet_ticks[i] = 0;
+  if (flags & (BODY_SLEEPING | BODY_STATIC)) {
+    store_set_flags(store, i, (flags & ~BODY_SLEEPING) | BODY_TOUCHED);
+  }
+}
+
+/**
+ * Takes a body's entry out of its store, moving the last entry into its place.
+ */
+static void body_store_release(body_t *body) {
+  body_store_t *store = body->store;
+  size_t i = body->index;
+  size_t last = --store->size;
+  store_count_flags(store, store->flags[i], -1);
+  if (i != last) {
+    store->positions[i] = store->positions[last];
+    store->velocities[i] = store->velocities[last];
+    store->forces[i] = store->forces[last];
+    store->impulses[i] = store->impulses[last];
+    store->last_moves[i] = store->last_moves[last];
+    store->inverse_masses[i] = store->inverse_masses[last];
+    store->categories[i] = store->categories[last];
+    store->quiet_ticks[i] = store->quiet_ticks[last];
+    store->flags[i] = store->flags[last];
+    store->bodies[i] = store->bodies[last];
+    store->bodies[i]->index = i;
+  }
+  body->store = NULL;
+}
+
+/**
+ * Brings a lent body's position back from its polygon, in case the polygon
+ * was moved directly.
+ */
+static void body_store_settle_entry(body_store_t *store, size_t i) {
+  if (!(store->flags[i] & BODY_LENT)) {
+    return;
+  }
+  store_set_flags(store, i, store->flags[i] & ~BODY_LENT);
+  vector_t center = polygon_get_center(store->bodies[i]->poly);
+  if (!same_point(center, store->positions[i])) {
+    store->positions[i] = center;
+    store->last_moves[i] = VEC_ZERO;
+    store_disturb(store, i);
+  }
+}
+
+void body_store_settle(body_store_t *store) {
+  for (size_t i = 0; i < store->size; i++) {
+    body_store_settle_entry(store, i);
+    polygon_t *poly = store->bodies[i]->poly;
+    if (!same_point(polygon_get_center(poly), store->positions[i])) {
+      polygon_set_center(poly, store->positions[i]);
+    }
+  }
+}
+
+void body_store_refresh(body_store_t *store) {
+  body_store_settle(store);
+  for (size_t i = 0; i < store->size; i++) {
+    polygon_refresh(store->bodies[i]->poly);
+  }
+}
+
+bool body_store_has_removed(body_store_t *store) {
+  return store->num_removed > 0;
+}
+
+/**
+ * Appends an entry with no flags set for a body to a store, and returns its
+ * index. The caller fills in the rest.
+ */
+static size_t body_store_push(body_store_t *store, body_t *body) {
+  body_store_reserve(store);
+  size_t i = store->size++;
+  store->flags[i] = 0;
+  store->bodies[i] = body;
+  return i;
+}
+
+void body_store_add(body_store_t *store, body_t *body) {
+  body_store_t *old = body->store;
+  size_t i = body->index;
+  if (old == store) {
+    return;
+  }
+  body_store_settle_entry(old, i);
+  size_t j = body_store_push(store, body);
+  store->positions[j] = old->positions[i];
+  store->velocities[j] = old->velocities[i];
+  store->forces[j] = old->forces[i];
+  store->impulses[j] = old->impulses[i];
+  store->last_moves[j] = old->last_moves[i];
+  store->inverse_masses[j] = old->inverse_masses[i];
+  store->categories[j] = old->categories[i];
+  store->quiet_ticks[j] = old->quiet_ticks[i];
+  store_set_flags(store, j, old->flags[i]);
+  body_store_release(body);
+  body->store = store;
+  body->index = j;
+}
+
+void body_store_update_quiet(body_store_t *store, double max_speed) {
+  const vector_t *restrict velocities = store->velocities;
+  uint32_t *restrict quiet_ticks = store->quiet_ticks;
+  double max_speed_squared = max_speed * max_speed;
+  for (size_t i = 0; i < store->size; i++) {
+    double speed_squared = velocities[i].x * velocities[i].x +
+                           velocities[i].y * velocities[i].y;
+    uint32_t quiet = quiet_ticks[i] + (quiet_ticks[i] < UINT32_MAX);
+    quiet_ticks[i] = speed_squared <= max_speed_squared ? quiet : 0;
+  }
+}
+
+size_t body_store_take_touched(body_store_t *store, list_t *touched) {
+  size_t found = 0;
+  for (size_t i = 0; i < store->size && store->num_touched > 0; i++) {
+    if (store->flags[i] & BODY_TOUCHED) {
+      store_set_flags(store, i, store->flags[i] & ~BODY_TOUCHED);
+      list_add(touched, store->bodies[i]);
+      found++;
+    }
+  }
+  return found;
+}
+
+/**
+ * Brings the entries in a range of a store up to date with their polygons.
+ */
+static void body_store_settle_range(body_store_t *store, size_t start,
+                                    size_t end) {
+  if (store->num_lent > 0) {
+    for (size_t i = start; i < end; i++) {
+      body_store_settle_entry(store, i);
+    }
+  }
+}
+
+size_t integrator_num_stages(integrator_t integrator) {
+  switch (integrator) {
+  case INTEGRATOR_VELOCITY_VERLET:
+    return 2;
+  case INTEGRATOR_RK4:
+    return 4;
+  default:
+    return 1;
+  }
+}
+
+static void integrate_trapezoidal(body_store_t *store, size_t start,
+                                  size_t end, double dt) {
+  vector_t *restrict positions = store->positions;
+  vector_t *restrict velocities = store->velocities;
+  const vector_t *restrict forces = store->forces;
+  const vector_t *restrict impulses = store->impulses;
+  vector_t *restrict last_moves = store->last_moves;
+  const double *restrict inverse_masses = store->inverse_masses;
+  for (size_t i = start; i < end; i++) {
+    // Acceleration = Force / Mass, and the body moves at the average of its
+    // velocities before and after the tick
+    double inverse_mass = inverse_masses[i];
+    vector_t velocity = velocities[i];
+    vector_t new_velocity = {
+        velocity.x + (inverse_mass * impulses[i].x +
+                      dt * (inverse_mass * forces[i].x)),
+        velocity.y + (inverse_mass * impulses[i].y +
+                      dt * (inverse_mass * forces[i].y))};
+    vector_t move = {dt / 2 * (new_velocity.x + velocity.x),
+                     dt / 2 * (new_velocity.y + velocity.y)};
+    positions[i].x += move.x;
+    positions[i].y += move.y;
+    velocities[i] = new_velocity;
+    last_moves[i] = move;
+  }
+}
+
+static void integrate_semi_implicit_euler(body_store_t *store, size_t start,
+                                          size_t end, double dt) {
+  vector_t *restrict positions = store->positions;
+  vector_t *restrict velocities = store->velocities;
+  const vector_t *restrict forces = store->forces;
+  const vector_t *restrict impulses = store->impulses;
+  vector_t *restrict last_moves = store->last_moves;
+  const double *restrict inverse_masses = store->inverse_masses;
+  for (size_t i = start; i < end; i++) {
+    double inverse_mass = inverse_masses[i];
+    vector_t velocity = {
+        velocities[i].x + inverse_mass * (impulses[i].x + dt * forces[i].x),
+        velocities[i].y + inverse_mass * (impulses[i].y + dt * forces[i].y)};
+    vector_t move = {dt * velocity.x, dt * velocity.y};
+    positions[i].x += move.x;
+    positions[i].y += move.y;
+    velocities[i] = velocity;
+    last_moves[i] = move;
+  }
+}
+
+/**
+ * The first stage of a multi-stage integrator: applies the impulses and
+ * remembers where each body started.
+ */
+static void integrate_begin(body_store_t *store, size_t start, size_t end) {
+  vector_t *restrict velocities = store->velocities;
+  const vector_t *restrict impulses = store->impulses;
+  const double *restrict inverse_masses = store->inverse_masses;
+  for (size_t i = start; i < end; i++) {
+    velocities[i].x += inverse_masses[i] * impulses[i].x;
+    velocities[i].y += inverse_masses[i] * impulses[i].y;
+  }
+  memcpy(&store->start_positions[start], &store->positions[start],
+         sizeof(vector_t) * (end - start));
+  memcpy(&store->start_velocities[start], &store->velocities[start],
+         sizeof(vector_t) * (end - start));
+}
+
+/**
+ * Kicks the velocities by half a tick of acceleration, then, on the first
+ * stage only, moves the bodies at their new velocities.
+ */
+static void integrate_verlet(body_store_t *store, size_t stage, size_t start,
+                             size_t end, double dt) {
+  vector_t *restrict positions = store->positions;
+  vector_t *restrict velocities = store->velocities;
+  const vector_t *restrict forces = store->forces;
+  const double *restrict inverse_masses = store->inverse_masses;
+  double half_dt = dt / 2;
+  for (size_t i = start; i < end; i++) {
+    velocities[i].x += half_dt * inverse_masses[i] * forces[i].x;
+    velocities[i].y += half_dt * inverse_masses[i] * forces[i].y;
+  }
+  if (stage > 0) {
+    return;
+  }
+  for (size_t i = start; i < end; i++) {
+    positions[i].x += dt * velocities[i].x;
+    positions[i].y += dt * velocities[i].y;
+  }
+}
+
+// The weight of each RK4 stage's derivative in the final sum, and how far
+// into the tick the state for the next stage is taken
+const double RK4_WEIGHTS[] = {1, 2, 2, 1};
+const double RK4_OFFSETS[] = {0.5, 0.5, 1};
+
+/**
+ * Adds this stage's derivatives to the running sums, then moves the bodies to
+ * the state the next stage is evaluated at, or to the end of the tick.
+ */
+static void integrate_rk4(body_store_t *store, size_t stage, size_t start,
+                          size_t end, double dt) {
+  vector_t *restrict positions = store->positions;
+  vector_t *restrict velocities = store->velocities;
+  const vector_t *restrict forces = store->forces;
+  const double *restrict inverse_masses = store->inverse_masses;
+  const vector_t *restrict start_positions = store->start_positions;
+  const vector_t *restrict start_velocities = store->start_velocities;
+  vector_t *restrict position_sums = store->position_sums;
+  vector_t *restrict velocity_sums = store->velocity_sums;
+  double weight = RK4_WEIGHTS[stage];
+  bool last = stage == 3;
+  double step = last ? dt / 6 : RK4_OFFSETS[stage] * dt;
+  for (size_t i = start; i < end; i++) {
+    // The derivative of the position is the velocity, and of the velocity
+    // the acceleration
+    vector_t acceleration = {inverse_masses[i] * forces[i].x,
+                             inverse_masses[i] * forces[i].y};
+    vector_t position_sum = {weight * velocities[i].x,
+                             weight * velocities[i].y};
+    vector_t velocity_sum = {weight * acceleration.x,
+                             weight * acceleration.y};
+    if (stage > 0) {
+      position_sum.x += position_sums[i].x;
+      position_sum.y += position_sums[i].y;
+      velocity_sum.x += velocity_sums[i].x;
+      velocity_sum.y += velocity_sums[i].y;
+    }
+    position_sums[i] = position_sum;
+    velocity_sums[i] = velocity_sum;
+    // Until the last stage, the next state comes from this stage's
+    // derivative alone
+    vector_t dx = last ? position_sum : (vector_t){velocities[i].x,
+                                                   velocities[i].y};
+    vector_t dv = last ? velocity_sum : acceleration;
+    positions[i].x = start_positions[i].x + step * dx.x;
+    positions[i].y = start_positions[i].y + step * dx.y;
+    velocities[i].x = start_velocities[i].x + step * dv.x;
+    velocities[i].y = start_velocities[i].y + step * dv.y;
+  }
+}
+
+void body_store_integrate(body_store_t *store, integrator_t integrator,
+                          size_t stage, size_t start, size_t end, double dt) {
+  assert(start <= end && end <= store->size);
+  assert(stage < integrator_num_stages(integrator));
+  body_store_settle_range(store, start, end);
+  switch (integrator) {
+  case INTEGRATOR_TRAPEZOIDAL:
+    integrate_trapezoidal(store, start, end, dt);
+    break;
+  case INTEGRATOR_SEMI_IMPLICIT_EULER:
+    integrate_semi_implicit_euler(store, start, end, dt);
+    break;
+  case INTEGRATOR_VELOCITY_VERLET:
+  case INTEGRATOR_RK4:
+    if (stage == 0) {
+      integrate_begin(store, start, end);
+    }
+    if (integrator == INTEGRATOR_VELOCITY_VERLET) {
+      integrate_verlet(store, stage, start, end, dt);
+    } else {
+      integrate_rk4(store, stage, start, end, dt);
+    }
+    if (stage + 1 == integrator_num_stages(integrator)) {
+      for (size_t i = start; i < end; i++) {
+        store->last_moves[i] =
+            vec_subtract(store->positions[i], store->start_positions[i]);
+      }
+    }
+    break;
+  }
+  memset(&store->forces[start], 0, sizeof(vector_t) * (end - start));
+  memset(&store->impulses[start], 0, sizeof(vector_t) * (end - start));
+}
+
+void body_store_tick(body_store_t *store, size_t start, size_t end,
+                     double dt) {
+  body_store_integrate(store, INTEGRATOR_TRAPEZOIDAL, 0, start, end, dt);
+}
+
+/**
+ * Returns whether a field acts on the body at an index of a store. Written
+ * without short-circuiting, so that the loops calling it vectorize.
+ */
+static inline bool field_affects(const body_store_t *store,
+                                 const force_field_t *field, size_t i) {
+  vector_t position = store->positions[i];
+  aabb_t region = field->region;
+  return ((store->categories[i] & field->category) != 0) &
+         (store->inverse_masses[i] > 0) &
+         ((store->flags[i] & BODY_SLEEPING) == 0) &
+         (position.x >= region.min.x) & (position.x <= region.max.x) &
+         (position.y >= region.min.y) & (position.y <= region.max.y);
+}
+
+void body_store_apply_field(body_store_t *store, const force_field_t *field,
+                            size_t start, size_t end) {
+  assert(start <= end && end <= store->size);
+  body_store_settle_range(store, start, end);
+  const vector_t *restrict positions = store->positions;
+  vector_t *restrict velocities = store->velocities;
+  vector_t *restrict forces = store->forces;
+  const double *restrict inverse_masses = store->inverse_masses;
+  // One loop per kind, each branch-free so that it vectorizes
+  switch (field->kind) {
+  case FORCE_FIELD_GRAVITY:
+    for (size_t i = start; i < end; i++) {
+      // 1 / inverse mass for the bodies the field affects, and 0 for the
+      // rest, without dividing by 0 for the ones that ignore forces
+      bool affects = field_affects(store, field, i);
+      double mass = affects / (inverse_masses[i] + !affects);
+      forces[i].x += mass * field->acceleration.x;
+      forces[i].y += mass * field->acceleration.y;
+    }
+    break;
+  case FORCE_FIELD_DRAG:
+    for (size_t i = start; i < end; i++) {
+      double gamma = field_affects(store, field, i) ? field->gamma : 0;
+      forces[i].x -= gamma * velocities[i].x;
+      forces[i].y -= gamma * velocities[i].y;
+    }
+    break;
+  case FORCE_FIELD_WIND:
+    for (size_t i = start; i < end; i++) {
+      double share = field_affects(store, field, i) ? 1 : 0;
+      forces[i].x += share * field->force.x;
+      forces[i].y += share * field->force.y;
+    }
+    break;
+  case FORCE_FIELD_GROUND:
+    for (size_t i = start; i < end; i++) {
+      // 1 if the body is on the ground and not leaving it, else 0
+      double stop = field_affects(store, field, i) &
+                    (positions[i].y <= field->height) & (velocities[i].y <= 0);
+      double down = forces[i].y < 0 ? forces[i].y : 0;
+      velocities[i].y -= stop * velocities[i].y;
+      forces[i].y -= stop * down;
+    }
+    break;
+  }
+}
+
+/**
+ * Allocates a body around an already created polygon.
+ */
+static body_t *body_init_with_polygon(polygon_t *poly, double mass, void *info,
+                                      free_func_t info_freer) {
+  body_t *body = pool_alloc(body_pool());
+  body->poly = poly;
   body->mass = mass;
-  body->force = VEC_ZERO;
-  body->impulse = VEC_ZERO;
-  body->removed = false;
+  body->mask = BODY_DEFAULT_MASK;
+  body->handle = BODY_HANDLE_NONE;
   body->info = info;
   body->info_freer = info_freer;
+  body_store_t *store = loose_bodies();
+  size_t i = body_store_push(store, body);
+  store->positions[i] = polygon_get_center(poly);
+  store->velocities[i] = VEC_ZERO;
+  store->forces[i] = VEC_ZERO;
+  store->impulses[i] = VEC_ZERO;
+  store->last_moves[i] = VEC_ZERO;
+  store->inverse_masses[i] = 1 / mass;
+  store->categories[i] = BODY_DEFAULT_CATEGORY;
+  store->quiet_ticks[i] = 0;
+  body->store = store;
+  body->index = i;
+  return body;
+}
+
+body_t *body_init_from_shape(shape_t *shape, vector_t position, double mass,
+                             rgb_color_t color, void *info,
+                             free_func_t info_freer) {
+  polygon_t *poly =
+      polygon_init_from_shape(shape, position, VEC_ZERO, INITIAL_ROTATION,
+                              color.r, color.g, color.b);
+  return body_init_with_polygon(poly, mass, info, info_freer);
+}
+
+body_t *body_init_from_vertices(const vector_t *vertices, size_t num_vertices,
+                                double mass, rgb_color_t color, void *info,
+                                free_func_t info_freer) {
+  assert(vertices != NULL);
+  polygon_t *poly =
+      polygon_init_from_vertices(vertices, num_vertices, VEC_ZERO,
+                                 INITIAL_ROTATION, color.r, color.g, color.b);
+  return body_init_with_polygon(poly, mass, info, info_freer);
+}
+
+body_t *body_init_with_info(list_t *shape, double mass, rgb_color_t color,
+                            void *info, free_func_t info_freer) {
+  assert(shape != NULL);
+  size_t size = list_size(shape);
+  vector_t *vertices = malloc(sizeof(vector_t) * size);
+  assert(size == 0 || vertices != NULL);
+  for (size_t i = 0; i < size; i++) {
+    vertices[i] = *(vector_t *)list_get(shape, i);
+  }
+  body_t *body =
+      body_init_from_vertices(vertices, size, mass, color, info, info_freer);
+  free(vertices);
+  list_free(shape);
   return body;
 }
 
@@ -48,48 +681,112 @@ void body_free(body_t *body) {
   if (body->info_freer != NULL) {
     body->info_freer(body->info);
   }
+  body_store_release(body);
   polygon_free(body->poly);
-  free(body);
+  pool_release(body_pool(), body);
+}
+
+/**
+ * Gets a body's entry in its store, up to date with its polygon.
+ */
+static size_t body_entry(body_t *body) {
+  body_store_settle_entry(body->store, body->index);
+  return body->index;
+}
+
+/**
+ * Gets a body's polygon, moved to the body's current position.
+ */
+static polygon_t *body_synced_polygon(body_t *body) {
+  vector_t position = body->store->positions[body_entry(body)];
+  if (!same_point(polygon_get_center(body->poly), position)) {
+    polygon_set_center(body->poly, position);
+  }
+  return body->poly;
 }
 
 list_t *body_get_shape(body_t *body) {
-  list_t *shape = polygon_get_points(body->poly);
-  list_t *points = list_init(list_size(shape), free);
-  for (size_t i = 0; i < list_size(shape); i++) {
+  polygon_t *poly = body_synced_polygon(body);
+  const vector_t *vertices = polygon_get_vertices(poly);
+  size_t size = polygon_num_vertices(poly);
+  list_t *points = list_init(size, free);
+  for (size_t i = 0; i < size; i++) {
     vector_t *point = malloc(sizeof(vector_t));
     assert(point != NULL);
-    *point = *(vector_t *)list_get(shape, i);
+    *point = vertices[i];
     list_add(points, point);
   }
   return points;
 }
 
+const vector_t *body_get_vertices(body_t *body) {
+  return polygon_get_vertices(body_synced_polygon(body));
+}
+
+size_t body_num_vertices(body_t *body) {
+  return polygon_num_vertices(body->poly);
+}
+
 vector_t body_get_centroid(body_t *body) {
-  return polygon_get_center(body->poly);
+  return body->store->positions[body_entry(body)];
+}
+
+aabb_t body_get_aabb(body_t *body) {
+  return polygon_get_aabb(body_synced_polygon(body));
 }
 
 vector_t body_get_velocity(body_t *body) {
-  return *polygon_get_velocity(body->poly);
+  return body->store->velocities[body->index];
 }
 
 rgb_color_t *body_get_color(body_t *body) {
   return polygon_get_color(body->poly);
 }
 
-polygon_t *body_get_polygon(body_t *body) { return body->poly; }
+polygon_t *body_peek_polygon(body_t *body) {
+  return body_synced_polygon(body);
+}
+
+polygon_t *body_get_polygon(body_t *body) {
+  polygon_t *poly = body_synced_polygon(body);
+  body_store_t *store = body->store;
+  if (!(store->flags[body->index] & BODY_LENT)) {
+    store->flags[body->index] |= BODY_LENT;
+    store->num_lent++;
+  }
+  return poly;
+}
 
 void *body_get_info(body_t *body) { return body->info; }
 
+body_handle_t body_get_handle(body_t *body) { return body->handle; }
+
+void body_set_handle(body_t *body, body_handle_t handle) {
+  body->handle = handle;
+}
+
 void body_set_color(body_t *body, rgb_color_t *col) {
   polygon_set_color(body->poly, col);
 }
 
 void body_set_centroid(body_t *body, vector_t x) {
-  polygon_set_center(body->poly, x);
+  size_t i = body_entry(body);
+  if (!same_point(body->store->positions[i], x)) {
+    body->store->positions[i] = x;
+    store_disturb(body->store, i);
+  }
+  body->store->last_moves[i] = VEC_ZERO;
 }
 
 void body_set_velocity(body_t *body, vector_t v) {
-  polygon_set_velocity(body->poly, v);
+  body_store_t *store = body->store;
+  size_t i = body->index;
+  if (store->flags[i] & BODY_STATIC ||
+      same_point(store->velocities[i], v)) {
+    return;
+  }
+  store->velocities[i] = v;
+  store_disturb(store, i);
 }
 
 double body_get_rotation(body_t *body) {
@@ -97,47 +794,200 @@ double body_get_rotation(body_t *body) {
 }
 
 void body_set_rotation(body_t *body, double angle) {
-  polygon_set_rotation(body->poly, angle);
+  polygon_set_rotation(body_synced_polygon(body), angle);
+  store_disturb(body->store, body->index);
 }
 
 void body_tick(body_t *body, double dt) {
-  if (body->poly == NULL) {
-    return;
+  body_store_tick(body->store, body->index, body->index + 1, dt);
+}
+
+void body_substep(body_t *body, integrator_t integrator, size_t num_steps,
+                  double dt, body_force_eval_t eval, void *aux) {
+  assert(num_steps > 0);
+  body_store_t *store = body->store;
+  size_t i = body_entry(body);
+  vector_t start = store->positions[i];
+  // Whatever eval doesn't account for is held constant
+  vector_t start_force = store->forces[i];
+  vector_t start_impulse = store->impulses[i];
+  store->forces[i] = VEC_ZERO;
+  eval(body, aux);
+  vector_t held_force = vec_subtract(start_force, store->forces[i]);
+  store->forces[i] = start_force;
+  store->impulses[i] = start_impulse;
+
+  size_t num_stages = integrator_num_stages(integrator);
+  double step_dt = dt / num_steps;
+  for (size_t step = 0; step < num_steps; step++) {
+    for (size_t stage = 0; stage < num_stages; stage++) {
+      if (step > 0 || stage > 0) {
+        eval(body, aux);
+        store->forces[i] = vec_add(store->forces[i], held_force);
+        store->impulses[i] = VEC_ZERO;
+      }
+      body_store_integrate(store, integrator, stage, i, i + 1, step_dt);
+    }
   }
-  // Acceleration = Force / Mass
-  vector_t acc = vec_multiply(1.0 / body->mass, body->force);
-  vector_t velocity_change = vec_multiply(dt, acc);
-  vector_t poly_velocity = *polygon_get_velocity(body->poly);
-  vector_t momentum_change = vec_multiply(1.0 / body->mass, body->impulse);
-  vector_t net_move = vec_add(momentum_change, velocity_change);
-  polygon_set_velocity(body->poly, vec_add(poly_velocity, net_move));
-  vector_t new_velocity = *polygon_get_velocity(body->poly);
-  vector_t average_velocity =
-      vec_multiply(dt / 2, vec_add(new_velocity, poly_velocity));
-  polygon_translate(body->poly, average_velocity);
-  body->force = VEC_ZERO;
-  body->impulse = VEC_ZERO;
+  store->last_moves[i] = vec_subtract(store->positions[i], start);
 }
 
-double body_get_mass(body_t *body) { return body->mass; }
+double body_get_mass(body_t *body) {
+  if (body->store->flags[body->index] & (BODY_STATIC | BODY_KINEMATIC)) {
+    return INFINITY;
+  }
+  return body->mass;
+}
+
+/**
+ * Adds to a body's total force or impulse, waking it if it was asleep.
+ * Static bodies can't be pushed.
+ */
+static void body_push(body_t *body, vector_t *totals, vector_t push) {
+  body_store_t *store = body->store;
+  size_t i = body->index;
+  uint8_t flags = store->flags[i];
+  if (flags & BODY_STATIC) {
+    return;
+  }
+  if (flags & BODY_SLEEPING && !same_point(push, VEC_ZERO)) {
+    store_disturb(store, i);
+  }
+  totals[i] = vec_add(totals[i], push);
+}
 
 void body_add_force(body_t *body, vector_t force) {
-  body->force = vec_add(body->force, force);
+  if (FORCE_SINK != NULL) {
+    FORCE_SINK(body, force, VEC_ZERO, FORCE_SINK_AUX);
+    return;
+  }
+  body_push(body, body->store->forces, force);
 }
 
 void body_add_impulse(body_t *body, vector_t impulse) {
-  body->impulse = vec_add(body->impulse, impulse);
+  if (FORCE_SINK != NULL) {
+    FORCE_SINK(body, VEC_ZERO, impulse, FORCE_SINK_AUX);
+    return;
+  }
+  body_push(body, body->store->impulses, impulse);
+}
+
+void body_set_force_sink(body_force_sink_t sink, void *aux) {
+  FORCE_SINK = sink;
+  FORCE_SINK_AUX = aux;
+}
+
+vector_t body_get_last_move(body_t *body) {
+  return body->store->last_moves[body_entry(body)];
+}
+
+/**
+ * Sets or clears one of a body's flags.
+ */
+static void body_set_flag(body_t *body, uint8_t flag, bool value) {
+  uint8_t flags = body->store->flags[body->index];
+  store_set_flags(body->store, body->index,
+                  value ? flags | flag : flags & ~flag);
+}
+
+static bool body_has_flag(body_t *body, uint8_t flag) {
+  return (body->store->flags[body->index] & flag) != 0;
+}
+
+void body_remove(body_t *body) { body_set_flag(body, BODY_REMOVED, true); }
+
+bool body_is_removed(body_t *body) { return body_has_flag(body, BODY_REMOVED); }
+
+void body_set_fast(body_t *body, bool fast) {
+  body_set_flag(body, BODY_FAST, fast);
+}
+
+bool body_is_fast(body_t *body) { return body_has_flag(body, BODY_FAST); }
+
+void body_set_collision_filter(body_t *body, uint32_t category,
+                               uint32_t mask) {
+  body->store->categories[body->index] = category;
+  body->mask = mask;
+}
+
+uint32_t body_get_category(body_t *body) {
+  return body->store->categories[body->index];
+}
+
+uint32_t body_get_mask(body_t *body) { return body->mask; }
+
+bool body_can_collide(body_t *body1, body_t *body2) {
+  return (body_get_category(body1) & body2->mask) != 0 &&
+         (body_get_category(body2) & body1->mask) != 0;
 }
 
-void body_remove(body_t *body) { body->removed = true; }
+void body_set_sensor(body_t *body, bool sensor) {
+  body_set_flag(body, BODY_SENSOR, sensor);
+}
 
-bool body_is_removed(body_t *body) { return body->removed; }
+bool body_is_sensor(body_t *body) { return body_has_flag(body, BODY_SENSOR); }
 
 void body_reset(body_t *body) {
-  body->force = VEC_ZERO;
-  body->impulse = VEC_ZERO;
+  body->store->forces[body->index] = VEC_ZERO;
+  body->store->impulses[body->index] = VEC_ZERO;
+}
+
+void body_set_type(body_t *body, body_type_t type) {
+  body_store_t *store = body->store;
+  size_t i = body_entry(body);
+  uint8_t flags = store->flags[i] & ~(BODY_STATIC | BODY_KINEMATIC);
+  switch (type) {
+  case BODY_TYPE_STATIC:
+    flags = (flags & ~BODY_SLEEPING) | BODY_STATIC;
+    store->velocities[i] = VEC_ZERO;
+    break;
+  case BODY_TYPE_KINEMATIC:
+    flags |= BODY_KINEMATIC;
+    break;
+  case BODY_TYPE_DYNAMIC:
+    break;
+  }
+  store->inverse_masses[i] = type == BODY_TYPE_DYNAMIC ? 1 / body->mass : 0;
+  store->forces[i] = VEC_ZERO;
+  store->impulses[i] = VEC_ZERO;
+  store->quiet_ticks[i] = 0;
+  store_set_flags(store, i, flags | BODY_TOUCHED);
+}
+
+body_type_t body_get_type(body_t *body) {
+  uint8_t flags = body->store->flags[body->index];
+  if (flags & BODY_STATIC) {
+    return BODY_TYPE_STATIC;
+  }
+  return flags & BODY_KINEMATIC ? BODY_TYPE_KINEMATIC : BODY_TYPE_DYNAMIC;
+}
+
+void body_sleep(body_t *body) {
+  body_store_t *store = body->store;
+  size_t i = body_entry(body);
+  uint8_t flags = store->flags[i];
+  if (flags & (BODY_STATIC | BODY_SLEEPING)) {
+    return;
+  }
+  store->velocities[i] = VEC_ZERO;
+  store->forces[i] = VEC_ZERO;
+  store->impulses[i] = VEC_ZERO;
+  store->last_moves[i] = VEC_ZERO;
+  store_set_flags(store, i, flags | BODY_SLEEPING | BODY_TOUCHED);
 }
 
+void body_wake(body_t *body) { store_disturb(body->store, body->index); }
+
+bool body_is_sleeping(body_t *body) {
+  return body_has_flag(body, BODY_SLEEPING);
+}
+
+uint32_t body_get_quiet_ticks(body_t *body) {
+  return body->store->quiet_ticks[body->index];
+}
+
+body_store_t *body_get_store(body_t *body) { return body->store; }
+
 // double body_get_health(body_t *body) {
 //   return body->health;
 // }
@@ -0,0 +1,380 @@
+#include "broadphase.h"
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+const size_t MIN_GRID_BUCKETS = 16;
+// Large primes to spread neighbouring cells over the hash table
+const uint64_t CELL_HASH_X = 73856093;
+const uint64_t CELL_HASH_Y = 19349663;
+
+typedef struct proxy {
+  body_t *body;
+  void *data;
+  aabb_t box;
+  uint32_t category;
+  uint32_t mask;
+} proxy_t;
+
+// A pair of proxies by index, with first < second
+typedef struct index_pair {
+  size_t first;
+  size_t second;
+} index_pair_t;
+
+// One grid cell covered by a proxy's box
+typedef struct grid_entry {
+  int64_t x;
+  int64_t y;
+  size_t proxy;
+} grid_entry_t;
+
+struct broadphase {
+  broadphase_kind_t kind;
+  double cell_size;
+  proxy_t *proxies;
+  size_t num_proxies;
+  size_t proxies_capacity;
+  // Sweep and prune: proxy indices sorted by the left edge of their boxes.
+  // Proxies added since the last update are not in it yet.
+  size_t *order;
+  size_t num_ordered;
+  size_t order_capacity;
+  // Grid: the cells covered by each box, and the same entries grouped by
+  // hash bucket
+  grid_entry_t *entries;
+  size_t entries_capacity;
+  grid_entry_t *bucketed;
+  size_t bucketed_capacity;
+  size_t *bucket_starts;
+  size_t buckets_capacity;
+  // Scratch map from old to new proxy indices in broadphase_remove_if()
+  size_t *new_index;
+  size_t new_index_capacity;
+  index_pair_t *candidates;
+  size_t candidates_capacity;
+  broadphase_pair_t *pairs;
+  size_t pairs_capacity;
+  size_t num_pairs;
+  broadphase_stats_t stats;
+};
+
+/**
+ * Makes room for at least needed elements in a growable array.
+ */
+static void *reserve(void *array, size_t *capacity, size_t needed,
+                     size_t elem_size) {
+  if (needed <= *capacity) {
+    return array;
+  }
+  size_t new_capacity = *capacity == 0 ? 8 : *capacity;
+  while (new_capacity < needed) {
+    new_capacity *= 2;
+  }
+  array = realloc(array, new_capacity * elem_size);
+  assert(array != NULL);
+  *capacity = new_capacity;
+  return array;
+}
+
+broadphase_t *broadphase_init(broadphase_kind_t kind, double cell_size) {
+  assert(kind != BROADPHASE_GRID || cell_size > 0);
+  broadphase_t *broadphase = calloc(1, sizeof(broadphase_t));
+  assert(broadphase != NULL);
+  broadphase->kind = kind;
+  broadphase->cell_size = cell_size;
+  return broadphase;
+}
+
+void broadphase_free(broadphase_t *broadphase) {
+  free(broadphase->proxies);
+  free(broadphase->order);
+  free(broadphase->entries);
+  free(broadphase->bucketed);
+  free(broadphase->bucket_starts);
+  free(broadphase->new_index);
+  free(broadphase->candidates);
+  free(broadphase->pairs);
+  free(broadphase);
+}
+
+broadphase_kind_t broadphase_get_kind(broadphase_t *broadphase) {
+  return broadphase->kind;
+}
+
+void broadphase_add(broadphase_t *broadphase, body_t *body, void *data) {
+  assert(body != NULL);
+  broadphase->proxies =
+      reserve(broadphase->proxies, &broadphase->proxies_capacity,
+              broadphase->num_proxies + 1, sizeof(proxy_t));
+  broadphase->proxies[broadphase->num_proxies++] =
+      (proxy_t){.body = body, .data = data, .box = body_get_aabb(body)};
+}
+
+size_t broadphase_remove_if(broadphase_t *broadphase, list_pred_t pred,
+                            void *aux) {
+  size_t old_size = broadphase->num_proxies;
+  broadphase->new_index =
+      reserve(broadphase->new_index, &broadphase->new_index_capacity, old_size,
+              sizeof(size_t));
+  size_t *new_index = broadphase->new_index;
+  size_t kept = 0;
+  for (size_t i = 0; i < old_size; i++) {
+    proxy_t proxy = broadphase->proxies[i];
+    if (pred(proxy.data, aux)) {
+      new_index[i] = SIZE_MAX;
+    } else {
+      new_index[i] = kept;
+      broadphase->proxies[kept++] = proxy;
+    }
+  }
+  broadphase->num_proxies = kept;
+
+  // Keep the sweep order of the survivors so the next sort stays cheap
+  size_t num_ordered = 0;
+  for (size_t i = 0; i < broadphase->num_ordered; i++) {
+    size_t index = new_index[broadphase->order[i]];
+    if (index != SIZE_MAX) {
+      broadphase->order[num_ordered++] = index;
+    }
+  }
+  broadphase->num_ordered = num_ordered;
+  return old_size - kept;
+}
+
+size_t broadphase_size(broadphase_t *broadphase) {
+  return broadphase->num_proxies;
+}
+
+/**
+ * Returns whether the collision filters of two proxies let them collide.
+ * Checked before the boxes, since it is cheaper and rules out more pairs.
+ */
+static bool can_collide(const proxy_t *proxy1, const proxy_t *proxy2) {
+  return (proxy1->category & proxy2->mask) != 0 &&
+         (proxy2->category & proxy1->mask) != 0;
+}
+
+static void add_candidate(broadphase_t *broadphase, size_t first,
+                          size_t second) {
+  broadphase->candidates =
+      reserve(broadphase->candidates, &broadphase->candidates_capacity,
+              broadphase->num_pairs + 1, sizeof(index_pair_t));
+  broadphase->candidates[broadphase->num_pairs++] =
+      (index_pair_t){first, second};
+}
+
+static int64_t cell_coordinate(double x, double cell_size) {
+  return (int64_t)floor(x / cell_size);
+}
+
+static size_t cell_bucket(int64_t x, int64_t y, size_t num_buckets) {
+  uint64_t hash = ((uint64_t)x * CELL_HASH_X) ^ ((uint64_t)y * CELL_HASH_Y);
+  return hash & (num_buckets - 1);
+}
+
+/**
+ * Finds overlapping pairs by binning every box into the grid cells it covers
+ * and testing boxes that share a cell.
+ */
+static void update_grid(broadphase_t *broadphase) {
+  double cell_size = broadphase->cell_size;
+  size_t num_entries = 0;
+  for (size_t i = 0; i < broadphase->num_proxies; i++) {
+    aabb_t box = broadphase->proxies[i].box;
+    int64_t min_x = cell_coordinate(box.min.x, cell_size);
+    int64_t max_x = cell_coordinate(box.max.x, cell_size);
+    int64_t min_y = cell_coordinate(box.min.y, cell_size);
+    int64_t max_y = cell_coordinate(box.max.y, cell_size);
+    for (int64_t x = min_x; x <= max_x; x++) {
+      for (int64_t y = min_y; y <= max_y; y++) {
+        broadphase->entries =
+            reserve(broadphase->entries, &broadphase->entries_capacity,
+                    num_entries + 1, sizeof(grid_entry_t));
+        broadphase->entries[num_entries++] = (grid_entry_t){x, y, i};
+      }
+    }
+  }
+  broadphase->bucketed =
+      reserve(broadphase->bucketed, &broadphase->bucketed_capacity,
+              num_entries, sizeof(grid_entry_t));
+
+  size_t num_buckets = MIN_GRID_BUCKETS;
+  while (num_buckets < num_entries) {
+    num_buckets *= 2;
+  }
+  broadphase->bucket_starts =
+      reserve(broadphase->bucket_starts, &broadphase->buckets_capacity,
+              num_buckets + 1, sizeof(size_t));
+  size_t *starts = broadphase->bucket_starts;
+
+  // Counting sort by bucket, which keeps each bucket in proxy order
+  for (size_t b = 0; b <= num_buckets; b++) {
+    starts[b] = 0;
+  }
+  for (size_t e = 0; e < num_entries; e++) {
+    grid_entry_t entry = broadphase->entries[e];
+    starts[cell_bucket(entry.x, entry.y, num_buckets) + 1]++;
+  }
+  for (size_t b = 0; b < num_buckets; b++) {
+    starts[b + 1] += starts[b];
+  }
+  for (size_t e = 0; e < num_entries; e++) {
+    grid_entry_t entry = broadphase->entries[e];
+    broadphase->bucketed[starts[cell_bucket(entry.x, entry.y, num_buckets)]++] =
+        entry;
+  }
+  // Each start has moved to the end of its bucket, i.e. the next one's start
+  for (size_t b = num_buckets; b > 0; b--) {
+    starts[b] = starts[b - 1];
+  }
+  starts[0] = 0;
+
+  for (size_t b = 0; b < num_buckets; b++) {
+    for (size_t i = starts[b]; i < starts[b + 1]; i++) {
+      grid_entry_t entry1 = broadphase->bucketed[i];
+      aabb_t box1 = broadphase->proxies[entry1.proxy].box;
+      for (size_t j = i + 1; j < starts[b + 1]; j++) {
+        grid_entry_t entry2 = broadphase->bucketed[j];
+        // Different cells can hash to the same bucket
+        if (entry1.x != entry2.x || entry1.y != entry2.y) {
+          continue;
+        }
+        if (!can_collide(&broadphase->proxies[entry1.proxy],
+                         &broadphase->proxies[entry2.proxy])) {
+          continue;
+        }
+        aabb_t box2 = broadphase->proxies[entry2.proxy].box;
+        broadphase->stats.num_tests++;
+        if (!aabb_overlaps(box1, box2)) {
+          continue;
+        }
+        // Boxes can share several cells; only report the pair from the one
+        // holding the lower-left corner of their overlap
+        double overlap_x = fmax(box1.min.x, box2.min.x);
+        double overlap_y = fmax(box1.min.y, box2.min.y);
+        if (cell_coordinate(overlap_x, cell_size) == entry1.x &&
+            cell_coordinate(overlap_y, cell_size) == entry1.y) {
+          add_candidate(broadphase, entry1.proxy, entry2.proxy);
+        }
+      }
+    }
+  }
+}
+
+/**
+ * Finds overlapping pairs by sorting boxes along x and sweeping across them.
+ * The order from the previous update is the starting point of the sort.
+ */
+static void update_sweep(broadphase_t *broadphase) {
+  broadphase->order =
+      reserve(broadphase->order, &broadphase->order_capacity,
+              broadphase->num_proxies, sizeof(size_t));
+  size_t *order = broadphase->order;
+  for (size_t i = broadphase->num_ordered; i < broadphase->num_proxies; i++) {
+    order[i] = i;
+  }
+  broadphase->num_ordered = broadphase->num_proxies;
+
+  proxy_t *proxies = broadphase->proxies;
+  // Insertion sort: close to linear when little has moved since last time
+  for (size_t i = 1; i < broadphase->num_ordered; i++) {
+    size_t index = order[i];
+    double min_x = proxies[index].box.min.x;
+    size_t j = i;
+    while (j > 0 && proxies[order[j - 1]].box.min.x > min_x) {
+      order[j] = order[j - 1];
+      j--;
+    }
+    order[j] = index;
+  }
+
+  for (size_t i = 0; i < broadphase->num_ordered; i++) {
+    size_t index1 = order[i];
+    aabb_t box1 = proxies[index1].box;
+    for (size_t j = i + 1; j < broadphase->num_ordered; j++) {
+      size_t index2 = order[j];
+      aabb_t box2 = proxies[index2].box;
+      if (box2.min.x > box1.max.x) {
+        break;
+      }
+      if (!can_collide(&proxies[index1], &proxies[index2])) {
+        continue;
+      }
+      broadphase->stats.num_tests++;
+      if (box1.min.y <= box2.max.y && box2.min.y <= box1.max.y) {
+        if (index1 < index2) {
+          add_candidate(broadphase, index1, index2);
+        } else {
+          add_candidate(broadphase, index2, index1);
+        }
+      }
+    }
+  }
+}
+
+static int compare_pairs(const void *p1, const void *p2) {
+  const index_pair_t *pair1 = p1;
+  const index_pair_t *pair2 = p2;
+  if (pair1->first != pair2->first) {
+    return pair1->first < pair2->first ? -1 : 1;
+  }
+  if (pair1->second != pair2->second) {
+    return pair1->second < pair2->second ? -1 : 1;
+  }
+  return 0;
+}
+
+size_t broadphase_update(broadphase_t *broadphase) {
+  clock_t start = clock();
+  for (size_t i = 0; i < broadphase->num_proxies; i++) {
+    proxy_t *proxy = &broadphase->proxies[i];
+    proxy->box = body_get_aabb(proxy->body);
+    proxy->category = body_get_category(proxy->body);
+    proxy->mask = body_get_mask(proxy->body);
+  }
+  broadphase->num_pairs = 0;
+  broadphase->stats.num_tests = 0;
+  if (broadphase->kind == BROADPHASE_GRID) {
+    update_grid(broadphase);
+  } else {
+    update_sweep(broadphase);
+  }
+
+  qsort(broadphase->candidates, broadphase->num_pairs, sizeof(index_pair_t),
+        compare_pairs);
+  broadphase->pairs =
+      reserve(broadphase->pairs, &broadphase->pairs_capacity,
+              broadphase->num_pairs, sizeof(broadphase_pair_t));
+  for (size_t i = 0; i < broadphase->num_pairs; i++) {
+    index_pair_t pair = broadphase->candidates[i];
+    broadphase->pairs[i] =
+        (broadphase_pair_t){broadphase->proxies[pair.first].data,
+                            broadphase->proxies[pair.second].data};
+  }
+
+  broadphase_stats_t *stats = &broadphase->stats;
+  stats->num_proxies = broadphase->num_proxies;
+  stats->num_pairs = broadphase->num_pairs;
+  stats->seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+  stats->num_updates++;
+  stats->total_pairs += stats->num_pairs;
+  stats->total_tests += stats->num_tests;
+  stats->total_seconds += stats->seconds;
+  return broadphase->num_pairs;
+}
+
+size_t broadphase_num_pairs(broadphase_t *broadphase) {
+  return broadphase->num_pairs;
+}
+
+broadphase_pair_t broadphase_get_pair(broadphase_t *broadphase, size_t index) {
+  assert(index < broadphase->num_pairs);
+  return broadphase->pairs[index];
+}
+
+broadphase_stats_t broadphase_get_stats(broadphase_t *broadphase) {
+  return broadphase->stats;
+}
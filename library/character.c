@@ -4,6 +4,7 @@
 #include <stdlib.h>
 
 const char *DEFAULT = "NONE";
+const size_t CHARACTER_POOL_CHUNK = 64;
 
 struct character {
   body_t *body;
@@ -22,11 +23,23 @@ struct character {
   bool health_boost;
 };
 
+static pool_t *CHARACTER_POOL = NULL;
+
+static pool_t *character_pool() {
+    if (CHARACTER_POOL == NULL) {
+        CHARACTER_POOL = pool_init(sizeof(character_t), CHARACTER_POOL_CHUNK);
+    }
+    return CHARACTER_POOL;
+}
+
+pool_stats_t character_pool_stats(){
+    return pool_get_stats(character_pool());
+}
+
 character_t *character_init(body_t *body, char* type, double health, bool fire, 
                             double fire_timer, double translation, char* bullet
                             , bool direction){
-    character_t *character = malloc(sizeof(character_t));
-    assert(character);
+    character_t *character = pool_alloc(character_pool());
     character->body = body;
     character->health = health;
     character->type = type;
@@ -122,7 +135,7 @@ char *character_get_ability(character_t *character){
 }
 
 void character_free(character_t *character){
-    free(character);
+    pool_release(character_pool(), character);
 }
 
 char *character_get_bullet_type(character_t *character) {
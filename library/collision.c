@@ -1,125 +1,1052 @@
 #include "collision.h"
+#include "aabb.h"
 #include "body.h"
 #include <assert.h>
 #include <math.h>
 #include <stdlib.h>
 
-const double PI = 3.14;
-const double TWO = 2;
+// The most vertices the EPA polytope can grow to
+#define EPA_MAX_VERTICES 64
+
+const size_t GJK_MAX_ITERATIONS = 32;
+// GJK stops once an iteration improves the distance by less than this fraction
+const double GJK_TOLERANCE = 1e-9;
+// EPA stops once the polytope is within this fraction of the true boundary
+const double EPA_TOLERANCE = 1e-6;
+// Contact points may sit this far outside the reference face and still count
+const double CONTACT_SLOP = 1e-6;
+// Polygons with more vertices than this go through GJK, whose cost grows with
+// the number of vertices rather than with its square like SAT's
+const size_t SAT_MAX_VERTICES = 32;
+// A core segment this close to a polygon is treated as reaching into it, since
+// the direction between them is mostly rounding error
+const double CORE_TOUCH_DISTANCE = 1e-9;
+const size_t TOI_MAX_ITERATIONS = 32;
+// A swept body stops advancing once it is this close to the other body
+const double TOI_TOLERANCE = 1e-3;
 
 /**
- * Returns a list of vectors representing the edges of a shape.
+ * Determines whether two polygons are certainly apart without running a
+ * kernel: first by their bounding circles, then by their bounding boxes.
+ */
+static bool is_trivially_separated(polygon_t *poly1, polygon_t *poly2) {
+  vector_t offset =
+      vec_subtract(polygon_get_center(poly2), polygon_get_center(poly1));
+  double reach = shape_get_radius(polygon_get_shape(poly1)) +
+                 shape_get_radius(polygon_get_shape(poly2));
+  if (vec_dot(offset, offset) > reach * reach) {
+    return true;
+  }
+  return !aabb_overlaps(polygon_get_aabb(poly1), polygon_get_aabb(poly2));
+}
+
+/**
+ * Computes the world-space core segment of a circle or capsule.
+ * For circles both endpoints are the center.
+ */
+static void get_core_segment(polygon_t *poly, vector_t *start, vector_t *end) {
+  shape_t *shape = polygon_get_shape(poly);
+  vector_t center = polygon_get_center(poly);
+  vector_t half = vec_rotate((vector_t){shape_get_half_length(shape), 0},
+                             polygon_get_rotation(poly));
+  *start = vec_subtract(center, half);
+  *end = vec_add(center, half);
+}
+
+/**
+ * Finds the closest pair of points between the segments p1q1 and p2q2.
  *
- * @param shape the list of vectors representing the vertices of a shape
- * @return a list of vectors representing the edges of the shape
+ * @param closest1 set to the closest point on the first segment
+ * @param closest2 set to the closest point on the second segment
+ * @return the squared distance between the two points
  */
-static list_t *get_edges(list_t *shape) {
-  list_t *edges = list_init(list_size(shape), free);
+static double closest_segment_points(vector_t p1, vector_t q1, vector_t p2,
+                                     vector_t q2, vector_t *closest1,
+                                     vector_t *closest2) {
+  vector_t d1 = vec_subtract(q1, p1);
+  vector_t d2 = vec_subtract(q2, p2);
+  vector_t r = vec_subtract(p1, p2);
+  double a = vec_dot(d1, d1);
+  double e = vec_dot(d2, d2);
+  double f = vec_dot(d2, r);
+  double s = 0;
+  double t = 0;
 
-  for (size_t i = 0; i < list_size(shape); i++) {
-    vector_t *vec = malloc(sizeof(vector_t));
-    assert(vec);
-    *vec =
-        vec_subtract(*(vector_t *)list_get(shape, i % list_size(shape)),
-                     *(vector_t *)list_get(shape, (i + 1) % list_size(shape)));
-    list_add(edges, vec);
+  if (a == 0 && e == 0) {
+    // Both segments are points
+  } else if (a == 0) {
+    t = fmin(fmax(f / e, 0), 1);
+  } else {
+    double c = vec_dot(d1, r);
+    if (e == 0) {
+      s = fmin(fmax(-c / a, 0), 1);
+    } else {
+      double b = vec_dot(d1, d2);
+      double denom = a * e - b * b;
+      if (denom != 0) {
+        s = fmin(fmax((b * f - c * e) / denom, 0), 1);
+      }
+      t = (b * s + f) / e;
+      if (t < 0) {
+        t = 0;
+        s = fmin(fmax(-c / a, 0), 1);
+      } else if (t > 1) {
+        t = 1;
+        s = fmin(fmax((b - c) / a, 0), 1);
+      }
+    }
   }
 
-  return edges;
+  *closest1 = vec_add(p1, vec_multiply(s, d1));
+  *closest2 = vec_add(p2, vec_multiply(t, d2));
+  vector_t gap = vec_subtract(*closest2, *closest1);
+  return vec_dot(gap, gap);
 }
 
 /**
- * Returns a vector containing the maximum and minimum length projections given
- * a unit axis and shape.
+ * Returns the unit vector along offset, or fallback if offset is zero.
+ */
+static vector_t normalize_or(vector_t offset, vector_t fallback) {
+  double length = vec_get_length(offset);
+  if (length == 0) {
+    return fallback;
+  }
+  return vec_multiply(1 / length, offset);
+}
+
+/**
+ * Tests a circle or capsule against another circle or capsule. Both are the
+ * set of points within some radius of a core segment, so they collide exactly
+ * when their core segments come within the sum of the radii.
+ */
+static collision_info_t round_round(polygon_t *poly1, polygon_t *poly2,
+                                    vector_t *separating_axis) {
+  vector_t start1, end1, start2, end2, closest1, closest2;
+  get_core_segment(poly1, &start1, &end1);
+  get_core_segment(poly2, &start2, &end2);
+  double radius1 = shape_get_round_radius(polygon_get_shape(poly1));
+  double radius2 = shape_get_round_radius(polygon_get_shape(poly2));
+  double distance_squared = closest_segment_points(start1, end1, start2, end2,
+                                                   &closest1, &closest2);
+  double distance = sqrt(distance_squared);
+  if (distance > radius1 + radius2) {
+    // For two circles, this is the direction between their centers
+    *separating_axis =
+        vec_multiply(1 / distance, vec_subtract(closest2, closest1));
+    return (collision_info_t){.collided = false, .axis = VEC_ZERO};
+  }
+  vector_t axis;
+  if (distance > 0) {
+    axis = vec_multiply(1 / distance, vec_subtract(closest2, closest1));
+  } else {
+    vector_t centers =
+        vec_subtract(polygon_get_center(poly2), polygon_get_center(poly1));
+    axis = normalize_or(centers, (vector_t){0, 1});
+  }
+  // Halfway between the two surfaces
+  vector_t surface1 = vec_add(closest1, vec_multiply(radius1, axis));
+  vector_t surface2 = vec_subtract(closest2, vec_multiply(radius2, axis));
+  return (collision_info_t){
+      .collided = true,
+      .axis = axis,
+      .depth = radius1 + radius2 - distance,
+      .num_contacts = 1,
+      .contacts = {vec_multiply(0.5, vec_add(surface1, surface2))}};
+}
+
+/**
+ * A convex body as GJK sees it: a core shape, inflated by a radius.
+ * Polygons and ellipses have no radius; circles and capsules are a point or
+ * a segment with one, which keeps their support functions exact.
+ */
+typedef struct convex {
+  polygon_t *poly;
+  shape_kind_t kind;
+  const vector_t *vertices;
+  size_t num_vertices;
+  vector_t center;
+  double angle;
+  vector_t semi_axes;
+  vector_t core_start;
+  vector_t core_end;
+  double radius;
+  // Added to the polygon's vertices, which can't be moved in place
+  vector_t offset;
+} convex_t;
+
+static convex_t make_convex(polygon_t *poly) {
+  shape_t *shape = polygon_get_shape(poly);
+  convex_t convex = {.poly = poly,
+                     .kind = shape_get_kind(shape),
+                     .center = polygon_get_center(poly),
+                     .angle = polygon_get_rotation(poly)};
+  switch (convex.kind) {
+  case SHAPE_CIRCLE:
+  case SHAPE_CAPSULE:
+    get_core_segment(poly, &convex.core_start, &convex.core_end);
+    convex.radius = shape_get_round_radius(shape);
+    break;
+  case SHAPE_ELLIPSE:
+    convex.semi_axes = shape_get_semi_axes(shape);
+    break;
+  default:
+    convex.vertices = polygon_get_vertices(poly);
+    convex.num_vertices = polygon_num_vertices(poly);
+    break;
+  }
+  return convex;
+}
+
+/**
+ * Returns the point of a convex body's core furthest along a direction.
+ */
+static vector_t convex_support(const convex_t *convex, vector_t direction) {
+  switch (convex->kind) {
+  case SHAPE_CIRCLE:
+  case SHAPE_CAPSULE:
+    return vec_dot(vec_subtract(convex->core_end, convex->core_start),
+                   direction) > 0
+               ? convex->core_end
+               : convex->core_start;
+  case SHAPE_ELLIPSE: {
+    // Solve in the ellipse's frame, where the support of a direction d is
+    // (a^2 d.x, b^2 d.y) / |(a d.x, b d.y)|
+    vector_t local = vec_rotate(direction, -convex->angle);
+    vector_t axes = convex->semi_axes;
+    vector_t scaled = {axes.x * local.x, axes.y * local.y};
+    double length = vec_get_length(scaled);
+    if (length == 0) {
+      return convex->center;
+    }
+    vector_t point = {axes.x * scaled.x / length, axes.y * scaled.y / length};
+    return vec_add(convex->center, vec_rotate(point, convex->angle));
+  }
+  default: {
+    size_t best = 0;
+    double best_projection = -INFINITY;
+    for (size_t i = 0; i < convex->num_vertices; i++) {
+      double projection = vec_dot(convex->vertices[i], direction);
+      if (projection > best_projection) {
+        best_projection = projection;
+        best = i;
+      }
+    }
+    return vec_add(convex->vertices[best], convex->offset);
+  }
+  }
+}
+
+/**
+ * Moves a convex body without touching the polygon it was made from.
+ */
+static void convex_translate(convex_t *convex, vector_t offset) {
+  convex->center = vec_add(convex->center, offset);
+  convex->core_start = vec_add(convex->core_start, offset);
+  convex->core_end = vec_add(convex->core_end, offset);
+  convex->offset = vec_add(convex->offset, offset);
+}
+
+/**
+ * A point of the Minkowski difference B - A of two cores, along with the
+ * points of A and B it came from.
+ */
+typedef struct support_point {
+  vector_t a;
+  vector_t b;
+  vector_t w;
+} support_point_t;
+
+static support_point_t support_difference(const convex_t *convex1,
+                                          const convex_t *convex2,
+                                          vector_t direction) {
+  support_point_t point;
+  point.a = convex_support(convex1, vec_negate(direction));
+  point.b = convex_support(convex2, direction);
+  point.w = vec_subtract(point.b, point.a);
+  return point;
+}
+
+// Up to three support points, and the barycentric weights of the point of
+// their hull closest to the origin
+typedef struct simplex {
+  support_point_t points[3];
+  double weights[3];
+  size_t size;
+} simplex_t;
+
+/**
+ * Reduces a two-point simplex to the part closest to the origin.
+ */
+static void simplex_solve2(simplex_t *simplex) {
+  vector_t w1 = simplex->points[0].w;
+  vector_t w2 = simplex->points[1].w;
+  vector_t edge = vec_subtract(w2, w1);
+  double toward2 = -vec_dot(w1, edge);
+  double toward1 = vec_dot(w2, edge);
+  if (toward2 <= 0) {
+    simplex->weights[0] = 1;
+    simplex->size = 1;
+  } else if (toward1 <= 0) {
+    simplex->points[0] = simplex->points[1];
+    simplex->weights[0] = 1;
+    simplex->size = 1;
+  } else {
+    simplex->weights[0] = toward1 / (toward1 + toward2);
+    simplex->weights[1] = toward2 / (toward1 + toward2);
+  }
+}
+
+/**
+ * Reduces a three-point simplex to the part closest to the origin, checking
+ * the Voronoi regions of its vertices, then its edges, then its interior.
+ */
+static void simplex_solve3(simplex_t *simplex) {
+  support_point_t *points = simplex->points;
+  vector_t w1 = points[0].w;
+  vector_t w2 = points[1].w;
+  vector_t w3 = points[2].w;
+
+  vector_t e12 = vec_subtract(w2, w1);
+  double d12_1 = vec_dot(w2, e12);
+  double d12_2 = -vec_dot(w1, e12);
+  vector_t e13 = vec_subtract(w3, w1);
+  double d13_1 = vec_dot(w3, e13);
+  double d13_2 = -vec_dot(w1, e13);
+  vector_t e23 = vec_subtract(w3, w2);
+  double d23_1 = vec_dot(w3, e23);
+  double d23_2 = -vec_dot(w2, e23);
+
+  double area = vec_cross(e12, e13);
+  double d123_1 = area * vec_cross(w2, w3);
+  double d123_2 = area * vec_cross(w3, w1);
+  double d123_3 = area * vec_cross(w1, w2);
+
+  if (d12_2 <= 0 && d13_2 <= 0) {
+    simplex->weights[0] = 1;
+    simplex->size = 1;
+  } else if (d12_1 > 0 && d12_2 > 0 && d123_3 <= 0) {
+    simplex->weights[0] = d12_1 / (d12_1 + d12_2);
+    simplex->weights[1] = d12_2 / (d12_1 + d12_2);
+    simplex->size = 2;
+  } else if (d13_1 > 0 && d13_2 > 0 && d123_2 <= 0) {
+    simplex->weights[0] = d13_1 / (d13_1 + d13_2);
+    simplex->weights[1] = d13_2 / (d13_1 + d13_2);
+    points[1] = points[2];
+    simplex->size = 2;
+  } else if (d12_1 <= 0 && d23_2 <= 0) {
+    points[0] = points[1];
+    simplex->weights[0] = 1;
+    simplex->size = 1;
+  } else if (d13_1 <= 0 && d23_1 <= 0) {
+    points[0] = points[2];
+    simplex->weights[0] = 1;
+    simplex->size = 1;
+  } else if (d23_1 > 0 && d23_2 > 0 && d123_1 <= 0) {
+    points[0] = points[2];
+    simplex->weights[0] = d23_2 / (d23_1 + d23_2);
+    simplex->weights[1] = d23_1 / (d23_1 + d23_2);
+    simplex->size = 2;
+  } else {
+    double total = d123_1 + d123_2 + d123_3;
+    simplex->weights[0] = d123_1 / total;
+    simplex->weights[1] = d123_2 / total;
+    simplex->weights[2] = d123_3 / total;
+  }
+}
+
+/**
+ * Computes the point of the simplex closest to the origin, along with the
+ * points of A and B it corresponds to.
+ */
+static vector_t simplex_closest(const simplex_t *simplex, vector_t *a,
+                                vector_t *b) {
+  vector_t w = VEC_ZERO;
+  *a = VEC_ZERO;
+  *b = VEC_ZERO;
+  for (size_t i = 0; i < simplex->size; i++) {
+    double weight = simplex->weights[i];
+    w = vec_add(w, vec_multiply(weight, simplex->points[i].w));
+    *a = vec_add(*a, vec_multiply(weight, simplex->points[i].a));
+    *b = vec_add(*b, vec_multiply(weight, simplex->points[i].b));
+  }
+  return w;
+}
+
+/**
+ * Runs GJK on the cores of two convex bodies.
+ * On return, the simplex holds the features of B - A closest to the origin.
  *
- * @param shape the list of vectors representing the vertices of a shape
- * @param unit_axis the unit axis to project eeach vertex on
- * @return a vector in the form (max, min) where `max` is the maximum projection
- * length and `min` is the minimum projection length.
+ * @return whether the cores overlap
  */
-static vector_t get_max_min_projections(list_t *shape, vector_t unit_axis) {
-  double min = INFINITY;
-  double max = -INFINITY;
+static bool gjk(const convex_t *convex1, const convex_t *convex2,
+                simplex_t *simplex) {
+  vector_t direction = vec_subtract(convex2->center, convex1->center);
+  if (direction.x == 0 && direction.y == 0) {
+    direction = (vector_t){1, 0};
+  }
+  simplex->points[0] =
+      support_difference(convex1, convex2, vec_negate(direction));
+  simplex->weights[0] = 1;
+  simplex->size = 1;
+  double last_distance_squared = INFINITY;
 
-  for (size_t i = 0; i < list_size(shape); i++) {
-    vector_t vertex = *(vector_t *)list_get(shape, i);
-    double projection = vec_dot(vertex, unit_axis);
-    if (projection < min) {
-      min = projection;
+  for (size_t i = 0; i < GJK_MAX_ITERATIONS; i++) {
+    if (simplex->size == 2) {
+      simplex_solve2(simplex);
+    } else if (simplex->size == 3) {
+      simplex_solve3(simplex);
+    }
+    if (simplex->size == 3) {
+      return true;
     }
-    if (projection > max) {
-      max = projection;
+    vector_t a, b;
+    vector_t closest = simplex_closest(simplex, &a, &b);
+    double distance_squared = vec_dot(closest, closest);
+    if (distance_squared == 0 ||
+        distance_squared >= last_distance_squared) {
+      return distance_squared == 0;
     }
+    last_distance_squared = distance_squared;
+
+    support_point_t point =
+        support_difference(convex1, convex2, vec_negate(closest));
+    // Stop once the new point gets no closer to the origin than we are
+    if (distance_squared - vec_dot(closest, point.w) <=
+        GJK_TOLERANCE * distance_squared) {
+      return false;
+    }
+    simplex->points[simplex->size++] = point;
   }
-  return (vector_t){max, min};
+  return false;
 }
 
 /**
- * Determines whether two convex polygons intersect.
- * The polygons are given as lists of vertices in counterclockwise order.
- * There is an edge between each pair of consecutive vertices,
- * and one between the first vertex and the last vertex.
+ * Runs EPA from a GJK simplex that encloses the origin, finding the edge of
+ * B - A nearest the origin: the direction and distance to separate the cores.
  *
- * @param shape1 the first shape
- * @param shape2 the second shape
- * @return whether the shapes are colliding
+ * @param normal set to the unit normal from A to B
+ * @param a set to the deepest point of A's core
+ * @param b set to the deepest point of B's core
+ * @return the penetration depth of the cores
  */
-static collision_info_t compare_collision(list_t *shape1, list_t *shape2,
-                                          double *min_overlap) {
-  list_t *edges1 = get_edges(shape1);
-  vector_t axis = VEC_ZERO;
-  for (size_t i = 0; i < list_size(edges1); i++) {
-    vector_t *edge = list_get(edges1, i);
-    vector_t unit_axis = vec_rotate(*edge, PI / TWO);
-    unit_axis = vec_multiply(1.0 / vec_get_length(unit_axis), unit_axis);
-    vector_t proj_shape1 = get_max_min_projections(shape1, unit_axis);
-    vector_t proj_shape2 = get_max_min_projections(shape2, unit_axis);
-
-    double overlap =
-        fmin(proj_shape1.x, proj_shape2.x) - fmax(proj_shape1.y, proj_shape2.y);
-    if (overlap < 0) {
-      list_free(edges1);
+static double epa(const convex_t *convex1, const convex_t *convex2,
+                  const simplex_t *simplex, vector_t *normal, vector_t *a,
+                  vector_t *b) {
+  support_point_t polytope[EPA_MAX_VERTICES];
+  size_t size = 3;
+  for (size_t i = 0; i < 3; i++) {
+    polytope[i] = simplex->points[i];
+  }
+  // Wind counterclockwise so edge normals (d.y, -d.x) point outward
+  if (vec_cross(vec_subtract(polytope[1].w, polytope[0].w),
+                vec_subtract(polytope[2].w, polytope[0].w)) < 0) {
+    support_point_t swap = polytope[1];
+    polytope[1] = polytope[2];
+    polytope[2] = swap;
+  }
+
+  size_t closest = 0;
+  double distance = 0;
+  vector_t edge_normal = VEC_ZERO;
+  while (true) {
+    distance = INFINITY;
+    for (size_t i = 0; i < size; i++) {
+      vector_t edge =
+          vec_subtract(polytope[(i + 1) % size].w, polytope[i].w);
+      vector_t n = normalize_or((vector_t){edge.y, -edge.x}, VEC_ZERO);
+      if (n.x == 0 && n.y == 0) {
+        continue;
+      }
+      double edge_distance = vec_dot(n, polytope[i].w);
+      if (edge_distance < distance) {
+        distance = edge_distance;
+        closest = i;
+        edge_normal = n;
+      }
+    }
+    support_point_t point = support_difference(convex1, convex2, edge_normal);
+    double reach = vec_dot(point.w, edge_normal);
+    if (reach - distance <= EPA_TOLERANCE * fmax(1, reach) ||
+        size == EPA_MAX_VERTICES) {
+      break;
+    }
+    for (size_t i = size; i > closest + 1; i--) {
+      polytope[i] = polytope[i - 1];
+    }
+    polytope[closest + 1] = point;
+    size++;
+  }
+
+  // Where the origin projects onto the closest edge
+  support_point_t start = polytope[closest];
+  support_point_t end = polytope[(closest + 1) % size];
+  vector_t edge = vec_subtract(end.w, start.w);
+  double t = fmin(fmax(-vec_dot(start.w, edge) / vec_dot(edge, edge), 0), 1);
+  *a = vec_add(start.a, vec_multiply(t, vec_subtract(end.a, start.a)));
+  *b = vec_add(start.b, vec_multiply(t, vec_subtract(end.b, start.b)));
+  *normal = vec_negate(edge_normal);
+  return distance;
+}
+
+/**
+ * Turns a one- or two-point simplex around the origin into a triangle, so EPA
+ * can start from it.
+ *
+ * @return false if B - A has no area (e.g. two points), so there is no
+ *   triangle to find
+ */
+static bool grow_simplex(const convex_t *convex1, const convex_t *convex2,
+                         simplex_t *simplex) {
+  if (simplex->size == 1) {
+    vector_t directions[] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+    for (size_t i = 0; i < 4 && simplex->size == 1; i++) {
+      support_point_t point =
+          support_difference(convex1, convex2, directions[i]);
+      vector_t offset = vec_subtract(point.w, simplex->points[0].w);
+      if (vec_dot(offset, offset) > 0) {
+        simplex->points[simplex->size++] = point;
+      }
+    }
+    if (simplex->size == 1) {
+      return false;
+    }
+  }
+  vector_t edge = vec_subtract(simplex->points[1].w, simplex->points[0].w);
+  vector_t perpendicular = {-edge.y, edge.x};
+  support_point_t left =
+      support_difference(convex1, convex2, perpendicular);
+  support_point_t right =
+      support_difference(convex1, convex2, vec_negate(perpendicular));
+  double left_reach = vec_dot(vec_subtract(left.w, simplex->points[0].w),
+                              perpendicular);
+  double right_reach = -vec_dot(vec_subtract(right.w, simplex->points[0].w),
+                                perpendicular);
+  if (fmax(left_reach, right_reach) <= 0) {
+    return false;
+  }
+  simplex->points[2] = left_reach > right_reach ? left : right;
+  simplex->size = 3;
+  return true;
+}
+
+/**
+ * Finds up to two contact points between two polygons by clipping the edge
+ * of one that meets a given edge of the other (its "reference") against it.
+ *
+ * @param ref the polygon with the reference edge
+ * @param ref_face the index of the reference edge
+ * @param inc the other polygon
+ * @return the number of contact points found
+ */
+static size_t clip_to_face(polygon_t *ref, size_t ref_face, polygon_t *inc,
+                           vector_t *contacts) {
+  const vector_t *ref_vertices = polygon_get_vertices(ref);
+  const vector_t *inc_vertices = polygon_get_vertices(inc);
+  const vector_t *inc_normals = polygon_get_normals(inc);
+  size_t ref_size = polygon_num_vertices(ref);
+  size_t inc_size = polygon_num_vertices(inc);
+
+  // The incident edge is the other polygon's most antiparallel edge
+  vector_t ref_normal = polygon_get_normals(ref)[ref_face];
+  size_t inc_face = 0;
+  double lowest = INFINITY;
+  for (size_t i = 0; i < inc_size; i++) {
+    double alignment = vec_dot(inc_normals[i], ref_normal);
+    if (alignment < lowest) {
+      lowest = alignment;
+      inc_face = i;
+    }
+  }
+  vector_t points[2] = {inc_vertices[inc_face],
+                        inc_vertices[(inc_face + 1) % inc_size]};
+
+  // Clip the incident edge to the slab beside the reference edge
+  vector_t ref_start = ref_vertices[ref_face];
+  vector_t ref_end = ref_vertices[(ref_face + 1) % ref_size];
+  vector_t tangent = normalize_or(vec_subtract(ref_end, ref_start), VEC_ZERO);
+  double bounds[2] = {vec_dot(ref_start, tangent), vec_dot(ref_end, tangent)};
+  for (size_t side = 0; side < 2; side++) {
+    double sign = side == 0 ? -1 : 1;
+    double offset1 = sign * (vec_dot(points[0], tangent) - bounds[side]);
+    double offset2 = sign * (vec_dot(points[1], tangent) - bounds[side]);
+    if (offset1 > 0 && offset2 > 0) {
+      return 0;
+    }
+    if (offset1 * offset2 < 0) {
+      vector_t crossing = vec_add(
+          points[0], vec_multiply(offset1 / (offset1 - offset2),
+                                  vec_subtract(points[1], points[0])));
+      points[offset1 > 0 ? 0 : 1] = crossing;
+    }
+  }
+
+  // Keep the points that are actually behind the reference face
+  size_t num_contacts = 0;
+  double face = vec_dot(ref_start, ref_normal);
+  for (size_t i = 0; i < 2; i++) {
+    if (vec_dot(points[i], ref_normal) - face <= CONTACT_SLOP) {
+      contacts[num_contacts++] = points[i];
+    }
+  }
+  return num_contacts;
+}
+
+/**
+ * Finds up to two contact points between two polygons colliding along a
+ * normal, taking the edge of either that faces the other most directly as the
+ * reference.
+ *
+ * @return the number of contact points found
+ */
+static size_t clip_contacts(polygon_t *poly1, polygon_t *poly2,
+                            vector_t normal, vector_t *contacts) {
+  polygon_t *polys[2] = {poly1, poly2};
+  vector_t directions[2] = {normal, vec_negate(normal)};
+  size_t faces[2] = {0, 0};
+  double alignments[2];
+  for (size_t p = 0; p < 2; p++) {
+    const vector_t *normals = polygon_get_normals(polys[p]);
+    alignments[p] = -INFINITY;
+    for (size_t i = 0; i < polygon_num_vertices(polys[p]); i++) {
+      double alignment = vec_dot(normals[i], directions[p]);
+      if (alignment > alignments[p]) {
+        alignments[p] = alignment;
+        faces[p] = i;
+      }
+    }
+  }
+  size_t ref = alignments[0] >= alignments[1] ? 0 : 1;
+  return clip_to_face(polys[ref], faces[ref], polys[1 - ref], contacts);
+}
+
+/**
+ * Tests any two convex bodies with GJK, falling back to EPA when their cores
+ * overlap, and builds a contact manifold. If the bodies are apart, the
+ * direction between their nearest points separates them.
+ */
+static collision_info_t gjk_epa(polygon_t *poly1, polygon_t *poly2,
+                                vector_t *separating_axis) {
+  convex_t convex1 = make_convex(poly1);
+  convex_t convex2 = make_convex(poly2);
+  double radius = convex1.radius + convex2.radius;
+
+  simplex_t simplex;
+  vector_t a, b, normal;
+  double depth;
+  if (!gjk(&convex1, &convex2, &simplex)) {
+    vector_t offset = simplex_closest(&simplex, &a, &b);
+    double distance = vec_get_length(offset);
+    normal = vec_multiply(1 / distance, offset);
+    if (distance > radius) {
+      *separating_axis = normal;
       return (collision_info_t){.collided = false, .axis = VEC_ZERO};
     }
-    if (proj_shape1.x >= proj_shape2.y && proj_shape1.y <= proj_shape2.x) {
-      overlap = (proj_shape2.x - proj_shape1.y);
-    } else if (proj_shape2.x >= proj_shape1.y &&
-               proj_shape2.y <= proj_shape2.x) {
-      overlap = (proj_shape1.x - proj_shape2.y);
+    depth = radius - distance;
+  } else if (simplex.size == 3 || grow_simplex(&convex1, &convex2, &simplex)) {
+    depth = epa(&convex1, &convex2, &simplex, &normal, &a, &b) + radius;
+  } else {
+    // The cores are both single points, in the same place
+    vector_t centers = vec_subtract(convex2.center, convex1.center);
+    normal = normalize_or(centers, (vector_t){0, 1});
+    simplex_closest(&simplex, &a, &b);
+    depth = radius;
+  }
+
+  collision_info_t info = {.collided = true, .axis = normal, .depth = depth};
+  if (convex1.kind == SHAPE_POLYGON && convex2.kind == SHAPE_POLYGON) {
+    info.num_contacts = clip_contacts(poly1, poly2, normal, info.contacts);
+  }
+  if (info.num_contacts == 0) {
+    // Halfway between the two surfaces
+    vector_t surface1 = vec_add(a, vec_multiply(convex1.radius, normal));
+    vector_t surface2 = vec_subtract(b, vec_multiply(convex2.radius, normal));
+    info.contacts[0] = vec_multiply(0.5, vec_add(surface1, surface2));
+    info.num_contacts = 1;
+  }
+  return info;
+}
+
+/**
+ * Projects a polygon's vertices onto a unit axis.
+ *
+ * @param min set to the smallest projection
+ * @param max set to the largest projection
+ */
+static void project_vertices(const vector_t *vertices, size_t size,
+                             vector_t axis, double *min, double *max) {
+  *min = INFINITY;
+  *max = -INFINITY;
+  for (size_t i = 0; i < size; i++) {
+    double projection = vec_dot(vertices[i], axis);
+    if (projection < *min) {
+      *min = projection;
+    }
+    if (projection > *max) {
+      *max = projection;
     }
+  }
+}
 
-    if (overlap < *min_overlap) {
-      *min_overlap = overlap;
-      axis = unit_axis;
+/**
+ * Finds the edge of one polygon that another polygon lies furthest beyond.
+ * Stops at the first edge the other polygon lies entirely beyond.
+ *
+ * @param face set to the index of that edge
+ * @return how far the other polygon lies beyond the edge: positive if the edge
+ *   separates them, otherwise minus how deep the other polygon reaches past it
+ */
+static double max_separation(polygon_t *poly, polygon_t *other,
+                             size_t *face) {
+  const vector_t *vertices = polygon_get_vertices(poly);
+  const vector_t *normals = polygon_get_normals(poly);
+  const vector_t *other_vertices = polygon_get_vertices(other);
+  size_t size = polygon_num_vertices(poly);
+  size_t other_size = polygon_num_vertices(other);
+  double best = -INFINITY;
+  *face = 0;
+  for (size_t i = 0; i < size; i++) {
+    vector_t normal = normals[i];
+    // Edges of zero length have no normal to test
+    if (normal.x == 0 && normal.y == 0) {
+      continue;
+    }
+    double nearest = INFINITY;
+    for (size_t j = 0; j < other_size; j++) {
+      double projection = vec_dot(other_vertices[j], normal);
+      if (projection < nearest) {
+        nearest = projection;
+      }
+    }
+    double separation = nearest - vec_dot(vertices[i], normal);
+    if (separation > best) {
+      best = separation;
+      *face = i;
+      if (best > 0) {
+        break;
+      }
     }
   }
-  list_free(edges1);
-  return (collision_info_t){.collided = true, .axis = axis};
+  return best;
 }
 
-collision_info_t find_collision(body_t *body1, body_t *body2) {
-  list_t *shape1 = body_get_shape(body1);
-  list_t *shape2 = body_get_shape(body2);
+/**
+ * Tests two polygons against each other with the separating axis theorem,
+ * using the edge normals of both as candidate axes. The edge the other
+ * polygon reaches least deeply past is the reference for the contacts.
+ * Polygons with many vertices go through GJK instead.
+ */
+static collision_info_t polygon_polygon(polygon_t *poly1, polygon_t *poly2,
+                                        vector_t *separating_axis) {
+  if (polygon_num_vertices(poly1) > SAT_MAX_VERTICES ||
+      polygon_num_vertices(poly2) > SAT_MAX_VERTICES) {
+    return gjk_epa(poly1, poly2, separating_axis);
+  }
+  size_t face1, face2;
+  double separation1 = max_separation(poly1, poly2, &face1);
+  if (separation1 > 0) {
+    *separating_axis = polygon_get_normals(poly1)[face1];
+    return (collision_info_t){.collided = false, .axis = VEC_ZERO};
+  }
+  double separation2 = max_separation(poly2, poly1, &face2);
+  if (separation2 > 0) {
+    *separating_axis = vec_negate(polygon_get_normals(poly2)[face2]);
+    return (collision_info_t){.collided = false, .axis = VEC_ZERO};
+  }
+  if (separation1 == -INFINITY && separation2 == -INFINITY) {
+    // Neither polygon has an edge of any length
+    return gjk_epa(poly1, poly2, separating_axis);
+  }
 
-  double c1_overlap = __DBL_MAX__;
-  double c2_overlap = __DBL_MAX__;
+  collision_info_t info = {.collided = true};
+  polygon_t *inc;
+  if (separation1 >= separation2) {
+    info.axis = polygon_get_normals(poly1)[face1];
+    info.depth = -separation1;
+    info.num_contacts = clip_to_face(poly1, face1, poly2, info.contacts);
+    inc = poly2;
+  } else {
+    info.axis = vec_negate(polygon_get_normals(poly2)[face2]);
+    info.depth = -separation2;
+    info.num_contacts = clip_to_face(poly2, face2, poly1, info.contacts);
+    inc = poly1;
+  }
+  if (info.num_contacts == 0) {
+    // The incident polygon's deepest vertex, halfway back out of the other
+    const vector_t *vertices = polygon_get_vertices(inc);
+    vector_t into = inc == poly2 ? info.axis : vec_negate(info.axis);
+    vector_t deepest = vertices[0];
+    for (size_t i = 1; i < polygon_num_vertices(inc); i++) {
+      if (vec_dot(vertices[i], into) < vec_dot(deepest, into)) {
+        deepest = vertices[i];
+      }
+    }
+    info.contacts[0] =
+        vec_add(deepest, vec_multiply(info.depth / 2, into));
+    info.num_contacts = 1;
+  }
+  return info;
+}
 
-  collision_info_t collision1 = compare_collision(shape1, shape2, &c1_overlap);
-  collision_info_t collision2 = compare_collision(shape2, shape1, &c2_overlap);
+/**
+ * Determines whether a point lies inside a convex polygon.
+ */
+static bool polygon_contains_point(const vector_t *vertices,
+                                   const vector_t *normals, size_t size,
+                                   vector_t point) {
+  for (size_t i = 0; i < size; i++) {
+    if (vec_dot(vec_subtract(point, vertices[i]), normals[i]) > 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Tests a circle or capsule against a polygon.
+ * While the core segment stays outside the polygon, the closest points between
+ * the segment and the polygon's edges give the axis directly. Once the core
+ * is inside, the shapes are separated along the polygon's edge normals and the
+ * segment's normal with the round shape's projection widened by its radius.
+ * Polygons with many vertices go through GJK instead.
+ */
+static collision_info_t round_polygon(polygon_t *round, polygon_t *poly,
+                                      vector_t *separating_axis) {
+  size_t size = polygon_num_vertices(poly);
+  if (size > SAT_MAX_VERTICES) {
+    return gjk_epa(round, poly, separating_axis);
+  }
+  vector_t start, end;
+  get_core_segment(round, &start, &end);
+  double radius = shape_get_round_radius(polygon_get_shape(round));
+  const vector_t *vertices = polygon_get_vertices(poly);
+  const vector_t *normals = polygon_get_normals(poly);
+
+  if (!polygon_contains_point(vertices, normals, size, start)) {
+    double min_distance_squared = INFINITY;
+    vector_t closest_round = VEC_ZERO;
+    vector_t closest_poly = VEC_ZERO;
+    for (size_t i = 0; i < size; i++) {
+      vector_t on_round, on_poly;
+      double distance_squared =
+          closest_segment_points(start, end, vertices[i],
+                                 vertices[(i + 1) % size], &on_round, &on_poly);
+      if (distance_squared < min_distance_squared) {
+        min_distance_squared = distance_squared;
+        closest_round = on_round;
+        closest_poly = on_poly;
+      }
+    }
+    if (min_distance_squared > CORE_TOUCH_DISTANCE * CORE_TOUCH_DISTANCE) {
+      double distance = sqrt(min_distance_squared);
+      vector_t axis = vec_multiply(1 / distance,
+                                   vec_subtract(closest_poly, closest_round));
+      if (distance > radius) {
+        *separating_axis = axis;
+        return (collision_info_t){.collided = false, .axis = VEC_ZERO};
+      }
+      // Halfway between the two surfaces
+      vector_t surface = vec_add(closest_round, vec_multiply(radius, axis));
+      return (collision_info_t){
+          .collided = true,
+          .axis = axis,
+          .depth = radius - distance,
+          .num_contacts = 1,
+          .contacts = {vec_multiply(0.5, vec_add(surface, closest_poly))}};
+    }
+  }
+
+  // The core segment reaches into the polygon
+  vector_t segment = vec_subtract(end, start);
+  vector_t segment_normal = normalize_or((vector_t){segment.y, -segment.x},
+                                         VEC_ZERO);
+  double depth = INFINITY;
+  vector_t axis = VEC_ZERO;
+  for (size_t i = 0; i <= size; i++) {
+    vector_t normal = i < size ? normals[i] : segment_normal;
+    if (normal.x == 0 && normal.y == 0) {
+      continue;
+    }
+    double poly_min, poly_max;
+    project_vertices(vertices, size, normal, &poly_min, &poly_max);
+    double proj_start = vec_dot(start, normal);
+    double proj_end = vec_dot(end, normal);
+    double round_max = fmax(proj_start, proj_end) + radius;
+    double round_min = fmin(proj_start, proj_end) - radius;
+    if (fmin(round_max, poly_max) - fmax(round_min, poly_min) < 0) {
+      *separating_axis = poly_min > round_max ? normal : vec_negate(normal);
+      return (collision_info_t){.collided = false, .axis = VEC_ZERO};
+    }
+    double forwards = round_max - poly_min;
+    double backwards = poly_max - round_min;
+    if (forwards <= backwards && forwards < depth) {
+      depth = forwards;
+      axis = normal;
+    } else if (backwards < forwards && backwards < depth) {
+      depth = backwards;
+      axis = vec_negate(normal);
+    }
+  }
+  // The round shape's deepest point, halfway back out of the polygon
+  vector_t deepest = vec_dot(start, axis) > vec_dot(end, axis) ? start : end;
+  vector_t contact = vec_add(deepest, vec_multiply(radius - depth / 2, axis));
+  return (collision_info_t){.collided = true,
+                            .axis = axis,
+                            .depth = depth,
+                            .num_contacts = 1,
+                            .contacts = {contact}};
+}
+
+/**
+ * Tests a polygon against a circle or capsule, keeping the axis pointing from
+ * the first shape towards the second.
+ */
+static collision_info_t polygon_round(polygon_t *poly, polygon_t *round,
+                                      vector_t *separating_axis) {
+  collision_info_t info = round_polygon(round, poly, separating_axis);
+  info.axis = vec_negate(info.axis);
+  *separating_axis = vec_negate(*separating_axis);
+  return info;
+}
+
+/**
+ * Measures the gap between the surfaces of two convex bodies.
+ *
+ * @param normal set to the unit vector from the first body towards the second,
+ *   if the bodies are apart
+ * @return the gap, which is at most 0 if the bodies overlap
+ */
+static double surface_distance(const convex_t *convex1,
+                               const convex_t *convex2, vector_t *normal) {
+  double radius = convex1->radius + convex2->radius;
+  simplex_t simplex;
+  if (gjk(convex1, convex2, &simplex)) {
+    return -radius;
+  }
+  vector_t a, b;
+  vector_t offset = simplex_closest(&simplex, &a, &b);
+  double distance = vec_get_length(offset);
+  *normal = vec_multiply(1 / distance, offset);
+  return distance - radius;
+}
+
+/**
+ * Returns whether an axis separates two convex bodies, i.e. whether the
+ * second lies entirely further along it than the first.
+ */
+static bool separates(const convex_t *convex1, const convex_t *convex2,
+                      vector_t axis) {
+  double reach1 = vec_dot(convex_support(convex1, axis), axis) +
+                  convex1->radius * vec_get_length(axis);
+  double reach2 = vec_dot(convex_support(convex2, vec_negate(axis)), axis) -
+                  convex2->radius * vec_get_length(axis);
+  return reach2 > reach1;
+}
+
+/**
+ * Tests two convex bodies against each other.
+ *
+ * @param separating_axis set to a unit axis along which the second body lies
+ *   beyond the first if the kernel finds them apart, otherwise left alone
+ */
+typedef collision_info_t (*collision_kernel_t)(polygon_t *poly1,
+                                               polygon_t *poly2,
+                                               vector_t *separating_axis);
+
+/**
+ * The collision kernel for each pair of shape kinds, indexed by the kinds of
+ * the first and second shapes. Pairs of circles and capsules have a closed
+ * form, and polygons with few vertices use SAT against each other and against
+ * circles and capsules. Ellipses, being curved, always go through GJK.
+ */
+const collision_kernel_t
+    COLLISION_KERNELS[NUM_SHAPE_KINDS][NUM_SHAPE_KINDS] = {
+        [SHAPE_POLYGON] = {[SHAPE_POLYGON] = polygon_polygon,
+                           [SHAPE_CIRCLE] = polygon_round,
+                           [SHAPE_ELLIPSE] = gjk_epa,
+                           [SHAPE_CAPSULE] = polygon_round},
+        [SHAPE_CIRCLE] = {[SHAPE_POLYGON] = round_polygon,
+                          [SHAPE_CIRCLE] = round_round,
+                          [SHAPE_ELLIPSE] = gjk_epa,
+                          [SHAPE_CAPSULE] = round_round},
+        [SHAPE_ELLIPSE] = {[SHAPE_POLYGON] = gjk_epa,
+                           [SHAPE_CIRCLE] = gjk_epa,
+                           [SHAPE_ELLIPSE] = gjk_epa,
+                           [SHAPE_CAPSULE] = gjk_epa},
+        [SHAPE_CAPSULE] = {[SHAPE_POLYGON] = round_polygon,
+                           [SHAPE_CIRCLE] = round_round,
+                           [SHAPE_ELLIPSE] = gjk_epa,
+                           [SHAPE_CAPSULE] = round_round},
+};
 
-  list_free(shape1);
-  list_free(shape2);
+collision_info_t find_collision(body_t *body1, body_t *body2) {
+  polygon_t *poly1 = body_peek_polygon(body1);
+  polygon_t *poly2 = body_peek_polygon(body2);
+  if (!body_can_collide(body1, body2) ||
+      is_trivially_separated(poly1, poly2)) {
+    return (collision_info_t){.collided = false, .axis = VEC_ZERO};
+  }
+  shape_kind_t kind1 = shape_get_kind(polygon_get_shape(poly1));
+  shape_kind_t kind2 = shape_get_kind(polygon_get_shape(poly2));
+  vector_t separating_axis = VEC_ZERO;
+  return COLLISION_KERNELS[kind1][kind2](poly1, poly2, &separating_axis);
+}
 
-  if (!collision1.collided) {
-    return collision1;
+collision_info_t find_collision_gjk(body_t *body1, body_t *body2) {
+  polygon_t *poly1 = body_peek_polygon(body1);
+  polygon_t *poly2 = body_peek_polygon(body2);
+  if (!body_can_collide(body1, body2) ||
+      is_trivially_separated(poly1, poly2)) {
+    return (collision_info_t){.collided = false, .axis = VEC_ZERO};
   }
+  vector_t separating_axis = VEC_ZERO;
+  return gjk_epa(poly1, poly2, &separating_axis);
+}
 
-  if (!collision2.collided) {
-    return collision2;
+collision_info_t find_collision_cached(body_t *body1, body_t *body2,
+                                       vector_t *separating_axis) {
+  polygon_t *poly1 = body_peek_polygon(body1);
+  polygon_t *poly2 = body_peek_polygon(body2);
+  if (!body_can_collide(body1, body2) ||
+      is_trivially_separated(poly1, poly2)) {
+    return (collision_info_t){.collided = false, .axis = VEC_ZERO};
   }
+  convex_t convex1 = make_convex(poly1);
+  convex_t convex2 = make_convex(poly2);
+  bool has_axis = separating_axis->x != 0 || separating_axis->y != 0;
+  if (has_axis && separates(&convex1, &convex2, *separating_axis)) {
+    return (collision_info_t){.collided = false, .axis = VEC_ZERO};
+  }
+
+  shape_kind_t kind1 = shape_get_kind(polygon_get_shape(poly1));
+  shape_kind_t kind2 = shape_get_kind(polygon_get_shape(poly2));
+  // The kernel leaves behind the axis it found the bodies apart on, if any
+  *separating_axis = VEC_ZERO;
+  return COLLISION_KERNELS[kind1][kind2](poly1, poly2, separating_axis);
+}
 
-  if (c1_overlap < c2_overlap) {
-    return collision1;
+double find_time_of_impact(body_t *body1, vector_t start, body_t *body2) {
+  polygon_t *poly1 = body_peek_polygon(body1);
+  vector_t motion = vec_subtract(polygon_get_center(poly1), start);
+  convex_t convex1 = make_convex(poly1);
+  convex_t convex2 = make_convex(body_peek_polygon(body2));
+  convex_translate(&convex1, vec_negate(motion));
+
+  // Conservative advancement: the gap can't close faster than the motion
+  // along the normal between the nearest points, so stepping by the gap over
+  // that speed never passes the first contact
+  double t = 0;
+  for (size_t i = 0; i < TOI_MAX_ITERATIONS; i++) {
+    vector_t normal;
+    double gap = surface_distance(&convex1, &convex2, &normal);
+    if (gap <= TOI_TOLERANCE) {
+      break;
+    }
+    double approach = vec_dot(motion, normal);
+    if (approach <= 0 || t + gap / approach > 1) {
+      return INFINITY;
+    }
+    t += gap / approach;
+    convex_translate(&convex1, vec_multiply(gap / approach, motion));
   }
-  return collision2;
+  return t > 0 ? t : INFINITY;
 }
@@ -7,10 +7,21 @@
 
 const double COLOR_MAX = 255; // max value of each rgb value
 const double WHITE_MIX = 1;
+const size_t COLOR_POOL_CHUNK = 64;
+
+static pool_t *COLOR_POOL = NULL;
+
+static pool_t *color_pool() {
+  if (COLOR_POOL == NULL) {
+    COLOR_POOL = pool_init(sizeof(rgb_color_t), COLOR_POOL_CHUNK);
+  }
+  return COLOR_POOL;
+}
+
+pool_stats_t color_pool_stats() { return pool_get_stats(color_pool()); }
 
 rgb_color_t *color_init(double red, double green, double blue) {
-  rgb_color_t *color = malloc(sizeof(rgb_color_t));
-  assert(color);
+  rgb_color_t *color = pool_alloc(color_pool());
 
   color->r = red;
   color->g = green;
@@ -39,4 +50,4 @@ bool color_compare(rgb_color_t c1, rgb_color_t c2) {
   return c1.r == c2.r && c1.g == c2.g && c1.b == c2.b;
 }
 
-void color_free(rgb_color_t *color) { free(color); }
+void color_free(rgb_color_t *color) { pool_release(color_pool(), color); }
@@ -1,3 +1,4 @@
+#include "arena.h"
 #include "math.h"
 #include "sdl_wrapper.h"
 #include "state.h"
@@ -20,6 +21,8 @@ void loop() {
   bool game_over = emscripten_main(state);
 
   if (sdl_is_done((void *)state)) { // Once our demo exits...
+    printf("frame arena high-water mark: %zu bytes\n",
+           arena_high_water(frame_arena()));
     emscripten_free(state);         // Free any state variables we've been using
 #ifdef __EMSCRIPTEN__ // Clean up emscripten environment (if we're using it)
     emscripten_cancel_main_loop();
@@ -31,6 +34,8 @@ void loop() {
   } else if (game_over) {
     SDL_Quit();
   }
+  // Scratch memory from this frame is no longer needed
+  arena_reset(frame_arena());
 }
 
 int main() {
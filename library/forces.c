@@ -1,4 +1,5 @@
 #include "forces.h"
+#include "nbody.h"
 
 #include <assert.h>
 #include <math.h>
@@ -7,12 +8,15 @@
 
 const double MIN_DIST = 5;
 const double DEFAULT_ELASTICITY = 1.0;
+// Fraction of the overlap between colliding bodies removed each tick
+const double POSITION_CORRECTION = 0.8;
+// Overlap left alone, so resting contacts don't jitter
+const double POSITION_SLOP = 0.5;
 typedef struct collision_aux {
   double force_const;
-  list_t *bodies;
   collision_handler_t handler;
-  bool collided;
   void *aux; // aux (if allocated in memory) should be free'd by the caller
+  bool correct_positions;
 } collision_aux_t;
 
 body_aux_t *body_aux_init(double force_const, list_t *bodies) {
@@ -25,17 +29,15 @@ body_aux_t *body_aux_init(double force_const, list_t *bodies) {
   return aux;
 }
 
-collision_aux_t *collision_aux_init(double force_const, list_t *bodies,
-                                    collision_handler_t handler, bool collided,
-                                    void *aux) {
+collision_aux_t *collision_aux_init(double force_const,
+                                    collision_handler_t handler, void *aux) {
   collision_aux_t *collision_aux = malloc(sizeof(collision_aux_t));
   assert(collision_aux);
 
   collision_aux->force_const = force_const;
-  collision_aux->bodies = bodies;
   collision_aux->handler = handler;
-  collision_aux->collided = collided;
   collision_aux->aux = aux;
+  collision_aux->correct_positions = false;
   return collision_aux;
 }
 
@@ -86,6 +88,87 @@ void create_newtonian_gravity(scene_t *scene, double G, body_t *body1,
                                  bodies);
 }
 
+typedef struct nbody_gravity_aux {
+  scene_t *scene;
+  nbody_t *solver;
+  double G;
+  double theta;
+  // Scratch space for the bodies gravity acts on this tick
+  body_t **bodies;
+  vector_t *positions;
+  double *masses;
+  vector_t *forces;
+  size_t capacity;
+} nbody_gravity_aux_t;
+
+static void nbody_gravity_aux_free(nbody_gravity_aux_t *aux) {
+  nbody_free(aux->solver);
+  free(aux->bodies);
+  free(aux->positions);
+  free(aux->masses);
+  free(aux->forces);
+  free(aux);
+}
+
+static void nbody_gravity_reserve(nbody_gravity_aux_t *aux, size_t size) {
+  if (aux->capacity >= size) {
+    return;
+  }
+  aux->bodies = realloc(aux->bodies, sizeof(body_t *) * size);
+  aux->positions = realloc(aux->positions, sizeof(vector_t) * size);
+  aux->masses = realloc(aux->masses, sizeof(double) * size);
+  aux->forces = realloc(aux->forces, sizeof(vector_t) * size);
+  assert(aux->bodies != NULL && aux->positions != NULL &&
+         aux->masses != NULL && aux->forces != NULL);
+  aux->capacity = size;
+}
+
+/**
+ * The force creator for gravity between every body in a scene. Gathers the
+ * bodies with a finite mass, and hands them to the n-body solver at once.
+ * The solver walks its tree on as many threads as the scene ticks on.
+ *
+ * @param info the scene and the solver's settings
+ */
+static void nbody_gravity(void *info) {
+  nbody_gravity_aux_t *aux = info;
+  nbody_gravity_reserve(aux, scene_bodies(aux->scene));
+  size_t num_masses = 0;
+  for (size_t i = 0; i < scene_bodies(aux->scene); i++) {
+    body_t *body = scene_get_body(aux->scene, i);
+    double mass = body_get_mass(body);
+    if (body_is_removed(body) || !isfinite(mass)) {
+      continue;
+    }
+    aux->bodies[num_masses] = body;
+    aux->positions[num_masses] = body_get_centroid(body);
+    aux->masses[num_masses] = mass;
+    num_masses++;
+  }
+  nbody_set_threads(aux->solver, scene_get_threads(aux->scene));
+  nbody_forces(aux->solver, num_masses, aux->positions, aux->masses, aux->G,
+               aux->theta, MIN_DIST, aux->forces);
+  for (size_t i = 0; i < num_masses; i++) {
+    body_add_force(aux->bodies[i], aux->forces[i]);
+  }
+}
+
+void create_nbody_gravity(scene_t *scene, double G, double theta) {
+  nbody_gravity_aux_t *aux = malloc(sizeof(nbody_gravity_aux_t));
+  assert(aux != NULL);
+  aux->scene = scene;
+  aux->solver = nbody_init();
+  aux->G = G;
+  aux->theta = theta;
+  aux->bodies = NULL;
+  aux->positions = NULL;
+  aux->masses = NULL;
+  aux->forces = NULL;
+  aux->capacity = 0;
+  scene_add_owned_force_creator(scene, nbody_gravity, aux, list_init(0, NULL),
+                                (free_func_t)nbody_gravity_aux_free);
+}
+
 /**
  * The force creator for spring forces between objects. Calculates
  * the magnitude of the force components and adds the force to each
@@ -146,50 +229,101 @@ void create_drag(scene_t *scene, double gamma, body_t *body) {
                                  bodies);
 }
 
-/**
- * The force creator for collisions. Checks if the bodies in the collision aux
- * are colliding, and if they do, runs the collision handler on the bodies.
- *
- * @param info auxiliary information about the force and associated body
- */
-static void collision_force_creator(void *collision_aux) {
-  collision_aux_t *col_aux = collision_aux;
+size_t create_gravity_field(scene_t *scene, uint32_t category,
+                            vector_t acceleration) {
+  force_field_t field = {.kind = FORCE_FIELD_GRAVITY,
+                         .category = category,
+                         .region = AABB_EVERYWHERE,
+                         .acceleration = acceleration};
+  return scene_add_force_field(scene, field);
+}
+
+size_t create_drag_field(scene_t *scene, uint32_t category, double gamma) {
+  force_field_t field = {.kind = FORCE_FIELD_DRAG,
+                         .category = category,
+                         .region = AABB_EVERYWHERE,
+                         .gamma = gamma};
+  return scene_add_force_field(scene, field);
+}
 
-  list_t *bodies = col_aux->bodies;
-  body_t *body1 = list_get(bodies, 0);
-  body_t *body2 = list_get(bodies, 1);
+size_t create_wind_field(scene_t *scene, uint32_t category, aabb_t region,
+                         vector_t force) {
+  force_field_t field = {.kind = FORCE_FIELD_WIND,
+                         .category = category,
+                         .region = region,
+                         .force = force};
+  return scene_add_force_field(scene, field);
+}
 
-  // Check for collision; if bodies collide, call collision_handler
-  bool prev_collision = col_aux->collided;
+size_t create_ground_field(scene_t *scene, uint32_t category, aabb_t region,
+                           double height) {
+  force_field_t field = {.kind = FORCE_FIELD_GROUND,
+                         .category = category,
+                         .region = region,
+                         .height = height};
+  return scene_add_force_field(scene, field);
+}
 
-  collision_info_t info = find_collision(body1, body2);
-  // avoids registering impulse multiple times while bodies are still colliding
-  if (info.collided && !prev_collision) {
-    collision_handler_t handler = col_aux->handler;
+/**
+ * Pushes two overlapping bodies apart along the collision axis, in inverse
+ * proportion to their masses, so they don't sink into each other.
+ */
+static void correct_positions(body_t *body1, body_t *body2,
+                              collision_info_t info) {
+  double inverse_mass1 = 1 / body_get_mass(body1);
+  double inverse_mass2 = 1 / body_get_mass(body2);
+  double total = inverse_mass1 + inverse_mass2;
+  double overlap = info.depth - POSITION_SLOP;
+  if (total == 0 || overlap <= 0) {
+    return;
+  }
+  vector_t correction =
+      vec_multiply(POSITION_CORRECTION * overlap / total, info.axis);
+  body_set_centroid(body1,
+                    vec_subtract(body_get_centroid(body1),
+                                 vec_multiply(inverse_mass1, correction)));
+  body_set_centroid(body2, vec_add(body_get_centroid(body2),
+                                   vec_multiply(inverse_mass2, correction)));
+}
 
-    handler(body1, body2, info.axis, col_aux->aux, col_aux->force_const);
-    col_aux->collided = true;
-  } else if (!info.collided && prev_collision) {
-    col_aux->collided = false;
+/**
+ * The contact handler for collisions. Runs the collision handler on the
+ * bodies when they start touching, so impulses aren't applied again while
+ * they stay in contact. Bodies that resolve their overlap are also pushed
+ * apart on every tick they overlap.
+ */
+static void collision_contact_handler(body_t *body1, body_t *body2,
+                                      contact_event_t event,
+                                      collision_info_t info, void *aux) {
+  collision_aux_t *col_aux = aux;
+  if (event == CONTACT_ENTER) {
+    col_aux->handler(body1, body2, info.axis, col_aux->aux,
+                     col_aux->force_const);
   }
+  if (event != CONTACT_EXIT && col_aux->correct_positions &&
+      !body_is_sensor(body1) && !body_is_sensor(body2)) {
+    correct_positions(body1, body2, info);
+  }
+}
+
+/**
+ * Subscribes the contact handler behind create_collision(), optionally with
+ * positional correction.
+ */
+static void add_collision(scene_t *scene, body_t *body1, body_t *body2,
+                          collision_handler_t handler, void *aux,
+                          double force_const, bool correct_positions) {
+  collision_aux_t *collision_aux =
+      collision_aux_init(force_const, handler, aux);
+  collision_aux->correct_positions = correct_positions;
+  scene_add_contact_handler(scene, body1, body2, collision_contact_handler,
+                            collision_aux, free);
 }
 
 void create_collision(scene_t *scene, body_t *body1, body_t *body2,
                       collision_handler_t handler, void *aux,
                       double force_const) {
-  list_t *bodies = list_init(2, NULL);
-  list_add(bodies, body1);
-  list_add(bodies, body2);
-
-  list_t *aux_bodies = list_init(2, NULL);
-  list_add(aux_bodies, body1);
-  list_add(aux_bodies, body2);
-
-  collision_aux_t *collision_aux =
-      collision_aux_init(force_const, aux_bodies, handler, false, aux);
-
-  scene_add_bodies_force_creator(scene, collision_force_creator, collision_aux,
-                                 bodies);
+  add_collision(scene, body1, body2, handler, aux, force_const, false);
 }
 
 /**
@@ -208,6 +342,10 @@ void create_destructive_collision(scene_t *scene, body_t *body1,
 
 void physics_collision_handler(body_t *body1, body_t *body2, vector_t axis,
                                void *aux, double force_const) {
+  // Sensors only detect overlaps
+  if (body_is_sensor(body1) || body_is_sensor(body2)) {
+    return;
+  }
   double mass1 = body_get_mass(body1);
   double mass2 = body_get_mass(body2);
   vector_t vel1 = body_get_velocity(body1);
@@ -236,6 +374,6 @@ void physics_collision_handler(body_t *body1, body_t *body2, vector_t axis,
 
 void create_physics_collision(scene_t *scene, body_t *body1, body_t *body2,
                               double elasticity) {
-  create_collision(scene, body1, body2, physics_collision_handler, NULL,
-                   elasticity);
+  add_collision(scene, body1, body2, physics_collision_handler, NULL,
+                elasticity, true);
 }
\ No newline at end of file
@@ -40,7 +40,7 @@ void *list_get(list_t *list, size_t index) {
 
 void list_add(list_t *list, void *value) {
   if (list->curr_size == list->max_size) {
-    list->max_size *= 2;
+    list->max_size = list->max_size > 0 ? list->max_size * 2 : 1;
     list->data = realloc(list->data, sizeof(void *) * list->max_size);
     assert(list->data != NULL);
   }
@@ -62,8 +62,61 @@ void *list_remove(list_t *list, size_t index) {
   return old_value;
 }
 
-void remove_entire_list(list_t *list) {
-  for (size_t i = 0; i < list_size(list); i++) {
-    list_remove(list, i);
+void *list_swap_remove(list_t *list, size_t index) {
+  assert(index >= 0 && index < list->curr_size);
+  void *old_value = list->data[index];
+
+  list->curr_size--;
+  list->data[index] = list->data[list->curr_size];
+
+  return old_value;
+}
+
+void list_swap(list_t *list, size_t index1, size_t index2) {
+  assert(index1 < list->curr_size && index2 < list->curr_size);
+  void *value = list->data[index1];
+  list->data[index1] = list->data[index2];
+  list->data[index2] = value;
+}
+
+size_t list_remove_if(list_t *list, list_pred_t pred, void *aux,
+                      free_func_t freer) {
+  size_t kept = 0;
+  for (size_t i = 0; i < list->curr_size; i++) {
+    void *value = list->data[i];
+    if (pred == NULL || pred(value, aux)) {
+      if (freer != NULL) {
+        freer(value);
+      }
+    } else {
+      list->data[kept] = value;
+      kept++;
+    }
   }
+  size_t removed = list->curr_size - kept;
+  list->curr_size = kept;
+  return removed;
+}
+
+size_t list_swap_remove_if(list_t *list, list_pred_t pred, void *aux,
+                           free_func_t freer) {
+  size_t removed = 0;
+  size_t i = 0;
+  while (i < list->curr_size) {
+    void *value = list->data[i];
+    if (pred == NULL || pred(value, aux)) {
+      list_swap_remove(list, i);
+      if (freer != NULL) {
+        freer(value);
+      }
+      removed++;
+    } else {
+      i++;
+    }
+  }
+  return removed;
+}
+
+void remove_entire_list(list_t *list) {
+  list_remove_if(list, NULL, NULL, NULL);
 }
@@ -0,0 +1,534 @@
+#include "nbody.h"
+#include "thread_pool.h"
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// Cells stop splitting this deep, so masses at almost the same point share a
+// leaf however many there are
+#define NBODY_MAX_DEPTH 48
+// A traversal pops one cell and pushes four per level
+#define NBODY_STACK_SIZE (3 * NBODY_MAX_DEPTH + 4)
+
+const uint32_t NBODY_NONE = UINT32_MAX;
+// Sets this small are quicker to sum exactly than to build a tree for
+const size_t NBODY_EXACT_MAX = 64;
+const size_t NBODY_INITIAL_CELLS = 64;
+// Leaves split once they hold more masses than this. The tree is walked once
+// per leaf, so bigger leaves mean fewer walks but longer interaction lists.
+const uint32_t NBODY_LEAF_SIZE = 8;
+
+typedef struct nbody_cell {
+  // The cell's square
+  double center_x;
+  double center_y;
+  double half_width;
+  // The total mass in the cell, and where its center of mass is
+  double mass;
+  double mass_x;
+  double mass_y;
+  // The first of the cell's four children, which are stored together, or
+  // NBODY_NONE for leaves
+  uint32_t children;
+  // The first mass in a leaf, or NBODY_NONE if it is empty. The rest follow
+  // through next_mass.
+  uint32_t first_mass;
+  uint32_t num_masses;
+} nbody_cell_t;
+
+// A list of masses, and scratch space for how hard each pulls
+typedef struct nbody_list {
+  double *xs;
+  double *ys;
+  double *ms;
+  double *pulls;
+  size_t size;
+  size_t capacity;
+} nbody_list_t;
+
+struct nbody {
+  nbody_cell_t *cells;
+  size_t num_cells;
+  size_t cell_capacity;
+  // Per mass scratch space, kept as separate arrays so the sums run down
+  // contiguous memory
+  double *xs;
+  double *ys;
+  double *ms;
+  double *force_xs;
+  double *force_ys;
+  uint32_t *next_mass;
+  size_t mass_capacity;
+  // The leaves that hold masses, in the order the tree holds them
+  uint32_t *leaves;
+  size_t num_leaves;
+  size_t leaf_capacity;
+  // What pulls on the leaf each thread is walking
+  nbody_list_t *lists;
+  size_t num_threads;
+  // NULL if there is only one thread
+  thread_pool_t *pool;
+  // The settings of the current call, for the threads
+  double theta_squared;
+  double min_squared;
+};
+
+static void *nbody_grow(void *array, size_t size) {
+  void *grown = realloc(array, size);
+  assert(grown != NULL);
+  return grown;
+}
+
+static void nbody_list_free(nbody_list_t *list) {
+  free(list->xs);
+  free(list->ys);
+  free(list->ms);
+  free(list->pulls);
+}
+
+static void nbody_list_reserve(nbody_list_t *list, size_t capacity) {
+  if (list->capacity >= capacity) {
+    return;
+  }
+  size_t size = sizeof(double) * capacity;
+  list->xs = nbody_grow(list->xs, size);
+  list->ys = nbody_grow(list->ys, size);
+  list->ms = nbody_grow(list->ms, size);
+  list->pulls = nbody_grow(list->pulls, size);
+  list->capacity = capacity;
+}
+
+static void nbody_list_add(nbody_list_t *list, double x, double y, double m) {
+  if (list->size == list->capacity) {
+    nbody_list_reserve(list, list->capacity > 0 ? list->capacity * 2
+                                                : NBODY_INITIAL_CELLS);
+  }
+  list->xs[list->size] = x;
+  list->ys[list->size] = y;
+  list->ms[list->size] = m;
+  list->size++;
+}
+
+static void nbody_stop_threads(nbody_t *solver) {
+  for (size_t i = 0; i < solver->num_threads; i++) {
+    nbody_list_free(&solver->lists[i]);
+  }
+  free(solver->lists);
+  if (solver->pool != NULL) {
+    thread_pool_free(solver->pool);
+  }
+  solver->lists = NULL;
+  solver->pool = NULL;
+  solver->num_threads = 0;
+}
+
+void nbody_set_threads(nbody_t *solver, size_t num_threads) {
+  assert(num_threads > 0);
+  if (num_threads == solver->num_threads) {
+    return;
+  }
+  nbody_stop_threads(solver);
+  solver->num_threads = num_threads;
+  solver->lists = calloc(num_threads, sizeof(nbody_list_t));
+  assert(solver->lists != NULL);
+  if (num_threads > 1) {
+    solver->pool = thread_pool_init(num_threads);
+  }
+}
+
+size_t nbody_get_threads(nbody_t *solver) { return solver->num_threads; }
+
+nbody_t *nbody_init(void) {
+  nbody_t *solver = malloc(sizeof(nbody_t));
+  assert(solver != NULL);
+  solver->cells = NULL;
+  solver->num_cells = 0;
+  solver->cell_capacity = 0;
+  solver->xs = NULL;
+  solver->ys = NULL;
+  solver->ms = NULL;
+  solver->force_xs = NULL;
+  solver->force_ys = NULL;
+  solver->next_mass = NULL;
+  solver->mass_capacity = 0;
+  solver->leaves = NULL;
+  solver->num_leaves = 0;
+  solver->leaf_capacity = 0;
+  solver->lists = NULL;
+  solver->num_threads = 0;
+  solver->pool = NULL;
+  nbody_set_threads(solver, 1);
+  return solver;
+}
+
+void nbody_free(nbody_t *solver) {
+  free(solver->cells);
+  free(solver->xs);
+  free(solver->ys);
+  free(solver->ms);
+  free(solver->force_xs);
+  free(solver->force_ys);
+  free(solver->next_mass);
+  free(solver->leaves);
+  nbody_stop_threads(solver);
+  free(solver);
+}
+
+size_t nbody_num_cells(nbody_t *solver) { return solver->num_cells; }
+
+/**
+ * Makes room for a number of masses, and copies them into the scratch
+ * arrays.
+ */
+static void nbody_load(nbody_t *solver, size_t num_masses,
+                       const vector_t *positions, const double *masses) {
+  if (solver->mass_capacity < num_masses) {
+    size_t size = sizeof(double) * num_masses;
+    solver->xs = nbody_grow(solver->xs, size);
+    solver->ys = nbody_grow(solver->ys, size);
+    solver->ms = nbody_grow(solver->ms, size);
+    solver->force_xs = nbody_grow(solver->force_xs, size);
+    solver->force_ys = nbody_grow(solver->force_ys, size);
+    solver->next_mass =
+        nbody_grow(solver->next_mass, sizeof(uint32_t) * num_masses);
+    solver->mass_capacity = num_masses;
+  }
+  for (size_t i = 0; i < num_masses; i++) {
+    solver->xs[i] = positions[i].x;
+    solver->ys[i] = positions[i].y;
+    solver->ms[i] = masses[i];
+  }
+}
+
+/**
+ * Finds how hard each of a list of masses pulls on a point, per unit of mass
+ * at the point and of displacement: m / r^3, or 0 for masses too close to it.
+ * The loop has no branches, so the compiler vectorizes it, as long as sqrt()
+ * isn't allowed to set errno (-fno-math-errno).
+ */
+static void nbody_pulls(size_t count, const double *restrict xs,
+                        const double *restrict ys, const double *restrict ms,
+                        double x, double y, double min_squared,
+                        double *restrict pulls) {
+  for (size_t i = 0; i < count; i++) {
+    double dx = xs[i] - x;
+    double dy = ys[i] - y;
+    double r_squared = dx * dx + dy * dy;
+    // Too close pairs are pushed out to infinity, where they don't pull
+    r_squared = r_squared > min_squared ? r_squared : INFINITY;
+    pulls[i] = ms[i] / (r_squared * sqrt(r_squared));
+  }
+}
+
+/**
+ * Sums the force between every pair of masses, each pair once.
+ */
+static void nbody_sum_exact(nbody_t *solver, size_t num_masses,
+                            double min_distance) {
+  const double *xs = solver->xs;
+  const double *ys = solver->ys;
+  const double *ms = solver->ms;
+  double *force_xs = solver->force_xs;
+  double *force_ys = solver->force_ys;
+  nbody_list_reserve(&solver->lists[0], num_masses);
+  double *pulls = solver->lists[0].pulls;
+  for (size_t i = 0; i < num_masses; i++) {
+    force_xs[i] = 0;
+    force_ys[i] = 0;
+  }
+  for (size_t i = 0; i < num_masses; i++) {
+    double x = xs[i];
+    double y = ys[i];
+    size_t rest = i + 1;
+    nbody_pulls(num_masses - rest, xs + rest, ys + rest, ms + rest, x, y,
+                min_distance * min_distance, pulls);
+    double force_x = 0;
+    double force_y = 0;
+    for (size_t j = rest; j < num_masses; j++) {
+      double pull = ms[i] * pulls[j - rest];
+      force_x += pull * (xs[j] - x);
+      force_y += pull * (ys[j] - y);
+      force_xs[j] -= pull * (xs[j] - x);
+      force_ys[j] -= pull * (ys[j] - y);
+    }
+    force_xs[i] += force_x;
+    force_ys[i] += force_y;
+  }
+}
+
+static uint32_t nbody_add_cells(nbody_t *solver, size_t count) {
+  if (solver->num_cells + count > solver->cell_capacity) {
+    size_t capacity = solver->cell_capacity > 0 ? solver->cell_capacity * 2
+                                                : NBODY_INITIAL_CELLS;
+    while (capacity < solver->num_cells + count) {
+      capacity *= 2;
+    }
+    solver->cells =
+        nbody_grow(solver->cells, sizeof(nbody_cell_t) * capacity);
+    solver->cell_capacity = capacity;
+  }
+  assert(solver->num_cells + count < NBODY_NONE);
+  uint32_t first = solver->num_cells;
+  solver->num_cells += count;
+  return first;
+}
+
+static void nbody_empty_cell(nbody_cell_t *cell, double center_x,
+                             double center_y, double half_width) {
+  cell->center_x = center_x;
+  cell->center_y = center_y;
+  cell->half_width = half_width;
+  cell->children = NBODY_NONE;
+  cell->first_mass = NBODY_NONE;
+  cell->num_masses = 0;
+}
+
+static void nbody_add_mass(nbody_t *solver, nbody_cell_t *cell,
+                           uint32_t mass) {
+  solver->next_mass[mass] = cell->first_mass;
+  cell->first_mass = mass;
+  cell->num_masses++;
+}
+
+// Which of a cell's children a point falls in
+static uint32_t nbody_quadrant(nbody_cell_t *cell, double x, double y) {
+  return (x >= cell->center_x) | (y >= cell->center_y) << 1;
+}
+
+/**
+ * Splits a full leaf into four, and moves its masses down.
+ */
+static void nbody_split(nbody_t *solver, uint32_t index) {
+  uint32_t children = nbody_add_cells(solver, 4);
+  nbody_cell_t *cell = &solver->cells[index];
+  double quarter = cell->half_width / 2;
+  for (uint32_t q = 0; q < 4; q++) {
+    nbody_empty_cell(&solver->cells[children + q],
+                     cell->center_x + (q & 1 ? quarter : -quarter),
+                     cell->center_y + (q & 2 ? quarter : -quarter), quarter);
+  }
+  uint32_t mass = cell->first_mass;
+  while (mass != NBODY_NONE) {
+    uint32_t next = solver->next_mass[mass];
+    uint32_t child =
+        children + nbody_quadrant(cell, solver->xs[mass], solver->ys[mass]);
+    nbody_add_mass(solver, &solver->cells[child], mass);
+    mass = next;
+  }
+  cell->children = children;
+  cell->first_mass = NBODY_NONE;
+  cell->num_masses = 0;
+}
+
+static void nbody_insert(nbody_t *solver, uint32_t mass) {
+  double x = solver->xs[mass];
+  double y = solver->ys[mass];
+  uint32_t index = 0;
+  size_t depth = 0;
+  while (true) {
+    nbody_cell_t *cell = &solver->cells[index];
+    if (cell->children != NBODY_NONE) {
+      index = cell->children + nbody_quadrant(cell, x, y);
+      depth++;
+    } else if (cell->num_masses < NBODY_LEAF_SIZE ||
+               depth == NBODY_MAX_DEPTH) {
+      nbody_add_mass(solver, cell, mass);
+      return;
+    } else {
+      // Splitting moves the cells, so look the cell up again
+      nbody_split(solver, index);
+    }
+  }
+}
+
+/**
+ * Builds the tree over the scratch arrays, and finds each cell's mass and
+ * center of mass.
+ */
+static void nbody_build(nbody_t *solver, size_t num_masses) {
+  double min_x = INFINITY, min_y = INFINITY;
+  double max_x = -INFINITY, max_y = -INFINITY;
+  for (size_t i = 0; i < num_masses; i++) {
+    min_x = fmin(min_x, solver->xs[i]);
+    min_y = fmin(min_y, solver->ys[i]);
+    max_x = fmax(max_x, solver->xs[i]);
+    max_y = fmax(max_y, solver->ys[i]);
+  }
+  // Pad the root a little, so the largest coordinates fall inside it
+  double half_width = fmax(max_x - min_x, max_y - min_y) / 2 * 1.0001 + 1e-9;
+  solver->num_cells = 0;
+  nbody_add_cells(solver, 1);
+  nbody_empty_cell(&solver->cells[0], (min_x + max_x) / 2,
+                   (min_y + max_y) / 2, half_width);
+  for (size_t i = 0; i < num_masses; i++) {
+    nbody_insert(solver, i);
+  }
+  // Children come after their parents, so going backwards sums them first
+  for (size_t c = solver->num_cells; c-- > 0;) {
+    nbody_cell_t *cell = &solver->cells[c];
+    double mass = 0, moment_x = 0, moment_y = 0;
+    if (cell->children != NBODY_NONE) {
+      for (uint32_t q = 0; q < 4; q++) {
+        nbody_cell_t *child = &solver->cells[cell->children + q];
+        mass += child->mass;
+        moment_x += child->mass * child->mass_x;
+        moment_y += child->mass * child->mass_y;
+      }
+    } else {
+      for (uint32_t i = cell->first_mass; i != NBODY_NONE;
+           i = solver->next_mass[i]) {
+        mass += solver->ms[i];
+        moment_x += solver->ms[i] * solver->xs[i];
+        moment_y += solver->ms[i] * solver->ys[i];
+      }
+    }
+    cell->mass = mass;
+    cell->mass_x = mass > 0 ? moment_x / mass : cell->center_x;
+    cell->mass_y = mass > 0 ? moment_y / mass : cell->center_y;
+  }
+}
+
+/**
+ * Returns the squared distance from a point to a cell's square, or 0 if the
+ * point is inside it.
+ */
+static double nbody_distance_squared(nbody_cell_t *cell, double x, double y) {
+  double dx = fmax(fabs(x - cell->center_x) - cell->half_width, 0);
+  double dy = fmax(fabs(y - cell->center_y) - cell->half_width, 0);
+  return dx * dx + dy * dy;
+}
+
+static bool nbody_overlap(nbody_cell_t *cell1, nbody_cell_t *cell2) {
+  double reach = cell1->half_width + cell2->half_width;
+  return fabs(cell1->center_x - cell2->center_x) < reach &&
+         fabs(cell1->center_y - cell2->center_y) < reach;
+}
+
+/**
+ * Walks the tree once for all the masses in a leaf, listing what pulls on
+ * them: a cell is taken as a single mass if it is small enough next to its
+ * distance from every point of the leaf, and is opened otherwise. The masses
+ * of the leaf itself and its neighbours are listed one by one. Then the pull
+ * of the list is summed for each mass in the leaf, the same way as the exact
+ * sum. A mass doesn't pull on itself, since it is too close.
+ */
+static void nbody_walk(nbody_t *solver, uint32_t leaf_index,
+                       nbody_list_t *list) {
+  nbody_cell_t *leaf = &solver->cells[leaf_index];
+  uint32_t stack[NBODY_STACK_SIZE];
+  size_t stack_size = 0;
+  stack[stack_size++] = 0;
+  list->size = 0;
+  while (stack_size > 0) {
+    nbody_cell_t *cell = &solver->cells[stack[--stack_size]];
+    if (cell->children == NBODY_NONE) {
+      for (uint32_t i = cell->first_mass; i != NBODY_NONE;
+           i = solver->next_mass[i]) {
+        nbody_list_add(list, solver->xs[i], solver->ys[i], solver->ms[i]);
+      }
+      continue;
+    }
+    double width = 2 * cell->half_width;
+    double distance_squared =
+        nbody_distance_squared(leaf, cell->mass_x, cell->mass_y);
+    if (!nbody_overlap(cell, leaf) &&
+        width * width < solver->theta_squared * distance_squared) {
+      nbody_list_add(list, cell->mass_x, cell->mass_y, cell->mass);
+      continue;
+    }
+    assert(stack_size + 4 <= NBODY_STACK_SIZE);
+    for (uint32_t q = 0; q < 4; q++) {
+      if (solver->cells[cell->children + q].mass > 0) {
+        stack[stack_size++] = cell->children + q;
+      }
+    }
+  }
+
+  for (uint32_t mass = leaf->first_mass; mass != NBODY_NONE;
+       mass = solver->next_mass[mass]) {
+    double x = solver->xs[mass];
+    double y = solver->ys[mass];
+    nbody_pulls(list->size, list->xs, list->ys, list->ms, x, y,
+                solver->min_squared, list->pulls);
+    double force_x = 0;
+    double force_y = 0;
+    for (size_t i = 0; i < list->size; i++) {
+      force_x += list->pulls[i] * (list->xs[i] - x);
+      force_y += list->pulls[i] * (list->ys[i] - y);
+    }
+    solver->force_xs[mass] = solver->ms[mass] * force_x;
+    solver->force_ys[mass] = solver->ms[mass] * force_y;
+  }
+}
+
+/**
+ * Lists the leaves that hold masses in the order the tree holds them, so that
+ * leaves walked one after the other are close together and walk through the
+ * same cells.
+ */
+static void nbody_find_leaves(nbody_t *solver) {
+  if (solver->leaf_capacity < solver->num_cells) {
+    solver->leaves = nbody_grow(solver->leaves,
+                                sizeof(uint32_t) * solver->cell_capacity);
+    solver->leaf_capacity = solver->cell_capacity;
+  }
+  uint32_t stack[NBODY_STACK_SIZE];
+  size_t stack_size = 0;
+  stack[stack_size++] = 0;
+  solver->num_leaves = 0;
+  while (stack_size > 0) {
+    uint32_t index = stack[--stack_size];
+    nbody_cell_t *cell = &solver->cells[index];
+    if (cell->children == NBODY_NONE) {
+      if (cell->num_masses > 0) {
+        solver->leaves[solver->num_leaves++] = index;
+      }
+      continue;
+    }
+    for (uint32_t q = 0; q < 4; q++) {
+      stack[stack_size++] = cell->children + q;
+    }
+  }
+}
+
+/**
+ * Walks one contiguous run of the leaves. Each leaf only writes the forces on
+ * its own masses, and its sums don't depend on which thread walks it, so the
+ * forces come out the same however many threads there are.
+ */
+static void nbody_walk_chunk(void *solver_ptr, size_t chunk) {
+  nbody_t *solver = solver_ptr;
+  size_t start = solver->num_leaves * chunk / solver->num_threads;
+  size_t end = solver->num_leaves * (chunk + 1) / solver->num_threads;
+  for (size_t i = start; i < end; i++) {
+    nbody_walk(solver, solver->leaves[i], &solver->lists[chunk]);
+  }
+}
+
+void nbody_forces(nbody_t *solver, size_t num_masses,
+                  const vector_t *positions, const double *masses, double G,
+                  double theta, double min_distance, vector_t *forces) {
+  assert(theta >= 0 && min_distance >= 0);
+  assert(num_masses < NBODY_NONE);
+  nbody_load(solver, num_masses, positions, masses);
+  if (theta == 0 || num_masses <= NBODY_EXACT_MAX) {
+    solver->num_cells = 0;
+    nbody_sum_exact(solver, num_masses, min_distance);
+  } else {
+    nbody_build(solver, num_masses);
+    nbody_find_leaves(solver);
+    solver->theta_squared = theta * theta;
+    solver->min_squared = min_distance * min_distance;
+    if (solver->pool != NULL) {
+      thread_pool_run(solver->pool, nbody_walk_chunk, solver,
+                      solver->num_threads);
+    } else {
+      nbody_walk_chunk(solver, 0);
+    }
+  }
+  for (size_t i = 0; i < num_masses; i++) {
+    forces[i] = (vector_t){G * solver->force_xs[i], G * solver->force_ys[i]};
+  }
+}
@@ -5,20 +5,57 @@
 #include <stdlib.h>
 
 typedef struct polygon {
-  list_t *points;
+  // Immutable outline, centered on its centroid
+  shape_t *shape;
+  // Pose: world position of the centroid and rotation about it
+  vector_t position;
+  double angle;
+  // World-space vertices, recomputed from the pose when it has changed
+  vector_t *points;
+  bool points_dirty;
+  // World-space bounding box. Translations move it along with the pose;
+  // rotations leave it to be recomputed on the next polygon_get_aabb().
+  aabb_t bounds;
+  bool bounds_dirty;
+  // World-space edge normals of a rotated polygon, allocated on first use.
+  // Unrotated polygons use their shape's normals directly.
+  vector_t *normals;
+  bool normals_dirty;
   vector_t velocity;
   double rotation_speed;
   rgb_color_t *color;
 } polygon_t;
 
-polygon_t *polygon_init(list_t *points, vector_t initial_velocity,
-                        double rotation_speed, double red, double green,
-                        double blue) {
+const size_t POLYGON_POOL_CHUNK = 64;
+
+static pool_t *POLYGON_POOL = NULL;
+
+static pool_t *polygon_pool() {
+  if (POLYGON_POOL == NULL) {
+    POLYGON_POOL = pool_init(sizeof(polygon_t), POLYGON_POOL_CHUNK);
+  }
+  return POLYGON_POOL;
+}
+
+pool_stats_t polygon_pool_stats() { return pool_get_stats(polygon_pool()); }
 
-  polygon_t *new = malloc(sizeof(polygon_t));
-  assert(new != NULL);
+pool_stats_t polygon_vertex_pool_stats() { return shape_vertex_pool_stats(); }
 
-  new->points = points;
+polygon_t *polygon_init_from_shape(shape_t *shape, vector_t position,
+                                   vector_t initial_velocity,
+                                   double rotation_speed, double red,
+                                   double green, double blue) {
+  assert(shape != NULL);
+  polygon_t *new = pool_alloc(polygon_pool());
+
+  new->shape = shape_retain(shape);
+  new->position = position;
+  new->angle = 0.0;
+  new->points = shape_alloc_vertices(shape_num_vertices(shape));
+  new->points_dirty = true;
+  new->bounds_dirty = true;
+  new->normals = NULL;
+  new->normals_dirty = true;
   new->velocity = initial_velocity;
   new->rotation_speed = rotation_speed;
   new->color = color_init(red, green, blue);
@@ -26,11 +63,124 @@ polygon_t *polygon_init(list_t *points, vector_t initial_velocity,
   return new;
 }
 
-list_t *polygon_get_points(polygon_t *polygon) {
+polygon_t *polygon_init_from_vertices(const vector_t *vertices,
+                                      size_t num_vertices,
+                                      vector_t initial_velocity,
+                                      double rotation_speed, double red,
+                                      double green, double blue) {
+  vector_t centroid;
+  shape_t *shape = shape_init(vertices, num_vertices, &centroid);
+  polygon_t *new =
+      polygon_init_from_shape(shape, centroid, initial_velocity,
+                              rotation_speed, red, green, blue);
+  shape_release(shape);
+  return new;
+}
+
+polygon_t *polygon_init(list_t *points, vector_t initial_velocity,
+                        double rotation_speed, double red, double green,
+                        double blue) {
+  assert(points != NULL);
+  size_t size = list_size(points);
+  vector_t *vertices = malloc(sizeof(vector_t) * size);
+  assert(size == 0 || vertices != NULL);
+  for (size_t i = 0; i < size; i++) {
+    vertices[i] = *(vector_t *)list_get(points, i);
+  }
+  polygon_t *new =
+      polygon_init_from_vertices(vertices, size, initial_velocity,
+                                 rotation_speed, red, green, blue);
+  free(vertices);
+  list_free(points);
+  return new;
+}
+
+const vector_t *polygon_get_vertices(polygon_t *polygon) {
   assert(polygon != NULL);
+  if (polygon->points_dirty) {
+    const vector_t *local = shape_get_vertices(polygon->shape);
+    size_t size = shape_num_vertices(polygon->shape);
+    double cos_angle = cos(polygon->angle);
+    double sin_angle = sin(polygon->angle);
+    vector_t position = polygon->position;
+    for (size_t i = 0; i < size; i++) {
+      vector_t v = local[i];
+      polygon->points[i] =
+          (vector_t){position.x + v.x * cos_angle - v.y * sin_angle,
+                     position.y + v.x * sin_angle + v.y * cos_angle};
+    }
+    polygon->points_dirty = false;
+  }
   return polygon->points;
 }
 
+size_t polygon_num_vertices(polygon_t *polygon) {
+  assert(polygon != NULL);
+  return shape_num_vertices(polygon->shape);
+}
+
+aabb_t polygon_get_aabb(polygon_t *polygon) {
+  assert(polygon != NULL);
+  if (polygon->bounds_dirty) {
+    shape_kind_t kind = shape_get_kind(polygon->shape);
+    if (polygon->angle == 0 || kind == SHAPE_CIRCLE) {
+      polygon->bounds =
+          aabb_translate(shape_get_aabb(polygon->shape), polygon->position);
+    } else if (kind == SHAPE_CAPSULE) {
+      // The tessellated ends fall inside the true outline, so bound the core
+      // segment and grow it by the radius instead
+      double radius = shape_get_round_radius(polygon->shape);
+      vector_t half = vec_rotate(
+          (vector_t){shape_get_half_length(polygon->shape), 0}, polygon->angle);
+      vector_t ends[2] = {vec_add(polygon->position, half),
+                          vec_subtract(polygon->position, half)};
+      aabb_t core = aabb_of_points(ends, 2);
+      polygon->bounds =
+          (aabb_t){vec_subtract(core.min, (vector_t){radius, radius}),
+                   vec_add(core.max, (vector_t){radius, radius})};
+    } else {
+      polygon->bounds = aabb_of_points(polygon_get_vertices(polygon),
+                                       polygon_num_vertices(polygon));
+    }
+    polygon->bounds_dirty = false;
+  }
+  return polygon->bounds;
+}
+
+const vector_t *polygon_get_normals(polygon_t *polygon) {
+  assert(polygon != NULL);
+  if (polygon->angle == 0) {
+    return shape_get_normals(polygon->shape);
+  }
+  size_t size = shape_num_vertices(polygon->shape);
+  if (polygon->normals == NULL) {
+    polygon->normals = shape_alloc_vertices(size);
+  }
+  if (polygon->normals_dirty) {
+    const vector_t *local = shape_get_normals(polygon->shape);
+    double cos_angle = cos(polygon->angle);
+    double sin_angle = sin(polygon->angle);
+    for (size_t i = 0; i < size; i++) {
+      vector_t n = local[i];
+      polygon->normals[i] = (vector_t){n.x * cos_angle - n.y * sin_angle,
+                                       n.x * sin_angle + n.y * cos_angle};
+    }
+    polygon->normals_dirty = false;
+  }
+  return polygon->normals;
+}
+
+void polygon_refresh(polygon_t *polygon) {
+  polygon_get_vertices(polygon);
+  polygon_get_normals(polygon);
+  polygon_get_aabb(polygon);
+}
+
+shape_t *polygon_get_shape(polygon_t *polygon) {
+  assert(polygon != NULL);
+  return polygon->shape;
+}
+
 void polygon_move(polygon_t *polygon, double time_elapsed) {
   assert(polygon != NULL);
 
@@ -38,8 +188,7 @@ void polygon_move(polygon_t *polygon, double time_elapsed) {
   polygon_translate(polygon, translate);
 
   double angle = polygon->rotation_speed * time_elapsed;
-  vector_t centroid = polygon_centroid(polygon);
-  polygon_rotate(polygon, angle, centroid);
+  polygon_rotate(polygon, angle, polygon->position);
 }
 
 void polygon_set_velocity(polygon_t *polygon, vector_t vel) {
@@ -49,9 +198,13 @@ void polygon_set_velocity(polygon_t *polygon, vector_t vel) {
 
 void polygon_free(polygon_t *polygon) {
   assert(polygon != NULL);
-  list_free(polygon->points);
+  shape_free_vertices(polygon->points, shape_num_vertices(polygon->shape));
+  if (polygon->normals != NULL) {
+    shape_free_vertices(polygon->normals, shape_num_vertices(polygon->shape));
+  }
+  shape_release(polygon->shape);
   color_free(polygon->color);
-  free(polygon);
+  pool_release(polygon_pool(), polygon);
 }
 
 vector_t *polygon_get_velocity(polygon_t *polygon) {
@@ -61,62 +214,34 @@ vector_t *polygon_get_velocity(polygon_t *polygon) {
 
 double polygon_area(polygon_t *polygon) {
   assert(polygon != NULL);
-
-  double area = 0.0;
-  size_t size = list_size(polygon->points);
-
-  if (size < 3) {
-    return area;
-  }
-
-  for (size_t i = 0; i < size; i++) {
-    vector_t area1 = *(vector_t *)list_get(polygon->points, i);
-    vector_t area2 = *(vector_t *)list_get(polygon->points, (i + 1) % size);
-    area += area1.x * area2.y - area2.x * area1.y;
-  }
-  area = fabs(area) / 2.0;
-  return area;
+  return shape_area(polygon->shape);
 }
 
 vector_t polygon_centroid(polygon_t *polygon) {
   assert(polygon != NULL);
-
-  vector_t centroid = (vector_t){.x = 0.0, .y = 0.0};
-  size_t size = list_size(polygon->points);
-  double area = polygon_area(polygon);
-  for (size_t i = 0; i < size; i++) {
-    vector_t vec1 = *((vector_t *)(list_get(polygon->points, i)));
-    vector_t vec2 = *((vector_t *)(list_get(polygon->points, (i + 1) % size)));
-    centroid.x += (vec1.x + vec2.x) * vec_cross(vec1, vec2);
-    centroid.y += (vec1.y + vec2.y) * vec_cross(vec1, vec2);
-  }
-
-  return vec_multiply(1 / (6.0 * area), centroid);
+  return polygon->position;
 }
 
 void polygon_translate(polygon_t *polygon, vector_t translation) {
   assert(polygon != NULL);
-
-  list_t *points = polygon_get_points(polygon);
-  size_t size = list_size(points);
-  for (size_t i = 0; i < size; i++) {
-    vector_t *point = list_get(points, i);
-    *point = vec_add(*point, translation);
+  polygon->position = vec_add(polygon->position, translation);
+  polygon->points_dirty = true;
+  if (!polygon->bounds_dirty) {
+    polygon->bounds = aabb_translate(polygon->bounds, translation);
   }
 }
 
 void polygon_rotate(polygon_t *polygon, double angle, vector_t point) {
   assert(polygon != NULL);
-
-  list_t *points = polygon->points;
-  size_t size = list_size(points);
-
-  for (size_t i = 0; i < size; i++) {
-    vector_t *vec = list_get(points, i);
-    vector_t translated = vec_subtract(*vec, point);
-    vector_t rotated = vec_rotate(translated, angle);
-    *vec = vec_add(rotated, point);
+  if (angle == 0) {
+    return;
   }
+  vector_t offset = vec_subtract(polygon->position, point);
+  polygon->position = vec_add(point, vec_rotate(offset, angle));
+  polygon->angle += angle;
+  polygon->points_dirty = true;
+  polygon->bounds_dirty = true;
+  polygon->normals_dirty = true;
 }
 
 rgb_color_t *polygon_get_color(polygon_t *polygon) {
@@ -129,19 +254,18 @@ void polygon_set_color(polygon_t *polygon, rgb_color_t *color) {
 }
 
 void polygon_set_center(polygon_t *polygon, vector_t centroid) {
-  vector_t center = polygon_get_center(polygon);
-  polygon_translate(polygon, vec_subtract(centroid, center));
+  polygon_translate(polygon, vec_subtract(centroid, polygon->position));
+  // Land exactly on the centroid, whatever the rounding in the translation
+  polygon->position = centroid;
 }
 
-vector_t polygon_get_center(polygon_t *polygon) {
-  return polygon_centroid(polygon);
-}
+vector_t polygon_get_center(polygon_t *polygon) { return polygon->position; }
 
 void polygon_set_rotation(polygon_t *polygon, double rot) {
-  polygon_rotate(polygon, rot - polygon->rotation_speed,
-                 polygon_get_center(polygon));
+  polygon->angle = rot;
+  polygon->points_dirty = true;
+  polygon->bounds_dirty = true;
+  polygon->normals_dirty = true;
 }
 
-double polygon_get_rotation(polygon_t *polygon) {
-  return polygon->rotation_speed;
-}
+double polygon_get_rotation(polygon_t *polygon) { return polygon->angle; }
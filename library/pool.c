@@ -0,0 +1,101 @@
+#include "pool.h"
+#include "list.h"
+#include <assert.h>
+#include <stdalign.h>
+#include <stdlib.h>
+
+const size_t POOL_ALIGNMENT = alignof(max_align_t);
+const size_t INITIAL_NUM_CHUNKS = 4;
+
+// A released block stores the link to the next free block in its own memory
+typedef struct free_block {
+  struct free_block *next;
+} free_block_t;
+
+struct pool {
+  size_t block_size;
+  size_t blocks_per_chunk;
+  list_t *chunks;
+  free_block_t *free_list;
+  size_t in_use;
+  size_t peak_in_use;
+};
+
+pool_t *pool_init(size_t block_size, size_t blocks_per_chunk) {
+  assert(blocks_per_chunk > 0);
+  pool_t *pool = malloc(sizeof(pool_t));
+  assert(pool != NULL);
+  if (block_size < sizeof(free_block_t)) {
+    block_size = sizeof(free_block_t);
+  }
+  pool->block_size =
+      (block_size + POOL_ALIGNMENT - 1) / POOL_ALIGNMENT * POOL_ALIGNMENT;
+  pool->blocks_per_chunk = blocks_per_chunk;
+  pool->chunks = list_init(INITIAL_NUM_CHUNKS, free);
+  pool->free_list = NULL;
+  pool->in_use = 0;
+  pool->peak_in_use = 0;
+  return pool;
+}
+
+void pool_free(pool_t *pool) {
+  list_free(pool->chunks);
+  free(pool);
+}
+
+/**
+ * Allocates a new chunk and threads all of its blocks onto the free list.
+ */
+static void pool_grow(pool_t *pool) {
+  char *chunk = malloc(pool->block_size * pool->blocks_per_chunk);
+  assert(chunk != NULL);
+  list_add(pool->chunks, chunk);
+  for (size_t i = pool->blocks_per_chunk; i > 0; i--) {
+    free_block_t *block = (free_block_t *)(chunk + (i - 1) * pool->block_size);
+    block->next = pool->free_list;
+    pool->free_list = block;
+  }
+}
+
+void *pool_alloc(pool_t *pool) {
+  if (pool->free_list == NULL) {
+    pool_grow(pool);
+  }
+  free_block_t *block = pool->free_list;
+  pool->free_list = block->next;
+  pool->in_use++;
+  if (pool->in_use > pool->peak_in_use) {
+    pool->peak_in_use = pool->in_use;
+  }
+  return block;
+}
+
+void pool_release(pool_t *pool, void *block) {
+  if (block == NULL) {
+    return;
+  }
+  assert(pool->in_use > 0);
+  free_block_t *free_block = block;
+  free_block->next = pool->free_list;
+  pool->free_list = free_block;
+  pool->in_use--;
+}
+
+pool_stats_t pool_get_stats(pool_t *pool) {
+  size_t num_chunks = list_size(pool->chunks);
+  return (pool_stats_t){.block_size = pool->block_size,
+                        .in_use = pool->in_use,
+                        .peak_in_use = pool->peak_in_use,
+                        .capacity = num_chunks * pool->blocks_per_chunk,
+                        .num_chunks = num_chunks};
+}
+
+void pool_stats_add(pool_stats_t *total, pool_stats_t stats) {
+  if (total->block_size != stats.block_size) {
+    total->block_size = 0;
+  }
+  total->in_use += stats.in_use;
+  total->peak_in_use += stats.peak_in_use;
+  total->capacity += stats.capacity;
+  total->num_chunks += stats.num_chunks;
+}
@@ -1,24 +1,185 @@
 #include <assert.h>
+#include <math.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include "aabb_tree.h"
+#include "broadphase.h"
+#include "collision.h"
 #include "forces.h"
 #include "scene.h"
+#include "thread_pool.h"
 
 const double BODY_NUMBER = 10;
 const double AUX_NUMBER = 20;
+// A handle packs a slot index in its low bits and the slot's generation in
+// its high bits. Generation 0 is never used, so 0 is never a valid handle.
+const uint32_t HANDLE_INDEX_BITS = 20;
+const uint32_t HANDLE_INDEX_MASK = (1u << 20) - 1;
+const uint32_t HANDLE_MAX_GENERATION = (1u << 12) - 1;
+const uint32_t NO_FREE_SLOT = UINT32_MAX;
+// How far bodies can move before the spatial index has to be updated
+const double SCENE_TREE_MARGIN = 4;
+// How far past the first touch a swept body is left, so that the contact
+// stage reports the hit
+const double SWEEP_OVERLAP = 0.5;
+const size_t MIN_PAIR_INDEX_CAPACITY = 16;
+// Fibonacci hashing spreads the pair keys over the index
+const uint64_t PAIR_HASH_MULTIPLIER = 11400714819323198485ull;
 
-struct scene {
-  ssize_t num_bodies;
+typedef struct force_creator_info force_creator_info_t;
+
+// A node in the list of force creators acting on a body. Each force creator
+// has one node per body it was registered with.
+typedef struct force_ref {
+  force_creator_info_t *info;
+  // The handle of the body whose list this node is in, or 0 if the body
+  // wasn't in the scene yet, in which case the node is in the scene's
+  // pending_refs until the body is added
+  body_handle_t handle;
+  struct force_ref *prev;
+  struct force_ref *next;
+} force_ref_t;
+
+struct force_creator_info {
+  force_creator_t force_creator;
+  void *aux;
+  // If NULL, aux is a body_aux_t
+  free_func_t aux_freer;
   list_t *bodies;
-  list_t *force_creators;
+  force_ref_t *refs;
+  // The creator's position in the scene's force_creators
+  size_t index;
+  // How many of its bodies are awake. Bodies that aren't in the scene count
+  // as awake, and so does a creator with no bodies at all.
+  size_t num_awake;
 };
 
 typedef struct {
-  force_creator_t force_creator;
+  body_t *body;
+  uint32_t generation;
+  uint32_t next_free;
+  // The body's proxy in the scene's spatial index
+  size_t proxy;
+  // The force creators registered with the body
+  force_ref_t *force_refs;
+  // How many steps the body is ticked in; see scene_set_substeps()
+  size_t substeps;
+  // The last tick the body was looked at when looking for islands to sleep
+  size_t island_stamp;
+  // The last tick the body was moved to a store
+  size_t placed_tick;
+  void *data[SCENE_HANDLE_DATA_SLOTS];
+} handle_slot_t;
+
+// A handler subscribed to a pair's contact events
+typedef struct {
+  contact_handler_t handler;
   void *aux;
+  free_func_t aux_freer;
+  // Whether the handler takes the pair's bodies the other way round
+  bool swapped;
+  // Whether the handler has been told the bodies are touching
+  bool touching;
+} contact_handler_info_t;
+
+// A handler for the contacts between two categories of bodies
+typedef struct {
+  uint32_t category1;
+  uint32_t category2;
+  contact_handler_t handler;
+  void *aux;
+  free_func_t aux_freer;
+} type_handler_t;
+
+// The cache entry for a pair of bodies, ordered by handle
+typedef struct {
+  body_t *body1;
+  body_t *body2;
+  uint64_t key;
+  vector_t separating_axis;
+  list_t *handlers;
+  // Whether the type handlers have been told the bodies are touching
+  bool touching;
+  // Whether the broadphase found the pair on this tick
+  bool seen;
+  // The tick the pair was last tested on (0 if never), and what it found.
+  // Idle bodies don't move, so pairs of them aren't tested again.
+  size_t tested_tick;
+  collision_info_t collision;
+} contact_pair_t;
+
+// Where a fast body was at the start of the current tick
+typedef struct {
+  body_t *body;
+  vector_t start;
+} sweep_t;
+
+// What a chunk of force creators applied to one body on a parallel tick.
+// Kept together so that applying both touches one cache line.
+typedef struct {
+  vector_t force;
+  vector_t impulse;
+} applied_force_t;
+
+// The forces and impulses one chunk of force creators applied on a parallel
+// tick, indexed by handle slot
+typedef struct {
+  applied_force_t *applied;
+  size_t capacity;
+} force_buffer_t;
+
+struct scene {
+  ssize_t num_bodies;
   list_t *bodies;
-} force_creator_info_t;
+  // The bodies' per-tick state, in the order it is integrated
+  body_store_t *store;
+  // The same for the bodies ticked in several steps, which are integrated
+  // one at a time
+  body_store_t *substep_store;
+  // The same for the sleeping and static bodies, which aren't ticked
+  body_store_t *idle_store;
+  integrator_t integrator;
+  // Force creators with an awake body come first, and only they are run
+  size_t num_active_creators;
+  // See scene_set_sleep(); bodies don't sleep if sleep_ticks is 0
+  uint32_t sleep_ticks;
+  double sleep_speed;
+  size_t num_ticks;
+  // Scratch lists of bodies, for waking and sleeping them
+  list_t *touched;
+  list_t *island;
+  list_t *sleepers;
+  list_t *force_creators;
+  // The force refs of bodies that weren't in the scene when their force
+  // creators were added, linked through prev and next
+  force_ref_t *pending_refs;
+  handle_slot_t *slots;
+  uint32_t num_slots;
+  uint32_t slot_capacity;
+  uint32_t free_slot;
+  aabb_tree_t *tree;
+  broadphase_t *broadphase;
+  list_t *type_handlers;
+  list_t *contact_pairs;
+  // Open-addressed hash of pair keys to positions in contact_pairs, plus 1;
+  // 0 marks an empty bucket. Its capacity is a power of 2.
+  size_t *pair_index;
+  size_t pair_index_capacity;
+  sweep_t *sweeps;
+  size_t num_sweeps;
+  size_t sweep_capacity;
+  force_field_t *fields;
+  size_t num_fields;
+  size_t field_capacity;
+  // Set by scene_set_threads(); NULL when ticks run on the calling thread
+  thread_pool_t *pool;
+  // One buffer per chunk of force creators, and so per thread
+  force_buffer_t *force_buffers;
+  size_t num_threads;
+};
 
 force_creator_info_t *force_creator_info_init(force_creator_t force_creator,
                                               void *aux, list_t *bodies) {
@@ -27,15 +188,42 @@ force_creator_info_t *force_creator_info_init(force_creator_t force_creator,
 
   result->force_creator = force_creator;
   result->aux = aux;
+  result->aux_freer = NULL;
   result->bodies = bodies;
+  result->refs = malloc(sizeof(force_ref_t) * list_size(bodies));
+  assert(result->refs != NULL || list_size(bodies) == 0);
   return result;
 }
 
+static void contact_handler_info_free(contact_handler_info_t *info) {
+  if (info->aux_freer != NULL) {
+    info->aux_freer(info->aux);
+  }
+  free(info);
+}
+
+static void type_handler_free(type_handler_t *info) {
+  if (info->aux_freer != NULL) {
+    info->aux_freer(info->aux);
+  }
+  free(info);
+}
+
+static void contact_pair_free(contact_pair_t *pair) {
+  list_free(pair->handlers);
+  free(pair);
+}
+
 void force_creator_info_free(force_creator_info_t *force_info) {
   list_free(force_info->bodies);
-  list_t *bodies_aux = ((body_aux_t *)force_info->aux)->bodies;
-  list_free(bodies_aux);
-  free(force_info->aux);
+  free(force_info->refs);
+  if (force_info->aux_freer != NULL) {
+    force_info->aux_freer(force_info->aux);
+  } else {
+    list_t *bodies_aux = ((body_aux_t *)force_info->aux)->bodies;
+    list_free(bodies_aux);
+    free(force_info->aux);
+  }
   free(force_info);
 }
 
@@ -44,26 +232,248 @@ scene_t *scene_init(void) {
   assert(scene != NULL);
   scene->bodies = list_init(BODY_NUMBER, (free_func_t)body_free);
   scene->num_bodies = 0;
+  scene->store = body_store_init();
+  scene->substep_store = body_store_init();
+  scene->idle_store = body_store_init();
+  scene->integrator = INTEGRATOR_TRAPEZOIDAL;
+  scene->num_active_creators = 0;
+  scene->sleep_ticks = 0;
+  scene->sleep_speed = 0;
+  scene->num_ticks = 0;
+  scene->touched = list_init(BODY_NUMBER, NULL);
+  scene->island = list_init(BODY_NUMBER, NULL);
+  scene->sleepers = list_init(BODY_NUMBER, NULL);
   scene->force_creators =
       list_init(AUX_NUMBER, (free_func_t)force_creator_info_free);
+  scene->pending_refs = NULL;
+  scene->slots = NULL;
+  scene->num_slots = 0;
+  scene->slot_capacity = 0;
+  scene->free_slot = NO_FREE_SLOT;
+  scene->tree = aabb_tree_init(SCENE_TREE_MARGIN);
+  scene->broadphase = broadphase_init(BROADPHASE_SWEEP, 0);
+  scene->type_handlers = list_init(1, (free_func_t)type_handler_free);
+  scene->contact_pairs = list_init(AUX_NUMBER, (free_func_t)contact_pair_free);
+  scene->pair_index = NULL;
+  scene->pair_index_capacity = 0;
+  scene->sweeps = NULL;
+  scene->num_sweeps = 0;
+  scene->sweep_capacity = 0;
+  scene->fields = NULL;
+  scene->num_fields = 0;
+  scene->field_capacity = 0;
+  scene->pool = NULL;
+  scene->force_buffers = NULL;
+  scene->num_threads = 1;
   return scene;
 }
 
 void scene_free(scene_t *scene) {
   list_free(scene->bodies);
+  body_store_free(scene->store);
+  body_store_free(scene->substep_store);
+  body_store_free(scene->idle_store);
+  list_free(scene->touched);
+  list_free(scene->island);
+  list_free(scene->sleepers);
   list_free(scene->force_creators);
+  free(scene->slots);
+  aabb_tree_free(scene->tree);
+  broadphase_free(scene->broadphase);
+  list_free(scene->type_handlers);
+  list_free(scene->contact_pairs);
+  free(scene->pair_index);
+  free(scene->sweeps);
+  free(scene->fields);
+  scene_set_threads(scene, 1);
   free(scene);
 }
 
+/**
+ * Returns the slot a handle refers to, or NULL if the handle is stale.
+ */
+static handle_slot_t *scene_get_slot(scene_t *scene, body_handle_t handle) {
+  uint32_t index = handle & HANDLE_INDEX_MASK;
+  uint32_t generation = handle >> HANDLE_INDEX_BITS;
+  if (index >= scene->num_slots) {
+    return NULL;
+  }
+  handle_slot_t *slot = &scene->slots[index];
+  if (slot->body == NULL || slot->generation != generation) {
+    return NULL;
+  }
+  return slot;
+}
+
+static body_handle_t scene_acquire_handle(scene_t *scene, body_t *body) {
+  uint32_t index;
+  if (scene->free_slot != NO_FREE_SLOT) {
+    index = scene->free_slot;
+    scene->free_slot = scene->slots[index].next_free;
+  } else {
+    assert(scene->num_slots <= HANDLE_INDEX_MASK);
+    if (scene->num_slots == scene->slot_capacity) {
+      scene->slot_capacity =
+          scene->slot_capacity > 0 ? scene->slot_capacity * 2 : BODY_NUMBER;
+      scene->slots = realloc(scene->slots,
+                             sizeof(handle_slot_t) * scene->slot_capacity);
+      assert(scene->slots != NULL);
+    }
+    index = scene->num_slots++;
+    scene->slots[index].generation = 1;
+  }
+  handle_slot_t *slot = &scene->slots[index];
+  slot->body = body;
+  slot->next_free = NO_FREE_SLOT;
+  slot->force_refs = NULL;
+  slot->substeps = 1;
+  slot->island_stamp = 0;
+  slot->placed_tick = 0;
+  for (size_t i = 0; i < SCENE_HANDLE_DATA_SLOTS; i++) {
+    slot->data[i] = NULL;
+  }
+  return (slot->generation << HANDLE_INDEX_BITS) | index;
+}
+
+/**
+ * Invalidates a handle and returns its slot to the free list.
+ * The slot's generation is bumped so outstanding copies of the handle
+ * no longer resolve.
+ */
+static void scene_release_handle(scene_t *scene, body_handle_t handle) {
+  handle_slot_t *slot = scene_get_slot(scene, handle);
+  if (slot == NULL) {
+    return;
+  }
+  aabb_tree_remove(scene->tree, slot->proxy);
+  slot->body = NULL;
+  slot->generation = slot->generation == HANDLE_MAX_GENERATION
+                         ? 1
+                         : slot->generation + 1;
+  slot->next_free = scene->free_slot;
+  scene->free_slot = handle & HANDLE_INDEX_MASK;
+}
+
+static void scene_swap_creators(scene_t *scene, size_t index1,
+                                size_t index2) {
+  force_creator_info_t *info1 = list_get(scene->force_creators, index1);
+  force_creator_info_t *info2 = list_get(scene->force_creators, index2);
+  list_swap(scene->force_creators, index1, index2);
+  info1->index = index2;
+  info2->index = index1;
+}
+
+/**
+ * Changes the number of awake bodies a force creator has, moving it in or
+ * out of the creators that run.
+ */
+static void scene_count_awake(scene_t *scene, force_creator_info_t *info,
+                              int change) {
+  info->num_awake += change;
+  if (change > 0 && info->num_awake == 1) {
+    scene_swap_creators(scene, info->index, scene->num_active_creators++);
+  } else if (change < 0 && info->num_awake == 0) {
+    scene_swap_creators(scene, info->index, --scene->num_active_creators);
+  }
+}
+
+static bool scene_is_idle(scene_t *scene, body_t *body) {
+  return body_get_store(body) == scene->idle_store;
+}
+
+/**
+ * Moves a body to the store it belongs in, keeping the force creators that
+ * run up to date. Waking a body wakes every sleeping body it shares a force
+ * creator with, through the touched list, so islands wake together.
+ */
+static void scene_place_body(scene_t *scene, body_t *body) {
+  handle_slot_t *slot = scene_get_slot(scene, body_get_handle(body));
+  bool idle = body_get_type(body) == BODY_TYPE_STATIC ||
+              body_is_sleeping(body);
+  body_store_t *store = idle                 ? scene->idle_store
+                        : slot->substeps > 1 ? scene->substep_store
+                                             : scene->store;
+  bool was_idle = scene_is_idle(scene, body);
+  body_store_add(store, body);
+  slot->placed_tick = scene->num_ticks;
+  if (idle) {
+    // It may have been moved while it was idle
+    aabb_tree_move(scene->tree, slot->proxy, body_get_aabb(body));
+  }
+  if (idle == was_idle) {
+    return;
+  }
+  for (force_ref_t *ref = slot->force_refs; ref != NULL; ref = ref->next) {
+    scene_count_awake(scene, ref->info, idle ? -1 : 1);
+    if (idle) {
+      continue;
+    }
+    for (size_t i = 0; i < list_size(ref->info->bodies); i++) {
+      body_t *other = list_get(ref->info->bodies, i);
+      if (scene_get_slot(scene, body_get_handle(other)) != NULL &&
+          body_is_sleeping(other)) {
+        body_wake(other);
+        list_add(scene->touched, other);
+      }
+    }
+  }
+}
+
+/**
+ * Places every body that was woken, put to sleep or changed type since the
+ * last time.
+ */
+static void scene_place_touched(scene_t *scene) {
+  body_store_t *stores[] = {scene->store, scene->substep_store,
+                            scene->idle_store};
+  for (size_t i = 0; i < sizeof(stores) / sizeof(stores[0]); i++) {
+    body_store_take_touched(stores[i], scene->touched);
+  }
+  while (list_size(scene->touched) > 0) {
+    body_t *body =
+        list_remove(scene->touched, list_size(scene->touched) - 1);
+    scene_place_body(scene, body);
+  }
+}
+
+body_t *scene_resolve_body(scene_t *scene, body_handle_t handle) {
+  handle_slot_t *slot = scene_get_slot(scene, handle);
+  return slot != NULL ? slot->body : NULL;
+}
+
+void scene_set_handle_data(scene_t *scene, body_handle_t handle, size_t key,
+                           void *data) {
+  assert(key < SCENE_HANDLE_DATA_SLOTS);
+  handle_slot_t *slot = scene_get_slot(scene, handle);
+  if (slot != NULL) {
+    slot->data[key] = data;
+  }
+}
+
+void *scene_get_handle_data(scene_t *scene, body_handle_t handle, size_t key) {
+  assert(key < SCENE_HANDLE_DATA_SLOTS);
+  handle_slot_t *slot = scene_get_slot(scene, handle);
+  return slot != NULL ? slot->data[key] : NULL;
+}
+
 size_t scene_bodies(scene_t *scene) { return scene->num_bodies; }
 
 body_t *scene_get_body(scene_t *scene, size_t index) {
   return list_get(scene->bodies, index);
 }
 
-void scene_add_body(scene_t *scene, body_t *body) {
+body_handle_t scene_add_body(scene_t *scene, body_t *body) {
+  // Start out active, so placing the body counts it as going idle if it is
+  body_store_add(scene->store, body);
   list_add(scene->bodies, body);
   scene->num_bodies++;
+  body_handle_t handle = scene_acquire_handle(scene, body);
+  body_set_handle(body, handle);
+  scene_get_slot(scene, handle)->proxy =
+      aabb_tree_insert(scene->tree, body_get_aabb(body), body);
+  broadphase_add(scene->broadphase, body, body);
+  scene_place_body(scene, body);
+  return handle;
 }
 
 void scene_remove_body(scene_t *scene, size_t index) {
@@ -78,37 +488,1029 @@ void scene_add_force_creator(scene_t *scene, force_creator_t force_creator,
 
 void scene_add_bodies_force_creator(scene_t *scene, force_creator_t forcer,
                                     void *aux, list_t *bodies) {
+  scene_add_owned_force_creator(scene, forcer, aux, bodies, NULL);
+}
+
+/**
+ * Pushes a force ref onto the front of a list, given by its head.
+ */
+static void force_ref_push(force_ref_t **head, force_ref_t *ref) {
+  ref->prev = NULL;
+  ref->next = *head;
+  if (ref->next != NULL) {
+    ref->next->prev = ref;
+  }
+  *head = ref;
+}
+
+/**
+ * Takes a force ref out of the list it is in: its body's, or the scene's
+ * pending refs.
+ */
+static void scene_unlink_ref(scene_t *scene, force_ref_t *ref) {
+  if (ref->prev != NULL) {
+    ref->prev->next = ref->next;
+  } else if (ref->handle != 0) {
+    scene_get_slot(scene, ref->handle)->force_refs = ref->next;
+  } else {
+    scene->pending_refs = ref->next;
+  }
+  if (ref->next != NULL) {
+    ref->next->prev = ref->prev;
+  }
+  ref->prev = NULL;
+  ref->next = NULL;
+}
+
+/**
+ * Links the pending force refs of bodies that have since been added to the
+ * scene into their bodies' lists, so that removing the bodies drops their
+ * force creators. Done in one pass per tick, rather than on every
+ * scene_add_body(), so that adding many bodies stays linear.
+ */
+static void scene_link_pending_refs(scene_t *scene) {
+  force_ref_t *ref = scene->pending_refs;
+  while (ref != NULL) {
+    force_ref_t *next = ref->next;
+    force_creator_info_t *info = ref->info;
+    body_t *body = list_get(info->bodies, ref - info->refs);
+    body_handle_t handle = body_get_handle(body);
+    handle_slot_t *slot = scene_get_slot(scene, handle);
+    if (slot != NULL && slot->body == body) {
+      scene_unlink_ref(scene, ref);
+      ref->handle = handle;
+      force_ref_push(&slot->force_refs, ref);
+      // It counted as awake while it wasn't in the scene
+      if (scene_is_idle(scene, body)) {
+        scene_count_awake(scene, info, -1);
+      }
+    }
+    ref = next;
+  }
+}
+
+void scene_add_owned_force_creator(scene_t *scene, force_creator_t forcer,
+                                   void *aux, list_t *bodies,
+                                   free_func_t aux_freer) {
   force_creator_info_t *info = force_creator_info_init(forcer, aux, bodies);
+  info->aux_freer = aux_freer;
+  info->index = list_size(scene->force_creators);
+  info->num_awake = 0;
   list_add(scene->force_creators, info);
+  scene_count_awake(scene, info, list_size(bodies) > 0 ? 0 : 1);
+  for (size_t i = 0; i < list_size(bodies); i++) {
+    force_ref_t *ref = &info->refs[i];
+    ref->info = info;
+    body_t *body = list_get(bodies, i);
+    body_handle_t handle = body_get_handle(body);
+    handle_slot_t *slot = scene_get_slot(scene, handle);
+    if (slot == NULL || slot->body != body) {
+      // Linked by the first tick after the body is added
+      ref->handle = 0;
+      force_ref_push(&scene->pending_refs, ref);
+      scene_count_awake(scene, info, 1);
+      continue;
+    }
+    if (!scene_is_idle(scene, body)) {
+      scene_count_awake(scene, info, 1);
+    }
+    ref->handle = handle;
+    force_ref_push(&slot->force_refs, ref);
+  }
 }
 
-void scene_tick(scene_t *scene, double dt) {
-  for (size_t j = 0; j < list_size(scene->force_creators); j++) {
+/**
+ * Takes a force creator out of the scene, unlinking it from the lists of all
+ * its bodies. Moves the last force creator into its place.
+ */
+static void scene_drop_force_creator(scene_t *scene,
+                                     force_creator_info_t *info) {
+  for (size_t i = 0; i < list_size(info->bodies); i++) {
+    scene_unlink_ref(scene, &info->refs[i]);
+    info->refs[i].handle = 0;
+  }
+  if (info->num_awake > 0) {
+    info->num_awake = 1;
+    scene_count_awake(scene, info, -1);
+  }
+  list_swap_remove(scene->force_creators, info->index);
+  if (info->index < list_size(scene->force_creators)) {
+    force_creator_info_t *moved = list_get(scene->force_creators, info->index);
+    moved->index = info->index;
+  }
+  force_creator_info_free(info);
+}
+
+static uint64_t contact_key(body_handle_t handle1, body_handle_t handle2) {
+  return (uint64_t)handle1 << 32 | handle2;
+}
+
+static size_t pair_bucket(scene_t *scene, uint64_t key) {
+  return (size_t)((key * PAIR_HASH_MULTIPLIER) >> 32) &
+         (scene->pair_index_capacity - 1);
+}
+
+/**
+ * Rebuilds the pair index from scratch, with room for the pairs to double.
+ * Done whenever pairs are removed, which is simpler than leaving tombstones.
+ */
+static void scene_rebuild_pair_index(scene_t *scene) {
+  size_t num_pairs = list_size(scene->contact_pairs);
+  size_t capacity = MIN_PAIR_INDEX_CAPACITY;
+  while (capacity < 4 * num_pairs) {
+    capacity *= 2;
+  }
+  if (capacity != scene->pair_index_capacity) {
+    free(scene->pair_index);
+    scene->pair_index = malloc(sizeof(size_t) * capacity);
+    assert(scene->pair_index != NULL);
+    scene->pair_index_capacity = capacity;
+  }
+  for (size_t i = 0; i < capacity; i++) {
+    scene->pair_index[i] = 0;
+  }
+  for (size_t i = 0; i < num_pairs; i++) {
+    contact_pair_t *pair = list_get(scene->contact_pairs, i);
+    size_t bucket = pair_bucket(scene, pair->key);
+    while (scene->pair_index[bucket] != 0) {
+      bucket = (bucket + 1) & (capacity - 1);
+    }
+    scene->pair_index[bucket] = i + 1;
+  }
+}
+
+/**
+ * Finds the cache entry for a pair of bodies, creating it if there is none.
+ */
+static contact_pair_t *scene_get_pair(scene_t *scene, body_t *body1,
+                                      body_t *body2) {
+  if (scene->pair_index == NULL) {
+    scene_rebuild_pair_index(scene);
+  }
+  uint64_t key = contact_key(body_get_handle(body1), body_get_handle(body2));
+  size_t mask = scene->pair_index_capacity - 1;
+  size_t bucket = pair_bucket(scene, key);
+  for (; scene->pair_index[bucket] != 0; bucket = (bucket + 1) & mask) {
+    contact_pair_t *pair =
+        list_get(scene->contact_pairs, scene->pair_index[bucket] - 1);
+    if (pair->key == key) {
+      return pair;
+    }
+  }
+
+  contact_pair_t *pair = malloc(sizeof(contact_pair_t));
+  assert(pair != NULL);
+  *pair = (contact_pair_t){
+      .body1 = body1,
+      .body2 = body2,
+      .key = key,
+      .separating_axis = VEC_ZERO,
+      .handlers = list_init(1, (free_func_t)contact_handler_info_free),
+      .touching = false,
+      .seen = false,
+      .tested_tick = 0};
+  list_add(scene->contact_pairs, pair);
+  scene->pair_index[bucket] = list_size(scene->contact_pairs);
+  // Keep the index at most half full, so probe runs stay short
+  if (2 * list_size(scene->contact_pairs) > scene->pair_index_capacity) {
+    scene_rebuild_pair_index(scene);
+  }
+  return pair;
+}
+
+void scene_add_contact_handler(scene_t *scene, body_t *body1, body_t *body2,
+                               contact_handler_t handler, void *aux,
+                               free_func_t aux_freer) {
+  assert(scene_get_slot(scene, body_get_handle(body1)) != NULL);
+  assert(scene_get_slot(scene, body_get_handle(body2)) != NULL);
+  bool swapped = body_get_handle(body1) > body_get_handle(body2);
+  contact_pair_t *pair = swapped ? scene_get_pair(scene, body2, body1)
+                                 : scene_get_pair(scene, body1, body2);
+  contact_handler_info_t *info = malloc(sizeof(contact_handler_info_t));
+  assert(info != NULL);
+  *info = (contact_handler_info_t){.handler = handler,
+                                   .aux = aux,
+                                   .aux_freer = aux_freer,
+                                   .swapped = swapped,
+                                   .touching = false};
+  list_add(pair->handlers, info);
+}
+
+void scene_add_type_handler(scene_t *scene, uint32_t category1,
+                            uint32_t category2, contact_handler_t handler,
+                            void *aux, free_func_t aux_freer) {
+  type_handler_t *info = malloc(sizeof(type_handler_t));
+  assert(info != NULL);
+  *info = (type_handler_t){.category1 = category1,
+                           .category2 = category2,
+                           .handler = handler,
+                           .aux = aux,
+                           .aux_freer = aux_freer};
+  list_add(scene->type_handlers, info);
+}
+
+size_t scene_contact_pairs(scene_t *scene) {
+  return list_size(scene->contact_pairs);
+}
+
+broadphase_stats_t scene_get_broadphase_stats(scene_t *scene) {
+  return broadphase_get_stats(scene->broadphase);
+}
+
+static bool type_handler_matches(type_handler_t *info, body_t *body1,
+                                 body_t *body2) {
+  return (body_get_category(body1) & info->category1) != 0 &&
+         (body_get_category(body2) & info->category2) != 0;
+}
+
+/**
+ * Returns whether any type handler is interested in a pair of bodies.
+ */
+static bool scene_has_type_handler(scene_t *scene, body_t *body1,
+                                   body_t *body2) {
+  for (size_t i = 0; i < list_size(scene->type_handlers); i++) {
+    type_handler_t *info = list_get(scene->type_handlers, i);
+    if (type_handler_matches(info, body1, body2) ||
+        type_handler_matches(info, body2, body1)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Marks the cached pairs whose boxes overlap this tick and that some type
+ * handler is interested in, caching any new ones.
+ */
+static void scene_find_typed_pairs(scene_t *scene) {
+  for (size_t i = 0; i < list_size(scene->contact_pairs); i++) {
+    ((contact_pair_t *)list_get(scene->contact_pairs, i))->seen = false;
+  }
+  size_t num_pairs = broadphase_update(scene->broadphase);
+  for (size_t i = 0; i < num_pairs; i++) {
+    broadphase_pair_t found = broadphase_get_pair(scene->broadphase, i);
+    body_t *body1 = found.first;
+    body_t *body2 = found.second;
+    if (!scene_has_type_handler(scene, body1, body2)) {
+      continue;
+    }
+    contact_pair_t *pair =
+        body_get_handle(body1) < body_get_handle(body2)
+            ? scene_get_pair(scene, body1, body2)
+            : scene_get_pair(scene, body2, body1);
+    pair->seen = true;
+  }
+}
+
+/**
+ * Passes a pair's event to every type handler interested in it, with the
+ * bodies in the order each expects.
+ */
+static void scene_notify_types(scene_t *scene, contact_pair_t *pair,
+                               contact_event_t event,
+                               collision_info_t collision) {
+  for (size_t i = 0; i < list_size(scene->type_handlers); i++) {
+    type_handler_t *info = list_get(scene->type_handlers, i);
+    if (type_handler_matches(info, pair->body1, pair->body2)) {
+      info->handler(pair->body1, pair->body2, event, collision, info->aux);
+    } else if (type_handler_matches(info, pair->body2, pair->body1)) {
+      collision_info_t flipped = collision;
+      flipped.axis = vec_negate(collision.axis);
+      info->handler(pair->body2, pair->body1, event, flipped, info->aux);
+    }
+  }
+}
+
+/**
+ * Passes an event to a handler, with the bodies in the order it expects.
+ */
+static void contact_notify(contact_pair_t *pair, contact_handler_info_t *info,
+                           contact_event_t event, collision_info_t collision) {
+  if (info->swapped) {
+    collision.axis = vec_negate(collision.axis);
+    info->handler(pair->body2, pair->body1, event, collision, info->aux);
+  } else {
+    info->handler(pair->body1, pair->body2, event, collision, info->aux);
+  }
+}
+
+/**
+ * Returns whether nothing needs a cached pair any more: it has no handlers of
+ * its own, and the type handlers neither see it nor think it is touching.
+ */
+static bool contact_pair_is_unused(void *contact_pair, void *aux) {
+  contact_pair_t *pair = contact_pair;
+  return list_size(pair->handlers) == 0 && !pair->seen && !pair->touching;
+}
+
+/**
+ * Returns whether a body is asleep or static, and has stayed where it is
+ * since a given tick.
+ */
+static bool scene_idle_since(scene_t *scene, body_t *body, size_t tick) {
+  return scene_is_idle(scene, body) &&
+         scene_get_slot(scene, body_get_handle(body))->placed_tick <= tick;
+}
+
+/**
+ * Wakes a sleeping body that an awake, moving one has run into. It is placed
+ * at the start of the next tick.
+ */
+static void scene_wake_on_hit(scene_t *scene, body_t *sleeper, body_t *other) {
+  if (body_is_sleeping(sleeper) && !scene_is_idle(scene, other) &&
+      body_get_quiet_ticks(other) == 0) {
+    body_wake(sleeper);
+  }
+}
+
+/**
+ * Finds out whether a pair is touching, reusing the last answer if neither
+ * body has moved since.
+ */
+static collision_info_t scene_test_pair(scene_t *scene, contact_pair_t *pair) {
+  if (pair->tested_tick > 0 &&
+      scene_idle_since(scene, pair->body1, pair->tested_tick) &&
+      scene_idle_since(scene, pair->body2, pair->tested_tick)) {
+    return pair->collision;
+  }
+  collision_info_t collision = find_collision_cached(
+      pair->body1, pair->body2, &pair->separating_axis);
+  pair->tested_tick = scene->num_ticks;
+  pair->collision = collision;
+  if (collision.collided) {
+    scene_wake_on_hit(scene, pair->body1, pair->body2);
+    scene_wake_on_hit(scene, pair->body2, pair->body1);
+  }
+  return collision;
+}
+
+/**
+ * The scene's contact stage. Finds the pairs the type handlers are
+ * interested in, tests every cached pair once, and tells all the handlers
+ * what changed. Handlers may subscribe more handlers as they go.
+ */
+static void scene_update_contacts(scene_t *scene) {
+  if (list_size(scene->type_handlers) > 0) {
+    scene_find_typed_pairs(scene);
+  }
+  for (size_t i = 0; i < list_size(scene->contact_pairs); i++) {
+    contact_pair_t *pair = list_get(scene->contact_pairs, i);
+    if (contact_pair_is_unused(pair, NULL)) {
+      continue;
+    }
+    collision_info_t collision = scene_test_pair(scene, pair);
+    if (collision.collided) {
+      contact_event_t event = pair->touching ? CONTACT_STAY : CONTACT_ENTER;
+      pair->touching = true;
+      scene_notify_types(scene, pair, event, collision);
+    } else if (pair->touching) {
+      pair->touching = false;
+      scene_notify_types(scene, pair, CONTACT_EXIT, collision);
+    }
+    for (size_t j = 0; j < list_size(pair->handlers); j++) {
+      contact_handler_info_t *info = list_get(pair->handlers, j);
+      if (collision.collided) {
+        contact_event_t event = info->touching ? CONTACT_STAY : CONTACT_ENTER;
+        info->touching = true;
+        contact_notify(pair, info, event, collision);
+      } else if (info->touching) {
+        info->touching = false;
+        contact_notify(pair, info, CONTACT_EXIT, collision);
+      }
+    }
+  }
+  if (list_remove_if(scene->contact_pairs, contact_pair_is_unused, NULL,
+                     (free_func_t)contact_pair_free) > 0) {
+    scene_rebuild_pair_index(scene);
+  }
+}
+
+/**
+ * Returns whether a pair involves a body marked for removal, telling its
+ * handlers the contact is over if so.
+ */
+static bool contact_pair_is_stale(void *contact_pair, void *scene) {
+  contact_pair_t *pair = contact_pair;
+  if (!body_is_removed(pair->body1) && !body_is_removed(pair->body2)) {
+    return false;
+  }
+  collision_info_t none = {.collided = false, .axis = VEC_ZERO};
+  if (pair->touching) {
+    pair->touching = false;
+    scene_notify_types(scene, pair, CONTACT_EXIT, none);
+  }
+  for (size_t j = 0; j < list_size(pair->handlers); j++) {
+    contact_handler_info_t *info = list_get(pair->handlers, j);
+    if (info->touching) {
+      info->touching = false;
+      contact_notify(pair, info, CONTACT_EXIT, none);
+    }
+  }
+  return true;
+}
+
+static bool body_is_removed_data(void *body, void *aux) {
+  return body_is_removed(body);
+}
+
+/**
+ * Returns whether a body is marked for removal. If so, drops the force
+ * creators acting on it and releases its handle.
+ */
+static bool body_is_removed_pred(void *body, void *scene) {
+  if (!body_is_removed(body)) {
+    return false;
+  }
+  handle_slot_t *slot = scene_get_slot(scene, body_get_handle(body));
+  while (slot->force_refs != NULL) {
+    scene_drop_force_creator(scene, slot->force_refs->info);
+  }
+  scene_release_handle(scene, body_get_handle(body));
+  return true;
+}
+
+static void scene_add_sweep(scene_t *scene, body_t *body) {
+  if (scene->num_sweeps == scene->sweep_capacity) {
+    scene->sweep_capacity =
+        scene->sweep_capacity > 0 ? scene->sweep_capacity * 2 : BODY_NUMBER;
+    scene->sweeps =
+        realloc(scene->sweeps, sizeof(sweep_t) * scene->sweep_capacity);
+    assert(scene->sweeps != NULL);
+  }
+  scene->sweeps[scene->num_sweeps++] =
+      (sweep_t){.body = body, .start = body_get_centroid(body)};
+}
+
+// The earliest hit found so far along a fast body's motion
+typedef struct {
+  sweep_t sweep;
+  double fraction;
+} sweep_hit_t;
+
+static bool sweep_leaf(void *body, void *aux) {
+  sweep_hit_t *hit = aux;
+  if (body != hit->sweep.body && !body_is_removed(body) &&
+      !body_is_sensor(body) && body_can_collide(hit->sweep.body, body)) {
+    hit->fraction = fmin(hit->fraction, find_time_of_impact(hit->sweep.body,
+                                                            hit->sweep.start,
+                                                            body));
+  }
+  return true;
+}
+
+/**
+ * Moves a fast body back to where its motion this tick first touched another
+ * body, if it did. Other bodies are taken at their new positions.
+ */
+static void scene_sweep(scene_t *scene, sweep_t sweep) {
+  vector_t end = body_get_centroid(sweep.body);
+  vector_t motion = vec_subtract(end, sweep.start);
+  double length = vec_get_length(motion);
+  if (length == 0) {
+    return;
+  }
+  aabb_t box = body_get_aabb(sweep.body);
+  aabb_t swept = aabb_union(box, aabb_translate(box, vec_negate(motion)));
+  sweep_hit_t hit = {.sweep = sweep, .fraction = INFINITY};
+  aabb_tree_query(scene->tree, swept, sweep_leaf, &hit);
+  if (hit.fraction > 1) {
+    return;
+  }
+  double fraction = fmin(hit.fraction + SWEEP_OVERLAP / length, 1);
+  body_set_centroid(sweep.body,
+                    vec_add(sweep.start, vec_multiply(fraction, motion)));
+  handle_slot_t *slot = scene_get_slot(scene, body_get_handle(sweep.body));
+  aabb_tree_move(scene->tree, slot->proxy, body_get_aabb(sweep.body));
+}
+
+void scene_set_threads(scene_t *scene, size_t num_threads) {
+  assert(num_threads > 0);
+  if (scene->pool != NULL) {
+    thread_pool_free(scene->pool);
+    for (size_t i = 0; i < scene->num_threads; i++) {
+      free(scene->force_buffers[i].applied);
+    }
+    free(scene->force_buffers);
+    scene->pool = NULL;
+    scene->force_buffers = NULL;
+  }
+  scene->num_threads = num_threads;
+  if (num_threads == 1) {
+    return;
+  }
+  scene->pool = thread_pool_init(num_threads);
+  scene->force_buffers = malloc(sizeof(force_buffer_t) * num_threads);
+  assert(scene->force_buffers != NULL);
+  for (size_t i = 0; i < num_threads; i++) {
+    scene->force_buffers[i] = (force_buffer_t){.applied = NULL};
+  }
+}
+
+size_t scene_get_threads(scene_t *scene) { return scene->num_threads; }
+
+void scene_set_integrator(scene_t *scene, integrator_t integrator) {
+  scene->integrator = integrator;
+}
+
+integrator_t scene_get_integrator(scene_t *scene) {
+  return scene->integrator;
+}
+
+void scene_set_substeps(scene_t *scene, body_t *body, size_t substeps) {
+  assert(substeps > 0);
+  handle_slot_t *slot = scene_get_slot(scene, body_get_handle(body));
+  assert(slot != NULL);
+  slot->substeps = substeps;
+  scene_place_body(scene, body);
+}
+
+size_t scene_get_substeps(scene_t *scene, body_t *body) {
+  handle_slot_t *slot = scene_get_slot(scene, body_get_handle(body));
+  return slot != NULL ? slot->substeps : 1;
+}
+
+void scene_set_sleep(scene_t *scene, uint32_t quiet_ticks, double max_speed) {
+  assert(max_speed >= 0);
+  scene->sleep_ticks = quiet_ticks;
+  scene->sleep_speed = max_speed;
+}
+
+uint32_t scene_get_sleep_ticks(scene_t *scene) { return scene->sleep_ticks; }
+
+size_t scene_add_force_field(scene_t *scene, force_field_t field) {
+  if (scene->num_fields == scene->field_capacity) {
+    scene->field_capacity =
+        scene->field_capacity > 0 ? scene->field_capacity * 2 : AUX_NUMBER;
+    scene->fields = realloc(scene->fields,
+                            sizeof(force_field_t) * scene->field_capacity);
+    assert(scene->fields != NULL);
+  }
+  scene->fields[scene->num_fields] = field;
+  return scene->num_fields++;
+}
+
+force_field_t scene_get_force_field(scene_t *scene, size_t index) {
+  assert(index < scene->num_fields);
+  return scene->fields[index];
+}
+
+void scene_set_force_field(scene_t *scene, size_t index, force_field_t field) {
+  assert(index < scene->num_fields);
+  scene->fields[index] = field;
+}
+
+/**
+ * Applies the scene's force fields to a range of one of its stores.
+ */
+static void scene_apply_fields(scene_t *scene, body_store_t *store,
+                               size_t start, size_t end) {
+  for (size_t f = 0; f < scene->num_fields; f++) {
+    body_store_apply_field(store, &scene->fields[f], start, end);
+  }
+}
+
+static void scene_force_sink(body_t *body, vector_t force, vector_t impulse,
+                             void *aux) {
+  body_handle_t handle = body_get_handle(body);
+  assert(handle != BODY_HANDLE_NONE);
+  applied_force_t *applied =
+      &((force_buffer_t *)aux)->applied[handle & HANDLE_INDEX_MASK];
+  applied->force = vec_add(applied->force, force);
+  applied->impulse = vec_add(applied->impulse, impulse);
+}
+
+/**
+ * Runs one contiguous chunk of the force creators into its own buffer.
+ * The chunks only depend on the number of threads, not on which thread runs
+ * them, so the buffers come out the same every time.
+ */
+static void scene_run_force_chunk(void *scene_ptr, size_t chunk) {
+  scene_t *scene = scene_ptr;
+  force_buffer_t *buffer = &scene->force_buffers[chunk];
+  if (buffer->capacity < scene->num_slots) {
+    buffer->capacity = scene->slot_capacity;
+    free(buffer->applied);
+    buffer->applied = malloc(sizeof(applied_force_t) * buffer->capacity);
+    assert(buffer->applied != NULL);
+  }
+  memset(buffer->applied, 0, sizeof(applied_force_t) * scene->num_slots);
+
+  size_t num_creators = scene->num_active_creators;
+  size_t start = num_creators * chunk / scene->num_threads;
+  size_t end = num_creators * (chunk + 1) / scene->num_threads;
+  body_set_force_sink(scene_force_sink, buffer);
+  for (size_t j = start; j < end; j++) {
     force_creator_info_t *force_info = list_get(scene->force_creators, j);
     force_info->force_creator(force_info->aux);
   }
+  body_set_force_sink(NULL, NULL);
+}
 
-  for (ssize_t i = 0; i < scene->num_bodies; i++) {
-    body_t *body = list_get(scene->bodies, i);
-    if (body_is_removed(body)) {
-      for (size_t j = 0; j < list_size(scene->force_creators); j++) {
-        force_creator_info_t *info = list_get(scene->force_creators, j);
-        list_t *bodies = info->bodies;
-        for (size_t k = 0; k < list_size(bodies); k++) {
-          if (list_get(bodies, k) == body) {
-            list_remove(scene->force_creators, j);
-            j--;
-            force_creator_info_free(info);
-            break;
-          }
+typedef struct {
+  scene_t *scene;
+  size_t stage;
+  double dt;
+} integrate_job_t;
+
+/**
+ * Adds up what the buffers hold for a body, in chunk order.
+ */
+static void scene_collect_forces(scene_t *scene, body_t *body) {
+  size_t index = body_get_handle(body) & HANDLE_INDEX_MASK;
+  for (size_t t = 0; t < scene->num_threads; t++) {
+    applied_force_t applied = scene->force_buffers[t].applied[index];
+    body_add_force(body, applied.force);
+    body_add_impulse(body, applied.impulse);
+  }
+}
+
+/**
+ * Adds up the buffers for one chunk of the scene's store and applies the
+ * force fields to it, then runs a stage of the integrator on it.
+ */
+static void scene_integrate_chunk(void *job_ptr, size_t chunk) {
+  integrate_job_t *job = job_ptr;
+  scene_t *scene = job->scene;
+  size_t size = body_store_size(scene->store);
+  size_t start = size * chunk / scene->num_threads;
+  size_t end = size * (chunk + 1) / scene->num_threads;
+  for (size_t i = start; i < end; i++) {
+    scene_collect_forces(scene, body_store_get(scene->store, i));
+  }
+  scene_apply_fields(scene, scene->store, start, end);
+  body_store_integrate(scene->store, scene->integrator, job->stage, start, end,
+                       job->dt);
+}
+
+/**
+ * Runs a stage of the integrator on every body across the scene's threads,
+ * each taking one contiguous range of the store. Force creators may have
+ * handed out polygons, so the store is settled first.
+ */
+static void scene_integrate_parallel(scene_t *scene, size_t stage,
+                                     double dt) {
+  body_store_settle(scene->store);
+  integrate_job_t job = {.scene = scene, .stage = stage, .dt = dt};
+  thread_pool_run(scene->pool, scene_integrate_chunk, &job,
+                  scene->num_threads);
+}
+
+/**
+ * Runs all the force creators, on the scene's threads if it has them.
+ */
+static void scene_apply_forces(scene_t *scene) {
+  if (scene->pool != NULL) {
+    // Reading a body can sync its polygon or fill in its cached vertices,
+    // which mustn't happen on two threads at once
+    body_store_refresh(scene->store);
+    body_store_refresh(scene->substep_store);
+    body_store_refresh(scene->idle_store);
+    thread_pool_run(scene->pool, scene_run_force_chunk, scene,
+                    scene->num_threads);
+    // Idle bodies aren't integrated, but a push still has to wake them
+    for (size_t i = 0; i < body_store_size(scene->idle_store); i++) {
+      scene_collect_forces(scene, body_store_get(scene->idle_store, i));
+    }
+  } else {
+    for (size_t j = 0; j < scene->num_active_creators; j++) {
+      force_creator_info_t *force_info = list_get(scene->force_creators, j);
+      force_info->force_creator(force_info->aux);
+    }
+  }
+}
+
+/**
+ * Passes on the forces and impulses on the body in aux, and drops the rest.
+ */
+static void scene_substep_sink(body_t *body, vector_t force, vector_t impulse,
+                               void *aux) {
+  if (body != aux) {
+    return;
+  }
+  body_set_force_sink(NULL, NULL);
+  body_add_force(body, force);
+  body_add_impulse(body, impulse);
+  body_set_force_sink(scene_substep_sink, aux);
+}
+
+typedef struct {
+  scene_t *scene;
+  handle_slot_t *slot;
+} substep_eval_t;
+
+/**
+ * Reruns the force creators registered with a body, keeping only the forces
+ * on that body.
+ */
+static void scene_substep_eval(body_t *body, void *eval_ptr) {
+  substep_eval_t *eval = eval_ptr;
+  body_set_force_sink(scene_substep_sink, body);
+  for (force_ref_t *ref = eval->slot->force_refs; ref != NULL;
+       ref = ref->next) {
+    ref->info->force_creator(ref->info->aux);
+  }
+  body_set_force_sink(NULL, NULL);
+}
+
+/**
+ * Ticks the bodies that take several steps per tick, one at a time, against
+ * the rest of the scene as it was at the start of the tick.
+ */
+static void scene_substep_bodies(scene_t *scene, double dt) {
+  for (size_t i = 0; i < body_store_size(scene->substep_store); i++) {
+    body_t *body = body_store_get(scene->substep_store, i);
+    if (scene->pool != NULL) {
+      scene_collect_forces(scene, body);
+    }
+    scene_apply_fields(scene, scene->substep_store, i, i + 1);
+    substep_eval_t eval = {
+        .scene = scene,
+        .slot = scene_get_slot(scene, body_get_handle(body))};
+    body_substep(body, scene->integrator, eval.slot->substeps, dt,
+                 scene_substep_eval, &eval);
+  }
+}
+
+/**
+ * Calls a function on every body the scene ticks, leaving out the idle ones.
+ */
+static void scene_for_active(scene_t *scene,
+                             void (*func)(scene_t *, body_t *)) {
+  body_store_t *stores[] = {scene->store, scene->substep_store};
+  for (size_t s = 0; s < sizeof(stores) / sizeof(stores[0]); s++) {
+    for (size_t i = 0; i < body_store_size(stores[s]); i++) {
+      func(scene, body_store_get(stores[s], i));
+    }
+  }
+}
+
+static void scene_add_sweep_if_fast(scene_t *scene, body_t *body) {
+  if (body_is_fast(body)) {
+    scene_add_sweep(scene, body);
+  }
+}
+
+static void scene_move_proxy(scene_t *scene, body_t *body) {
+  handle_slot_t *slot = scene_get_slot(scene, body_get_handle(body));
+  aabb_tree_move(scene->tree, slot->proxy, body_get_aabb(body));
+}
+
+/**
+ * Finds the island of awake bodies a body belongs to: every body joined to
+ * it through force creators, stopping at idle bodies. Leaves the island in
+ * scene->island, and returns whether all of it can go to sleep. An island
+ * whose creators also act on bodies outside the scene never sleeps.
+ */
+static bool scene_find_island(scene_t *scene, body_t *body) {
+  list_t *island = scene->island;
+  bool quiet = true;
+  list_add(island, body);
+  scene_get_slot(scene, body_get_handle(body))->island_stamp =
+      scene->num_ticks;
+  for (size_t i = 0; i < list_size(island); i++) {
+    body_t *member = list_get(island, i);
+    quiet = quiet && body_get_quiet_ticks(member) >= scene->sleep_ticks;
+    handle_slot_t *slot = scene_get_slot(scene, body_get_handle(member));
+    for (force_ref_t *ref = slot->force_refs; ref != NULL; ref = ref->next) {
+      list_t *bodies = ref->info->bodies;
+      for (size_t j = 0; j < list_size(bodies); j++) {
+        body_t *other = list_get(bodies, j);
+        handle_slot_t *other_slot =
+            scene_get_slot(scene, body_get_handle(other));
+        if (other_slot == NULL) {
+          quiet = false;
+        } else if (other_slot->island_stamp != scene->num_ticks &&
+                   !scene_is_idle(scene, other)) {
+          other_slot->island_stamp = scene->num_ticks;
+          list_add(island, other);
         }
       }
-      list_remove(scene->bodies, i);
-      scene->num_bodies--;
-      body_free(body);
-      i--;
+    }
+  }
+  return quiet;
+}
+
+/**
+ * Puts to sleep every island of bodies that have all been quiet for long
+ * enough. Islands sleep whole, so a body never sleeps while a force creator
+ * still pulls it towards an awake one.
+ */
+static void scene_sleep_islands(scene_t *scene) {
+  body_store_update_quiet(scene->store, scene->sleep_speed);
+  body_store_update_quiet(scene->substep_store, scene->sleep_speed);
+  body_store_t *stores[] = {scene->store, scene->substep_store};
+  for (size_t s = 0; s < sizeof(stores) / sizeof(stores[0]); s++) {
+    for (size_t i = 0; i < body_store_size(stores[s]); i++) {
+      body_t *body = body_store_get(stores[s], i);
+      handle_slot_t *slot = scene_get_slot(scene, body_get_handle(body));
+      if (slot->island_stamp == scene->num_ticks ||
+          body_get_quiet_ticks(body) < scene->sleep_ticks) {
+        continue;
+      }
+      bool quiet = scene_find_island(scene, body);
+      while (list_size(scene->island) > 0) {
+        body_t *member =
+            list_remove(scene->island, list_size(scene->island) - 1);
+        if (quiet) {
+          list_add(scene->sleepers, member);
+        }
+      }
+    }
+  }
+  // The stores can't change while they are being walked
+  while (list_size(scene->sleepers) > 0) {
+    body_sleep(list_remove(scene->sleepers, list_size(scene->sleepers) - 1));
+  }
+  scene_place_touched(scene);
+}
+
+void scene_tick(scene_t *scene, double dt) {
+  scene->num_ticks++;
+  if (scene->pending_refs != NULL) {
+    scene_link_pending_refs(scene);
+  }
+  // Bodies woken, put to sleep or changed since the last tick move to their
+  // stores first, and so do any woken by forces
+  scene_place_touched(scene);
+  scene_apply_forces(scene);
+  scene_place_touched(scene);
+
+  // Reclaim dead bodies and the contact pairs involving them. The pairs must
+  // go first, since they still read the bodies. Each dead body drops only the
+  // force creators registered with it. Most ticks remove nothing, so check
+  // that first.
+  if (body_store_has_removed(scene->store) ||
+      body_store_has_removed(scene->substep_store) ||
+      body_store_has_removed(scene->idle_store)) {
+    if (list_remove_if(scene->contact_pairs, contact_pair_is_stale, scene,
+                       (free_func_t)contact_pair_free) > 0) {
+      scene_rebuild_pair_index(scene);
+    }
+    broadphase_remove_if(scene->broadphase, body_is_removed_data, NULL);
+    scene->num_bodies -= list_remove_if(scene->bodies, body_is_removed_pred,
+                                        scene, (free_func_t)body_free);
+  }
+
+  scene->num_sweeps = 0;
+  scene_for_active(scene, scene_add_sweep_if_fast);
+  scene_substep_bodies(scene, dt);
+  size_t num_stages = integrator_num_stages(scene->integrator);
+  for (size_t stage = 0; stage < num_stages; stage++) {
+    if (stage > 0) {
+      scene_apply_forces(scene);
+    }
+    if (scene->pool != NULL) {
+      scene_integrate_parallel(scene, stage, dt);
+    } else {
+      size_t size = body_store_size(scene->store);
+      scene_apply_fields(scene, scene->store, 0, size);
+      body_store_integrate(scene->store, scene->integrator, stage, 0, size,
+                           dt);
+    }
+  }
+  // The later stages' forces on the substepped bodies were already accounted
+  // for by their own steps
+  for (size_t i = 0; i < body_store_size(scene->substep_store); i++) {
+    body_reset(body_store_get(scene->substep_store, i));
+  }
+  // Idle bodies haven't moved, so their proxies are already in place
+  scene_for_active(scene, scene_move_proxy);
+
+  // Fast bodies can pass through others in one tick, so once everything has
+  // moved, stop each one where it first hit something
+  for (size_t i = 0; i < scene->num_sweeps; i++) {
+    scene_sweep(scene, scene->sweeps[i]);
+  }
+
+  if (scene->sleep_ticks > 0) {
+    scene_sleep_islands(scene);
+  }
+
+  // Contacts are found last, so that bodies removed by their handlers stay
+  // alive until the next tick and the caller can let go of them first
+  scene_update_contacts(scene);
+}
+
+// Filters tree matches down to live bodies that really overlap the query
+typedef struct {
+  scene_query_t callback;
+  void *aux;
+  aabb_t box;
+  vector_t center;
+  double radius;
+} scene_query_info_t;
+
+static bool query_aabb_leaf(void *body, void *aux) {
+  scene_query_info_t *info = aux;
+  if (body_is_removed(body) ||
+      !aabb_overlaps(body_get_aabb(body), info->box)) {
+    return true;
+  }
+  return info->callback(body, info->aux);
+}
+
+void scene_query_aabb(scene_t *scene, aabb_t box, scene_query_t callback,
+                      void *aux) {
+  scene_query_info_t info = {.callback = callback, .aux = aux, .box = box};
+  aabb_tree_query(scene->tree, box, query_aabb_leaf, &info);
+}
+
+static bool query_radius_leaf(void *body, void *aux) {
+  scene_query_info_t *info = aux;
+  if (body_is_removed(body) ||
+      aabb_distance(body_get_aabb(body), info->center) > info->radius) {
+    return true;
+  }
+  return info->callback(body, info->aux);
+}
+
+void scene_query_radius(scene_t *scene, vector_t center, double radius,
+                        scene_query_t callback, void *aux) {
+  scene_query_info_t info = {
+      .callback = callback, .aux = aux, .center = center, .radius = radius};
+  aabb_t box = aabb_expand((aabb_t){center, center}, radius);
+  aabb_tree_query(scene->tree, box, query_radius_leaf, &info);
+}
+
+/**
+ * Clips a segment against a body's outline, one edge at a time.
+ * Returns the fraction where the segment enters the body, or INFINITY if it
+ * misses or starts inside. If it hits, normal is set to the entered edge's.
+ */
+static double raycast_body(body_t *body, vector_t start, vector_t end,
+                           vector_t *normal) {
+  const vector_t *vertices = body_get_vertices(body);
+  const vector_t *normals = polygon_get_normals(body_peek_polygon(body));
+  size_t size = body_num_vertices(body);
+  vector_t delta = vec_subtract(end, start);
+  double enter = -INFINITY;
+  double leave = 1;
+  vector_t enter_normal = VEC_ZERO;
+  for (size_t i = 0; i < size; i++) {
+    if (normals[i].x == 0 && normals[i].y == 0) {
+      continue;
+    }
+    // How far outside this edge the start is, and how fast the ray closes in
+    double outside = vec_dot(normals[i], vec_subtract(start, vertices[i]));
+    double approach = vec_dot(normals[i], delta);
+    if (approach == 0) {
+      if (outside > 0) {
+        return INFINITY;
+      }
+      continue;
+    }
+    double t = -outside / approach;
+    if (approach < 0) {
+      if (t > enter) {
+        enter = t;
+        enter_normal = normals[i];
+      }
     } else {
-      body_tick(body, dt);
+      leave = fmin(leave, t);
     }
+    if (enter > leave) {
+      return INFINITY;
+    }
+  }
+  if (enter < 0) {
+    return INFINITY;
+  }
+  *normal = enter_normal;
+  return enter;
+}
+
+static double raycast_leaf(void *body, vector_t start, vector_t end,
+                           void *aux) {
+  if (body_is_removed(body)) {
+    return INFINITY;
   }
+  vector_t normal;
+  return raycast_body(body, start, end, &normal);
+}
+
+scene_raycast_t scene_raycast(scene_t *scene, vector_t start, vector_t end) {
+  double fraction;
+  body_t *body =
+      aabb_tree_raycast(scene->tree, start, end, raycast_leaf, NULL, &fraction);
+  if (body == NULL) {
+    return (scene_raycast_t){.hit = false};
+  }
+  scene_raycast_t result = {.hit = true, .body = body, .fraction = fraction};
+  raycast_body(body, start, end, &result.normal);
+  result.point =
+      vec_add(start, vec_multiply(fraction, vec_subtract(end, start)));
+  return result;
+}
+
+static double nearest_leaf(void *body, vector_t point, void *aux) {
+  if (body_is_removed(body)) {
+    return INFINITY;
+  }
+  return aabb_distance(body_get_aabb(body), point);
+}
+
+size_t scene_query_nearest(scene_t *scene, vector_t point, size_t k,
+                           body_t **nearest) {
+  return aabb_tree_nearest(scene->tree, point, k, nearest_leaf, NULL,
+                           (void **)nearest);
 }
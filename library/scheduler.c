@@ -0,0 +1,83 @@
+#include "scheduler.h"
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Lets a frame that is a whole number of ticks long, give or take rounding,
+// run all of them
+const double SCHEDULER_TOLERANCE = 1e-9;
+
+struct scheduler {
+  double dt;
+  size_t max_substeps;
+  double accumulator;
+  // The time of the last call to scheduler_frame(), if there was one
+  double last_time;
+  bool started;
+  size_t ticks;
+  double dropped;
+};
+
+double scheduler_now(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+scheduler_t *scheduler_init(double tick_rate, size_t max_substeps) {
+  assert(tick_rate > 0 && max_substeps > 0);
+  scheduler_t *scheduler = malloc(sizeof(scheduler_t));
+  assert(scheduler != NULL);
+  scheduler->dt = 1 / tick_rate;
+  scheduler->max_substeps = max_substeps;
+  scheduler->accumulator = 0;
+  scheduler->last_time = 0;
+  scheduler->started = false;
+  scheduler->ticks = 0;
+  scheduler->dropped = 0;
+  return scheduler;
+}
+
+void scheduler_free(scheduler_t *scheduler) { free(scheduler); }
+
+size_t scheduler_frame(scheduler_t *scheduler) {
+  double now = scheduler_now();
+  double elapsed = scheduler->started ? now - scheduler->last_time : 0;
+  scheduler->last_time = now;
+  scheduler->started = true;
+  return scheduler_advance(scheduler, elapsed);
+}
+
+size_t scheduler_advance(scheduler_t *scheduler, double elapsed) {
+  assert(elapsed >= 0);
+  scheduler->accumulator += elapsed;
+  size_t ticks = (size_t)floor(scheduler->accumulator / scheduler->dt +
+                               SCHEDULER_TOLERANCE);
+  if (ticks > scheduler->max_substeps) {
+    // Keep the fraction of a tick, so the alpha stays continuous
+    double excess = (ticks - scheduler->max_substeps) * scheduler->dt;
+    scheduler->dropped += excess;
+    scheduler->accumulator -= excess;
+    ticks = scheduler->max_substeps;
+  }
+  scheduler->accumulator -= ticks * scheduler->dt;
+  // Rounding can leave the accumulator a hair outside [0, dt)
+  scheduler->accumulator =
+      fmin(fmax(scheduler->accumulator, 0), nextafter(scheduler->dt, 0));
+  scheduler->ticks += ticks;
+  return ticks;
+}
+
+double scheduler_get_dt(scheduler_t *scheduler) { return scheduler->dt; }
+
+double scheduler_get_alpha(scheduler_t *scheduler) {
+  return scheduler->accumulator / scheduler->dt;
+}
+
+size_t scheduler_get_ticks(scheduler_t *scheduler) { return scheduler->ticks; }
+
+double scheduler_get_dropped(scheduler_t *scheduler) {
+  return scheduler->dropped;
+}
@@ -1,6 +1,8 @@
 #include "sdl_wrapper.h"
+#include "arena.h"
 #include "state.h"
 #include "asset_cache.h"
+#include "scheduler.h"
 #include <SDL2/SDL.h>
 #include <SDL2/SDL2_gfxPrimitives.h>
 #include <SDL2/SDL_image.h>
@@ -18,8 +20,6 @@ const char WINDOW_TITLE[] = "CS 3";
 const int WINDOW_WIDTH = 1000;
 const int WINDOW_HEIGHT = 500;
 const double MS_PER_S = 1e3;
-const double MINIMUM = -DBL_MAX;
-const double MAXIMUM = DBL_MAX;
 const size_t NUM_KEYS = 512;
 const double MAX_VOLUME = 128;
 
@@ -48,25 +48,25 @@ key_handler_t key_handler = NULL;
  */
 mouse_handler_t mouse_handler = NULL;
 /**
- * SDL's timestamp when a key was last pressed or released.
- * Used to mesasure how long a key has been held.
+ * The value of scheduler_now() when each key was first seen held down,
+ * or 0 if it is up. Used to measure how long a key has been held.
  */
-uint32_t key_start_timestamp;
+double key_press_times[SDL_NUM_SCANCODES];
 /**
- * The value of clock() when time_since_last_tick() was last called.
+ * The value of scheduler_now() when time_since_last_tick() was last called.
  * Initially 0.
  */
-clock_t last_clock = 0;
+double last_tick_time = 0;
+/**
+ * How far between the last two ticks to draw bodies; see sdl_set_interpolation.
+ */
+double render_alpha = 1;
 
 /** Computes the center of the window in pixel coordinates */
 vector_t get_window_center(void) {
-  int *width = malloc(sizeof(*width)), *height = malloc(sizeof(*height));
-  assert(width != NULL);
-  assert(height != NULL);
-  SDL_GetWindowSize(window, width, height);
-  vector_t dimensions = {.x = *width, .y = *height};
-  free(width);
-  free(height);
+  int width, height;
+  SDL_GetWindowSize(window, &width, &height);
+  vector_t dimensions = {.x = width, .y = height};
   return vec_multiply(0.5, dimensions);
 }
 
@@ -146,33 +146,36 @@ void sdl_init(vector_t min, vector_t max) {
 
 bool sdl_is_done(void *state) {
   const Uint8 *keyboard_state = SDL_GetKeyboardState(NULL);
-  SDL_Event *event = malloc(sizeof(*event));
-  assert(event != NULL);
-  while (SDL_PollEvent(event)) {
-    switch (event->type) {
+  SDL_Event event;
+  while (SDL_PollEvent(&event)) {
+    switch (event.type) {
     case SDL_QUIT:
-      free(event);
       return true;
     case SDL_MOUSEBUTTONDOWN: {
-      asset_cache_handle_buttons(state, event->motion.x, event->motion.y);
+      asset_cache_handle_buttons(state, event.motion.x, event.motion.y);
       if (mouse_handler == NULL) {
         return false;
       }
-      mouse_handler(state, event->motion.x, event->motion.y);
+      mouse_handler(state, event.motion.x, event.motion.y);
       break;
     }
     }
   }
 
+  double now = scheduler_now();
   for (int scancode = 0; scancode < SDL_NUM_SCANCODES; scancode++) {
-        if (keyboard_state[scancode]) {
-            char key = get_key_from_scancode(scancode);
-            key_event_type_t type = KEY_PRESSED;
-            double held_time = time_since_last_tick(); 
-            key_handler(key, type, held_time, state);
+        if (!keyboard_state[scancode]) {
+            key_press_times[scancode] = 0;
+            continue;
+        }
+        if (key_press_times[scancode] == 0) {
+            key_press_times[scancode] = now;
         }
+        char key = get_key_from_scancode(scancode);
+        key_event_type_t type = KEY_PRESSED;
+        double held_time = now - key_press_times[scancode];
+        key_handler(key, type, held_time, state);
     }
-  free(event);
   return false;
 }
 
@@ -182,21 +185,18 @@ void sdl_clear(void) {
 }
 
 void sdl_draw_polygon(polygon_t *poly, rgb_color_t color) {
-  list_t *points = polygon_get_points(poly);
+  const vector_t *points = polygon_get_vertices(poly);
   // Check parameters
-  size_t n = list_size(points);
+  size_t n = polygon_num_vertices(poly);
   assert(n >= 3);
 
   vector_t window_center = get_window_center();
 
   // Convert each vertex to a point on screen
-  int16_t *x_points = malloc(sizeof(*x_points) * n),
-          *y_points = malloc(sizeof(*y_points) * n);
-  assert(x_points != NULL);
-  assert(y_points != NULL);
+  int16_t *x_points = arena_alloc(frame_arena(), sizeof(*x_points) * n),
+          *y_points = arena_alloc(frame_arena(), sizeof(*y_points) * n);
   for (size_t i = 0; i < n; i++) {
-    vector_t *vertex = list_get(points, i);
-    vector_t pixel = get_window_position(*vertex, window_center);
+    vector_t pixel = get_window_position(points[i], window_center);
     x_points[i] = pixel.x;
     y_points[i] = pixel.y;
   }
@@ -204,8 +204,6 @@ void sdl_draw_polygon(polygon_t *poly, rgb_color_t color) {
   // Draw polygon with the given color
   filledPolygonRGBA(renderer, x_points, y_points, n, color.r * 255,
                     color.g * 255, color.b * 255, 255);
-  free(x_points);
-  free(y_points);
 }
 
 void sdl_show(void) {
@@ -215,15 +213,12 @@ void sdl_show(void) {
            min = vec_subtract(center, max_diff);
   vector_t max_pixel = get_window_position(max, window_center),
            min_pixel = get_window_position(min, window_center);
-  SDL_Rect *boundary = malloc(sizeof(*boundary));
-  assert(boundary != NULL);
-  boundary->x = min_pixel.x;
-  boundary->y = max_pixel.y;
-  boundary->w = max_pixel.x - min_pixel.x;
-  boundary->h = min_pixel.y - max_pixel.y;
+  SDL_Rect boundary = {.x = min_pixel.x,
+                       .y = max_pixel.y,
+                       .w = max_pixel.x - min_pixel.x,
+                       .h = min_pixel.y - max_pixel.y};
   SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-  SDL_RenderDrawRect(renderer, boundary);
-  free(boundary);
+  SDL_RenderDrawRect(renderer, &boundary);
 
   SDL_RenderPresent(renderer);
 }
@@ -233,14 +228,11 @@ void sdl_render_scene(scene_t *scene, void *aux) {
   size_t body_count = scene_bodies(scene);
   for (size_t i = 0; i < body_count; i++) {
     body_t *body = scene_get_body(scene, i);
-    list_t *shape = body_get_shape(body);
-    polygon_t *poly = polygon_init(shape, (vector_t){0, 0}, 0, 0, 0, 0);
-    sdl_draw_polygon(poly, *body_get_color(body));
-    list_free(shape);
+    sdl_draw_polygon(body_peek_polygon(body), *body_get_color(body));
   }
   if (aux != NULL) {
     body_t *body = aux;
-    sdl_draw_polygon(body_get_polygon(body), *body_get_color(body));
+    sdl_draw_polygon(body_peek_polygon(body), *body_get_color(body));
   }
   sdl_show();
 }
@@ -250,14 +242,16 @@ void sdl_on_key(key_handler_t handler) { key_handler = handler; }
 void sdl_on_click(mouse_handler_t handler) { mouse_handler = handler; }
 
 double time_since_last_tick(void) {
-  clock_t now = clock();
-  double difference = last_clock
-                          ? (double)(now - last_clock) / CLOCKS_PER_SEC
+  double now = scheduler_now();
+  double difference = last_tick_time
+                          ? now - last_tick_time
                           : 0.0; // return 0 the first time this is called
-  last_clock = now;
+  last_tick_time = now;
   return difference;
 }
 
+void sdl_set_interpolation(double alpha) { render_alpha = alpha; }
+
 void sdl_create_image(SDL_Texture *img, vector_t position, vector_t size) {
   SDL_Rect texr;
   texr.x = position.x;
@@ -274,11 +268,9 @@ SDL_Texture *sdl_create_texture(const char *filename) {
 SDL_Surface *sdl_create_message(const char *filename, double curr_time) {
   TTF_Font *Sans = TTF_OpenFont(filename, 24);
   SDL_Color Black = {0, 0, 0};
-  char *temp = malloc(100 * sizeof(char));
-  assert(temp != NULL);
-  sprintf(temp, "Clock: %d", (int)floor(curr_time));
+  char temp[100];
+  snprintf(temp, sizeof(temp), "Clock: %d", (int)floor(curr_time));
   SDL_Surface *ret = TTF_RenderText_Solid(Sans, temp, Black);
-  free(temp);
   return ret;
 }
 
@@ -300,32 +292,13 @@ void sdl_make_text(TTF_Font *font, const char *str, SDL_Color *color,
 }
 
 SDL_Rect *sdl_make_bounding_box(body_t *body) {
-  SDL_Rect *rect = malloc(sizeof(SDL_Rect));
-  assert(rect != NULL);
-  vector_t min, max;
-  min.x = MAXIMUM;
-  min.y = MAXIMUM;
-  max.x = MINIMUM;
-  max.y = MINIMUM;
-  list_t *vertices = body_get_shape(body);
+  SDL_Rect *rect = arena_alloc(frame_arena(), sizeof(SDL_Rect));
+  // Draw the body between where it was and where it is after the last tick
+  vector_t lag = vec_multiply(render_alpha - 1, body_get_last_move(body));
+  aabb_t box = aabb_translate(body_get_aabb(body), lag);
   vector_t window_center = get_window_center();
-  for (size_t i = 0; i < list_size(vertices); i++) {
-    vector_t *vertice = list_get(vertices, i);
-    if (vertice->x < min.x) {
-      min.x = vertice->x;
-    }
-    if (vertice->y < min.y) {
-      min.y = vertice->y;
-    }
-    if (vertice->x > max.x) {
-      max.x = vertice->x;
-    }
-    if (vertice->y > max.y) {
-      max.y = vertice->y;
-    }
-  }
-  vector_t pixel_min = get_window_position(min, window_center);
-  vector_t pixel_max = get_window_position(max, window_center);
+  vector_t pixel_min = get_window_position(box.min, window_center);
+  vector_t pixel_max = get_window_position(box.max, window_center);
   rect->x = (int)pixel_min.x;
   rect->y = (int)pixel_max.y;
   rect->w = (int)(pixel_max.x - pixel_min.x);
@@ -0,0 +1,271 @@
+#include "shape.h"
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+
+struct shape {
+  shape_kind_t kind;
+  // Parameters of analytic kinds: the semi-axes of an ellipse, or the half
+  // length of a capsule's core segment along local x and its radius.
+  // A circle is a capsule whose core has zero length.
+  vector_t semi_axes;
+  double half_length;
+  double round_radius;
+  // Outline in counterclockwise order; analytic kinds are tessellated
+  vector_t *vertices;
+  size_t num_vertices;
+  // Outward unit normal of the edge from each vertex to the next,
+  // or zero for an edge of zero length
+  vector_t *normals;
+  double area;
+  aabb_t bounds;
+  // Distance from the centroid to the farthest point of the shape
+  double radius;
+  size_t num_refs;
+};
+
+const size_t SHAPE_POOL_CHUNK = 64;
+// Vertex arrays are pooled in power-of-two size classes from
+// MIN_POOLED_VERTICES up to MIN_POOLED_VERTICES << (NUM_VERTEX_POOLS - 1).
+// Larger arrays fall back to malloc.
+#define NUM_VERTEX_POOLS 5
+const size_t MIN_POOLED_VERTICES = 4;
+const size_t VERTEX_POOL_CHUNK = 32;
+
+static pool_t *SHAPE_POOL = NULL;
+static pool_t *VERTEX_POOLS[NUM_VERTEX_POOLS];
+
+static pool_t *shape_pool() {
+  if (SHAPE_POOL == NULL) {
+    SHAPE_POOL = pool_init(sizeof(shape_t), SHAPE_POOL_CHUNK);
+  }
+  return SHAPE_POOL;
+}
+
+/**
+ * Gets the pool for vertex arrays of the given length,
+ * or NULL if arrays that long are not pooled.
+ */
+static pool_t *vertex_pool(size_t num_vertices) {
+  size_t size_class = 0;
+  size_t class_vertices = MIN_POOLED_VERTICES;
+  while (class_vertices < num_vertices) {
+    size_class++;
+    class_vertices *= 2;
+  }
+  if (size_class >= NUM_VERTEX_POOLS) {
+    return NULL;
+  }
+  if (VERTEX_POOLS[size_class] == NULL) {
+    VERTEX_POOLS[size_class] =
+        pool_init(sizeof(vector_t) * class_vertices, VERTEX_POOL_CHUNK);
+  }
+  return VERTEX_POOLS[size_class];
+}
+
+vector_t *shape_alloc_vertices(size_t num_vertices) {
+  pool_t *pool = vertex_pool(num_vertices);
+  if (pool == NULL) {
+    vector_t *vertices = malloc(sizeof(vector_t) * num_vertices);
+    assert(vertices != NULL);
+    return vertices;
+  }
+  return pool_alloc(pool);
+}
+
+void shape_free_vertices(vector_t *vertices, size_t num_vertices) {
+  pool_t *pool = vertex_pool(num_vertices);
+  if (pool == NULL) {
+    free(vertices);
+  } else {
+    pool_release(pool, vertices);
+  }
+}
+
+pool_stats_t shape_pool_stats() { return pool_get_stats(shape_pool()); }
+
+pool_stats_t shape_vertex_pool_stats() {
+  pool_stats_t total = {0};
+  for (size_t i = 0; i < NUM_VERTEX_POOLS; i++) {
+    if (VERTEX_POOLS[i] != NULL) {
+      pool_stats_add(&total, pool_get_stats(VERTEX_POOLS[i]));
+    }
+  }
+  return total;
+}
+
+/**
+ * Computes the signed area of a polygon with the shoelace formula.
+ * Positive for counterclockwise vertices.
+ */
+static double signed_area(const vector_t *vertices, size_t size) {
+  double area = 0.0;
+  for (size_t i = 0; i < size; i++) {
+    area += vec_cross(vertices[i], vertices[(i + 1) % size]);
+  }
+  return area / 2.0;
+}
+
+/**
+ * Computes the centroid of a polygon.
+ * Degenerate polygons with no area use the average of their vertices.
+ */
+static vector_t centroid(const vector_t *vertices, size_t size,
+                         double signed_area) {
+  vector_t result = VEC_ZERO;
+  if (size == 0) {
+    return result;
+  }
+  if (size < 3 || signed_area == 0) {
+    for (size_t i = 0; i < size; i++) {
+      result = vec_add(result, vertices[i]);
+    }
+    return vec_multiply(1.0 / size, result);
+  }
+  for (size_t i = 0; i < size; i++) {
+    vector_t vec1 = vertices[i];
+    vector_t vec2 = vertices[(i + 1) % size];
+    double cross = vec_cross(vec1, vec2);
+    result.x += (vec1.x + vec2.x) * cross;
+    result.y += (vec1.y + vec2.y) * cross;
+  }
+  return vec_multiply(1 / (6.0 * signed_area), result);
+}
+
+/**
+ * Allocates a shape with the given outline, moved so that center is at the
+ * origin, and fills in everything derived from the outline.
+ * The caller sets the kind and its parameters.
+ */
+static shape_t *shape_build(const vector_t *vertices, size_t num_vertices,
+                            vector_t center, double area) {
+  shape_t *shape = pool_alloc(shape_pool());
+  shape->kind = SHAPE_POLYGON;
+  shape->semi_axes = VEC_ZERO;
+  shape->half_length = 0.0;
+  shape->round_radius = 0.0;
+  shape->vertices = shape_alloc_vertices(num_vertices);
+  for (size_t i = 0; i < num_vertices; i++) {
+    shape->vertices[i] = vec_subtract(vertices[i], center);
+  }
+  shape->num_vertices = num_vertices;
+  shape->area = fabs(area);
+  shape->bounds = aabb_of_points(shape->vertices, num_vertices);
+  shape->normals = shape_alloc_vertices(num_vertices);
+  shape->radius = 0.0;
+  for (size_t i = 0; i < num_vertices; i++) {
+    vector_t edge = vec_subtract(shape->vertices[(i + 1) % num_vertices],
+                                 shape->vertices[i]);
+    double length = vec_get_length(edge);
+    shape->normals[i] = length == 0 ? VEC_ZERO
+                                    : (vector_t){edge.y / length,
+                                                 -edge.x / length};
+    shape->radius = fmax(shape->radius, vec_get_length(shape->vertices[i]));
+  }
+  shape->num_refs = 1;
+  return shape;
+}
+
+shape_t *shape_init(const vector_t *vertices, size_t num_vertices,
+                    vector_t *centroid_out) {
+  assert(num_vertices == 0 || vertices != NULL);
+  double area = num_vertices < 3 ? 0.0 : signed_area(vertices, num_vertices);
+  vector_t center = centroid(vertices, num_vertices, area);
+  if (centroid_out != NULL) {
+    *centroid_out = center;
+  }
+  return shape_build(vertices, num_vertices, center, area);
+}
+
+shape_t *shape_init_circle(double radius, size_t num_vertices) {
+  return shape_init_capsule(0.0, radius, num_vertices);
+}
+
+shape_t *shape_init_ellipse(double x_radius, double y_radius,
+                            size_t num_vertices) {
+  assert(x_radius > 0 && y_radius > 0);
+  assert(num_vertices >= 3);
+  vector_t vertices[num_vertices];
+  for (size_t i = 0; i < num_vertices; i++) {
+    double angle = 2 * M_PI * i / num_vertices;
+    vertices[i] = (vector_t){x_radius * cos(angle), y_radius * sin(angle)};
+  }
+  double area = M_PI * x_radius * y_radius;
+  shape_t *shape = shape_build(vertices, num_vertices, VEC_ZERO, area);
+  shape->kind = SHAPE_ELLIPSE;
+  shape->semi_axes = (vector_t){x_radius, y_radius};
+  shape->bounds = (aabb_t){{-x_radius, -y_radius}, {x_radius, y_radius}};
+  shape->radius = fmax(x_radius, y_radius);
+  return shape;
+}
+
+shape_t *shape_init_capsule(double half_length, double radius,
+                            size_t num_vertices) {
+  assert(half_length >= 0 && radius > 0);
+  assert(num_vertices >= 3);
+  vector_t vertices[num_vertices];
+  if (half_length == 0) {
+    for (size_t i = 0; i < num_vertices; i++) {
+      double angle = 2 * M_PI * i / num_vertices;
+      vertices[i] = (vector_t){radius * cos(angle), radius * sin(angle)};
+    }
+  } else {
+    // Half of the vertices go around each rounded end
+    assert(num_vertices >= 4 && num_vertices % 2 == 0);
+    size_t end_vertices = num_vertices / 2;
+    for (size_t i = 0; i < end_vertices; i++) {
+      double angle = -M_PI / 2 + M_PI * i / (end_vertices - 1);
+      vector_t offset = {radius * cos(angle), radius * sin(angle)};
+      vertices[i] = (vector_t){half_length + offset.x, offset.y};
+      vertices[end_vertices + i] = (vector_t){-half_length - offset.x,
+                                              -offset.y};
+    }
+  }
+  shape_t *shape =
+      shape_build(vertices, num_vertices, VEC_ZERO,
+                  M_PI * radius * radius + 4 * half_length * radius);
+  shape->kind = half_length == 0 ? SHAPE_CIRCLE : SHAPE_CAPSULE;
+  shape->half_length = half_length;
+  shape->round_radius = radius;
+  shape->radius = half_length + radius;
+  // The tessellated ends may miss the extreme points of the true outline
+  shape->bounds = (aabb_t){{-half_length - radius, -radius},
+                           {half_length + radius, radius}};
+  return shape;
+}
+
+shape_t *shape_retain(shape_t *shape) {
+  assert(shape->num_refs > 0);
+  shape->num_refs++;
+  return shape;
+}
+
+void shape_release(shape_t *shape) {
+  assert(shape->num_refs > 0);
+  shape->num_refs--;
+  if (shape->num_refs == 0) {
+    shape_free_vertices(shape->vertices, shape->num_vertices);
+    shape_free_vertices(shape->normals, shape->num_vertices);
+    pool_release(shape_pool(), shape);
+  }
+}
+
+const vector_t *shape_get_vertices(shape_t *shape) { return shape->vertices; }
+
+size_t shape_num_vertices(shape_t *shape) { return shape->num_vertices; }
+
+double shape_area(shape_t *shape) { return shape->area; }
+
+aabb_t shape_get_aabb(shape_t *shape) { return shape->bounds; }
+
+const vector_t *shape_get_normals(shape_t *shape) { return shape->normals; }
+
+double shape_get_radius(shape_t *shape) { return shape->radius; }
+
+shape_kind_t shape_get_kind(shape_t *shape) { return shape->kind; }
+
+vector_t shape_get_semi_axes(shape_t *shape) { return shape->semi_axes; }
+
+double shape_get_half_length(shape_t *shape) { return shape->half_length; }
+
+double shape_get_round_radius(shape_t *shape) { return shape->round_radius; }
@@ -0,0 +1,151 @@
+#include "str_table.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+const uint64_t FNV_OFFSET_BASIS = 14695981039346656037u;
+const uint64_t FNV_PRIME = 1099511628211u;
+const size_t EMPTY_BUCKET = SIZE_MAX;
+const size_t MIN_BUCKETS = 8;
+
+typedef struct {
+  uint64_t hash;
+  size_t id;
+} bucket_t;
+
+struct str_table {
+  char **strings;
+  uint64_t *hashes;
+  size_t size;
+  size_t capacity;
+  // Open-addressing index with linear probing.
+  // num_buckets is a power of two and at least twice size.
+  bucket_t *buckets;
+  size_t num_buckets;
+};
+
+/**
+ * Hashes a string with 64-bit FNV-1a.
+ */
+static uint64_t hash_string(const char *str) {
+  uint64_t hash = FNV_OFFSET_BASIS;
+  for (const unsigned char *c = (const unsigned char *)str; *c != '\0'; c++) {
+    hash ^= *c;
+    hash *= FNV_PRIME;
+  }
+  return hash;
+}
+
+static bucket_t *buckets_init(size_t num_buckets) {
+  bucket_t *buckets = malloc(sizeof(bucket_t) * num_buckets);
+  assert(buckets != NULL);
+  for (size_t i = 0; i < num_buckets; i++) {
+    buckets[i].id = EMPTY_BUCKET;
+  }
+  return buckets;
+}
+
+/**
+ * Places an ID into the first free bucket along its probe sequence.
+ */
+static void buckets_insert(bucket_t *buckets, size_t num_buckets,
+                           uint64_t hash, size_t id) {
+  size_t mask = num_buckets - 1;
+  size_t i = hash & mask;
+  while (buckets[i].id != EMPTY_BUCKET) {
+    i = (i + 1) & mask;
+  }
+  buckets[i].hash = hash;
+  buckets[i].id = id;
+}
+
+static void str_table_rehash(str_table_t *table, size_t num_buckets) {
+  free(table->buckets);
+  table->buckets = buckets_init(num_buckets);
+  table->num_buckets = num_buckets;
+  for (size_t id = 0; id < table->size; id++) {
+    buckets_insert(table->buckets, num_buckets, table->hashes[id], id);
+  }
+}
+
+str_table_t *str_table_init(size_t initial_capacity) {
+  str_table_t *table = malloc(sizeof(str_table_t));
+  assert(table != NULL);
+  if (initial_capacity == 0) {
+    initial_capacity = 1;
+  }
+  table->strings = malloc(sizeof(char *) * initial_capacity);
+  table->hashes = malloc(sizeof(uint64_t) * initial_capacity);
+  assert(table->strings != NULL && table->hashes != NULL);
+  table->size = 0;
+  table->capacity = initial_capacity;
+
+  size_t num_buckets = MIN_BUCKETS;
+  while (num_buckets < 2 * initial_capacity) {
+    num_buckets *= 2;
+  }
+  table->buckets = buckets_init(num_buckets);
+  table->num_buckets = num_buckets;
+  return table;
+}
+
+void str_table_free(str_table_t *table) {
+  for (size_t i = 0; i < table->size; i++) {
+    free(table->strings[i]);
+  }
+  free(table->strings);
+  free(table->hashes);
+  free(table->buckets);
+  free(table);
+}
+
+size_t str_table_size(str_table_t *table) { return table->size; }
+
+bool str_table_find(str_table_t *table, const char *str, size_t *id) {
+  assert(str != NULL);
+  uint64_t hash = hash_string(str);
+  size_t mask = table->num_buckets - 1;
+  for (size_t i = hash & mask; table->buckets[i].id != EMPTY_BUCKET;
+       i = (i + 1) & mask) {
+    bucket_t bucket = table->buckets[i];
+    if (bucket.hash == hash && strcmp(table->strings[bucket.id], str) == 0) {
+      if (id != NULL) {
+        *id = bucket.id;
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+size_t str_table_intern(str_table_t *table, const char *str) {
+  size_t id;
+  if (str_table_find(table, str, &id)) {
+    return id;
+  }
+
+  if (table->size == table->capacity) {
+    table->capacity *= 2;
+    table->strings = realloc(table->strings, sizeof(char *) * table->capacity);
+    table->hashes = realloc(table->hashes, sizeof(uint64_t) * table->capacity);
+    assert(table->strings != NULL && table->hashes != NULL);
+  }
+  id = table->size;
+  table->strings[id] = strdup(str);
+  assert(table->strings[id] != NULL);
+  table->hashes[id] = hash_string(str);
+  table->size++;
+
+  if (2 * table->size > table->num_buckets) {
+    str_table_rehash(table, table->num_buckets * 2);
+  } else {
+    buckets_insert(table->buckets, table->num_buckets, table->hashes[id], id);
+  }
+  return id;
+}
+
+const char *str_table_get(str_table_t *table, size_t id) {
+  assert(id < table->size);
+  return table->strings[id];
+}
@@ -0,0 +1,125 @@
+#include "thread_pool.h"
+#include <assert.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+struct thread_pool {
+  pthread_t *workers;
+  size_t num_workers;
+  pthread_mutex_t lock;
+  // Signalled when a batch is submitted or the pool is stopping
+  pthread_cond_t work_ready;
+  // Signalled when the last task of a batch finishes
+  pthread_cond_t work_done;
+  // The current batch. All fields below are guarded by lock.
+  thread_pool_task_t task;
+  void *aux;
+  size_t num_tasks;
+  size_t next_task;
+  size_t finished_tasks;
+  // Bumped for every batch, so workers can tell a new one has arrived
+  size_t batch;
+  bool stopping;
+};
+
+/**
+ * Runs tasks of the current batch until there are none left to start.
+ * Must be called with the lock held, and returns with it held.
+ */
+static void thread_pool_work(thread_pool_t *pool) {
+  while (pool->next_task < pool->num_tasks) {
+    size_t index = pool->next_task++;
+    thread_pool_task_t task = pool->task;
+    void *aux = pool->aux;
+    pthread_mutex_unlock(&pool->lock);
+    task(aux, index);
+    pthread_mutex_lock(&pool->lock);
+    if (++pool->finished_tasks == pool->num_tasks) {
+      pthread_cond_signal(&pool->work_done);
+    }
+  }
+}
+
+static void *thread_pool_worker(void *arg) {
+  thread_pool_t *pool = arg;
+  pthread_mutex_lock(&pool->lock);
+  size_t seen_batch = pool->batch;
+  while (true) {
+    while (pool->batch == seen_batch && !pool->stopping) {
+      pthread_cond_wait(&pool->work_ready, &pool->lock);
+    }
+    if (pool->stopping) {
+      break;
+    }
+    seen_batch = pool->batch;
+    thread_pool_work(pool);
+  }
+  pthread_mutex_unlock(&pool->lock);
+  return NULL;
+}
+
+thread_pool_t *thread_pool_init(size_t num_threads) {
+  assert(num_threads > 0);
+  thread_pool_t *pool = malloc(sizeof(thread_pool_t));
+  assert(pool != NULL);
+  pool->workers = malloc(sizeof(pthread_t) * (num_threads - 1));
+  assert(pool->workers != NULL || num_threads == 1);
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->work_ready, NULL);
+  pthread_cond_init(&pool->work_done, NULL);
+  pool->task = NULL;
+  pool->aux = NULL;
+  pool->num_tasks = 0;
+  pool->next_task = 0;
+  pool->finished_tasks = 0;
+  pool->batch = 0;
+  pool->stopping = false;
+  pool->num_workers = 0;
+  for (size_t i = 0; i + 1 < num_threads; i++) {
+    if (pthread_create(&pool->workers[i], NULL, thread_pool_worker, pool) !=
+        0) {
+      // Carry on with the workers we have; the caller picks up the slack
+      break;
+    }
+    pool->num_workers++;
+  }
+  return pool;
+}
+
+void thread_pool_free(thread_pool_t *pool) {
+  pthread_mutex_lock(&pool->lock);
+  pool->stopping = true;
+  pthread_cond_broadcast(&pool->work_ready);
+  pthread_mutex_unlock(&pool->lock);
+  for (size_t i = 0; i < pool->num_workers; i++) {
+    pthread_join(pool->workers[i], NULL);
+  }
+  pthread_cond_destroy(&pool->work_done);
+  pthread_cond_destroy(&pool->work_ready);
+  pthread_mutex_destroy(&pool->lock);
+  free(pool->workers);
+  free(pool);
+}
+
+size_t thread_pool_size(thread_pool_t *pool) { return pool->num_workers + 1; }
+
+void thread_pool_run(thread_pool_t *pool, thread_pool_task_t task, void *aux,
+                     size_t num_tasks) {
+  if (num_tasks == 0) {
+    return;
+  }
+  pthread_mutex_lock(&pool->lock);
+  pool->task = task;
+  pool->aux = aux;
+  pool->num_tasks = num_tasks;
+  pool->next_task = 0;
+  pool->finished_tasks = 0;
+  pool->batch++;
+  pthread_cond_broadcast(&pool->work_ready);
+  thread_pool_work(pool);
+  while (pool->finished_tasks < pool->num_tasks) {
+    pthread_cond_wait(&pool->work_done, &pool->lock);
+  }
+  pthread_mutex_unlock(&pool->lock);
+}
@@ -0,0 +1,143 @@
+#include "broadphase.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Measures how long each broadphase takes to find the overlapping pairs of a
+// game-like scene per frame, against testing every pair of boxes, as the
+// number of bodies grows. The map grows with the body count so the density
+// stays close to the demo's. The last columns give the same scene with the
+// demo's collision filters, where most bodies are goombas that ignore each
+// other.
+
+#define MAX_BODIES 4096
+
+const size_t FRAMES = 200;
+const double BODY_RADIUS = 40;
+// Map area per body: the demo has a few dozen bodies on a 1000 x 500 screen
+const double AREA_PER_BODY = 20000;
+const double MAX_STEP = 5;
+
+static body_t *BODIES[MAX_BODIES];
+
+// The demo's collision categories and masks
+enum {
+  PLAYER = 1 << 0,
+  BULLET = 1 << 1,
+  GOOMBA = 1 << 2,
+  MYSTERY = 1 << 3,
+};
+
+// Keeps the compiler from optimizing away results that are unused
+static volatile size_t SINK;
+
+static double rand_range(double low, double high) {
+  return low + (high - low) * rand() / RAND_MAX;
+}
+
+static void make_bodies(size_t num_bodies) {
+  double side = sqrt(AREA_PER_BODY * num_bodies);
+  for (size_t i = 0; i < num_bodies; i++) {
+    shape_t *shape = shape_init_circle(BODY_RADIUS, 20);
+    vector_t center = {rand_range(0, 2 * side), rand_range(0, side / 2)};
+    BODIES[i] = body_init_from_shape(shape, center, 1, (rgb_color_t){0, 0, 0},
+                                     NULL, NULL);
+    shape_release(shape);
+  }
+}
+
+// Two players, and then mostly goombas with some bullets and mystery boxes
+static void set_filters(size_t num_bodies) {
+  for (size_t i = 0; i < num_bodies; i++) {
+    if (i < 2) {
+      body_set_collision_filter(BODIES[i], PLAYER, BULLET | GOOMBA | MYSTERY);
+    } else if (i % 10 == 0) {
+      body_set_collision_filter(BODIES[i], BULLET, PLAYER | GOOMBA);
+    } else if (i % 10 == 1) {
+      body_set_collision_filter(BODIES[i], MYSTERY, PLAYER);
+    } else {
+      body_set_collision_filter(BODIES[i], GOOMBA, PLAYER | BULLET);
+    }
+  }
+}
+
+static void step_bodies(size_t num_bodies) {
+  for (size_t i = 0; i < num_bodies; i++) {
+    vector_t step = {rand_range(-MAX_STEP, MAX_STEP),
+                     rand_range(-MAX_STEP, MAX_STEP)};
+    body_set_centroid(BODIES[i], vec_add(body_get_centroid(BODIES[i]), step));
+  }
+}
+
+static void free_bodies(size_t num_bodies) {
+  for (size_t i = 0; i < num_bodies; i++) {
+    body_free(BODIES[i]);
+  }
+}
+
+// Returns microseconds per frame, and the average pairs found per frame
+static double time_brute_force(size_t num_bodies, double *pairs) {
+  srand(11);
+  make_bodies(num_bodies);
+  double seconds = 0;
+  size_t total_pairs = 0;
+  for (size_t frame = 0; frame < FRAMES; frame++) {
+    step_bodies(num_bodies);
+    clock_t start = clock();
+    for (size_t i = 0; i < num_bodies; i++) {
+      aabb_t box = body_get_aabb(BODIES[i]);
+      for (size_t j = i + 1; j < num_bodies; j++) {
+        total_pairs += aabb_overlaps(box, body_get_aabb(BODIES[j]));
+      }
+    }
+    seconds += (double)(clock() - start) / CLOCKS_PER_SEC;
+  }
+  free_bodies(num_bodies);
+  *pairs = (double)total_pairs / FRAMES;
+  return seconds / FRAMES * 1e6;
+}
+
+static double time_broadphase(size_t num_bodies, broadphase_kind_t kind,
+                              bool filtered, double *pairs) {
+  srand(11);
+  make_bodies(num_bodies);
+  if (filtered) {
+    set_filters(num_bodies);
+  }
+  broadphase_t *broadphase = broadphase_init(kind, 2 * BODY_RADIUS);
+  for (size_t i = 0; i < num_bodies; i++) {
+    broadphase_add(broadphase, BODIES[i], BODIES[i]);
+  }
+  for (size_t frame = 0; frame < FRAMES; frame++) {
+    step_bodies(num_bodies);
+    SINK = broadphase_update(broadphase);
+  }
+  broadphase_stats_t stats = broadphase_get_stats(broadphase);
+  broadphase_free(broadphase);
+  free_bodies(num_bodies);
+  *pairs = (double)stats.total_pairs / stats.num_updates;
+  return stats.total_seconds / stats.num_updates * 1e6;
+}
+
+int main() {
+  printf("%7s %12s %12s %12s %10s %12s %10s\n", "bodies", "brute us",
+         "grid us", "sweep us", "pairs", "masked us", "pairs");
+  for (size_t num_bodies = 16; num_bodies <= MAX_BODIES; num_bodies *= 4) {
+    double brute_pairs, grid_pairs, sweep_pairs, masked_pairs;
+    double brute = time_brute_force(num_bodies, &brute_pairs);
+    double grid =
+        time_broadphase(num_bodies, BROADPHASE_GRID, false, &grid_pairs);
+    double sweep =
+        time_broadphase(num_bodies, BROADPHASE_SWEEP, false, &sweep_pairs);
+    double masked =
+        time_broadphase(num_bodies, BROADPHASE_SWEEP, true, &masked_pairs);
+    if (grid_pairs != brute_pairs || sweep_pairs != brute_pairs) {
+      printf("pair counts differ: %f %f %f\n", brute_pairs, grid_pairs,
+             sweep_pairs);
+      return 1;
+    }
+    printf("%7zu %12.1f %12.1f %12.1f %10.1f %12.1f %10.1f\n", num_bodies,
+           brute, grid, sweep, brute_pairs, masked, masked_pairs);
+  }
+}
@@ -0,0 +1,215 @@
+#include "body.h"
+#include "collision.h"
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Measures narrowphase throughput (pairs tested per second) of find_collision
+// against the list-based implementation it replaced, which copied both shapes
+// with body_get_shape and allocated an edge list for every test, and against
+// find_collision_gjk, which sends every pair through GJK instead of the
+// specialized kernels.
+//
+// The hit counts differ where the two disagree. The old code rotated edges by
+// 3.14 / 2, so its axes were tilted by about 8e-4 radians and it missed gaps
+// of a few thousandths along long edges: in the dense scene it reports two
+// pairs as colliding that are 0.0039 and 0.0012 apart. In the circle scene
+// the new code tests true circles rather than their polygon outlines.
+
+const size_t NUM_BODIES = 200;
+const size_t NUM_SIDES = 20;
+const size_t MANY_SIDES = 100;
+const double MIN_RADIUS = 10;
+const double MAX_RADIUS = 40;
+const double BENCH_SECONDS = 1;
+
+/* ---- Previous implementation, kept verbatim for comparison ---- */
+
+const double LEGACY_PI = 3.14;
+const double LEGACY_TWO = 2;
+
+static list_t *legacy_get_edges(list_t *shape) {
+  list_t *edges = list_init(list_size(shape), free);
+  for (size_t i = 0; i < list_size(shape); i++) {
+    vector_t *vec = malloc(sizeof(vector_t));
+    assert(vec);
+    *vec =
+        vec_subtract(*(vector_t *)list_get(shape, i % list_size(shape)),
+                     *(vector_t *)list_get(shape, (i + 1) % list_size(shape)));
+    list_add(edges, vec);
+  }
+  return edges;
+}
+
+static vector_t legacy_get_max_min_projections(list_t *shape,
+                                               vector_t unit_axis) {
+  double min = INFINITY;
+  double max = -INFINITY;
+  for (size_t i = 0; i < list_size(shape); i++) {
+    vector_t vertex = *(vector_t *)list_get(shape, i);
+    double projection = vec_dot(vertex, unit_axis);
+    if (projection < min) {
+      min = projection;
+    }
+    if (projection > max) {
+      max = projection;
+    }
+  }
+  return (vector_t){max, min};
+}
+
+static collision_info_t legacy_compare_collision(list_t *shape1,
+                                                 list_t *shape2,
+                                                 double *min_overlap) {
+  list_t *edges1 = legacy_get_edges(shape1);
+  vector_t axis = VEC_ZERO;
+  for (size_t i = 0; i < list_size(edges1); i++) {
+    vector_t *edge = list_get(edges1, i);
+    vector_t unit_axis = vec_rotate(*edge, LEGACY_PI / LEGACY_TWO);
+    unit_axis = vec_multiply(1.0 / vec_get_length(unit_axis), unit_axis);
+    vector_t proj_shape1 = legacy_get_max_min_projections(shape1, unit_axis);
+    vector_t proj_shape2 = legacy_get_max_min_projections(shape2, unit_axis);
+
+    double overlap =
+        fmin(proj_shape1.x, proj_shape2.x) - fmax(proj_shape1.y, proj_shape2.y);
+    if (overlap < 0) {
+      list_free(edges1);
+      return (collision_info_t){.collided = false, .axis = VEC_ZERO};
+    }
+    if (proj_shape1.x >= proj_shape2.y && proj_shape1.y <= proj_shape2.x) {
+      overlap = (proj_shape2.x - proj_shape1.y);
+    } else if (proj_shape2.x >= proj_shape1.y &&
+               proj_shape2.y <= proj_shape2.x) {
+      overlap = (proj_shape1.x - proj_shape2.y);
+    }
+    if (overlap < *min_overlap) {
+      *min_overlap = overlap;
+      axis = unit_axis;
+    }
+  }
+  list_free(edges1);
+  return (collision_info_t){.collided = true, .axis = axis};
+}
+
+static collision_info_t legacy_find_collision(body_t *body1, body_t *body2) {
+  list_t *shape1 = body_get_shape(body1);
+  list_t *shape2 = body_get_shape(body2);
+  double c1_overlap = __DBL_MAX__;
+  double c2_overlap = __DBL_MAX__;
+  collision_info_t collision1 =
+      legacy_compare_collision(shape1, shape2, &c1_overlap);
+  collision_info_t collision2 =
+      legacy_compare_collision(shape2, shape1, &c2_overlap);
+  list_free(shape1);
+  list_free(shape2);
+  if (!collision1.collided) {
+    return collision1;
+  }
+  if (!collision2.collided) {
+    return collision2;
+  }
+  if (c1_overlap < c2_overlap) {
+    return collision1;
+  }
+  return collision2;
+}
+
+/* ---- Benchmark ---- */
+
+typedef collision_info_t (*narrowphase_t)(body_t *body1, body_t *body2);
+
+static double rand_range(double low, double high) {
+  return low + (high - low) * rand() / RAND_MAX;
+}
+
+static body_t *make_ngon(vector_t center, size_t num_sides) {
+  double rx = rand_range(MIN_RADIUS, MAX_RADIUS);
+  double ry = rand_range(MIN_RADIUS, MAX_RADIUS);
+  vector_t points[num_sides];
+  for (size_t i = 0; i < num_sides; i++) {
+    double angle = 2 * M_PI * i / num_sides;
+    points[i] = (vector_t){center.x + rx * cos(angle),
+                           center.y + ry * sin(angle)};
+  }
+  body_t *body = body_init_from_vertices(points, num_sides, 1,
+                                         (rgb_color_t){0, 0, 0}, NULL, NULL);
+  body_set_rotation(body, rand_range(0, M_PI));
+  return body;
+}
+
+static body_t *make_ellipse(vector_t center) {
+  return make_ngon(center, NUM_SIDES);
+}
+
+// Polygons with many vertices, where SAT's cost grows quadratically
+static body_t *make_many_sided(vector_t center) {
+  return make_ngon(center, MANY_SIDES);
+}
+
+// Circles as the game builds them, tested through the circle kernels
+static body_t *make_circle(vector_t center) {
+  shape_t *shape =
+      shape_init_circle(rand_range(MIN_RADIUS, MAX_RADIUS), NUM_SIDES);
+  body_t *body = body_init_from_shape(shape, center, 1, (rgb_color_t){0, 0, 0},
+                                      NULL, NULL);
+  shape_release(shape);
+  return body;
+}
+
+/**
+ * Tests every pair of bodies repeatedly for about BENCH_SECONDS.
+ * Returns pairs per second, and stores how many pairs collided in one pass.
+ */
+static double time_pairs(body_t **bodies, narrowphase_t find,
+                         size_t *num_collided) {
+  size_t pairs = 0;
+  clock_t start = clock();
+  clock_t end = start + BENCH_SECONDS * CLOCKS_PER_SEC;
+  do {
+    *num_collided = 0;
+    for (size_t i = 0; i < NUM_BODIES; i++) {
+      for (size_t j = i + 1; j < NUM_BODIES; j++) {
+        *num_collided += find(bodies[i], bodies[j]).collided;
+      }
+    }
+    pairs += NUM_BODIES * (NUM_BODIES - 1) / 2;
+  } while (clock() < end);
+  return pairs / ((double)(clock() - start) / CLOCKS_PER_SEC);
+}
+
+static void run_scene(const char *name, vector_t extent,
+                      body_t *(*make_body)(vector_t center)) {
+  body_t *bodies[NUM_BODIES];
+  for (size_t i = 0; i < NUM_BODIES; i++) {
+    bodies[i] = make_body(
+        (vector_t){rand_range(0, extent.x), rand_range(0, extent.y)});
+  }
+  size_t legacy_collided, collided, gjk_collided;
+  double legacy_rate =
+      time_pairs(bodies, legacy_find_collision, &legacy_collided);
+  double rate = time_pairs(bodies, find_collision, &collided);
+  double gjk_rate = time_pairs(bodies, find_collision_gjk, &gjk_collided);
+  // GJK must agree with the specialized kernels
+  assert(gjk_collided == collided);
+  printf("%-8s %12.0f %12.0f %12.0f %7.1fx %10zu %10zu\n", name, legacy_rate,
+         rate, gjk_rate, rate / legacy_rate, legacy_collided, collided);
+  for (size_t i = 0; i < NUM_BODIES; i++) {
+    body_free(bodies[i]);
+  }
+}
+
+int main() {
+  srand(3);
+  printf("%-8s %12s %12s %12s %8s %10s %10s\n", "scene", "before", "after",
+         "GJK only", "speedup", "hits before", "hits after");
+  // Pairs per second for each narrowphase
+  // Spread out like a game level: most pairs are far apart
+  run_scene("sparse", (vector_t){1000, 500}, make_ellipse);
+  // Packed together: most pairs need the full SAT test
+  run_scene("dense", (vector_t){100, 100}, make_ellipse);
+  run_scene("100-gons", (vector_t){100, 100}, make_many_sided);
+  // The dense scene again with every body a circle
+  run_scene("circles", (vector_t){100, 100}, make_circle);
+}
@@ -0,0 +1,68 @@
+#include "forces.h"
+#include "scene.h"
+#include "scheduler.h"
+#include <stdio.h>
+
+// Measures scene_tick on bodies falling under gravity and drag, applied the
+// old way, with a body_add_force() call per body before each tick and a drag
+// force creator per body, and with a gravity field and a drag field.
+// Moving the bodies and keeping the spatial index up to date take most of
+// the tick either way, so the difference here is much smaller than the
+// difference between the force passes themselves.
+
+#define NUM_SIZES 3
+
+const size_t SIZES[NUM_SIZES] = {1000, 10000, 100000};
+const size_t TICKS = 20;
+const double DT = 1.0 / 120;
+const double SPACING = 4;
+const double DRAG_GAMMA = 0.5;
+const vector_t GRAVITY = {0, -2000};
+const uint32_t FALLING_CATEGORY = 1 << 1;
+
+static scene_t *make_scene(size_t num_bodies, bool fields) {
+  scene_t *scene = scene_init();
+  size_t width = 250;
+  for (size_t i = 0; i < num_bodies; i++) {
+    shape_t *shape = shape_init_circle(1, 8);
+    vector_t center = {(i % width) * SPACING, (i / width) * SPACING};
+    body_t *body = body_init_from_shape(shape, center, 1,
+                                        (rgb_color_t){0, 0, 0}, NULL, NULL);
+    shape_release(shape);
+    // Nothing collides, so only the forces cost anything
+    body_set_collision_filter(body, FALLING_CATEGORY, 0);
+    scene_add_body(scene, body);
+    if (!fields) {
+      create_drag(scene, DRAG_GAMMA, body);
+    }
+  }
+  if (fields) {
+    create_gravity_field(scene, FALLING_CATEGORY, GRAVITY);
+    create_drag_field(scene, FALLING_CATEGORY, DRAG_GAMMA);
+  }
+  return scene;
+}
+
+static double time_ticks(size_t num_bodies, bool fields) {
+  scene_t *scene = make_scene(num_bodies, fields);
+  double start = scheduler_now();
+  for (size_t t = 0; t < TICKS; t++) {
+    for (size_t i = 0; !fields && i < num_bodies; i++) {
+      body_add_force(scene_get_body(scene, i), GRAVITY);
+    }
+    scene_tick(scene, DT);
+  }
+  double ms = (scheduler_now() - start) / TICKS * 1e3;
+  scene_free(scene);
+  return ms;
+}
+
+int main() {
+  printf("%10s %10s %12s\n", "bodies", "forces", "ms per tick");
+  for (size_t s = 0; s < NUM_SIZES; s++) {
+    printf("%10zu %10s %12.3f\n", SIZES[s], "per body",
+           time_ticks(SIZES[s], false));
+    printf("%10zu %10s %12.3f\n", SIZES[s], "fields",
+           time_ticks(SIZES[s], true));
+  }
+}
@@ -0,0 +1,189 @@
+#include "forces.h"
+#include "scene.h"
+#include "scheduler.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Measures how far each integrator lets the energy of a conservative scene
+// drift, across a range of tick lengths. The springs are a ring of masses on
+// springs, shaken out of place; the orbits are planets circling a heavy star.
+// For each integrator, the largest tick that keeps the drift under
+// MAX_DRIFT is reported, along with how many force creator passes it takes
+// per simulated second. That is what a server pays for.
+
+#define NUM_RING 64
+#define NUM_PLANETS 4
+#define NUM_DTS 8
+#define NUM_INTEGRATORS 4
+
+const double MAX_DRIFT = 1e-3;
+const double FIRST_DT = 1e-3;
+
+const double RING_MASS = 1;
+const double RING_K = 100;
+const double RING_RADIUS = 50;
+const double RING_JITTER = 2;
+const double RING_TIME = 20;
+
+const double ORBIT_G = 1;
+const double STAR_MASS = 1e4;
+const double PLANET_MASS = 1;
+const double FIRST_ORBIT = 20;
+const double ORBIT_TIME = 100;
+
+const char *INTEGRATOR_NAMES[NUM_INTEGRATORS] = {
+    "trapezoidal", "semi-implicit euler", "velocity verlet", "rk4"};
+
+typedef struct {
+  const char *name;
+  double time;
+  scene_t *(*make)(integrator_t integrator);
+  double (*energy)(scene_t *scene);
+} workload_t;
+
+static body_t *make_body(scene_t *scene, vector_t center, double mass) {
+  shape_t *shape = shape_init_circle(1, 8);
+  body_t *body = body_init_from_shape(shape, center, mass,
+                                      (rgb_color_t){0, 0, 0}, NULL, NULL);
+  shape_release(shape);
+  scene_add_body(scene, body);
+  return body;
+}
+
+static double kinetic_energy(scene_t *scene) {
+  double energy = 0;
+  for (size_t i = 0; i < scene_bodies(scene); i++) {
+    body_t *body = scene_get_body(scene, i);
+    if (isfinite(body_get_mass(body))) {
+      vector_t v = body_get_velocity(body);
+      energy += body_get_mass(body) * vec_dot(v, v) / 2;
+    }
+  }
+  return energy;
+}
+
+static scene_t *make_ring(integrator_t integrator) {
+  scene_t *scene = scene_init();
+  scene_set_integrator(scene, integrator);
+  // The same shake every run
+  srand(1);
+  for (size_t i = 0; i < NUM_RING; i++) {
+    double angle = 2 * M_PI * i / NUM_RING;
+    vector_t jitter = {RING_JITTER * (rand() / (double)RAND_MAX - 0.5),
+                       RING_JITTER * (rand() / (double)RAND_MAX - 0.5)};
+    vector_t center = vec_add(
+        vec_multiply(RING_RADIUS, (vector_t){cos(angle), sin(angle)}), jitter);
+    make_body(scene, center, RING_MASS);
+  }
+  for (size_t i = 0; i < NUM_RING; i++) {
+    create_spring(scene, RING_K, scene_get_body(scene, i),
+                  scene_get_body(scene, (i + 1) % NUM_RING));
+  }
+  return scene;
+}
+
+static double ring_energy(scene_t *scene) {
+  double energy = kinetic_energy(scene);
+  for (size_t i = 0; i < NUM_RING; i++) {
+    body_t *body1 = scene_get_body(scene, i);
+    body_t *body2 = scene_get_body(scene, (i + 1) % NUM_RING);
+    vector_t stretch =
+        vec_subtract(body_get_centroid(body1), body_get_centroid(body2));
+    energy += RING_K * vec_dot(stretch, stretch) / 2;
+  }
+  return energy;
+}
+
+static scene_t *make_orbits(integrator_t integrator) {
+  scene_t *scene = scene_init();
+  scene_set_integrator(scene, integrator);
+  body_t *star = make_body(scene, VEC_ZERO, STAR_MASS);
+  double radius = FIRST_ORBIT;
+  for (size_t i = 0; i < NUM_PLANETS; i++) {
+    body_t *planet = make_body(scene, (vector_t){radius, 0}, PLANET_MASS);
+    body_set_velocity(planet,
+                      (vector_t){0, sqrt(ORBIT_G * STAR_MASS / radius)});
+    create_newtonian_gravity(scene, ORBIT_G, star, planet);
+    radius *= 2;
+  }
+  return scene;
+}
+
+static double orbit_energy(scene_t *scene) {
+  double energy = kinetic_energy(scene);
+  body_t *star = scene_get_body(scene, 0);
+  for (size_t i = 1; i < scene_bodies(scene); i++) {
+    body_t *planet = scene_get_body(scene, i);
+    vector_t r =
+        vec_subtract(body_get_centroid(planet), body_get_centroid(star));
+    energy -= ORBIT_G * STAR_MASS * PLANET_MASS / vec_get_length(r);
+  }
+  return energy;
+}
+
+// Returns the largest relative drift in the energy over the run
+static double max_drift(workload_t *workload, integrator_t integrator,
+                        double dt, double *ms) {
+  scene_t *scene = workload->make(integrator);
+  double initial = workload->energy(scene);
+  double drift = 0;
+  size_t ticks = (size_t)round(workload->time / dt);
+  double start = scheduler_now();
+  for (size_t i = 0; i < ticks; i++) {
+    scene_tick(scene, dt);
+    double energy = workload->energy(scene);
+    double error = fabs((energy - initial) / initial);
+    // A blown up run is as bad as it gets
+    drift = isfinite(error) ? fmax(drift, error) : INFINITY;
+  }
+  *ms = (scheduler_now() - start) * 1e3;
+  scene_free(scene);
+  return drift;
+}
+
+static void run_workload(workload_t *workload) {
+  printf("%s, %g simulated seconds: largest relative energy drift\n",
+         workload->name, workload->time);
+  printf("%20s", "dt");
+  for (size_t d = 0; d < NUM_DTS; d++) {
+    printf(" %9g", FIRST_DT * (1 << d));
+  }
+  printf(" %9s %14s %9s\n", "stable dt", "passes per s", "ms");
+  for (integrator_t integrator = 0; integrator < NUM_INTEGRATORS;
+       integrator++) {
+    printf("%20s", INTEGRATOR_NAMES[integrator]);
+    // The largest dt that, like every smaller one, keeps the drift down
+    double stable_dt = 0;
+    double stable_ms = 0;
+    bool stable = true;
+    for (size_t d = 0; d < NUM_DTS; d++) {
+      double dt = FIRST_DT * (1 << d);
+      double ms;
+      double drift = max_drift(workload, integrator, dt, &ms);
+      printf(" %9.2g", drift);
+      stable = stable && drift < MAX_DRIFT;
+      if (stable) {
+        stable_dt = dt;
+        stable_ms = ms;
+      }
+    }
+    if (stable_dt > 0) {
+      printf(" %9g %14.0f %9.2f\n", stable_dt,
+             integrator_num_stages(integrator) / stable_dt, stable_ms);
+    } else {
+      printf(" %9s %14s %9s\n", "none", "-", "-");
+    }
+  }
+  printf("\n");
+}
+
+int main() {
+  workload_t workloads[] = {
+      {"springs", RING_TIME, make_ring, ring_energy},
+      {"orbits", ORBIT_TIME, make_orbits, orbit_energy},
+  };
+  for (size_t i = 0; i < sizeof(workloads) / sizeof(workloads[0]); i++) {
+    run_workload(&workloads[i]);
+  }
+}
@@ -0,0 +1,131 @@
+#include "forces.h"
+#include "nbody.h"
+#include "scene.h"
+#include "scheduler.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Measures gravity between every pair of n bodies three ways: a force creator
+// per pair, the exact sum in one pass, and Barnes-Hut at a few thetas. The
+// error is the total error in the forces relative to the total force, against
+// the exact sum. The last table ticks whole scenes with create_nbody_gravity.
+
+#define NUM_SIZES 3
+#define NUM_THETAS 3
+
+const size_t SIZES[NUM_SIZES] = {1000, 10000, 100000};
+const double THETAS[NUM_THETAS] = {0.3, 0.5, 0.8};
+// The exact sum and the creators per pair take too long beyond these
+const size_t MAX_EXACT = 10000;
+const size_t MAX_PAIRWISE = 1000;
+const double G = 1;
+const double MIN_DISTANCE = 5;
+const double DISK_RADIUS = 1e4;
+const size_t SCENE_TICKS = 5;
+const double DT = 1e-3;
+
+static vector_t random_point() {
+  // Spread evenly over a disk
+  double r = DISK_RADIUS * sqrt(rand() / (double)RAND_MAX);
+  double angle = 2 * M_PI * rand() / RAND_MAX;
+  return (vector_t){r * cos(angle), r * sin(angle)};
+}
+
+static double time_forces(nbody_t *solver, size_t n, vector_t *positions,
+                          double *masses, double theta, vector_t *forces) {
+  double start = scheduler_now();
+  nbody_forces(solver, n, positions, masses, G, theta, MIN_DISTANCE, forces);
+  return (scheduler_now() - start) * 1e3;
+}
+
+static double relative_error(size_t n, vector_t *approx, vector_t *exact) {
+  double error = 0;
+  double size = 0;
+  for (size_t i = 0; i < n; i++) {
+    error += vec_get_length(vec_subtract(approx[i], exact[i]));
+    size += vec_get_length(exact[i]);
+  }
+  return error / size;
+}
+
+static scene_t *make_scene(size_t n, bool pairwise, double theta) {
+  scene_t *scene = scene_init();
+  for (size_t i = 0; i < n; i++) {
+    shape_t *shape = shape_init_circle(1, 8);
+    body_t *body = body_init_from_shape(shape, random_point(), 1 + i % 3,
+                                        (rgb_color_t){0, 0, 0}, NULL, NULL);
+    shape_release(shape);
+    scene_add_body(scene, body);
+    for (size_t j = 0; pairwise && j < i; j++) {
+      create_newtonian_gravity(scene, G, body, scene_get_body(scene, j));
+    }
+  }
+  if (!pairwise) {
+    create_nbody_gravity(scene, G, theta);
+  }
+  return scene;
+}
+
+static double time_scene(size_t n, bool pairwise, double theta) {
+  srand(1);
+  scene_t *scene = make_scene(n, pairwise, theta);
+  double start = scheduler_now();
+  for (size_t i = 0; i < SCENE_TICKS; i++) {
+    scene_tick(scene, DT);
+  }
+  double ms = (scheduler_now() - start) / SCENE_TICKS * 1e3;
+  scene_free(scene);
+  return ms;
+}
+
+int main() {
+  size_t max_size = SIZES[NUM_SIZES - 1];
+  vector_t *positions = malloc(sizeof(vector_t) * max_size);
+  double *masses = malloc(sizeof(double) * max_size);
+  vector_t *exact = malloc(sizeof(vector_t) * max_size);
+  vector_t *approx = malloc(sizeof(vector_t) * max_size);
+  nbody_t *solver = nbody_init();
+
+  printf("%8s %10s %12s %12s\n", "bodies", "method", "ms per pass",
+         "error");
+  for (size_t s = 0; s < NUM_SIZES; s++) {
+    size_t n = SIZES[s];
+    srand(1);
+    for (size_t i = 0; i < n; i++) {
+      positions[i] = random_point();
+      masses[i] = 1 + i % 3;
+    }
+    bool have_exact = n <= MAX_EXACT;
+    if (have_exact) {
+      double ms = time_forces(solver, n, positions, masses, 0, exact);
+      printf("%8zu %10s %12.2f %12s\n", n, "exact", ms, "-");
+    }
+    for (size_t t = 0; t < NUM_THETAS; t++) {
+      double ms = time_forces(solver, n, positions, masses, THETAS[t], approx);
+      char method[16];
+      snprintf(method, sizeof(method), "bh %.1f", THETAS[t]);
+      if (have_exact) {
+        printf("%8zu %10s %12.2f %12.2e\n", n, method, ms,
+               relative_error(n, approx, exact));
+      } else {
+        printf("%8zu %10s %12.2f %12s\n", n, method, ms, "-");
+      }
+    }
+  }
+
+  printf("\n%8s %10s %12s\n", "bodies", "scene", "ms per tick");
+  for (size_t s = 0; s < NUM_SIZES; s++) {
+    size_t n = SIZES[s];
+    if (n <= MAX_PAIRWISE) {
+      printf("%8zu %10s %12.2f\n", n, "pairwise", time_scene(n, true, 0));
+    }
+    printf("%8zu %10s %12.2f\n", n, "bh 0.5", time_scene(n, false, 0.5));
+  }
+
+  nbody_free(solver);
+  free(positions);
+  free(masses);
+  free(exact);
+  free(approx);
+}
@@ -0,0 +1,96 @@
+#include "forces.h"
+#include "scene.h"
+#include "scheduler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Measures scene_tick on a large spring and gravity scene as the number of
+// threads grows. Wall time is measured, since clock() adds up the CPU time of
+// every thread. Each thread count is run twice to check that the results are
+// exactly the same; they are also compared against a single thread.
+// The speedup column only shows scaling on a machine with at least as many
+// cores as threads. On fewer, it shows the cost of the buffered path.
+
+#define GRID_WIDTH 250
+#define GRID_HEIGHT 200
+#define NUM_BODIES (GRID_WIDTH * GRID_HEIGHT)
+#define MAX_THREADS 8
+
+const size_t TICKS = 20;
+const double SPACING = 4;
+const double SPRING_K = 10;
+const double GRAVITY_G = 50;
+const double DRAG_GAMMA = 0.5;
+const double DT = 1e-3;
+
+static vector_t POSITIONS[NUM_BODIES];
+
+static scene_t *make_scene(size_t num_threads) {
+  scene_t *scene = scene_init();
+  scene_set_threads(scene, num_threads);
+  for (size_t i = 0; i < NUM_BODIES; i++) {
+    shape_t *shape = shape_init_circle(1, 8);
+    vector_t center = {(i % GRID_WIDTH) * SPACING, (i / GRID_WIDTH) * SPACING};
+    body_t *body = body_init_from_shape(shape, center, 1 + i % 3,
+                                        (rgb_color_t){0, 0, 0}, NULL, NULL);
+    shape_release(shape);
+    scene_add_body(scene, body);
+  }
+  for (size_t i = 0; i < NUM_BODIES; i++) {
+    body_t *body = scene_get_body(scene, i);
+    if (i % GRID_WIDTH + 1 < GRID_WIDTH) {
+      create_spring(scene, SPRING_K, body, scene_get_body(scene, i + 1));
+    }
+    if (i + GRID_WIDTH < NUM_BODIES) {
+      create_spring(scene, SPRING_K, body,
+                    scene_get_body(scene, i + GRID_WIDTH));
+    }
+    create_newtonian_gravity(scene, GRAVITY_G, body,
+                             scene_get_body(scene, (i * 7919) % NUM_BODIES));
+    create_drag(scene, DRAG_GAMMA, body);
+  }
+  return scene;
+}
+
+// Returns milliseconds per tick, and leaves the final positions in POSITIONS
+static double time_ticks(size_t num_threads) {
+  scene_t *scene = make_scene(num_threads);
+  double start = scheduler_now();
+  for (size_t i = 0; i < TICKS; i++) {
+    scene_tick(scene, DT);
+  }
+  double ms = (scheduler_now() - start) / TICKS * 1e3;
+  for (size_t i = 0; i < NUM_BODIES; i++) {
+    POSITIONS[i] = body_get_centroid(scene_get_body(scene, i));
+  }
+  scene_free(scene);
+  return ms;
+}
+
+int main() {
+  static vector_t serial[NUM_BODIES], first[NUM_BODIES];
+  printf("%8s %12s %10s %14s %16s\n", "threads", "ms per tick", "speedup",
+         "reproducible", "max diff vs 1");
+  double serial_ms = 0;
+  for (size_t threads = 1; threads <= MAX_THREADS; threads *= 2) {
+    double ms = time_ticks(threads);
+    memcpy(first, POSITIONS, sizeof(POSITIONS));
+    time_ticks(threads);
+    bool same = memcmp(first, POSITIONS, sizeof(POSITIONS)) == 0;
+    if (threads == 1) {
+      serial_ms = ms;
+      memcpy(serial, POSITIONS, sizeof(POSITIONS));
+    }
+    double max_diff = 0;
+    for (size_t i = 0; i < NUM_BODIES; i++) {
+      double diff = vec_get_length(vec_subtract(POSITIONS[i], serial[i]));
+      max_diff = diff > max_diff ? diff : max_diff;
+    }
+    printf("%8zu %12.2f %10.2f %14s %16.3g\n", threads, ms, serial_ms / ms,
+           same ? "yes" : "NO", max_diff);
+    if (!same) {
+      return 1;
+    }
+  }
+}
@@ -0,0 +1,85 @@
+#include "forces.h"
+#include "scene.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Measures the cost of a scene_tick that removes bodies, as the number of
+// force creators grows, against a tick that removes nothing. Every body is
+// tied to the next few by springs, so each one has a handful of force
+// creators. The last column is what the removals add to the tick.
+// This only uses the scene API, so it also builds against trees from before
+// force creators were indexed by body, to compare the two teardowns.
+
+#define MAX_BODIES 4000
+#define SPRINGS_PER_BODY 10
+
+const size_t REPEATS = 20;
+const double BODY_SPACING = 10;
+const double SPRING_CONST = 1;
+const double TICK = 1e-3;
+
+static body_t *BODIES[MAX_BODIES];
+
+static double elapsed_us(clock_t start) {
+  return (double)(clock() - start) / CLOCKS_PER_SEC * 1e6;
+}
+
+static scene_t *make_scene(size_t num_bodies) {
+  scene_t *scene = scene_init();
+  for (size_t i = 0; i < num_bodies; i++) {
+    shape_t *shape = shape_init_circle(1, 8);
+    vector_t center = {i * BODY_SPACING, 0};
+    BODIES[i] = body_init_from_shape(shape, center, 1, (rgb_color_t){0, 0, 0},
+                                     NULL, NULL);
+    shape_release(shape);
+    scene_add_body(scene, BODIES[i]);
+  }
+  for (size_t i = 0; i < num_bodies; i++) {
+    for (size_t j = 1; j <= SPRINGS_PER_BODY; j++) {
+      body_t *other = BODIES[(i + j) % num_bodies];
+      create_spring(scene, SPRING_CONST, BODIES[i], other);
+    }
+  }
+  return scene;
+}
+
+// Returns microseconds for a tick removing num_removed bodies, and fills in
+// the cost of a tick removing none
+static double time_teardown(size_t num_bodies, size_t num_removed,
+                            double *idle_us) {
+  double total = 0;
+  *idle_us = 0;
+  for (size_t r = 0; r < REPEATS; r++) {
+    scene_t *scene = make_scene(num_bodies);
+    scene_tick(scene, TICK);
+    clock_t start = clock();
+    scene_tick(scene, TICK);
+    *idle_us += elapsed_us(start);
+
+    for (size_t i = 0; i < num_removed; i++) {
+      body_remove(BODIES[i * (num_bodies / num_removed)]);
+    }
+    start = clock();
+    scene_tick(scene, TICK);
+    total += elapsed_us(start);
+    scene_free(scene);
+  }
+  *idle_us /= REPEATS;
+  return total / REPEATS;
+}
+
+int main() {
+  printf("%8s %8s %12s %12s %12s\n", "creators", "removed", "idle us",
+         "removal us", "added us");
+  for (size_t num_bodies = 250; num_bodies <= MAX_BODIES; num_bodies *= 4) {
+    size_t removals[] = {1, num_bodies / 10};
+    for (size_t i = 0; i < sizeof(removals) / sizeof(removals[0]); i++) {
+      double idle;
+      double removal = time_teardown(num_bodies, removals[i], &idle);
+      printf("%8zu %8zu %12.1f %12.1f %12.1f\n",
+             num_bodies * SPRINGS_PER_BODY, removals[i], idle, removal,
+             removal - idle);
+    }
+  }
+}
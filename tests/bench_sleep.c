@@ -0,0 +1,79 @@
+#include "forces.h"
+#include "scene.h"
+#include "scheduler.h"
+#include <stdio.h>
+
+// Measures scene_tick on a mostly idle map: a grid of bodies at rest, each
+// with its own drag, and a few bodies flying across it. Without sleep every
+// body is integrated and every drag is run each tick; with it, only the
+// moving bodies should cost anything, as when the resting bodies are static.
+
+#define NUM_SIZES 3
+
+const size_t MAP_SIZES[NUM_SIZES] = {1000, 10000, 50000};
+const size_t NUM_MOVING = 100;
+const size_t SETTLE_TICKS = 100;
+const size_t TICKS = 100;
+const double SPACING = 4;
+const double DRAG_GAMMA = 0.5;
+const double DT = 1.0 / 120;
+const uint32_t SLEEP_TICKS = 30;
+const double SLEEP_SPEED = 1e-3;
+
+typedef enum {
+  MAP_AWAKE,
+  MAP_SLEEPING,
+  MAP_STATIC,
+} map_mode_t;
+
+const char *MODE_NAMES[] = {"awake", "sleeping", "static"};
+
+static body_t *make_body(scene_t *scene, vector_t center) {
+  shape_t *shape = shape_init_circle(1, 8);
+  body_t *body = body_init_from_shape(shape, center, 1,
+                                      (rgb_color_t){0, 0, 0}, NULL, NULL);
+  shape_release(shape);
+  scene_add_body(scene, body);
+  return body;
+}
+
+static scene_t *make_map(size_t num_resting, map_mode_t mode) {
+  scene_t *scene = scene_init();
+  if (mode == MAP_SLEEPING) {
+    scene_set_sleep(scene, SLEEP_TICKS, SLEEP_SPEED);
+  }
+  size_t width = 250;
+  for (size_t i = 0; i < num_resting; i++) {
+    body_t *body = make_body(
+        scene, (vector_t){(i % width) * SPACING, (i / width) * SPACING});
+    create_drag(scene, DRAG_GAMMA, body);
+    if (mode == MAP_STATIC) {
+      body_set_type(body, BODY_TYPE_STATIC);
+    }
+  }
+  for (size_t i = 0; i < NUM_MOVING; i++) {
+    body_t *body = make_body(scene, (vector_t){0, i * SPACING});
+    body_set_velocity(body, (vector_t){100, 0});
+  }
+  // Long enough for the resting bodies to fall asleep
+  for (size_t i = 0; i < SETTLE_TICKS; i++) {
+    scene_tick(scene, DT);
+  }
+  return scene;
+}
+
+int main() {
+  printf("%10s %10s %12s\n", "bodies", "map", "ms per tick");
+  for (size_t s = 0; s < NUM_SIZES; s++) {
+    for (map_mode_t mode = MAP_AWAKE; mode <= MAP_STATIC; mode++) {
+      scene_t *scene = make_map(MAP_SIZES[s], mode);
+      double start = scheduler_now();
+      for (size_t i = 0; i < TICKS; i++) {
+        scene_tick(scene, DT);
+      }
+      double ms = (scheduler_now() - start) / TICKS * 1e3;
+      printf("%10zu %10s %12.3f\n", MAP_SIZES[s], MODE_NAMES[mode], ms);
+      scene_free(scene);
+    }
+  }
+}
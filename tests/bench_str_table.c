@@ -0,0 +1,71 @@
+#include "str_table.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Measures the cost of looking up a filepath in the asset cache index as the
+// cache grows, against the linear strcmp scan the cache used to do.
+
+#define MAX_SIZE 65536
+#define PATH_LENGTH 64
+
+const size_t LOOKUPS = 1000000;
+const size_t LINEAR_MAX_SIZE = 4096;
+
+static char PATHS[MAX_SIZE][PATH_LENGTH];
+
+// Keeps the compiler from optimizing away lookups whose results are unused
+static volatile size_t SINK;
+
+static double elapsed_ns(clock_t start) {
+  return (double)(clock() - start) / CLOCKS_PER_SEC * 1e9;
+}
+
+static double time_hashed(size_t size) {
+  str_table_t *table = str_table_init(size);
+  for (size_t i = 0; i < size; i++) {
+    str_table_intern(table, PATHS[i]);
+  }
+  clock_t start = clock();
+  for (size_t i = 0; i < LOOKUPS; i++) {
+    size_t id;
+    str_table_find(table, PATHS[(i * 7919) % size], &id);
+    SINK = id;
+  }
+  double ns = elapsed_ns(start) / LOOKUPS;
+  str_table_free(table);
+  return ns;
+}
+
+static double time_linear(size_t size) {
+  size_t lookups = LOOKUPS / size + 1;
+  clock_t start = clock();
+  for (size_t i = 0; i < lookups; i++) {
+    const char *path = PATHS[(i * 7919) % size];
+    for (size_t j = 0; j < size; j++) {
+      if (strcmp(PATHS[j], path) == 0) {
+        SINK = j;
+        break;
+      }
+    }
+  }
+  return elapsed_ns(start) / lookups;
+}
+
+int main() {
+  // Asset paths share a long common prefix, like the real ones do
+  for (size_t i = 0; i < MAX_SIZE; i++) {
+    snprintf(PATHS[i], PATH_LENGTH, "assets/sprites/frame_%zu.png", i);
+  }
+
+  printf("%8s %14s %14s\n", "entries", "hashed ns/op", "linear ns/op");
+  for (size_t size = 16; size <= MAX_SIZE; size *= 4) {
+    printf("%8zu %14.1f", size, time_hashed(size));
+    if (size <= LINEAR_MAX_SIZE) {
+      printf(" %14.1f\n", time_linear(size));
+    } else {
+      printf(" %14s\n", "-");
+    }
+  }
+}
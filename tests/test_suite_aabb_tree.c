@@ -0,0 +1,196 @@
+#include "aabb_tree.h"
+#include "scene.h"
+#include "test_util.h"
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define NUM_TREE_BOXES 300
+
+static aabb_t BOXES[NUM_TREE_BOXES];
+static bool REMOVED[NUM_TREE_BOXES];
+
+static aabb_t random_box() {
+  vector_t min = {rand() % 1000, rand() % 1000};
+  vector_t size = {1 + rand() % 30, 1 + rand() % 30};
+  return (aabb_t){min, vec_add(min, size)};
+}
+
+static size_t index_of(void *data) { return (uintptr_t)data; }
+
+static bool count_match(void *data, void *aux) {
+  size_t *counts = aux;
+  counts[index_of(data)]++;
+  return true;
+}
+
+static double box_raycast(void *data, vector_t start, vector_t end,
+                          void *aux) {
+  // Step along the ray finely; good enough to check the tree's pruning
+  aabb_t box = BOXES[index_of(data)];
+  for (size_t i = 0; i <= 1000; i++) {
+    double t = i / 1000.0;
+    vector_t point = vec_add(start, vec_multiply(t, vec_subtract(end, start)));
+    if (aabb_contains(box, point)) {
+      return t;
+    }
+  }
+  return INFINITY;
+}
+
+static double box_distance(void *data, vector_t point, void *aux) {
+  return aabb_distance(BOXES[index_of(data)], point);
+}
+
+// The tree finds the same boxes as checking each one, while staying balanced
+// through inserts, moves and removals
+void test_tree_matches_brute_force() {
+  srand(5);
+  aabb_tree_t *tree = aabb_tree_init(0);
+  size_t proxies[NUM_TREE_BOXES];
+  for (size_t i = 0; i < NUM_TREE_BOXES; i++) {
+    BOXES[i] = random_box();
+    REMOVED[i] = false;
+    proxies[i] = aabb_tree_insert(tree, BOXES[i], (void *)(uintptr_t)i);
+  }
+  for (size_t i = 0; i < NUM_TREE_BOXES; i += 3) {
+    BOXES[i] = random_box();
+    assert(aabb_tree_move(tree, proxies[i], BOXES[i]));
+  }
+  for (size_t i = 1; i < NUM_TREE_BOXES; i += 4) {
+    aabb_tree_remove(tree, proxies[i]);
+    REMOVED[i] = true;
+  }
+  assert(aabb_tree_size(tree) == NUM_TREE_BOXES - NUM_TREE_BOXES / 4);
+  // A balanced tree of n leaves is about log2(n) high
+  assert(aabb_tree_height(tree) <= 2 * log2(NUM_TREE_BOXES) + 1);
+
+  for (size_t q = 0; q < 20; q++) {
+    aabb_t query = random_box();
+    query.max = vec_add(query.max, (vector_t){100, 100});
+    size_t counts[NUM_TREE_BOXES] = {0};
+    aabb_tree_query(tree, query, count_match, counts);
+    for (size_t i = 0; i < NUM_TREE_BOXES; i++) {
+      assert(counts[i] == (!REMOVED[i] && aabb_overlaps(BOXES[i], query)));
+    }
+
+    vector_t point = {rand() % 1000, rand() % 1000};
+    void *nearest[5];
+    assert(aabb_tree_nearest(tree, point, 5, box_distance, NULL, nearest) == 5);
+    double last = 0;
+    for (size_t k = 0; k < 5; k++) {
+      double distance = aabb_distance(BOXES[index_of(nearest[k])], point);
+      assert(distance >= last);
+      last = distance;
+    }
+    size_t closer = 0;
+    for (size_t i = 0; i < NUM_TREE_BOXES; i++) {
+      closer += !REMOVED[i] && aabb_distance(BOXES[i], point) < last;
+    }
+    assert(closer <= 4);
+
+    vector_t start = {rand() % 1000, -10};
+    vector_t end = {rand() % 1000, 1010};
+    double fraction;
+    void *hit =
+        aabb_tree_raycast(tree, start, end, box_raycast, NULL, &fraction);
+    double best = INFINITY;
+    for (size_t i = 0; i < NUM_TREE_BOXES; i++) {
+      if (!REMOVED[i]) {
+        best = fmin(best, box_raycast((void *)(uintptr_t)i, start, end, NULL));
+      }
+    }
+    assert(hit == NULL ? best == INFINITY : fraction == best);
+  }
+  aabb_tree_free(tree);
+}
+
+// Small moves stay inside the fattened box and leave the tree alone
+void test_tree_margin() {
+  aabb_tree_t *tree = aabb_tree_init(1);
+  aabb_t box = {{0, 0}, {2, 2}};
+  size_t proxy = aabb_tree_insert(tree, box, NULL);
+  aabb_t fat = aabb_tree_get_fat_aabb(tree, proxy);
+  assert(vec_equal(fat.min, (vector_t){-1, -1}));
+  assert(vec_equal(fat.max, (vector_t){3, 3}));
+  assert(!aabb_tree_move(tree, proxy, aabb_translate(box, (vector_t){1, 0})));
+  assert(aabb_tree_move(tree, proxy, aabb_translate(box, (vector_t){2, 0})));
+  assert(aabb_tree_height(tree) == 1);
+  aabb_tree_remove(tree, proxy);
+  assert(aabb_tree_size(tree) == 0 && aabb_tree_height(tree) == 0);
+  aabb_tree_free(tree);
+}
+
+static body_t *make_square(vector_t center) {
+  vector_t v[] = {{center.x - 1, center.y - 1},
+                  {center.x + 1, center.y - 1},
+                  {center.x + 1, center.y + 1},
+                  {center.x - 1, center.y + 1}};
+  return body_init_from_vertices(v, 4, 1, (rgb_color_t){0, 0, 0}, NULL, NULL);
+}
+
+static bool count_bodies(body_t *body, void *aux) {
+  (*(size_t *)aux)++;
+  return true;
+}
+
+// The scene keeps its index up to date as bodies move and are removed
+void test_scene_queries() {
+  scene_t *scene = scene_init();
+  body_t *a = make_square(VEC_ZERO);
+  body_t *b = make_square((vector_t){10, 0});
+  body_t *c = make_square((vector_t){20, 0});
+  scene_add_body(scene, a);
+  scene_add_body(scene, b);
+  scene_add_body(scene, c);
+
+  size_t count = 0;
+  scene_query_aabb(scene, (aabb_t){{-5, -5}, {12, 5}}, count_bodies, &count);
+  assert(count == 2);
+  count = 0;
+  scene_query_radius(scene, (vector_t){15, 0}, 4, count_bodies, &count);
+  assert(count == 2);
+
+  scene_raycast_t ray = scene_raycast(scene, (vector_t){-5, 0},
+                                      (vector_t){25, 0});
+  assert(ray.hit && ray.body == a);
+  assert(vec_isclose(ray.point, (vector_t){-1, 0}));
+  assert(vec_isclose(ray.normal, (vector_t){-1, 0}));
+  // Starting inside a body doesn't hit it
+  ray = scene_raycast(scene, VEC_ZERO, (vector_t){25, 0});
+  assert(ray.hit && ray.body == b);
+  assert(within(1e-7, ray.fraction, 9.0 / 25));
+  assert(!scene_raycast(scene, (vector_t){-5, 5}, (vector_t){25, 5}).hit);
+
+  body_t *nearest[3];
+  assert(scene_query_nearest(scene, (vector_t){18, 0}, 3, nearest) == 3);
+  assert(nearest[0] == c && nearest[1] == b && nearest[2] == a);
+
+  // After a tick the index follows moved bodies and drops removed ones
+  body_set_velocity(c, (vector_t){-100, 0});
+  body_remove(b);
+  scene_tick(scene, 0.1);
+  assert(scene_query_nearest(scene, (vector_t){18, 0}, 3, nearest) == 2);
+  assert(nearest[0] == c && nearest[1] == a);
+  ray = scene_raycast(scene, (vector_t){5, 0}, (vector_t){25, 0});
+  assert(ray.hit && ray.body == c);
+  assert(vec_isclose(ray.point, (vector_t){9, 0}));
+  scene_free(scene);
+}
+
+int main(int argc, char *argv[]) {
+  // Run all tests if there are no command-line arguments
+  bool all_tests = argc == 1;
+  // Read test name from file
+  char testname[100];
+  if (!all_tests) {
+    read_testname(argv[1], testname, sizeof(testname));
+  }
+
+  DO_TEST(test_tree_matches_brute_force)
+  DO_TEST(test_tree_margin)
+  DO_TEST(test_scene_queries)
+
+  puts("aabb_tree_test PASS");
+}
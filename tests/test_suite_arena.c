@@ -0,0 +1,84 @@
+#include "arena.h"
+#include "test_util.h"
+#include <assert.h>
+#include <stdalign.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+void test_arena_alloc_and_reset() {
+  arena_t *arena = arena_init(256);
+  char *a = arena_alloc(arena, 10);
+  char *b = arena_alloc(arena, 10);
+  assert((uintptr_t)a % alignof(max_align_t) == 0);
+  assert((uintptr_t)b % alignof(max_align_t) == 0);
+  assert(b >= a + 10);
+  memset(a, 'a', 10);
+  memset(b, 'b', 10);
+  assert(a[9] == 'a');
+  size_t used = arena_used(arena);
+  assert(used >= 20);
+  assert(arena_high_water(arena) == used);
+
+  arena_reset(arena);
+  assert(arena_used(arena) == 0);
+  assert(arena_high_water(arena) == used);
+  // Memory is reused after a reset
+  assert(arena_alloc(arena, 10) == a);
+  arena_free(arena);
+}
+
+void test_arena_mark_release() {
+  arena_t *arena = arena_init(256);
+  arena_alloc(arena, 32);
+  arena_mark_t mark = arena_mark(arena);
+  void *scratch = arena_alloc(arena, 64);
+  arena_release(arena, mark);
+  assert(arena_used(arena) == 32);
+  assert(arena_alloc(arena, 64) == scratch);
+  arena_free(arena);
+}
+
+// Allocations past the first block chain on more blocks,
+// and the next reset merges them into one
+void test_arena_grows() {
+  arena_t *arena = arena_init(0);
+  const size_t n = 1000;
+  size_t *values[n];
+  for (size_t i = 0; i < n; i++) {
+    values[i] = arena_alloc(arena, 100);
+    *values[i] = i;
+  }
+  arena_mark_t mark = arena_mark(arena);
+  arena_alloc(arena, 1 << 20);
+  arena_release(arena, mark);
+  for (size_t i = 0; i < n; i++) {
+    assert(*values[i] == i);
+  }
+  size_t high_water = arena_high_water(arena);
+  assert(high_water >= n * 100 + (1 << 20));
+
+  arena_reset(arena);
+  char *first = arena_alloc(arena, 1);
+  arena_alloc(arena, high_water - 2 * alignof(max_align_t));
+  // Everything from before the reset now fits in the first block
+  char *last = arena_alloc(arena, 1);
+  assert(last > first && (size_t)(last - first) < high_water);
+  arena_free(arena);
+}
+
+int main(int argc, char *argv[]) {
+  // Run all tests if there are no command-line arguments
+  bool all_tests = argc == 1;
+  // Read test name from file
+  char testname[100];
+  if (!all_tests) {
+    read_testname(argv[1], testname, sizeof(testname));
+  }
+
+  DO_TEST(test_arena_alloc_and_reset)
+  DO_TEST(test_arena_mark_release)
+  DO_TEST(test_arena_grows)
+
+  puts("arena_test PASS");
+}
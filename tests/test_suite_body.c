@@ -1,4 +1,5 @@
 #include "body.h"
+#include "collision.h"
 #include "test_util.h"
 #include <assert.h>
 #include <math.h>
@@ -23,9 +24,9 @@ void test_body_init() {
   list_free(shape2);
   assert(vec_isclose(body_get_centroid(body), (vector_t){1.5, 1.5}));
   assert(vec_equal(body_get_velocity(body), VEC_ZERO));
-  assert(body_get_color(body).r == color.r);
-  assert(body_get_color(body).g == color.g);
-  assert(body_get_color(body).b == color.b);
+  assert(body_get_color(body)->r == color.r);
+  assert(body_get_color(body)->g == color.g);
+  assert(body_get_color(body)->b == color.b);
   assert(body_get_mass(body) == 3);
   body_free(body);
 }
@@ -248,6 +249,381 @@ void test_body_info_freer() {
   body_free(body);
 }
 
+void test_body_init_from_vertices() {
+  vector_t v[] = {{1, 1}, {2, 1}, {2, 2}, {1, 2}};
+  const size_t VERTICES = sizeof(v) / sizeof(*v);
+  body_t *body = body_init_from_vertices(v, VERTICES, 3,
+                                         (rgb_color_t){0, 0, 0}, NULL, NULL);
+  // The body keeps its own copy of the vertices
+  v[0] = (vector_t){100, 100};
+  assert(body_num_vertices(body) == VERTICES);
+  const vector_t *vertices = body_get_vertices(body);
+  assert(vec_isclose(vertices[0], (vector_t){1, 1}));
+  assert(vec_isclose(body_get_centroid(body), (vector_t){1.5, 1.5}));
+  body_set_centroid(body, (vector_t){3, 3});
+  vertices = body_get_vertices(body);
+  assert(vec_isclose(vertices[0], (vector_t){2.5, 2.5}));
+  assert(vec_isclose(vertices[2], (vector_t){3.5, 3.5}));
+  body_free(body);
+}
+
+// Bodies placed from one shape share its vertices but have their own pose
+void test_body_shared_shape() {
+  vector_t v[] = {{1, 1}, {2, 1}, {2, 2}, {1, 2}};
+  vector_t centroid;
+  shape_t *square = shape_init(v, 4, &centroid);
+  assert(vec_isclose(centroid, (vector_t){1.5, 1.5}));
+  assert(vec_isclose(shape_get_vertices(square)[0], (vector_t){-0.5, -0.5}));
+  assert(within(1e-7, shape_area(square), 1));
+
+  body_t *a = body_init_from_shape(square, VEC_ZERO, 1, (rgb_color_t){0, 0, 0},
+                                   NULL, NULL);
+  body_t *b = body_init_from_shape(square, (vector_t){10, 0}, 1,
+                                   (rgb_color_t){0, 0, 0}, NULL, NULL);
+  shape_release(square);
+  assert(polygon_get_shape(body_get_polygon(a)) ==
+         polygon_get_shape(body_get_polygon(b)));
+
+  body_set_rotation(b, M_PI / 2);
+  assert(within(1e-7, body_get_rotation(b), M_PI / 2));
+  assert(vec_isclose(body_get_vertices(a)[0], (vector_t){-0.5, -0.5}));
+  assert(vec_isclose(body_get_vertices(b)[0], (vector_t){10.5, -0.5}));
+  assert(vec_isclose(body_get_centroid(b), (vector_t){10, 0}));
+
+  // Rotating about another point moves the centroid too
+  polygon_rotate(body_get_polygon(a), M_PI, (vector_t){1, 0});
+  assert(vec_isclose(body_get_centroid(a), (vector_t){2, 0}));
+  assert(vec_isclose(body_get_vertices(a)[0], (vector_t){2.5, 0.5}));
+  body_free(a);
+  body_free(b);
+}
+
+// The cached bounding box follows translations and is rebuilt after rotations
+void test_body_aabb() {
+  vector_t v[] = {{0, 0}, {2, 0}, {2, 1}, {0, 1}};
+  body_t *body =
+      body_init_from_vertices(v, 4, 1, (rgb_color_t){0, 0, 0}, NULL, NULL);
+  aabb_t box = body_get_aabb(body);
+  assert(vec_isclose(box.min, (vector_t){0, 0}));
+  assert(vec_isclose(box.max, (vector_t){2, 1}));
+
+  body_set_velocity(body, (vector_t){1, 2});
+  body_tick(body, 1);
+  box = body_get_aabb(body);
+  assert(vec_isclose(box.min, (vector_t){1, 2}));
+  assert(vec_isclose(box.max, (vector_t){3, 3}));
+
+  body_set_rotation(body, M_PI / 2);
+  box = body_get_aabb(body);
+  assert(vec_isclose(box.min, (vector_t){1.5, 1.5}));
+  assert(vec_isclose(box.max, (vector_t){2.5, 3.5}));
+  body_set_centroid(body, VEC_ZERO);
+  box = body_get_aabb(body);
+  assert(vec_isclose(box.min, (vector_t){-0.5, -1}));
+  assert(vec_isclose(box.max, (vector_t){0.5, 1}));
+
+  assert(aabb_overlaps(box, (aabb_t){{0.5, 1}, {2, 2}}));
+  assert(!aabb_overlaps(box, (aabb_t){{0.6, 0}, {2, 2}}));
+  assert(aabb_contains(box, VEC_ZERO));
+  body_free(body);
+}
+
+// Round shapes collide through their own kernels, with the axis pointing from
+// the first body to the second
+void test_body_shape_kinds() {
+  rgb_color_t black = {0, 0, 0};
+  shape_t *circle = shape_init_circle(1, 20);
+  assert(shape_get_kind(circle) == SHAPE_CIRCLE);
+  assert(within(1e-7, shape_get_round_radius(circle), 1));
+  assert(within(1e-7, shape_area(circle), M_PI));
+  shape_t *capsule = shape_init_capsule(2, 1, 20);
+  assert(shape_get_kind(capsule) == SHAPE_CAPSULE);
+  assert(within(1e-7, shape_get_radius(capsule), 3));
+  vector_t v[] = {{-1, -1}, {1, -1}, {1, 1}, {-1, 1}};
+  shape_t *square = shape_init(v, 4, NULL);
+  assert(shape_get_kind(square) == SHAPE_POLYGON);
+
+  body_t *a = body_init_from_shape(circle, VEC_ZERO, 1, black, NULL, NULL);
+  body_t *b =
+      body_init_from_shape(circle, (vector_t){1.9, 0}, 1, black, NULL, NULL);
+  collision_info_t info = find_collision(a, b);
+  assert(info.collided);
+  assert(vec_isclose(info.axis, (vector_t){1, 0}));
+  body_set_centroid(b, (vector_t){1.5, 1.5});
+  assert(!find_collision(a, b).collided);
+
+  // Circle against the square's corner and face
+  body_t *box =
+      body_init_from_shape(square, (vector_t){0, 3}, 1, black, NULL, NULL);
+  body_set_centroid(a, (vector_t){1.6, 1.6});
+  assert(find_collision(a, box).collided);
+  body_set_centroid(a, (vector_t){1.8, 1.2});
+  assert(!find_collision(a, box).collided);
+  body_set_centroid(a, (vector_t){0, 1.1});
+  info = find_collision(box, a);
+  assert(info.collided);
+  assert(vec_isclose(info.axis, (vector_t){0, -1}));
+  body_set_centroid(a, (vector_t){0, 2.5});
+  info = find_collision(a, box);
+  assert(info.collided);
+  assert(vec_isclose(info.axis, (vector_t){0, 1}));
+
+  // A capsule stood upright reaches the circle above it
+  body_t *c = body_init_from_shape(capsule, VEC_ZERO, 1, black, NULL, NULL);
+  body_set_rotation(c, M_PI / 2);
+  body_set_centroid(b, (vector_t){0, 3.9});
+  info = find_collision(c, b);
+  assert(info.collided);
+  assert(vec_isclose(info.axis, (vector_t){0, 1}));
+  body_set_centroid(b, (vector_t){2.1, 0});
+  assert(!find_collision(c, b).collided);
+
+  shape_release(circle);
+  shape_release(capsule);
+  shape_release(square);
+  body_free(a);
+  body_free(b);
+  body_free(box);
+  body_free(c);
+}
+
+// Overlapping bodies report how deep they overlap and where they touch
+void test_body_contact_manifold() {
+  rgb_color_t black = {0, 0, 0};
+  vector_t v[] = {{-1, -1}, {1, -1}, {1, 1}, {-1, 1}};
+  shape_t *square = shape_init(v, 4, NULL);
+  body_t *a = body_init_from_shape(square, VEC_ZERO, 1, black, NULL, NULL);
+  body_t *b =
+      body_init_from_shape(square, (vector_t){1.5, 0.5}, 1, black, NULL, NULL);
+  collision_info_t info = find_collision(a, b);
+  assert(info.collided);
+  assert(vec_isclose(info.axis, (vector_t){1, 0}));
+  assert(within(1e-6, info.depth, 0.5));
+  // The faces touch along the edge x = 1 (or 0.5) between y = -0.5 and y = 1
+  assert(info.num_contacts == 2);
+  for (size_t i = 0; i < info.num_contacts; i++) {
+    assert(info.contacts[i].x > 0.5 - 1e-6 && info.contacts[i].x < 1 + 1e-6);
+    assert(info.contacts[i].y > -0.5 - 1e-6 && info.contacts[i].y < 1 + 1e-6);
+  }
+
+  shape_t *circle = shape_init_circle(1, 20);
+  body_t *c =
+      body_init_from_shape(circle, (vector_t){0, 1.75}, 1, black, NULL, NULL);
+  info = find_collision(a, c);
+  assert(info.collided);
+  assert(vec_isclose(info.axis, (vector_t){0, 1}));
+  assert(within(1e-6, info.depth, 0.25));
+  assert(info.num_contacts == 1);
+  assert(within(1e-6, info.contacts[0].y, 0.875));
+
+  shape_release(square);
+  shape_release(circle);
+  body_free(a);
+  body_free(b);
+  body_free(c);
+}
+
+// SAT and the closed forms agree with GJK and EPA on whether bodies collide,
+// along which axis and how deeply
+void test_body_kernels_agree() {
+  rgb_color_t black = {0, 0, 0};
+  vector_t v[] = {{-1, -1}, {2, -1}, {1, 1}, {-1, 0.5}};
+  shape_t *shapes[] = {shape_init(v, 4, NULL), shape_init_circle(1, 20),
+                       shape_init_capsule(1.5, 0.5, 20)};
+  const size_t NUM_SHAPES = sizeof(shapes) / sizeof(*shapes);
+  srand(7);
+  size_t num_collided = 0;
+  for (size_t i = 0; i < 300; i++) {
+    shape_t *shape1 = shapes[0];
+    shape_t *shape2 = shapes[i % NUM_SHAPES];
+    vector_t offset = {4.0 * rand() / RAND_MAX - 2,
+                       4.0 * rand() / RAND_MAX - 2};
+    body_t *a = body_init_from_shape(shape1, VEC_ZERO, 1, black, NULL, NULL);
+    body_t *b = body_init_from_shape(shape2, offset, 1, black, NULL, NULL);
+    body_set_rotation(a, 6.0 * rand() / RAND_MAX);
+    body_set_rotation(b, 6.0 * rand() / RAND_MAX);
+    for (size_t order = 0; order < 2; order++) {
+      body_t *first = order == 0 ? a : b;
+      body_t *second = order == 0 ? b : a;
+      collision_info_t info = find_collision(first, second);
+      collision_info_t gjk = find_collision_gjk(first, second);
+      assert(info.collided == gjk.collided);
+      if (info.collided) {
+        assert(within(1e-5, info.depth, gjk.depth));
+        assert(vec_within(1e-5, info.axis, gjk.axis));
+        assert(info.num_contacts >= 1 && info.num_contacts <= 2);
+        num_collided++;
+      }
+    }
+    body_free(a);
+    body_free(b);
+  }
+  assert(num_collided > 100);
+  for (size_t i = 0; i < NUM_SHAPES; i++) {
+    shape_release(shapes[i]);
+  }
+}
+
+// A thin gap along a long edge keeps bodies apart. The old narrowphase
+// rotated edges by 3.14 / 2, tilting its axes by about 8e-4 radians, which
+// over this 100 unit edge hides the gap and reported a collision.
+void test_body_grazing_gap() {
+  rgb_color_t black = {0, 0, 0};
+  vector_t plank[] = {{-50, -10}, {50, -10}, {50, 0}, {-50, 0}};
+  vector_t square[] = {{-50, 0.01}, {-40, 0.01}, {-40, 10.01}, {-50, 10.01}};
+  body_t *a = body_init_from_vertices(plank, 4, 1, black, NULL, NULL);
+  body_t *b = body_init_from_vertices(square, 4, 1, black, NULL, NULL);
+  assert(!find_collision(a, b).collided);
+  assert(!find_collision(b, a).collided);
+  body_set_centroid(b, vec_add(body_get_centroid(b), (vector_t){0, -0.02}));
+  assert(find_collision(a, b).collided);
+  body_free(a);
+  body_free(b);
+}
+
+// A body swept through another reports when it first touched it
+void test_body_time_of_impact() {
+  rgb_color_t black = {0, 0, 0};
+  vector_t v[] = {{-1, -1}, {1, -1}, {1, 1}, {-1, 1}};
+  shape_t *square = shape_init(v, 4, NULL);
+  shape_t *circle = shape_init_circle(1, 20);
+  body_t *wall = body_init_from_shape(square, VEC_ZERO, 1, black, NULL, NULL);
+  body_t *bullet =
+      body_init_from_shape(circle, (vector_t){10, 0.5}, 1, black, NULL, NULL);
+  // It touches the wall once its center reaches x = -2
+  assert(within(1e-3, find_time_of_impact(bullet, (vector_t){-10, 0.5}, wall),
+                0.4));
+  assert(!find_collision(bullet, wall).collided);
+  // Passing above the wall, or moving away from it, misses
+  body_set_centroid(bullet, (vector_t){10, 2.5});
+  assert(find_time_of_impact(bullet, (vector_t){-10, 2.5}, wall) == INFINITY);
+  body_set_centroid(bullet, (vector_t){-10, 0});
+  assert(find_time_of_impact(bullet, (vector_t){-5, 0}, wall) == INFINITY);
+  // Nor does leaving a contact it started in
+  assert(find_time_of_impact(bullet, (vector_t){-1.5, 0}, wall) == INFINITY);
+
+  shape_release(square);
+  shape_release(circle);
+  body_free(wall);
+  body_free(bullet);
+}
+
+// The cached test agrees with the full one, and keeps a separating axis
+void test_body_cached_collision() {
+  rgb_color_t black = {0, 0, 0};
+  vector_t v[] = {{-1, -1}, {1, -1}, {1, 1}, {-1, 1}};
+  vector_t w[] = {{-4, -0.25}, {4, -0.25}, {4, 0.25}, {-4, 0.25}};
+  shape_t *square = shape_init(v, 4, NULL);
+  shape_t *plank = shape_init(w, 4, NULL);
+  // A diagonal plank, whose bounding box overlaps the square's
+  body_t *a = body_init_from_shape(plank, VEC_ZERO, 1, black, NULL, NULL);
+  body_set_rotation(a, M_PI / 4);
+  body_t *b = body_init_from_shape(square, VEC_ZERO, 1, black, NULL, NULL);
+  vector_t axis = VEC_ZERO;
+  size_t num_separated = 0;
+  for (double t = 2; t > 0; t -= 0.25) {
+    body_set_centroid(b, (vector_t){-t, t});
+    collision_info_t cached = find_collision_cached(a, b, &axis);
+    collision_info_t full = find_collision(a, b);
+    assert(cached.collided == full.collided);
+    if (cached.collided) {
+      assert(vec_isclose(axis, VEC_ZERO));
+      assert(vec_isclose(cached.axis, full.axis));
+    } else {
+      assert(vec_isclose(axis, (vector_t){-M_SQRT1_2, M_SQRT1_2}));
+      num_separated++;
+    }
+  }
+  // The square's corner reaches the plank once t < 1 + sqrt(2) / 8
+  assert(num_separated == 4);
+
+  // The round kernels hand back their own axes too
+  shape_t *circle = shape_init_circle(1, 20);
+  shape_t *capsule = shape_init_capsule(2, 0.5, 20);
+  body_t *c = body_init_from_shape(capsule, VEC_ZERO, 1, black, NULL, NULL);
+  body_set_rotation(c, M_PI / 4);
+  // Half a unit off the capsule, square to its core
+  vector_t beside = {1 - M_SQRT2, 1 + M_SQRT2};
+  body_t *d = body_init_from_shape(circle, beside, 1, black, NULL, NULL);
+  axis = VEC_ZERO;
+  assert(!find_collision_cached(c, d, &axis).collided);
+  assert(vec_isclose(axis, (vector_t){-M_SQRT1_2, M_SQRT1_2}));
+  body_free(c);
+  c = body_init_from_shape(circle, VEC_ZERO, 1, black, NULL, NULL);
+  num_separated = 0;
+  for (double t = 2; t > 0; t -= 0.25) {
+    body_set_centroid(c, (vector_t){-t, t});
+    collision_info_t cached = find_collision_cached(a, c, &axis);
+    assert(cached.collided == find_collision(a, c).collided);
+    if (cached.collided) {
+      assert(vec_isclose(axis, VEC_ZERO));
+    } else {
+      assert(vec_isclose(axis, (vector_t){-M_SQRT1_2, M_SQRT1_2}));
+      num_separated++;
+    }
+  }
+  // The circle reaches the plank once t < 1.25 / sqrt(2)
+  assert(num_separated == 5);
+  shape_release(square);
+  shape_release(plank);
+  shape_release(circle);
+  shape_release(capsule);
+  body_free(a);
+  body_free(b);
+  body_free(c);
+  body_free(d);
+}
+
+// The last tick's move is kept for interpolation, and teleports clear it
+void test_body_last_move() {
+  vector_t v[] = {{-1, -1}, {1, -1}, {1, 1}, {-1, 1}};
+  body_t *body =
+      body_init_from_vertices(v, 4, 1, (rgb_color_t){0, 0, 0}, NULL, NULL);
+  assert(vec_equal(body_get_last_move(body), VEC_ZERO));
+  body_set_velocity(body, (vector_t){2, 0});
+  body_tick(body, 0.5);
+  assert(vec_isclose(body_get_last_move(body), (vector_t){1, 0}));
+  body_set_centroid(body, (vector_t){10, 0});
+  assert(vec_equal(body_get_last_move(body), VEC_ZERO));
+  body_free(body);
+}
+
+// Bodies keep their state when they move between stores, and when another
+// body leaving a store moves them within it
+void test_body_store() {
+  vector_t v[] = {{-1, -1}, {1, -1}, {1, 1}, {-1, 1}};
+  body_store_t *store = body_store_init();
+  body_t *bodies[3];
+  for (size_t i = 0; i < 3; i++) {
+    bodies[i] = body_init_from_vertices(v, 4, i + 1, (rgb_color_t){0, 0, 0},
+                                        NULL, NULL);
+    body_set_velocity(bodies[i], (vector_t){i, 0});
+    body_add_force(bodies[i], (vector_t){0, 2 * (i + 1)});
+    body_store_add(store, bodies[i]);
+  }
+  assert(body_store_size(store) == 3);
+  assert(body_store_get(store, 0) == bodies[0]);
+  body_remove(bodies[2]);
+  assert(body_store_has_removed(store));
+  body_free(bodies[0]);
+  assert(body_store_size(store) == 2);
+  assert(body_store_get(store, 0) == bodies[2]);
+
+  body_store_tick(store, 0, body_store_size(store), 1);
+  for (size_t i = 1; i < 3; i++) {
+    // Every body accelerates at 2 upwards
+    assert(vec_isclose(body_get_velocity(bodies[i]), (vector_t){i, 2}));
+    assert(vec_isclose(body_get_centroid(bodies[i]), (vector_t){i, 1}));
+    assert(vec_isclose(body_get_vertices(bodies[i])[0],
+                       (vector_t){i - 1, 0}));
+  }
+  assert(body_is_removed(bodies[2]) && !body_is_removed(bodies[1]));
+  body_free(bodies[1]);
+  body_free(bodies[2]);
+  assert(!body_store_has_removed(store));
+  body_store_free(store);
+}
+
 int main(int argc, char *argv[]) {
   // Run all tests if there are no command-line arguments
   bool all_tests = argc == 1;
@@ -265,6 +641,17 @@ int main(int argc, char *argv[]) {
   DO_TEST(test_body_remove)
   DO_TEST(test_body_info)
   DO_TEST(test_body_info_freer)
+  DO_TEST(test_body_init_from_vertices)
+  DO_TEST(test_body_shared_shape)
+  DO_TEST(test_body_aabb)
+  DO_TEST(test_body_shape_kinds)
+  DO_TEST(test_body_contact_manifold)
+  DO_TEST(test_body_grazing_gap)
+  DO_TEST(test_body_kernels_agree)
+  DO_TEST(test_body_time_of_impact)
+  DO_TEST(test_body_cached_collision)
+  DO_TEST(test_body_last_move)
+  DO_TEST(test_body_store)
 
   puts("body_test PASS");
 }
@@ -0,0 +1,162 @@
+#include "broadphase.h"
+#include "collision.h"
+#include "test_util.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+const size_t NUM_BROADPHASE_BODIES = 200;
+
+static body_t *make_square(vector_t center, double half_size) {
+  vector_t v[] = {{center.x - half_size, center.y - half_size},
+                  {center.x + half_size, center.y - half_size},
+                  {center.x + half_size, center.y + half_size},
+                  {center.x - half_size, center.y + half_size}};
+  return body_init_from_vertices(v, 4, 1, (rgb_color_t){0, 0, 0}, NULL, NULL);
+}
+
+static bool is_odd(void *data, void *aux) {
+  return (uintptr_t)data % 2 == 1;
+}
+
+/**
+ * Checks that a broadphase reports exactly the overlapping pairs, in order.
+ * Each body's data is its index in bodies.
+ */
+static void check_pairs(broadphase_t *broadphase, body_t **bodies,
+                        size_t num_bodies, bool odd_removed) {
+  size_t expected = 0;
+  for (size_t i = 0; i < num_bodies; i++) {
+    for (size_t j = i + 1; j < num_bodies; j++) {
+      if (odd_removed && (i % 2 == 1 || j % 2 == 1)) {
+        continue;
+      }
+      aabb_t box1 = body_get_aabb(bodies[i]);
+      aabb_t box2 = body_get_aabb(bodies[j]);
+      if (!aabb_overlaps(box1, box2)) {
+        continue;
+      }
+      assert(expected < broadphase_num_pairs(broadphase));
+      broadphase_pair_t pair = broadphase_get_pair(broadphase, expected++);
+      assert((uintptr_t)pair.first == i);
+      assert((uintptr_t)pair.second == j);
+    }
+  }
+  assert(broadphase_num_pairs(broadphase) == expected);
+  assert(broadphase_get_stats(broadphase).num_pairs == expected);
+}
+
+static void test_matches_brute_force(broadphase_kind_t kind) {
+  srand(7);
+  broadphase_t *broadphase = broadphase_init(kind, 20);
+  assert(broadphase_get_kind(broadphase) == kind);
+  body_t *bodies[NUM_BROADPHASE_BODIES];
+  for (size_t i = 0; i < NUM_BROADPHASE_BODIES; i++) {
+    vector_t center = {rand() % 500 - 250, rand() % 500 - 250};
+    // A few bodies much larger than a cell
+    double half_size = i % 20 == 0 ? 60 : 1 + rand() % 10;
+    bodies[i] = make_square(center, half_size);
+    broadphase_add(broadphase, bodies[i], (void *)(uintptr_t)i);
+  }
+  assert(broadphase_size(broadphase) == NUM_BROADPHASE_BODIES);
+  broadphase_update(broadphase);
+  check_pairs(broadphase, bodies, NUM_BROADPHASE_BODIES, false);
+
+  // Move everything a little, as between frames
+  for (size_t step = 0; step < 5; step++) {
+    for (size_t i = 0; i < NUM_BROADPHASE_BODIES; i++) {
+      vector_t offset = {rand() % 21 - 10, rand() % 21 - 10};
+      body_set_centroid(bodies[i],
+                        vec_add(body_get_centroid(bodies[i]), offset));
+    }
+    broadphase_update(broadphase);
+    check_pairs(broadphase, bodies, NUM_BROADPHASE_BODIES, false);
+  }
+
+  assert(broadphase_remove_if(broadphase, is_odd, NULL) ==
+         NUM_BROADPHASE_BODIES / 2);
+  assert(broadphase_size(broadphase) == NUM_BROADPHASE_BODIES / 2);
+  broadphase_update(broadphase);
+  check_pairs(broadphase, bodies, NUM_BROADPHASE_BODIES, true);
+
+  broadphase_stats_t stats = broadphase_get_stats(broadphase);
+  assert(stats.num_updates == 7);
+  assert(stats.num_proxies == NUM_BROADPHASE_BODIES / 2);
+  assert(stats.num_tests >= stats.num_pairs);
+  for (size_t i = 0; i < NUM_BROADPHASE_BODIES; i++) {
+    body_free(bodies[i]);
+  }
+  broadphase_free(broadphase);
+}
+
+void test_grid() { test_matches_brute_force(BROADPHASE_GRID); }
+
+void test_sweep() { test_matches_brute_force(BROADPHASE_SWEEP); }
+
+// Touching boxes overlap, and an empty broadphase finds nothing
+void test_touching() {
+  broadphase_kind_t kinds[] = {BROADPHASE_GRID, BROADPHASE_SWEEP};
+  for (size_t k = 0; k < 2; k++) {
+    broadphase_t *broadphase = broadphase_init(kinds[k], 4);
+    assert(broadphase_update(broadphase) == 0);
+    body_t *a = make_square(VEC_ZERO, 1);
+    body_t *b = make_square((vector_t){2, 0}, 1);
+    body_t *c = make_square((vector_t){4.5, 0}, 1);
+    broadphase_add(broadphase, a, a);
+    broadphase_add(broadphase, b, b);
+    broadphase_add(broadphase, c, c);
+    assert(broadphase_update(broadphase) == 1);
+    broadphase_pair_t pair = broadphase_get_pair(broadphase, 0);
+    assert(pair.first == a && pair.second == b);
+    body_free(a);
+    body_free(b);
+    body_free(c);
+    broadphase_free(broadphase);
+  }
+}
+
+// Pairs whose collision filters exclude each other are never box tested
+void test_filters() {
+  broadphase_kind_t kinds[] = {BROADPHASE_GRID, BROADPHASE_SWEEP};
+  for (size_t k = 0; k < 2; k++) {
+    broadphase_t *broadphase = broadphase_init(kinds[k], 4);
+    // All in one grid cell, so each pair is considered once
+    vector_t center = {2, 2};
+    body_t *a = make_square(center, 1);
+    body_t *b = make_square(center, 1);
+    body_t *c = make_square(center, 1);
+    body_set_collision_filter(a, 1, 2);
+    body_set_collision_filter(b, 2, 1);
+    body_set_collision_filter(c, 1, 2);
+    assert(body_can_collide(a, b) && !body_can_collide(a, c));
+    assert(find_collision(a, b).collided && !find_collision(a, c).collided);
+    broadphase_add(broadphase, a, a);
+    broadphase_add(broadphase, b, b);
+    broadphase_add(broadphase, c, c);
+    assert(broadphase_update(broadphase) == 2);
+    assert(broadphase_get_stats(broadphase).num_tests == 2);
+    broadphase_pair_t pair = broadphase_get_pair(broadphase, 1);
+    assert(pair.first == b && pair.second == c);
+    body_free(a);
+    body_free(b);
+    body_free(c);
+    broadphase_free(broadphase);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  // Run all tests if there are no command-line arguments
+  bool all_tests = argc == 1;
+  // Read test name from file
+  char testname[100];
+  if (!all_tests) {
+    read_testname(argv[1], testname, sizeof(testname));
+  }
+
+  DO_TEST(test_grid)
+  DO_TEST(test_sweep)
+  DO_TEST(test_touching)
+  DO_TEST(test_filters)
+
+  puts("broadphase_test PASS");
+}
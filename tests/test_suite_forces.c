@@ -3,6 +3,7 @@
 #include <assert.h>
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 
 list_t *make_shape() {
   list_t *shape = list_init(4, free);
@@ -130,6 +131,151 @@ void test_collisions() {
   scene_free(scene);
 }
 
+// Tests that a fast body hits a body it would pass through within one tick
+void test_fast_collisions() {
+  const double DT = 0.1;
+  const double V = 1000;
+
+  for (int fast = 0; fast < 2; fast++) {
+    scene_t *scene = scene_init();
+    body_t *bullet = body_init(make_shape(), 1, (rgb_color_t){0, 0, 0});
+    body_set_centroid(bullet, (vector_t){-10, 0});
+    body_set_velocity(bullet, (vector_t){V, 0});
+    body_set_fast(bullet, fast);
+    scene_add_body(scene, bullet);
+    body_t *wall = body_init(make_shape(), INFINITY, (rgb_color_t){0, 0, 0});
+    scene_add_body(scene, wall);
+    create_destructive_collision(scene, bullet, wall);
+
+    for (int i = 0; i < 3; i++) {
+      scene_tick(scene, DT);
+    }
+    assert(scene_bodies(scene) == (fast ? 0 : 2));
+    scene_free(scene);
+  }
+}
+
+typedef struct {
+  contact_event_t events[16];
+  vector_t axes[16];
+  size_t num_events;
+} contact_log_t;
+
+static void log_contact(body_t *body1, body_t *body2, contact_event_t event,
+                        collision_info_t info, void *aux) {
+  contact_log_t *log = aux;
+  assert(log->num_events < 16);
+  log->events[log->num_events] = event;
+  log->axes[log->num_events] = info.axis;
+  log->num_events++;
+}
+
+// Tests that contact handlers see a pair enter, stay and exit, and that both
+// orders of the bodies share one cached pair
+void test_contact_events() {
+  scene_t *scene = scene_init();
+  body_t *body1 = body_init(make_shape(), 1, (rgb_color_t){0, 0, 0});
+  scene_add_body(scene, body1);
+  body_t *body2 = body_init(make_shape(), 1, (rgb_color_t){0, 0, 0});
+  body_set_centroid(body2, (vector_t){-5.5, 0});
+  body_set_velocity(body2, (vector_t){10, 0});
+  scene_add_body(scene, body2);
+  contact_log_t log = {.num_events = 0};
+  contact_log_t swapped_log = {.num_events = 0};
+  scene_add_contact_handler(scene, body1, body2, log_contact, &log, NULL);
+  scene_add_contact_handler(scene, body2, body1, log_contact, &swapped_log,
+                            NULL);
+  assert(scene_contact_pairs(scene) == 1);
+
+  // body2 moves 1 per tick, overlapping body1 from x = -1.5 to x = 1.5
+  for (int i = 0; i < 10; i++) {
+    scene_tick(scene, 0.1);
+  }
+  contact_event_t expected[] = {CONTACT_ENTER, CONTACT_STAY, CONTACT_STAY,
+                                CONTACT_STAY, CONTACT_EXIT};
+  assert(log.num_events == 5 && swapped_log.num_events == 5);
+  for (size_t i = 0; i < 5; i++) {
+    assert(log.events[i] == expected[i]);
+    assert(swapped_log.events[i] == expected[i]);
+  }
+  assert(vec_isclose(log.axes[0], (vector_t){-1, 0}));
+  assert(vec_isclose(swapped_log.axes[0], (vector_t){1, 0}));
+
+  // Removing a touching body ends the contact and drops the pair
+  body_set_velocity(body2, VEC_ZERO);
+  body_set_centroid(body2, (vector_t){1, 0});
+  scene_tick(scene, 0.1);
+  scene_tick(scene, 0.1);
+  body_remove(body1);
+  scene_tick(scene, 0.1);
+  assert(log.num_events == 8);
+  assert(log.events[5] == CONTACT_ENTER && log.events[6] == CONTACT_STAY &&
+         log.events[7] == CONTACT_EXIT);
+  assert(scene_contact_pairs(scene) == 0);
+  scene_free(scene);
+}
+
+static void log_typed_contact(body_t *body1, body_t *body2,
+                              contact_event_t event, collision_info_t info,
+                              void *aux) {
+  // Bodies come in the order of the categories the handler was added with
+  assert(body_get_category(body1) == 2 && body_get_category(body2) == 1);
+  log_contact(body1, body2, event, info, aux);
+}
+
+// Tests that type handlers hear about every pair of their categories that
+// touches, and that the scene forgets those pairs once they are apart
+void test_type_handlers() {
+  scene_t *scene = scene_init();
+  contact_log_t log = {.num_events = 0};
+  scene_add_type_handler(scene, 2, 1, log_typed_contact, &log, NULL);
+  body_t *wall = body_init(make_shape(), INFINITY, (rgb_color_t){0, 0, 0});
+  scene_add_body(scene, wall);
+  body_t *mover = body_init(make_shape(), 1, (rgb_color_t){0, 0, 0});
+  body_set_collision_filter(mover, 2, BODY_DEFAULT_MASK);
+  body_set_centroid(mover, (vector_t){-3.5, 0});
+  body_set_velocity(mover, (vector_t){10, 0});
+  scene_add_body(scene, mover);
+  // Another body in category 1, which overlaps the wall without a handler
+  body_t *other = body_init(make_shape(), 1, (rgb_color_t){0, 0, 0});
+  body_set_centroid(other, (vector_t){0, 1});
+  scene_add_body(scene, other);
+
+  for (int i = 0; i < 8; i++) {
+    scene_tick(scene, 0.1);
+  }
+  // The mover overlaps both category 1 bodies from x = -1.5 to x = 1.5
+  assert(log.num_events == 10);
+  assert(log.events[0] == CONTACT_ENTER && log.events[1] == CONTACT_ENTER);
+  assert(vec_isclose(log.axes[0], (vector_t){1, 0}));
+  assert(log.events[8] == CONTACT_EXIT && log.events[9] == CONTACT_EXIT);
+  assert(scene_contact_pairs(scene) == 0);
+  assert(scene_get_broadphase_stats(scene).num_updates == 8);
+  scene_free(scene);
+}
+
+// Tests that physics collisions pass straight through sensors
+void test_sensor_collisions() {
+  scene_t *scene = scene_init();
+  body_t *body = body_init(make_shape(), 1, (rgb_color_t){0, 0, 0});
+  body_set_centroid(body, (vector_t){-2.5, 0});
+  body_set_velocity(body, (vector_t){10, 0});
+  scene_add_body(scene, body);
+  body_t *sensor = body_init(make_shape(), 1, (rgb_color_t){0, 0, 0});
+  body_set_sensor(sensor, true);
+  scene_add_body(scene, sensor);
+  create_physics_collision(scene, body, sensor, 1);
+
+  for (int i = 0; i < 10; i++) {
+    scene_tick(scene, 0.1);
+  }
+  assert(vec_isclose(body_get_velocity(body), (vector_t){10, 0}));
+  assert(vec_isclose(body_get_velocity(sensor), VEC_ZERO));
+  assert(vec_isclose(body_get_centroid(body), (vector_t){7.5, 0}));
+  assert(vec_isclose(body_get_centroid(sensor), VEC_ZERO));
+  scene_free(scene);
+}
+
 // Tests that force creators properly register their list of affected bodies.
 // If they don't, asan will report a heap-use-after-free failure.
 void test_forces_removed() {
@@ -151,6 +297,308 @@ void test_forces_removed() {
   scene_free(scene);
 }
 
+// Tests that removing a body drops only the force creators acting on it
+void test_forces_removed_selectively() {
+  scene_t *scene = scene_init();
+  body_t *bodies[3];
+  for (int i = 0; i < 3; i++) {
+    bodies[i] = body_init(make_shape(), 1, (rgb_color_t){0, 0, 0});
+    body_set_velocity(bodies[i], (vector_t){1, 0});
+    scene_add_body(scene, bodies[i]);
+    create_drag(scene, 1, bodies[i]);
+  }
+  // The springs are slack, since all the bodies start at the origin
+  create_spring(scene, 1, bodies[0], bodies[1]);
+  create_spring(scene, 1, bodies[1], bodies[2]);
+  body_remove(bodies[1]);
+  scene_tick(scene, 0.5);
+  scene_tick(scene, 0.5);
+  assert(vec_isclose(body_get_velocity(bodies[0]), (vector_t){0.25, 0}));
+  assert(vec_isclose(body_get_velocity(bodies[2]), (vector_t){0.25, 0}));
+  scene_free(scene);
+}
+
+static void count_calls(void *calls) { (*(size_t *)calls)++; }
+
+static void keep_calls(void *calls) {}
+
+// Force creators registered before their bodies are added to the scene are
+// still dropped when one of the bodies is removed
+void test_forces_added_before_bodies() {
+  scene_t *scene = scene_init();
+  body_t *body1 = body_init(make_shape(), 1, (rgb_color_t){0, 0, 0});
+  body_t *body2 = body_init(make_shape(), 1, (rgb_color_t){0, 0, 0});
+  body_set_centroid(body2, (vector_t){10, 0});
+  create_spring(scene, 1, body1, body2);
+  size_t calls = 0;
+  list_t *bodies = list_init(1, NULL);
+  list_add(bodies, body1);
+  scene_add_owned_force_creator(scene, count_calls, &calls, bodies,
+                                keep_calls);
+  scene_add_body(scene, body1);
+  scene_add_body(scene, body2);
+  scene_tick(scene, 0.1);
+  assert(calls == 1);
+  assert(body_get_velocity(body1).x > 0);
+  // Creators still run on the tick that reclaims the body, but not after
+  body_remove(body1);
+  scene_tick(scene, 0.1);
+  scene_tick(scene, 0.1);
+  assert(calls == 2);
+  assert(scene_bodies(scene) == 1);
+  scene_free(scene);
+}
+
+static scene_t *make_spring_ring(size_t num_threads) {
+  scene_t *scene = scene_init();
+  scene_set_threads(scene, num_threads);
+  for (int i = 0; i < 100; i++) {
+    body_t *body = body_init(make_shape(), 1 + i % 3, (rgb_color_t){0, 0, 0});
+    body_set_centroid(body, (vector_t){10 * cos(i), 10 * sin(i)});
+    scene_add_body(scene, body);
+    create_drag(scene, 0.1, body);
+  }
+  for (int i = 0; i < 100; i++) {
+    body_t *body = scene_get_body(scene, i);
+    create_spring(scene, 2, body, scene_get_body(scene, (i + 1) % 100));
+    create_newtonian_gravity(scene, 5, body,
+                             scene_get_body(scene, (i + 7) % 100));
+  }
+  return scene;
+}
+
+// Tests that parallel ticks match serial ones up to rounding, and are exactly
+// the same from run to run
+void test_parallel_tick() {
+  scene_t *serial = make_spring_ring(1);
+  scene_t *parallel1 = make_spring_ring(4);
+  scene_t *parallel2 = make_spring_ring(4);
+  assert(scene_get_threads(parallel1) == 4);
+  for (int tick = 0; tick < 100; tick++) {
+    scene_tick(serial, 0.01);
+    scene_tick(parallel1, 0.01);
+    scene_tick(parallel2, 0.01);
+  }
+  for (int i = 0; i < 100; i++) {
+    vector_t expected = body_get_centroid(scene_get_body(serial, i));
+    vector_t actual1 = body_get_centroid(scene_get_body(parallel1, i));
+    vector_t actual2 = body_get_centroid(scene_get_body(parallel2, i));
+    assert(vec_isclose(actual1, expected));
+    assert(memcmp(&actual1, &actual2, sizeof(vector_t)) == 0);
+  }
+  scene_free(serial);
+  scene_free(parallel1);
+  scene_free(parallel2);
+}
+
+// Pushes the body in aux by its lowest vertex, reading its cached vertices
+// and bounding box
+static void push_by_vertices(void *aux) {
+  body_t *body = aux;
+  const vector_t *vertices = body_get_vertices(body);
+  double lowest = body_get_aabb(body).min.y;
+  for (size_t i = 0; i < body_num_vertices(body); i++) {
+    lowest = fmin(lowest, vertices[i].y);
+  }
+  body_add_force(body, (vector_t){0, -lowest});
+}
+
+// Tests that parallel creators can all read the same rotated body
+void test_parallel_shared_reads() {
+  scene_t *serial = scene_init();
+  scene_t *parallel = scene_init();
+  scene_set_threads(parallel, 4);
+  body_t *bodies[2];
+  scene_t *scenes[2] = {serial, parallel};
+  for (size_t s = 0; s < 2; s++) {
+    bodies[s] = body_init(make_shape(), 1, (rgb_color_t){0, 0, 0});
+    body_set_rotation(bodies[s], 0.5);
+    scene_add_body(scenes[s], bodies[s]);
+    for (int i = 0; i < 8; i++) {
+      list_t *acted_on = list_init(1, NULL);
+      list_add(acted_on, bodies[s]);
+      scene_add_owned_force_creator(scenes[s], push_by_vertices, bodies[s],
+                                    acted_on, keep_calls);
+    }
+  }
+  for (int tick = 0; tick < 10; tick++) {
+    scene_tick(serial, 0.1);
+    scene_tick(parallel, 0.1);
+  }
+  assert(vec_isclose(body_get_centroid(bodies[1]),
+                     body_get_centroid(bodies[0])));
+  scene_free(serial);
+  scene_free(parallel);
+}
+
+// Returns where a unit mass on a unit spring, let go at x = 1, is after t
+// seconds of ticks of dt
+static double integrate_spring(integrator_t integrator, double dt, double t,
+                               size_t substeps) {
+  scene_t *scene = scene_init();
+  scene_set_integrator(scene, integrator);
+  body_t *mass = body_init(make_shape(), 1, (rgb_color_t){0, 0, 0});
+  body_set_centroid(mass, (vector_t){1, 0});
+  scene_add_body(scene, mass);
+  body_t *anchor = body_init(make_shape(), INFINITY, (rgb_color_t){0, 0, 0});
+  scene_add_body(scene, anchor);
+  create_spring(scene, 1, mass, anchor);
+  scene_set_substeps(scene, mass, substeps);
+  for (size_t i = 0; i < round(t / dt); i++) {
+    scene_tick(scene, dt);
+  }
+  double x = body_get_centroid(mass).x;
+  scene_free(scene);
+  return x;
+}
+
+// Each integrator is as accurate as its order, and its multi-stage versions
+// run the forces at the intermediate states
+void test_integrators() {
+  const double DT = 1e-2;
+  double trapezoidal = integrate_spring(INTEGRATOR_TRAPEZOIDAL, DT, 1, 1);
+  double euler = integrate_spring(INTEGRATOR_SEMI_IMPLICIT_EULER, DT, 1, 1);
+  double verlet = integrate_spring(INTEGRATOR_VELOCITY_VERLET, DT, 1, 1);
+  double rk4 = integrate_spring(INTEGRATOR_RK4, DT, 1, 1);
+  assert(within(1e-3, trapezoidal, cos(1)));
+  assert(within(1e-2, euler, cos(1)));
+  assert(within(1e-5, verlet, cos(1)));
+  assert(within(1e-9, rk4, cos(1)));
+  // Substeps are as accurate as ticks of the same length
+  double substepped = integrate_spring(INTEGRATOR_RK4, 10 * DT, 1, 10);
+  assert(within(1e-12, substepped, rk4));
+}
+
+static body_t *add_square(scene_t *scene, vector_t center) {
+  body_t *body = body_init(make_shape(), 1, (rgb_color_t){0, 0, 0});
+  body_set_centroid(body, center);
+  scene_add_body(scene, body);
+  return body;
+}
+
+// Bodies joined by force creators sleep together once they have settled, and
+// wake together. Static bodies never move.
+void test_sleep() {
+  scene_t *scene = scene_init();
+  scene_set_sleep(scene, 5, 1e-3);
+  body_t *pair1 = add_square(scene, VEC_ZERO);
+  body_t *pair2 = add_square(scene, VEC_ZERO);
+  body_t *alone = add_square(scene, (vector_t){100, 0});
+  body_t *anchor = add_square(scene, (vector_t){-100, 0});
+  body_t *hanging = add_square(scene, (vector_t){-95, 0});
+  body_set_type(anchor, BODY_TYPE_STATIC);
+  assert(body_get_mass(anchor) == INFINITY);
+  body_set_velocity(pair1, (vector_t){1, 0});
+  create_spring(scene, 1, pair1, pair2);
+  create_drag(scene, 1, pair1);
+  create_drag(scene, 1, pair2);
+  create_spring(scene, 1, anchor, hanging);
+  create_drag(scene, 1, hanging);
+
+  for (int tick = 0; tick < 5; tick++) {
+    scene_tick(scene, 0.1);
+  }
+  assert(body_is_sleeping(alone));
+  assert(!body_is_sleeping(pair1) && !body_is_sleeping(pair2));
+  for (int tick = 0; tick < 1000; tick++) {
+    scene_tick(scene, 0.1);
+  }
+  assert(body_is_sleeping(pair1) && body_is_sleeping(pair2));
+  assert(body_is_sleeping(hanging) && !body_is_sleeping(anchor));
+  assert(vec_equal(body_get_centroid(anchor), (vector_t){-100, 0}));
+  // It stops wherever it was when it got slow enough
+  assert(within(1e-2, body_get_centroid(hanging).x, -100));
+  assert(vec_equal(body_get_velocity(pair1), VEC_ZERO));
+
+  // A push wakes the whole island, and nothing else
+  vector_t before = body_get_centroid(pair2);
+  body_add_impulse(pair1, (vector_t){1, 0});
+  scene_tick(scene, 0.1);
+  scene_tick(scene, 0.1);
+  assert(!body_is_sleeping(pair1) && !body_is_sleeping(pair2));
+  assert(body_get_centroid(pair2).x > before.x);
+  assert(body_is_sleeping(alone) && body_is_sleeping(hanging));
+  scene_free(scene);
+}
+
+static scene_t *make_cloud(bool pairwise) {
+  scene_t *scene = scene_init();
+  for (int i = 0; i < 100; i++) {
+    body_t *body = body_init(make_shape(), 1 + i % 3, (rgb_color_t){0, 0, 0});
+    body_set_centroid(body, (vector_t){50 * cos(i), 50 * sin(3 * i)});
+    scene_add_body(scene, body);
+    for (int j = 0; pairwise && j < i; j++) {
+      create_newtonian_gravity(scene, 10, body, scene_get_body(scene, j));
+    }
+  }
+  if (!pairwise) {
+    create_nbody_gravity(scene, 10, 0);
+  }
+  return scene;
+}
+
+// Scene-wide gravity moves bodies just like a creator per pair, and outlives
+// removed bodies
+void test_nbody_gravity() {
+  scene_t *pairs = make_cloud(true);
+  scene_t *nbody = make_cloud(false);
+  for (int tick = 0; tick < 10; tick++) {
+    scene_tick(pairs, 0.01);
+    scene_tick(nbody, 0.01);
+  }
+  for (int i = 0; i < 100; i++) {
+    assert(vec_isclose(body_get_centroid(scene_get_body(nbody, i)),
+                       body_get_centroid(scene_get_body(pairs, i))));
+  }
+  body_t *last = scene_get_body(nbody, 99);
+  body_remove(scene_get_body(nbody, 0));
+  vector_t before = body_get_velocity(last);
+  scene_tick(nbody, 0.01);
+  assert(!vec_isclose(body_get_velocity(last), before));
+  scene_free(pairs);
+  scene_free(nbody);
+}
+
+// Fields act only on bodies in their categories and regions: gravity pulls
+// bodies onto the ground, drag matches create_drag(), and wind stops at the
+// edge of its region
+void test_force_fields() {
+  scene_t *scene = scene_init();
+  body_t *faller = add_square(scene, (vector_t){0, 10});
+  body_t *bystander = add_square(scene, (vector_t){20, 10});
+  body_t *dragged = add_square(scene, (vector_t){40, 0});
+  body_t *drag_creator = add_square(scene, (vector_t){40, 20});
+  body_t *sailer = add_square(scene, (vector_t){60, 0});
+  body_set_collision_filter(faller, 1 << 1, 0);
+  body_set_collision_filter(dragged, 1 << 2, 0);
+  body_set_collision_filter(sailer, 1 << 3, 0);
+  body_set_velocity(dragged, (vector_t){5, 0});
+  body_set_velocity(drag_creator, (vector_t){5, 0});
+  create_gravity_field(scene, 1 << 1, (vector_t){0, -10});
+  create_ground_field(scene, 1 << 1, AABB_EVERYWHERE, 0);
+  create_drag_field(scene, 1 << 2, 0.5);
+  create_drag(scene, 0.5, drag_creator);
+  aabb_t region = {.min = {55, -5}, .max = {65, 5}};
+  create_wind_field(scene, 1 << 3, region, (vector_t){10, 0});
+
+  for (int tick = 0; tick < 300; tick++) {
+    scene_tick(scene, 0.01);
+  }
+  vector_t landed = body_get_centroid(faller);
+  assert(landed.y <= 0 && landed.y > -1);
+  assert(vec_equal(body_get_velocity(faller), VEC_ZERO));
+  assert(vec_equal(body_get_centroid(bystander), (vector_t){20, 10}));
+  assert(vec_isclose(body_get_centroid(dragged),
+                     vec_subtract(body_get_centroid(drag_creator),
+                                  (vector_t){0, 20})));
+  // Pushed out of the region, then left coasting
+  vector_t coasting = body_get_velocity(sailer);
+  assert(body_get_centroid(sailer).x > region.max.x && coasting.x > 0);
+  scene_tick(scene, 0.01);
+  assert(vec_equal(body_get_velocity(sailer), coasting));
+  scene_free(scene);
+}
+
 int main(int argc, char *argv[]) {
   // Run all tests if there are no command-line arguments
   bool all_tests = argc == 1;
@@ -163,7 +611,19 @@ int main(int argc, char *argv[]) {
   DO_TEST(test_spring_sinusoid)
   DO_TEST(test_energy_conservation)
   DO_TEST(test_collisions)
+  DO_TEST(test_fast_collisions)
+  DO_TEST(test_contact_events)
+  DO_TEST(test_type_handlers)
+  DO_TEST(test_sensor_collisions)
   DO_TEST(test_forces_removed)
+  DO_TEST(test_forces_removed_selectively)
+  DO_TEST(test_forces_added_before_bodies)
+  DO_TEST(test_parallel_tick)
+  DO_TEST(test_parallel_shared_reads)
+  DO_TEST(test_integrators)
+  DO_TEST(test_sleep)
+  DO_TEST(test_nbody_gravity)
+  DO_TEST(test_force_fields)
 
   puts("forces_test PASS");
 }
@@ -0,0 +1,120 @@
+#include "scene.h"
+#include "test_util.h"
+#include <assert.h>
+#include <stdlib.h>
+
+// The number of generations a handle slot goes through before wrapping
+const size_t GENERATIONS = (1 << 12) - 1;
+
+list_t *make_shape() {
+  list_t *shape = list_init(4, free);
+  vector_t *v = malloc(sizeof(*v));
+  *v = (vector_t){-1, -1};
+  list_add(shape, v);
+  v = malloc(sizeof(*v));
+  *v = (vector_t){+1, -1};
+  list_add(shape, v);
+  v = malloc(sizeof(*v));
+  *v = (vector_t){+1, +1};
+  list_add(shape, v);
+  v = malloc(sizeof(*v));
+  *v = (vector_t){-1, +1};
+  list_add(shape, v);
+  return shape;
+}
+
+// Removes a body and lets the scene free it, invalidating its handle
+void free_body(scene_t *scene, body_t *body) {
+  body_remove(body);
+  scene_tick(scene, 0);
+}
+
+// Handles stay stable across removals and go stale once their body is freed
+void test_body_handles() {
+  scene_t *scene = scene_init();
+  body_t *bodies[3];
+  body_handle_t handles[3];
+  int data[3];
+  for (int i = 0; i < 3; i++) {
+    bodies[i] = body_init(make_shape(), 1, (rgb_color_t){0, 0, 0});
+    handles[i] = scene_add_body(scene, bodies[i]);
+    assert(handles[i] != BODY_HANDLE_NONE);
+    assert(body_get_handle(bodies[i]) == handles[i]);
+    scene_set_handle_data(scene, handles[i], 1, &data[i]);
+  }
+  assert(scene_resolve_body(scene, BODY_HANDLE_NONE) == NULL);
+
+  free_body(scene, bodies[0]);
+  assert(scene_resolve_body(scene, handles[0]) == NULL);
+  assert(scene_get_handle_data(scene, handles[0], 1) == NULL);
+  for (int i = 1; i < 3; i++) {
+    assert(scene_resolve_body(scene, handles[i]) == bodies[i]);
+    assert(scene_get_handle_data(scene, handles[i], 1) == &data[i]);
+    assert(scene_get_handle_data(scene, handles[i], 0) == NULL);
+  }
+
+  // A new body reuses the freed slot under a different handle
+  body_t *body = body_init(make_shape(), 1, (rgb_color_t){0, 0, 0});
+  body_handle_t handle = scene_add_body(scene, body);
+  assert(handle != handles[0]);
+  assert(scene_resolve_body(scene, handle) == body);
+  assert(scene_resolve_body(scene, handles[0]) == NULL);
+  assert(scene_get_handle_data(scene, handle, 1) == NULL);
+  scene_free(scene);
+}
+
+// Setting data on a stale handle does not touch the slot's new body
+void test_stale_handle_data() {
+  scene_t *scene = scene_init();
+  body_t *body = body_init(make_shape(), 1, (rgb_color_t){0, 0, 0});
+  body_handle_t stale = scene_add_body(scene, body);
+  free_body(scene, body);
+
+  body = body_init(make_shape(), 1, (rgb_color_t){0, 0, 0});
+  body_handle_t handle = scene_add_body(scene, body);
+  int data;
+  scene_set_handle_data(scene, stale, 0, &data);
+  assert(scene_get_handle_data(scene, stale, 0) == NULL);
+  assert(scene_get_handle_data(scene, handle, 0) == NULL);
+  scene_free(scene);
+}
+
+// Reusing one slot past its last generation wraps around without ever
+// producing BODY_HANDLE_NONE, and every handle goes stale on reuse
+void test_generation_wrap() {
+  scene_t *scene = scene_init();
+  body_t *body = body_init(make_shape(), 1, (rgb_color_t){0, 0, 0});
+  body_handle_t first = scene_add_body(scene, body);
+  body_handle_t last = first;
+  for (size_t i = 1; i <= GENERATIONS; i++) {
+    free_body(scene, body);
+    assert(scene_resolve_body(scene, last) == NULL);
+    body = body_init(make_shape(), 1, (rgb_color_t){0, 0, 0});
+    body_handle_t handle = scene_add_body(scene, body);
+    assert(handle != BODY_HANDLE_NONE);
+    assert(handle != last);
+    assert(scene_resolve_body(scene, handle) == body);
+    assert(scene_resolve_body(scene, last) == NULL);
+    last = handle;
+  }
+  // After a full cycle the slot is back to its first generation
+  assert(last == first);
+  assert(scene_resolve_body(scene, first) == body);
+  scene_free(scene);
+}
+
+int main(int argc, char *argv[]) {
+  // Run all tests if there are no command-line arguments
+  bool all_tests = argc == 1;
+  // Read test name from file
+  char testname[100];
+  if (!all_tests) {
+    read_testname(argv[1], testname, sizeof(testname));
+  }
+
+  DO_TEST(test_body_handles)
+  DO_TEST(test_stale_handle_data)
+  DO_TEST(test_generation_wrap)
+
+  puts("handle_test PASS");
+}
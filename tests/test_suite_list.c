@@ -245,6 +245,74 @@ void test_null_values() {
   list_free(l);
 }
 
+bool vec_x_is_odd(void *value, void *aux) {
+  return (long)((vector_t *)value)->x % 2 == 1;
+}
+
+// Bulk removal keeps survivors in order and frees what it removes
+void test_remove_if() {
+  list_t *l = list_init(4, free);
+  for (size_t i = 0; i < 10; i++) {
+    vector_t *v = malloc(sizeof(*v));
+    *v = (vector_t){i, i};
+    list_add(l, v);
+  }
+  assert(list_remove_if(l, vec_x_is_odd, NULL, free) == 5);
+  assert(list_size(l) == 5);
+  for (size_t i = 0; i < 5; i++) {
+    assert(vec_equal(*(vector_t *)list_get(l, i), (vector_t){2 * i, 2 * i}));
+  }
+  // A NULL predicate removes everything
+  assert(list_remove_if(l, NULL, NULL, free) == 5);
+  assert(list_size(l) == 0);
+  list_free(l);
+}
+
+// Swap removal fills holes from the end of the list
+void test_swap_remove() {
+  list_t *l = list_init(4, free);
+  for (size_t i = 0; i < 10; i++) {
+    vector_t *v = malloc(sizeof(*v));
+    *v = (vector_t){i, i};
+    list_add(l, v);
+  }
+  vector_t *v = list_swap_remove(l, 2);
+  assert(vec_equal(*v, (vector_t){2, 2}));
+  free(v);
+  assert(list_size(l) == 9);
+  assert(vec_equal(*(vector_t *)list_get(l, 2), (vector_t){9, 9}));
+  list_swap(l, 0, 2);
+  list_swap(l, 1, 1);
+  assert(vec_equal(*(vector_t *)list_get(l, 0), (vector_t){9, 9}));
+  assert(vec_equal(*(vector_t *)list_get(l, 1), (vector_t){1, 1}));
+  assert(vec_equal(*(vector_t *)list_get(l, 2), (vector_t){0, 0}));
+
+  assert(list_swap_remove_if(l, vec_x_is_odd, NULL, free) == 5);
+  assert(list_size(l) == 4);
+  double sum = 0;
+  for (size_t i = 0; i < list_size(l); i++) {
+    vector_t *w = list_get(l, i);
+    assert((long)w->x % 2 == 0);
+    sum += w->x;
+  }
+  assert(sum == 0 + 4 + 6 + 8);
+  assert(list_swap_remove_if(l, NULL, NULL, free) == 4);
+  assert(list_size(l) == 0);
+  list_free(l);
+}
+
+// Clearing a list removes every element, not every other one
+void test_remove_entire_list() {
+  list_t *l = list_init(4, free);
+  vector_t v[7];
+  for (size_t i = 0; i < 7; i++) {
+    list_add(l, &v[i]);
+  }
+  remove_entire_list(l);
+  assert(list_size(l) == 0);
+  list_free(l);
+}
+
 int main(int argc, char *argv[]) {
   // Run all tests if there are no command-line arguments
   bool all_tests = argc == 1;
@@ -263,6 +331,9 @@ int main(int argc, char *argv[]) {
   DO_TEST(test_full_add)
   DO_TEST(test_empty_remove)
   DO_TEST(test_null_values)
+  DO_TEST(test_remove_if)
+  DO_TEST(test_swap_remove)
+  DO_TEST(test_remove_entire_list)
 
   puts("list_test PASS");
 }
@@ -0,0 +1,103 @@
+#include "nbody.h"
+#include "test_util.h"
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+
+#define NUM_MASSES 2000
+
+static vector_t POSITIONS[NUM_MASSES];
+static double MASSES[NUM_MASSES];
+static vector_t EXACT[NUM_MASSES];
+static vector_t APPROX[NUM_MASSES];
+
+static void random_masses(size_t num_masses) {
+  srand(3);
+  for (size_t i = 0; i < num_masses; i++) {
+    // Clustered, so the tree gets deep in places
+    double spread = i % 4 == 0 ? 1000 : 50;
+    POSITIONS[i] = (vector_t){spread * rand() / RAND_MAX,
+                              spread * rand() / RAND_MAX};
+    MASSES[i] = 1 + rand() % 10;
+  }
+}
+
+// Returns the error in the forces, relative to the average force
+static double relative_error(size_t num_masses) {
+  double error = 0;
+  double size = 0;
+  for (size_t i = 0; i < num_masses; i++) {
+    error += vec_get_length(vec_subtract(APPROX[i], EXACT[i]));
+    size += vec_get_length(EXACT[i]);
+  }
+  return error / size;
+}
+
+// The exact sum matches the force between each pair, skips pairs that are
+// too close, and has no net force
+void test_nbody_exact() {
+  nbody_t *solver = nbody_init();
+  vector_t positions[] = {{0, 0}, {3, 4}, {0, -10}, {0.5, 0}};
+  double masses[] = {2, 5, 1, 7};
+  vector_t forces[4];
+  nbody_forces(solver, 4, positions, masses, 3, 0, 1, forces);
+  // The last mass is too close to the first to pull on it
+  vector_t expected =
+      vec_add(vec_multiply(3 * 2 * 5 / 125.0, (vector_t){3, 4}),
+              vec_multiply(3 * 2 * 1 / 1000.0, (vector_t){0, -10}));
+  assert(vec_isclose(forces[0], expected));
+  vector_t total = VEC_ZERO;
+  for (size_t i = 0; i < 4; i++) {
+    total = vec_add(total, forces[i]);
+  }
+  assert(vec_isclose(total, VEC_ZERO));
+  assert(nbody_num_cells(solver) == 0);
+  nbody_free(solver);
+}
+
+// Barnes-Hut gets closer to the exact sum as theta shrinks
+void test_nbody_barnes_hut() {
+  random_masses(NUM_MASSES);
+  nbody_t *solver = nbody_init();
+  nbody_forces(solver, NUM_MASSES, POSITIONS, MASSES, 1, 0, 0.1, EXACT);
+  nbody_forces(solver, NUM_MASSES, POSITIONS, MASSES, 1, 0.5, 0.1, APPROX);
+  assert(nbody_num_cells(solver) > 0);
+  double coarse = relative_error(NUM_MASSES);
+  assert(coarse < 1e-2);
+  nbody_forces(solver, NUM_MASSES, POSITIONS, MASSES, 1, 0.1, 0.1, APPROX);
+  assert(relative_error(NUM_MASSES) < coarse / 10);
+  // A tiny theta opens every cell, which is exact up to rounding
+  nbody_forces(solver, NUM_MASSES, POSITIONS, MASSES, 1, 1e-9, 0.1, APPROX);
+  assert(relative_error(NUM_MASSES) < 1e-12);
+  nbody_free(solver);
+}
+
+// Masses at the same point share a leaf rather than splitting it forever
+void test_nbody_coincident() {
+  for (size_t i = 0; i < 100; i++) {
+    POSITIONS[i] = (vector_t){i < 50 ? 1 : 2, 0};
+    MASSES[i] = 1;
+  }
+  nbody_t *solver = nbody_init();
+  nbody_forces(solver, 100, POSITIONS, MASSES, 1, 0.5, 0.5, APPROX);
+  for (size_t i = 0; i < 100; i++) {
+    assert(vec_isclose(APPROX[i], (vector_t){i < 50 ? 50 : -50, 0}));
+  }
+  nbody_free(solver);
+}
+
+int main(int argc, char *argv[]) {
+  // Run all tests if there are no command-line arguments
+  bool all_tests = argc == 1;
+  // Read test name from file
+  char testname[100];
+  if (!all_tests) {
+    read_testname(argv[1], testname, sizeof(testname));
+  }
+
+  DO_TEST(test_nbody_exact)
+  DO_TEST(test_nbody_barnes_hut)
+  DO_TEST(test_nbody_coincident)
+
+  puts("nbody_test PASS");
+}
@@ -0,0 +1,105 @@
+#include "body.h"
+#include "pool.h"
+#include "test_util.h"
+#include <assert.h>
+#include <stdalign.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+void test_pool_reuses_blocks() {
+  pool_t *pool = pool_init(sizeof(double), 4);
+  pool_stats_t stats = pool_get_stats(pool);
+  assert(stats.in_use == 0 && stats.capacity == 0 && stats.num_chunks == 0);
+
+  double *a = pool_alloc(pool);
+  double *b = pool_alloc(pool);
+  assert(a != b);
+  *a = 1;
+  *b = 2;
+  pool_release(pool, a);
+  // The most recently released block is handed out first
+  assert(pool_alloc(pool) == a);
+  assert(*b == 2);
+
+  stats = pool_get_stats(pool);
+  assert(stats.in_use == 2);
+  assert(stats.peak_in_use == 2);
+  assert(stats.capacity == 4);
+  assert(stats.num_chunks == 1);
+  pool_release(pool, NULL);
+  pool_free(pool);
+}
+
+void test_pool_grows() {
+  const size_t n = 1000;
+  pool_t *pool = pool_init(3, 16);
+  char *blocks[n];
+  for (size_t i = 0; i < n; i++) {
+    blocks[i] = pool_alloc(pool);
+    assert((uintptr_t)blocks[i] % alignof(max_align_t) == 0);
+    blocks[i][0] = i % 128;
+  }
+  for (size_t i = 0; i < n; i++) {
+    assert(blocks[i][0] == (char)(i % 128));
+  }
+  pool_stats_t stats = pool_get_stats(pool);
+  assert(stats.in_use == n);
+  assert(stats.capacity >= n);
+  assert(stats.num_chunks == (n + 15) / 16);
+
+  // Releasing and reallocating everything does not grow the pool
+  for (size_t i = 0; i < n; i++) {
+    pool_release(pool, blocks[i]);
+  }
+  for (size_t i = 0; i < n; i++) {
+    blocks[i] = pool_alloc(pool);
+  }
+  assert(pool_get_stats(pool).num_chunks == stats.num_chunks);
+  assert(pool_get_stats(pool).peak_in_use == n);
+  pool_free(pool);
+}
+
+// Spawning and despawning bodies in steady state stops growing the pools
+void test_body_churn_reuses_pools() {
+  vector_t square[] = {{0, 0}, {1, 0}, {1, 1}, {0, 1}};
+  body_t *bodies[10];
+  for (size_t i = 0; i < 10; i++) {
+    bodies[i] = body_init_from_vertices(square, 4, 1, (rgb_color_t){0, 0, 0},
+                                        NULL, NULL);
+  }
+  pool_stats_t body_stats = body_pool_stats();
+  pool_stats_t polygon_stats = polygon_pool_stats();
+  pool_stats_t vertex_stats = polygon_vertex_pool_stats();
+  pool_stats_t color_stats = color_pool_stats();
+  assert(body_stats.in_use >= 10);
+  for (size_t frame = 0; frame < 100; frame++) {
+    size_t i = frame % 10;
+    body_free(bodies[i]);
+    bodies[i] = body_init_from_vertices(square, 4, 1, (rgb_color_t){0, 0, 0},
+                                        NULL, NULL);
+  }
+  assert(body_pool_stats().num_chunks == body_stats.num_chunks);
+  assert(polygon_pool_stats().num_chunks == polygon_stats.num_chunks);
+  assert(polygon_vertex_pool_stats().num_chunks == vertex_stats.num_chunks);
+  assert(color_pool_stats().num_chunks == color_stats.num_chunks);
+  for (size_t i = 0; i < 10; i++) {
+    body_free(bodies[i]);
+  }
+  assert(body_pool_stats().in_use == body_stats.in_use - 10);
+}
+
+int main(int argc, char *argv[]) {
+  // Run all tests if there are no command-line arguments
+  bool all_tests = argc == 1;
+  // Read test name from file
+  char testname[100];
+  if (!all_tests) {
+    read_testname(argv[1], testname, sizeof(testname));
+  }
+
+  DO_TEST(test_pool_reuses_blocks)
+  DO_TEST(test_pool_grows)
+  DO_TEST(test_body_churn_reuses_pools)
+
+  puts("pool_test PASS");
+}
@@ -0,0 +1,69 @@
+#include "scheduler.h"
+#include "test_util.h"
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+
+// A frame rate that isn't a multiple of the tick rate still simulates exactly
+// as much time as has passed, with the rest carried over in the alpha
+void test_scheduler_accumulates() {
+  scheduler_t *scheduler = scheduler_init(120, 8);
+  assert(within(1e-12, scheduler_get_dt(scheduler), 1.0 / 120));
+  size_t ticks = 0;
+  for (size_t frame = 0; frame < 50; frame++) {
+    ticks += scheduler_advance(scheduler, 1.0 / 50);
+    double simulated = ticks * scheduler_get_dt(scheduler);
+    double alpha = scheduler_get_alpha(scheduler);
+    assert(0 <= alpha && alpha < 1);
+    double left = (frame + 1) / 50.0 - simulated;
+    assert(within(1e-9, alpha * scheduler_get_dt(scheduler), left));
+  }
+  // One second at 120 Hz
+  assert(ticks == 120 && scheduler_get_ticks(scheduler) == 120);
+  // Frames a whole number of ticks long run all of them despite rounding
+  for (size_t frame = 0; frame < 100; frame++) {
+    assert(scheduler_advance(scheduler, 1.0 / 60) == 2);
+  }
+  scheduler_free(scheduler);
+}
+
+// A long frame runs at most max_substeps ticks and drops the rest
+void test_scheduler_caps_substeps() {
+  scheduler_t *scheduler = scheduler_init(100, 4);
+  assert(scheduler_advance(scheduler, 0.105) == 4);
+  assert(within(1e-9, scheduler_get_dropped(scheduler), 0.06));
+  assert(within(1e-9, scheduler_get_alpha(scheduler), 0.5));
+  assert(scheduler_advance(scheduler, 0.005) == 1);
+  assert(within(1e-9, scheduler_get_alpha(scheduler), 0));
+  scheduler_free(scheduler);
+}
+
+// The first frame runs nothing, and the clock only moves forwards
+void test_scheduler_clock() {
+  scheduler_t *scheduler = scheduler_init(1e6, 1);
+  assert(scheduler_frame(scheduler) == 0);
+  double start = scheduler_now();
+  double now;
+  do {
+    now = scheduler_now();
+    assert(now >= start);
+  } while (now - start < 1e-3);
+  assert(scheduler_frame(scheduler) == 1);
+  scheduler_free(scheduler);
+}
+
+int main(int argc, char *argv[]) {
+  // Run all tests if there are no command-line arguments
+  bool all_tests = argc == 1;
+  // Read test name from file
+  char testname[100];
+  if (!all_tests) {
+    read_testname(argv[1], testname, sizeof(testname));
+  }
+
+  DO_TEST(test_scheduler_accumulates)
+  DO_TEST(test_scheduler_caps_substeps)
+  DO_TEST(test_scheduler_clock)
+
+  puts("scheduler_test PASS");
+}
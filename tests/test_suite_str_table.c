@@ -0,0 +1,67 @@
+#include "str_table.h"
+#include "test_util.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void test_intern_assigns_ids_in_order() {
+  str_table_t *table = str_table_init(0);
+  assert(str_table_size(table) == 0);
+  assert(str_table_intern(table, "assets/a.png") == 0);
+  assert(str_table_intern(table, "assets/b.png") == 1);
+  assert(str_table_intern(table, "assets/a.png") == 0);
+  assert(str_table_size(table) == 2);
+  assert(strcmp(str_table_get(table, 1), "assets/b.png") == 0);
+  str_table_free(table);
+}
+
+void test_find() {
+  str_table_t *table = str_table_init(4);
+  char path[32] = "assets/a.png";
+  str_table_intern(table, path);
+  // The table keeps its own copy of the string
+  path[7] = 'z';
+  size_t id = 1;
+  assert(!str_table_find(table, path, &id));
+  assert(id == 1);
+  assert(str_table_find(table, "assets/a.png", &id));
+  assert(id == 0);
+  str_table_free(table);
+}
+
+// IDs and strings survive the index growing many times over
+void test_ids_stable_across_growth() {
+  const size_t n = 10000;
+  str_table_t *table = str_table_init(1);
+  char path[32];
+  for (size_t i = 0; i < n; i++) {
+    snprintf(path, sizeof(path), "assets/%zu.png", i);
+    assert(str_table_intern(table, path) == i);
+  }
+  assert(str_table_size(table) == n);
+  for (size_t i = 0; i < n; i++) {
+    snprintf(path, sizeof(path), "assets/%zu.png", i);
+    size_t id;
+    assert(str_table_find(table, path, &id));
+    assert(id == i);
+    assert(strcmp(str_table_get(table, i), path) == 0);
+  }
+  str_table_free(table);
+}
+
+int main(int argc, char *argv[]) {
+  // Run all tests if there are no command-line arguments
+  bool all_tests = argc == 1;
+  // Read test name from file
+  char testname[100];
+  if (!all_tests) {
+    read_testname(argv[1], testname, sizeof(testname));
+  }
+
+  DO_TEST(test_intern_assigns_ids_in_order)
+  DO_TEST(test_find)
+  DO_TEST(test_ids_stable_across_growth)
+
+  puts("str_table_test PASS");
+}